@@ -10,12 +10,14 @@
 #include "camera.h"
 #include "feeds.h"
 #include "earth.h"
+#include "earth_index.h"
 #include "worker.h"
 #include "ui_ctrlr.h"
 #include "audio.h"
 #include "settings.h"
 #include "webview.h"
 #include "metrics.h"
+#include "../engine/utility/cx_varmod.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -30,6 +32,9 @@
 #define CAMERA_START_FOV                      (50.0f)
 #define CLOCK_UPDATE_INTERVAL_SECONDS         (30.0f)
 #define CITY_INDEX_INVALID                    (-1)
+#define TEXTURE_STREAM_BYTES_PER_FRAME        (1024 * 1024)
+#define DEBUG_VARMOD_INTERVAL_SECONDS         (1.0f)
+#define DEBUG_VARMOD_LOG                      (0)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -65,7 +70,8 @@ typedef enum
 typedef struct
 {
   cx_vec4 *renderPos;
-  cx_vec2 *opacity; // x - point, y - text
+  cx_vec2 *opacity; // x - text, y - point
+  cxu8 *visible;    // in front of the eye, on screen and facing
 } render2d_t;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -74,6 +80,7 @@ typedef struct
 
 static camera_t       *g_camera = NULL;
 static render2d_t      g_render2dInfo;
+static earth_index_t  *g_cityIndex = NULL;
 
 #define NEW_ROTATION 1
 
@@ -143,6 +150,7 @@ static void app_input_touch_moved (float x, float y, float px, float py);
 static void app_input_touch_ended (float x, float y);
 static void app_input_zoom (float factor);
 static int  app_input_touch_earth (float screenX, float screenY, float screenWidth, float screenHeight);
+static bool app_input_touch_earth_filter (int index, void *userdata);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -183,7 +191,10 @@ static void app_render_load (void);
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void app_test_code (void);
+static void app_file_async_dispatch (cx_file_async_func func, void *userdata)
+{
+  worker_task_release (worker_task_submit (func, userdata, TASK_PRIORITY_NORMAL));
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -215,6 +226,8 @@ static cx_thread_exit_status app_init_load (void *userdata)
   
   settings_set_city_names (cityNames, cityCount);
   
+  g_cityIndex = earth_index_create (earth_data_get_position (0), cityCount);
+  
   g_glowTex = cx_texture_create_from_file ("data/images/earth/glowcircle.gb25-16.png", CX_FILE_STORAGE_BASE_RESOURCE, false);
   
   //
@@ -242,6 +255,9 @@ static cx_thread_exit_status app_init_load (void *userdata)
   g_render2dInfo.opacity = cx_malloc (sizeof (cx_vec2) * cityCount);
   memset (g_render2dInfo.opacity, 0, (sizeof (cx_vec2) * cityCount));
   
+  g_render2dInfo.visible = cx_malloc (sizeof (cxu8) * cityCount);
+  memset (g_render2dInfo.visible, 0, (sizeof (cxu8) * cityCount));
+  
   //
   // other
   //
@@ -292,8 +308,25 @@ void app_init (void *rootvc, void *gctx, int width, int height)
   
   cx_engine_init (CX_ENGINE_INIT_ALL, &params);
   
+  //
+  // debug variables
+  //
+  
+  cx_varmod_settings varmodSettings;
+  varmodSettings.renderFunc = NULL;
+  
+  cx_varmod_init (&varmodSettings);
+  
   g_appState = APP_STATE_INIT;
   
+  //
+  // worker
+  //
+  
+  worker_init ();
+  
+  cx_file_storage_set_async_dispatcher (app_file_async_dispatch);
+  
   //
   // metrics
   //
@@ -372,6 +405,12 @@ void app_init (void *rootvc, void *gctx, int width, int height)
 
 void app_deinit (void)
 {
+  if (g_cityIndex)
+  {
+    earth_index_destroy (g_cityIndex);
+    g_cityIndex = NULL;
+  }
+  
   feeds_deinit ();
   
   input_deinit ();
@@ -380,6 +419,12 @@ void app_deinit (void)
   
   metrics_deinit ();
   
+  cx_file_storage_set_async_dispatcher (NULL);
+  
+  worker_deinit ();
+  
+  cx_varmod_deinit ();
+  
   cx_engine_deinit ();
 }
 
@@ -444,6 +489,8 @@ void app_update (void)
       
       app_update_feeds ();
       
+      cx_texture_stream_update (TEXTURE_STREAM_BYTES_PER_FRAME);
+      
       break;
     }
       
@@ -878,35 +925,8 @@ static void app_update_camera (void)
   
 #endif // END_ROTATION
   
-  cx_vec4_set (&g_camera->position, 0.0f, 0.0f, -2.0f, 1.0f);
-  cx_vec4_set (&g_camera->target, 0.0f, 0.0f, 0.0f, 1.0f);
-  
   // update camera (view and projetion matrix)
-
-  // set rotation
-  cx_vec4 center = {{0.0f, 0.0f, 0.0f, 1.0f}};
-  cx_vec4 axis_x = {{1.0f, 0.0f, 0.0f, 0.0f}};
-  cx_vec4 axis_y = {{0.0f, 1.0f, 0.0f, 0.0f}};
-  
-  camera_rotate_around_point (g_camera, &center, cx_rad (roty), &axis_x);
-  camera_rotate_around_point (g_camera, &center, cx_rad (-rotx), &axis_y);
-  
-  // get projection matrix
-  cx_mat4x4 projmatrix;
-  camera_get_projection_matrix (g_camera, &projmatrix);
-  
-  // get view matrix
-  cx_mat4x4 viewmatrix;
-  camera_get_view_matrix (g_camera, &viewmatrix);
-  
-  // compute modelviewprojection matrix
-  cx_mat4x4 mvpMatrix;
-  cx_mat4x4_mul (&mvpMatrix, &projmatrix, &viewmatrix);
-  
-  //camera_update (g_camera, deltaTime);
-  cx_gdi_set_transform (CX_GDI_TRANSFORM_P, &projmatrix);
-  cx_gdi_set_transform (CX_GDI_TRANSFORM_MV, &viewmatrix);
-  cx_gdi_set_transform (CX_GDI_TRANSFORM_MVP, &mvpMatrix);
+  camera_orbit (g_camera, rotx, roty);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -946,10 +966,6 @@ static void app_update_earth (void)
   camera_get_projection_matrix (g_camera, &proj);
   camera_get_view_matrix (g_camera, &view);
   
-  // for each point, get 2d point
-  float depth, scale;
-  cx_vec2 screen;
-  
   float zfar = CAMERA_PROJECTION_ORTHOGRAPHIC_FAR;
   float znear = CAMERA_PROJECTION_ORTHOGRAPHIC_NEAR;
   
@@ -959,35 +975,55 @@ static void app_update_earth (void)
   cx_vec4_sub (&look, &g_camera->position, &g_camera->target); // use inverse direction vector for dot product calcuation
   cx_vec4_normalize (&look);
   
-  for (i = 0, c = earth_data_get_count (); i < c; ++i)
+  // get 2d points and facing opacity (x - text, y - point) for all points in one pass
+  
+  const cx_vec4 fade = {{ 0.95f, 1.0f, 0.80f, 1.0f }};
+  
+  // grow the viewport by the half-extent of the largest (nearest) point sprite so points at the edges
+  // aren't dropped while still partly on screen. size as points_tex.vsh: u_sw * proj (0.01 * size * 0.5) / z
+  
+  const cx_vec4 *eye = &g_camera->position;
+  
+  float eyeDist = cx_sqrt ((eye->x * eye->x) + (eye->y * eye->y) + (eye->z * eye->z));
+  float nearest = cx_max (eyeDist - earth_index_get_radius (g_cityIndex), CX_EPSILON);
+  float pointSize = g_isRetina ? 3.0f : 2.0f; // as app_render_3d_earth
+  float pointHalfExtent = 0.5f * (screenHeight * 0.5f) * (proj.f16 [0] * 0.005f * pointSize) / nearest;
+  
+  const cx_vec2 margin = {{ pointHalfExtent, pointHalfExtent }};
+  
+  c = earth_data_get_count ();
+  
+  cx_util_world_space_to_screen_space_batch (screenWidth, screenHeight, &proj, &view, earth_data_get_position (0), 
+                                             earth_data_get_normal (0), c, &look, &fade, &margin, 
+                                             g_render2dInfo.renderPos, g_render2dInfo.opacity, g_render2dInfo.visible);
+  
+  if (earth_data_validate_index (g_selectedCity))
   {
-    const cx_vec4 *pos = earth_data_get_position (i);
-    const cx_vec4 *nor = earth_data_get_normal (i);
+    float depth, scale;
+    cx_vec2 screen;
     
-    cx_vec4 spos;
+    cx_vec4 spos, snor;
+    cx_vec4_mul (&snor, 0.035f, earth_data_get_normal (g_selectedCity));
+    cx_vec4_add (&spos, earth_data_get_position (g_selectedCity), &snor);
     
-    if (i == g_selectedCity)
-    {
-      cx_vec4 snor;
-      cx_vec4_mul (&snor, 0.035f, nor);
-      cx_vec4_add (&spos, pos, &snor);
+    cx_util_world_space_to_screen_space (screenWidth, screenHeight, &proj, &view, &spos, &screen, &depth, &scale);
     
-      pos = &spos;
-    }
-    
-    cx_util_world_space_to_screen_space (screenWidth, screenHeight, &proj, &view, pos, &screen, &depth, &scale);
+    cx_vec4_set (&g_render2dInfo.renderPos [g_selectedCity], screen.x, screen.y, depth, scale);
+  }
+  
+  for (i = 0; i < c; ++i)
+  {
+    float depth = g_render2dInfo.renderPos [i].z;
+    float scale = g_render2dInfo.renderPos [i].w;
     
     float clipz = (2.0f * depth) - 1.0f;
     float z = ((clipz + (zfar + znear) / (zfar - znear)) * (zfar - znear)) / -2.0f;
     
-    g_render2dInfo.renderPos [i].x = screen.x;
-    g_render2dInfo.renderPos [i].y = screen.y;
     g_render2dInfo.renderPos [i].z = z;
     g_render2dInfo.renderPos [i].w = scale * 0.7f;
     
-    float dotp = cx_max (0.0f, cx_vec4_dot (nor, &look));
-    float alphaText = cx_smoothstep (0.95f, 1.0f, dotp);
-    float alphaPoint = cx_smoothstep (0.80f, 1.0f, dotp);
+    float alphaText = g_render2dInfo.opacity [i].x;
+    float alphaPoint = g_render2dInfo.opacity [i].y;
     
     g_render2dInfo.opacity [i].x = (i == g_selectedCity) ? (opacity * alphaPoint) : (opacity * alphaText);
     g_render2dInfo.opacity [i].y = opacity * alphaPoint;
@@ -1309,15 +1345,6 @@ static void app_render_3d (void)
 
 static void app_render_3d_earth (void)
 {
-  // earth
-  earth_render (&g_camera->position, &g_dateUTC);
-
-  // points
-  cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_CULL | CX_GDI_RENDER_STATE_BLEND | CX_GDI_RENDER_STATE_DEPTH_TEST);
-  cx_gdi_set_blend_mode (CX_GDI_BLEND_MODE_SRC_ALPHA, CX_GDI_BLEND_MODE_ONE_MINUS_SRC_ALPHA);
-  cx_gdi_enable_z_write (false);
-  
-  // draw points
   float opacity = g_feedsOSDZoomOpacity;
   
   // gather points
@@ -1332,7 +1359,7 @@ static void app_render_3d_earth (void)
   
   for (int i = 0; i < cityCount; ++i)
   {
-    bool display = settings_get_city_display (i);
+    bool display = settings_get_city_display (i) && g_render2dInfo.visible [i];
     
     if (display)
     {
@@ -1371,16 +1398,14 @@ static void app_render_3d_earth (void)
   // draw points
   static bool hackReadyDraw = false; // haven't quite figured the bug that has given birth to this hack
 
-  if (hackReadyDraw)
-  {
-    cx_draw_points (displayCount, loc, col, g_glowTex, g_isRetina ? 3.0f : 2.0f);
-  }
-  else
+  if (!hackReadyDraw)
   {
+    displayCount = 0;
     hackReadyDraw = true;
   }
-
-  cx_gdi_enable_z_write (true);
+  
+  // earth and points
+  earth_render_scene (&g_camera->position, &g_dateUTC, displayCount, loc, col, g_glowTex, g_isRetina ? 3.0f : 2.0f);
   
   // debug
 #if (CX_DEBUG && 0)
@@ -1503,6 +1528,9 @@ static void app_render_2d (void)
   // render earth icons
   app_render_2d_earth ();
   
+  // ui quads are queued and sorted by texture, text flushes them to keep draw order
+  cx_draw_batch_begin ();
+  
   // render feeds
   app_render_2d_feeds ();
   
@@ -1515,6 +1543,22 @@ static void app_render_2d (void)
   // logo
   app_render_2d_logo ();
   
+  cx_draw_batch_end ();
+  
+#if (CX_DEBUG && DEBUG_VARMOD_LOG)
+  // debug variables (set DEBUG_VARMOD_LOG to see them), logged at an interval to keep the console readable
+  static float varmodTime = 0.0f;
+  
+  varmodTime += (float) cx_system_time_get_delta_time ();
+  
+  if (varmodTime >= DEBUG_VARMOD_INTERVAL_SECONDS)
+  {
+    cx_varmod_render ();
+    
+    varmodTime = 0.0f;
+  }
+#endif
+  
   //////////////
   // end
   //////////////
@@ -1702,6 +1746,10 @@ static void app_render_2d_earth (void)
   cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_BLEND | CX_GDI_RENDER_STATE_DEPTH_TEST);
   cx_gdi_enable_z_write (true);
   
+  // labels are queued and drawn once per font at the end, after the icons
+  cx_font_batch_begin ();
+  cx_draw_batch_begin ();
+  
   int unitType = settings_get_temperature_unit ();
   char tempUnit [4];
   
@@ -1917,6 +1965,9 @@ static void app_render_2d_earth (void)
   }
 #endif
   
+  cx_draw_batch_end ();
+  cx_font_batch_end ();
+  
   cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_BLEND);
   cx_gdi_enable_z_write (false);
 }
@@ -2170,6 +2221,17 @@ static void app_input_zoom (float factor)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static bool app_input_touch_earth_filter (int index, void *userdata)
+{
+  CX_REF_UNUSED (userdata);
+  
+  return settings_get_city_display (index) && (g_render2dInfo.opacity [index].y > 0.1f) && g_render2dInfo.visible [index];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static int app_input_touch_earth (float screenX, float screenY, float screenWidth, float screenHeight)
 {
   // do ray test
@@ -2191,66 +2253,55 @@ static int app_input_touch_earth (float screenX, float screenY, float screenWidt
   
   cx_vec4_normalize (&rayDir);
   
-  // detect if ray and point normal are on a collision course
-  // get closest distance between point and distance and check if less than bounding circle 
+  // intersect ray with the sphere the city points lie on. if it misses (touching just off
+  // the limb) use the point on the sphere closest to the ray instead.
   
-  cx_vec4 normal, position, toPos;
+  float radius = earth_index_get_radius (g_cityIndex);
   
-  int cityIndex = CITY_INDEX_INVALID;
+  const cx_vec4 *o = &rayOrigin;
+  const cx_vec4 *d = &rayDir;
   
-  int i, c;
-  for (i = 0, c = earth_data_get_count (); i < c; ++i)
+  float b = (o->x * d->x) + (o->y * d->y) + (o->z * d->z);
+  float c = (o->x * o->x) + (o->y * o->y) + (o->z * o->z) - (radius * radius);
+  float disc = (b * b) - c;
+  
+  float t = (disc > 0.0f) ? (-b - cx_sqrt (disc)) : -b;
+  
+  cx_vec4 touchPt;
+  
+  touchPt.x = o->x + (d->x * t);
+  touchPt.y = o->y + (d->y * t);
+  touchPt.z = o->z + (d->z * t);
+  touchPt.w = 1.0f;
+  
+  if (disc <= 0.0f)
   {
-    bool display = settings_get_city_display (i);
+    float len = cx_sqrt ((touchPt.x * touchPt.x) + (touchPt.y * touchPt.y) + (touchPt.z * touchPt.z));
+    float s = radius / cx_max (len, CX_EPSILON);
     
-    if (display)
-    {
+    touchPt.x *= s;
+    touchPt.y *= s;
+    touchPt.z *= s;
+  }
+  
+  // nearest visible city within touch radius
+  
+  float touchRadius = 0.025f;
+  
+  int cityIndex = earth_index_find_nearest (g_cityIndex, &touchPt, touchRadius, app_input_touch_earth_filter, NULL);
+  
+  if (cityIndex == EARTH_INDEX_INVALID)
+  {
+    cityIndex = CITY_INDEX_INVALID;
+  }
 #if CX_DEBUG
-      const char *city = earth_data_get_city (i);
-      CX_REF_UNUSED (city);
-#endif
-    
-      float opacityPoint = g_render2dInfo.opacity [i].y;
-      
-      if (opacityPoint > 0.1f)
-      {
-        normal = *earth_data_get_normal (i);
-        position = *earth_data_get_position (i);
-        
-        float dotp = cx_vec4_dot (&normal, &rayDir);
-        
-        if (dotp < 0.0f)
-        {
-          cx_vec4 intersectpt, tmp;
-          
-          cx_vec4_sub (&tmp, &position, &rayOrigin);
-          
-          float t = (cx_vec4_dot (&normal, &tmp)) / dotp;
-          
-          cx_vec4_mul (&tmp, t, &rayDir);
-          
-          cx_vec4_add (&intersectpt, &rayOrigin, &tmp);
-          
-          // get distance (squared)
-          
-          cx_vec4_sub (&toPos, &position, &intersectpt);
-        
-          float touchRadius = 0.025f;
-          float distSqr = cx_vec4_length_sq (&toPos);
-          
-          if (distSqr <= (touchRadius * touchRadius))
-          {
-            CX_LOG_CONSOLE (0, "%s", city);
-            
-            cityIndex = i;
-            
-            break;
-          } 
-        }
-      }
-    }
+  else
+  {
+    const char *city = earth_data_get_city (cityIndex);
+    CX_LOG_CONSOLE (0, "%s", city);
   }
-
+#endif
+  
   return cityIndex;
 }
 
@@ -2380,48 +2431,3 @@ void app_on_memory_warning (void)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-#if 0
-void app_test_code (void)
-{
-  const int size = 8 * 1024;
-  //cx_vec4 vectors [size];
-  cx_mat4x4 matrices [size];
-  cx_mat4x4 matrix; 
-  cx_mat4x4_identity(&matrix);
-  
-  float mat16 [16];
-  
-  cx_timer timer;
-  cx_time_start_timer (&timer);
-  
-  for (int i = 0; i < size; ++i)
-  {
-    float r = rand () / (RAND_MAX + 1.0f);
-    memset (mat16, r, sizeof(mat16));
-    
-    //cx_vec4_set (&vectors [i], r, r * i, r * i * 2.0f, r * i * 0.5f);
-    cx_mat4x4_set (&matrices [i], mat16);
-  }
-  
-  for (int i = 0; i < size; ++i)
-  {
-    //cx_mat4x4_mul_vec4(&vectors [i], &matrix, &vectors [i]);
-  }
-  
-  for (int i = 0; i < size; ++i)
-  {
-    cx_mat4x4_mul (&matrices [i], &matrix, &matrices [i]);
-  }
-  
-  cx_time_stop_timer (&timer);
-  
-  printf ("app_test_code: %.3f\n", timer.elapsedTime);
-}
-#endif
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////
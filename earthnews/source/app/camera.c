@@ -13,6 +13,7 @@
 
 #define CAMERA_PERSPECTIVE_NEAR       (0.1f)
 #define CAMERA_PERSPECTIVE_FAR        (100.0f)
+#define CAMERA_ORBIT_DISTANCE         (2.0f)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -131,6 +132,45 @@ void camera_get_projection_matrix (camera_t *camera, cx_mat4x4 *matrix)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void camera_orbit (camera_t *camera, float rotx, float roty)
+{
+  CX_ASSERT (camera);
+  
+  // looks at the earth from its rotation in degrees (roty about x, then rotx about y) and sets the
+  // gdi transforms. shared by app_update_camera and tools/golden.c
+  
+  cx_vec4_set (&camera->position, 0.0f, 0.0f, -CAMERA_ORBIT_DISTANCE, 1.0f);
+  cx_vec4_set (&camera->target, 0.0f, 0.0f, 0.0f, 1.0f);
+  
+  // set rotation
+  cx_vec4 center = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  cx_vec4 axis_x = {{1.0f, 0.0f, 0.0f, 0.0f}};
+  cx_vec4 axis_y = {{0.0f, 1.0f, 0.0f, 0.0f}};
+  
+  camera_rotate_around_point (camera, &center, cx_rad (roty), &axis_x);
+  camera_rotate_around_point (camera, &center, cx_rad (-rotx), &axis_y);
+  
+  // get projection matrix
+  cx_mat4x4 projmatrix;
+  camera_get_projection_matrix (camera, &projmatrix);
+  
+  // get view matrix
+  cx_mat4x4 viewmatrix;
+  camera_get_view_matrix (camera, &viewmatrix);
+  
+  // compute modelviewprojection matrix
+  cx_mat4x4 mvpMatrix;
+  cx_mat4x4_mul (&mvpMatrix, &projmatrix, &viewmatrix);
+  
+  cx_gdi_set_transform (CX_GDI_TRANSFORM_P, &projmatrix);
+  cx_gdi_set_transform (CX_GDI_TRANSFORM_MV, &viewmatrix);
+  cx_gdi_set_transform (CX_GDI_TRANSFORM_MVP, &mvpMatrix);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 /*
 void camera_look_at (camera_t *camera, const cx_vec4 *eye, const cx_vec4 *target, const cx_vec4 *updir)
 {
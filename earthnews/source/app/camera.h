@@ -48,6 +48,8 @@ void camera_rotate_around_point (camera_t *camera, const cx_vec4 * CX_RESTRICT p
 void camera_get_view_matrix (camera_t *camera, cx_mat4x4 *matrix);
 void camera_get_projection_matrix (camera_t *camera, cx_mat4x4 *matrix);
 
+void camera_orbit (camera_t *camera, float rotx, float roty);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
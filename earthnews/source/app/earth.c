@@ -6,7 +6,9 @@
 //
 
 #include "earth.h"
+#include "earth_db.h"
 #include "util.h"
+#include "../engine/utility/cx_varmod.h"
 
 #ifdef __APPLE__
 #include "TargetConditionals.h"
@@ -31,7 +33,7 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define WEATHER_ID_MAX_LEN 16
+#define WEATHER_ID_MAX_LEN EARTH_DB_WEATHER_ID_LEN
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -45,7 +47,9 @@ struct earth_visual_t
   bool animClouds;
   bool highSpec;
   
-  cx_mesh *mesh [3];
+  cx_globe *globe [3];          // surface, clouds, atmosphere
+  cxi32 submitted [3];          // patches drawn last frame
+  cxi32 culled [3];             // patches behind the horizon or off screen last frame
   cx_texture *nightMap;
 };
 
@@ -65,6 +69,10 @@ struct earth_data_t
   
   // number of cities
   int count;
+  
+  // precompiled database mapping (NULL if parsed from json)
+  const cxu8 *dbMapping;
+  cxu32 dbMappingSize;
 };
 
 struct earth_t
@@ -141,7 +149,7 @@ static float earth_visual_dump_multiples (float mul, float div)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static struct earth_data_t *earth_data_create (const char *filename, float radius, int slices)
+static struct earth_data_t *earth_data_create_json (const char *filename, float radius, int slices)
 {
   struct earth_data_t *earthdata = NULL;
   
@@ -150,7 +158,7 @@ static struct earth_data_t *earth_data_create (const char *filename, float radiu
   
   if (cx_file_storage_load_contents (&filedata, &filedataSize, filename, CX_FILE_STORAGE_BASE_RESOURCE))
   {
-    cx_json_tree jsonTree = cx_json_tree_create ((const char *) filedata, filedataSize);
+    cx_json_tree jsonTree = cx_json_tree_create_ex ((const char *) filedata, filedataSize, CX_JSON_TREE_FLAG_ARENA);
     
     if (jsonTree)
     {
@@ -183,6 +191,9 @@ static struct earth_data_t *earth_data_create (const char *filename, float radiu
       memset (earthdata->longitude, 0, (sizeof (float) * count));
       memset (earthdata->latitude, 0, (sizeof (float) * count));
       
+      earthdata->dbMapping = NULL;
+      earthdata->dbMappingSize = 0;
+      
       for (unsigned int i = 0; i < count; ++i)
       {
         cx_json_node objectNode = cx_json_array_member (rootNode, i);
@@ -216,8 +227,9 @@ static struct earth_data_t *earth_data_create (const char *filename, float radiu
             cx_json_node utcNode = cx_json_object_child (p, "utcoffset");
             cx_json_node tznNode = cx_json_object_child (p, "name");
             
-            const char *tzn = cx_json_value_string (tznNode);
-            unsigned int tznlen = cx_util_roundup_pow2 (strlen (tzn));
+            cxu32 tznlen = 0;
+            const char *tzn = cx_json_value_string_view (tznNode, &tznlen);
+            tznlen = cx_util_roundup_pow2 (tznlen);
             
             if (tznlen > 0)
             {
@@ -274,6 +286,236 @@ static struct earth_data_t *earth_data_create (const char *filename, float radiu
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static bool earth_data_db_validate (const earth_db_header *header, cxu32 size, float radius, const char *sourceFilename)
+{
+  CX_ASSERT (header);
+  CX_ASSERT (sourceFilename);
+  
+  if ((size < sizeof (earth_db_header)) || (header->magic != EARTH_DB_MAGIC) || (header->version != EARTH_DB_VERSION))
+  {
+    return false;
+  }
+  
+  if ((header->size != size) || (header->radius != radius))
+  {
+    return false;
+  }
+  
+  // stale if the json has been edited since the database was compiled
+  
+  const cxu8 *source = NULL;
+  cxu32 sourceSize = 0;
+  
+  if (cx_file_storage_map_contents (&source, &sourceSize, sourceFilename, CX_FILE_STORAGE_BASE_RESOURCE))
+  {
+    bool match = (header->sourceSize == sourceSize) && (header->sourceHash == earth_db_source_hash (source, sourceSize));
+    
+    cx_file_storage_unmap_contents (source, sourceSize);
+    
+    if (!match)
+    {
+      return false;
+    }
+  }
+  
+  const cxu32 elemSize [EARTH_DB_SECTION_STRINGS] =
+  {
+    sizeof (cx_vec4), sizeof (cx_vec4), sizeof (float), sizeof (float), sizeof (int),
+    EARTH_DB_WEATHER_ID_LEN, sizeof (cxu32), sizeof (cxu32), sizeof (cxu32)
+  };
+  
+  for (int s = 0; s < EARTH_DB_NUM_SECTIONS; ++s)
+  {
+    cxu32 offset = header->sectionOffset [s];
+    cxu32 sectionSize = header->sectionSize [s];
+    
+    if ((offset & (EARTH_DB_ALIGNMENT - 1)) || (offset > size) || (sectionSize > (size - offset)))
+    {
+      return false;
+    }
+    
+    if ((s < EARTH_DB_SECTION_STRINGS) && (sectionSize != (elemSize [s] * header->count)))
+    {
+      return false;
+    }
+  }
+  
+  const cxu8 *data = (const cxu8 *) header;
+  
+  cxu32 strSize = header->sectionSize [EARTH_DB_SECTION_STRINGS];
+  
+  if ((strSize == 0) || (data [header->sectionOffset [EARTH_DB_SECTION_STRINGS] + strSize - 1] != 0))
+  {
+    return false;
+  }
+  
+  cxu32 checksum = earth_db_checksum (data + sizeof (earth_db_header), size - sizeof (earth_db_header));
+  
+  return (checksum == header->checksum);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static struct earth_data_t *earth_data_create_db (const char *filename, const char *sourceFilename, float radius)
+{
+  struct earth_data_t *earthdata = NULL;
+  
+  const cxu8 *mapping = NULL;
+  cxu32 size = 0;
+  
+  if (!cx_file_storage_map_contents (&mapping, &size, filename, CX_FILE_STORAGE_BASE_RESOURCE))
+  {
+    return NULL;
+  }
+  
+  const earth_db_header *header = (const earth_db_header *) mapping;
+  
+  if (earth_data_db_validate (header, size, radius, sourceFilename))
+  {
+    const cxu8 *data = mapping;
+    const char *strings = (const char *) (data + header->sectionOffset [EARTH_DB_SECTION_STRINGS]);
+    const cxu32 *nameOffsets = (const cxu32 *) (data + header->sectionOffset [EARTH_DB_SECTION_NAME]);
+    const cxu32 *newsOffsets = (const cxu32 *) (data + header->sectionOffset [EARTH_DB_SECTION_NEWS]);
+    const cxu32 *tznOffsets = (const cxu32 *) (data + header->sectionOffset [EARTH_DB_SECTION_TZ_NAME]);
+    
+    cxu32 strSize = header->sectionSize [EARTH_DB_SECTION_STRINGS];
+    
+    int count = (int) header->count;
+    
+    earthdata = (struct earth_data_t *) cx_malloc (sizeof (struct earth_data_t));
+    
+    earthdata->count = count;
+    earthdata->dbMapping = mapping;
+    earthdata->dbMappingSize = size;
+    
+    // sections are used in place
+    
+    earthdata->location = (cx_vec4 *) (data + header->sectionOffset [EARTH_DB_SECTION_LOCATION]);
+    earthdata->normal = (cx_vec4 *) (data + header->sectionOffset [EARTH_DB_SECTION_NORMAL]);
+    earthdata->latitude = (float *) (data + header->sectionOffset [EARTH_DB_SECTION_LATITUDE]);
+    earthdata->longitude = (float *) (data + header->sectionOffset [EARTH_DB_SECTION_LONGITUDE]);
+    earthdata->utcOffset = (int *) (data + header->sectionOffset [EARTH_DB_SECTION_UTC_OFFSET]);
+    earthdata->weatherId = (char *) (data + header->sectionOffset [EARTH_DB_SECTION_WEATHER_ID]);
+    
+    // string tables and dst offsets are resolved at runtime
+    
+    const char **strTables = (const char **) cx_malloc (sizeof (char *) * count * 3);
+    
+    earthdata->names = strTables;
+    earthdata->newsFeeds = strTables + count;
+    earthdata->tznames = strTables + (count * 2);
+    earthdata->dstOffset = (int *) cx_malloc (sizeof (int) * count);
+    
+    for (int i = 0; i < count; ++i)
+    {
+      CX_ASSERT ((nameOffsets [i] < strSize) && (newsOffsets [i] < strSize) && (tznOffsets [i] < strSize));
+      CX_REF_UNUSED (strSize);
+      
+      earthdata->names [i] = strings + nameOffsets [i];
+      earthdata->newsFeeds [i] = strings + newsOffsets [i];
+      earthdata->tznames [i] = strings + tznOffsets [i];
+      earthdata->dstOffset [i] = util_get_dst_offset_secs (earthdata->tznames [i]);
+    }
+  }
+  else
+  {
+    CX_LOG_CONSOLE (1, "Invalid or stale database: %s", filename);
+    
+    cx_file_storage_unmap_contents (mapping, size);
+  }
+  
+  return earthdata;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static struct earth_data_t *earth_data_create (const char *filename, float radius, int slices)
+{
+  // prefer the precompiled database next to the json source (tools/earthdb.c)
+  
+  char dbFilename [CX_FILENAME_MAX];
+  
+  cx_strcpy (dbFilename, CX_FILENAME_MAX, filename);
+  
+  char *ext = strrchr (dbFilename, '.');
+  
+  if (ext)
+  {
+    *ext = 0;
+  }
+  
+  cx_strcat (dbFilename, CX_FILENAME_MAX, ".db");
+  
+  struct earth_data_t *earthdata = earth_data_create_db (dbFilename, filename, radius);
+  
+  if (!earthdata)
+  {
+    earthdata = earth_data_create_json (filename, radius, slices);
+  }
+  
+  return earthdata;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void earth_data_destroy (struct earth_data_t *earthdata)
+{
+  CX_ASSERT (earthdata);
+  
+  if (earthdata->dbMapping)
+  {
+    // sections are used in place, names, newsFeeds and tznames share one table
+    
+    cx_free ((void *) earthdata->names);
+    cx_free (earthdata->dstOffset);
+    
+    cx_file_storage_unmap_contents (earthdata->dbMapping, earthdata->dbMappingSize);
+  }
+  else
+  {
+    for (int i = 0; i < earthdata->count; ++i)
+    {
+      if (earthdata->names [i])
+      {
+        cx_free ((void *) earthdata->names [i]);
+      }
+      
+      if (earthdata->newsFeeds [i])
+      {
+        cx_free ((void *) earthdata->newsFeeds [i]);
+      }
+      
+      if (earthdata->tznames [i])
+      {
+        cx_free ((void *) earthdata->tznames [i]);
+      }
+    }
+    
+    cx_free (earthdata->location);
+    cx_free (earthdata->normal);
+    cx_free ((void *) earthdata->names);
+    cx_free ((void *) earthdata->newsFeeds);
+    cx_free (earthdata->weatherId);
+    cx_free (earthdata->utcOffset);
+    cx_free (earthdata->dstOffset);
+    cx_free ((void *) earthdata->tznames);
+    cx_free (earthdata->longitude);
+    cx_free (earthdata->latitude);
+  }
+  
+  cx_free (earthdata);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static struct earth_visual_t *earth_visual_create (const cx_date *date, float radius, int slices)
 {
   CX_ASSERT (radius > 0.0f);
@@ -293,8 +535,6 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
   bool highSpec = false;
   bool animClouds = false;
   
-  short slicesCloud = 0;
-  short slicesAtmos = 0;
 
   device_type_t devType = util_get_device_type ();
   switch (devType)
@@ -302,8 +542,6 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
     case DEVICE_TYPE_UNKNOWN:
     case DEVICE_TYPE_IPAD3:
     {
-      slicesAtmos = 128;
-      slicesCloud = 48;
       earthShader   = "topo-hi";     highSpec = true;
       cloudShader   = "clouds-anim";  animClouds = true;
       specTexPath   = "data/images/earth/maps/spec1-2048.png";
@@ -317,8 +555,6 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
     case DEVICE_TYPE_IPAD2:
     {
 #if DEBUG_PERFORMANCE_TEST_HI
-      slicesAtmos = 128;
-      slicesCloud = 48;
       earthShader   = "topo-hi";     highSpec = true;
       cloudShader   = "clouds-anim";  animClouds = true;
       specTexPath   = "data/images/earth/maps/spec1-2048.png";
@@ -328,8 +564,6 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
       cx_sprintf (diffTexPath, 64, "data/images/earth/maps/diff-%02d-4096.png", month);
 #elif DEBUG_PERFORMANCE_TEST_LO
       month = 6;
-      slicesAtmos = 72;
-      slicesCloud = 32;
       earthShader   = "topo-lo"; highSpec = false;
       cloudShader   = "clouds";   animClouds = false;
       specTexPath   = "data/images/earth/maps/spec1-1024.jpg";
@@ -338,8 +572,6 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
       nightTexPath  = "data/images/earth/maps/night1-2048.jpg";
       cx_sprintf (diffTexPath, 64, "data/images/earth/maps/diff-%02d-2048.jpg", month);
 #else // default
-      slicesAtmos = 96;
-      slicesCloud = 36;
       earthShader   = "topo-hi";     highSpec = true;
       cloudShader   = "clouds-anim";  animClouds = true;
       specTexPath   = "data/images/earth/maps/spec1-2048.png";
@@ -355,8 +587,6 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
     default:
     {
       month = 6;
-      slicesAtmos = 72;
-      slicesCloud = 32;
       earthShader   = "topo-lo"; highSpec = false;
       cloudShader   = "clouds";   animClouds = false;
       specTexPath   = "data/images/earth/maps/spec1-1024.jpg";
@@ -378,12 +608,17 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
   visual->highSpec = highSpec;
   
 #if NEW_EARTH_SHADER
-  cx_texture *diffTexture   = cx_texture_create_from_file (diffTexPath, CX_FILE_STORAGE_BASE_RESOURCE, true);
-  cx_texture *specTexture   = cx_texture_create_from_file (specTexPath, CX_FILE_STORAGE_BASE_RESOURCE, true);
-  cx_texture *cloudTexture  = cx_texture_create_from_file (cloudTexPath, CX_FILE_STORAGE_BASE_RESOURCE, true);
-  cx_texture *nightTexture  = cx_texture_create_from_file (nightTexPath, CX_FILE_STORAGE_BASE_RESOURCE, true);
-  cx_texture *bumpTexture   = cx_texture_create_from_file (bumpTexPath, CX_FILE_STORAGE_BASE_RESOURCE, true);
+  // decoded in parallel on the workers. waits for low res previews, the rest streams in with app_update
   
+  cx_texture *diffTexture   = cx_texture_create_from_file_streamed (diffTexPath, CX_FILE_STORAGE_BASE_RESOURCE);
+  cx_texture *specTexture   = cx_texture_create_from_file_streamed (specTexPath, CX_FILE_STORAGE_BASE_RESOURCE);
+  cx_texture *cloudTexture  = cx_texture_create_from_file_streamed (cloudTexPath, CX_FILE_STORAGE_BASE_RESOURCE);
+  cx_texture *nightTexture  = cx_texture_create_from_file_streamed (nightTexPath, CX_FILE_STORAGE_BASE_RESOURCE);
+  cx_texture *bumpTexture   = cx_texture_create_from_file_streamed (bumpTexPath, CX_FILE_STORAGE_BASE_RESOURCE);
+  
+  bool texturesLoaded = cx_texture_stream_wait ();
+  
+  CX_ASSERT (texturesLoaded); CX_REF_UNUSED (texturesLoaded);
   CX_ASSERT (specTexture);
   CX_ASSERT (bumpTexture);
   CX_ASSERT (cloudTexture);
@@ -408,11 +643,12 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
   visual->nightMap = cx_texture_create_from_file ("data/maps/2048-night.png", CX_FILE_STORAGE_BASE_RESOURCE, true);
 #endif
   
-  cx_vertex_data *sphere = cx_vertex_data_create_sphere (radius, (short) slices, CX_VERTEX_FORMAT_PTNTB);
+  // surface, clouds and atmosphere are patched cube-spheres refined and culled by view
   
-  visual->mesh [0] = cx_mesh_create (sphere, shader, material);
+  visual->globe [0] = cx_globe_create (radius, CX_VERTEX_FORMAT_PTNTB, shader, material);
+  visual->globe [1] = NULL;
+  visual->globe [2] = NULL;
   
-  //cx_vertex_data_destroy (sphere);
   //////////////////////////////////////////////////////////////////////////////////////////
   
 #if NEW_EARTH_SHADER && ENABLE_CLOUDS
@@ -426,16 +662,16 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
   cx_texture *cloudBump = cx_texture_create_from_file ("data/maps/2048-normal-clouds.png", CX_FILE_STORAGE_BASE_RESOURCE, true);
   cx_material_set_texture (material1, cloudBump, CX_MATERIAL_TEXTURE_BUMP);
   
-  cx_vertex_data *sphere1 = cx_vertex_data_create_sphere (radius1, slicesCloud, CX_VERTEX_FORMAT_PTNTB);
+  cx_vertex_format format1 = CX_VERTEX_FORMAT_PTNTB;
 #else
   cx_shader *shader1     = cx_shader_create (cloudShader, "data/shaders");
   cx_material *material1 = cx_material_create (cloudShader);
   
   cx_material_set_texture (material1, cloudTexture, CX_MATERIAL_TEXTURE_DIFFUSE);
-  cx_vertex_data *sphere1 = cx_vertex_data_create_sphere (radius1, slicesCloud, CX_VERTEX_FORMAT_PTN);
+  cx_vertex_format format1 = CX_VERTEX_FORMAT_PTN;
 #endif
   
-  visual->mesh [1] = cx_mesh_create (sphere1, shader1, material1);
+  visual->globe [1] = cx_globe_create (radius1, format1, shader1, material1);
 #else
   CX_REF_UNUSED (cloudTexture);
 #endif
@@ -444,16 +680,27 @@ static struct earth_visual_t *earth_visual_create (const cx_date *date, float ra
   
 #if NEW_EARTH_SHADER && ENABLE_ATMOSPHERE
   float radius2 = radius + 0.010f;
-  cx_vertex_data *sphere2 = cx_vertex_data_create_sphere (radius2, slicesAtmos, CX_VERTEX_FORMAT_PN);
   
   cx_shader *shader2 = cx_shader_create ("atmos", "data/shaders");
   cx_material *material2 = cx_material_create ("atmos");
   
   material2->diffuse = *cx_colour_blue ();
   
-  visual->mesh [2] = cx_mesh_create (sphere2, shader2, material2);
+  visual->globe [2] = cx_globe_create (radius2, CX_VERTEX_FORMAT_PN, shader2, material2);
 #endif
   
+  //////////////////////////////////////////////////////////////////////////////////////////
+  
+  memset (visual->submitted, 0, sizeof (visual->submitted));
+  memset (visual->culled, 0, sizeof (visual->culled));
+  
+  cx_varmod_register_int (&visual->submitted [0], "earth: surface patches", 0, CX_GLOBE_PATCH_COUNT);
+  cx_varmod_register_int (&visual->culled [0], "earth: surface patches culled", 0, CX_GLOBE_PATCH_COUNT);
+  cx_varmod_register_int (&visual->submitted [1], "earth: cloud patches", 0, CX_GLOBE_PATCH_COUNT);
+  cx_varmod_register_int (&visual->culled [1], "earth: cloud patches culled", 0, CX_GLOBE_PATCH_COUNT);
+  cx_varmod_register_int (&visual->submitted [2], "earth: atmosphere patches", 0, CX_GLOBE_PATCH_COUNT);
+  cx_varmod_register_int (&visual->culled [2], "earth: atmosphere patches culled", 0, CX_GLOBE_PATCH_COUNT);
+  
   return visual;
 }
 
@@ -592,6 +839,25 @@ static void earth_visual_get_sun_position (cx_vec4 *position, const cx_date *dat
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static void earth_visual_update_globe (int index, const cx_vec4 *eye, const cx_mat4x4 *mvp)
+{
+  CX_ASSERT ((index >= 0) && (index < 3));
+  
+  struct earth_visual_t *visual = g_earth->visual;
+  
+  cx_globe_update (visual->globe [index], eye, mvp);
+  
+  cx_globe_stats stats;
+  cx_globe_get_stats (visual->globe [index], &stats);
+  
+  visual->submitted [index] = (cxi32) stats.submitted;
+  visual->culled [index] = (cxi32) (stats.horizonCulled + stats.frustumCulled);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
 {
   CX_ASSERT (g_earth);
@@ -683,41 +949,43 @@ static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
     cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_CULL | CX_GDI_RENDER_STATE_DEPTH_TEST);
     cx_gdi_enable_z_write (true);
     
-    // get mesh
-    cx_mesh *mesh = g_earth->visual->mesh [0];
+    // get globe, pick patch detail and visible patches for this view
+    cx_globe *globe = g_earth->visual->globe [0];
+    
+    earth_visual_update_globe (0, &eyePos, &mvpMatrix);
     
     // use shader
-    cx_shader_begin (mesh->shader);
+    cx_shader_begin (globe->shader);
     
     // set u_mvpMatrix
-    cx_shader_set_uniform (mesh->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
+    cx_shader_set_uniform (globe->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
     
     // night map
     
     cx_texture *nightMap = g_earth->visual->nightMap;
-    cx_shader_set_texture (mesh->shader, "u_nightMap", nightMap, 3);
+    cx_shader_set_texture (globe->shader, "u_nightMap", nightMap, 3);
     
-    cx_shader_set_uniform (mesh->shader, CX_SHADER_UNIFORM_EYE_POSITION, &eyePos);
-    cx_shader_set_uniform (mesh->shader, CX_SHADER_UNIFORM_LIGHT_POSITION, &lightPos);
+    cx_shader_set_uniform (globe->shader, CX_SHADER_UNIFORM_EYE_POSITION, &eyePos);
+    cx_shader_set_uniform (globe->shader, CX_SHADER_UNIFORM_LIGHT_POSITION, &lightPos);
     
     cx_colour_set (&ambient, 0.15f, 0.15f, 0.15f, 1.0f);
     cx_colour_set (&diffuse, 1.0f, 1.0f, 1.0f, 1.0f);
     cx_colour_set (&specular, 1.0f, 0.98f, 0.803f, 1.0f);
     
-    cx_shader_set_vector4 (mesh->shader, "u_ambientLight", &ambient, 1);
-    cx_shader_set_vector4 (mesh->shader, "u_diffuseLight", &diffuse, 1);
+    cx_shader_set_vector4 (globe->shader, "u_ambientLight", &ambient, 1);
+    cx_shader_set_vector4 (globe->shader, "u_diffuseLight", &diffuse, 1);
     
     if (g_earth->visual->highSpec)
     {
       shininess = 3.5f;
       
-      cx_shader_set_vector4 (mesh->shader, "u_specularLight", &specular, 1);
-      cx_shader_set_float (mesh->shader, "u_shininess", &shininess, 1);
+      cx_shader_set_vector4 (globe->shader, "u_specularLight", &specular, 1);
+      cx_shader_set_float (globe->shader, "u_shininess", &shininess, 1);
     }
     
-    cx_mesh_render (mesh);   // set u_diffuseMap, u_normalMap
+    cx_globe_render (globe);   // set u_diffuseMap, u_normalMap
     
-    cx_shader_end (mesh->shader);
+    cx_shader_end (globe->shader);
   }
   
 #endif
@@ -733,9 +1001,13 @@ static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
     cx_gdi_set_blend_mode (CX_GDI_BLEND_MODE_SRC_ALPHA, CX_GDI_BLEND_MODE_ONE_MINUS_SRC_ALPHA);
     cx_gdi_enable_z_write (false);
     
-    cx_mesh *mesh1 = g_earth->visual->mesh [1];
+    cx_globe *globe1 = g_earth->visual->globe [1];
+    
+    // eye and mvp in cloud space, rotated when animated
+    cx_vec4 eyeClouds = eyePos;
+    cx_mat4x4 mvpClouds = mvpMatrix;
     
-    cx_shader_begin (mesh1->shader);
+    cx_shader_begin (globe1->shader);
 
 #if BUMP_MAPPED_CLOUDS
     cx_colour_set (&ambient, 0.0f, 0.0f, 0.0f, 0.0f);
@@ -744,11 +1016,11 @@ static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
     
     shininess = 1.5f;
     
-    cx_shader_set_uniform (mesh1->shader, CX_SHADER_UNIFORM_EYE_POSITION, &eyePos);
-    cx_shader_set_vector4 (mesh1->shader, "u_ambientLight", &ambient, 1);
-    cx_shader_set_vector4 (mesh1->shader, "u_diffuseLight", &diffuse, 1);
-    cx_shader_set_vector4 (mesh1->shader, "u_specularLight", &specular, 1);
-    cx_shader_set_float (mesh1->shader, "u_shininess", &shininess, 1);
+    cx_shader_set_uniform (globe1->shader, CX_SHADER_UNIFORM_EYE_POSITION, &eyePos);
+    cx_shader_set_vector4 (globe1->shader, "u_ambientLight", &ambient, 1);
+    cx_shader_set_vector4 (globe1->shader, "u_diffuseLight", &diffuse, 1);
+    cx_shader_set_vector4 (globe1->shader, "u_specularLight", &specular, 1);
+    cx_shader_set_float (globe1->shader, "u_shininess", &shininess, 1);
     
 #else
     
@@ -763,24 +1035,29 @@ static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
       cx_mat4x4 r; // model-view matrix
       cx_mat4x4_rotation_axis_y (&r, cx_rad (angle));
     
-      cx_mat4x4 mvp; // new mvp matrix
-      cx_mat4x4_mul (&mvp, &mvpMatrix, &r);
+      cx_mat4x4 rt;
+      cx_mat4x4_transpose (&rt, &r);
       
-      cx_shader_set_uniform (mesh1->shader, CX_SHADER_UNIFORM_TRANSFORM_MV, &r);
-      cx_shader_set_uniform (mesh1->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
+      cx_mat4x4_mul (&mvpClouds, &mvpMatrix, &r); // new mvp matrix
+      cx_mat4x4_mul_vec4 (&eyeClouds, &rt, &eyePos);
+      
+      cx_shader_set_uniform (globe1->shader, CX_SHADER_UNIFORM_TRANSFORM_MV, &r);
+      cx_shader_set_uniform (globe1->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpClouds);
     }
     else
     {
-      cx_shader_set_uniform (mesh1->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
+      cx_shader_set_uniform (globe1->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
     }
     
 #endif
     
-    cx_shader_set_uniform (mesh1->shader, CX_SHADER_UNIFORM_LIGHT_POSITION, &lightPos);
+    cx_shader_set_uniform (globe1->shader, CX_SHADER_UNIFORM_LIGHT_POSITION, &lightPos);
+    
+    earth_visual_update_globe (1, &eyeClouds, &mvpClouds);
     
-    cx_mesh_render (mesh1);
+    cx_globe_render (globe1);
     
-    cx_shader_end (mesh1->shader);
+    cx_shader_end (globe1->shader);
     
     cx_gdi_enable_z_write (true);
   }
@@ -798,17 +1075,20 @@ static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
     cx_gdi_set_blend_mode (CX_GDI_BLEND_MODE_SRC_ALPHA, CX_GDI_BLEND_MODE_ONE_MINUS_SRC_ALPHA);
     cx_gdi_enable_z_write (false);
     
-    cx_mesh *mesh2 = g_earth->visual->mesh [2];
+    cx_globe *globe2 = g_earth->visual->globe [2];
+    
+    earth_visual_update_globe (2, &eyePos, &mvpMatrix);
     
-    cx_shader_begin (mesh2->shader);
+    cx_shader_begin (globe2->shader);
     
-    cx_shader_set_uniform (mesh2->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
-    cx_shader_set_uniform (mesh2->shader, CX_SHADER_UNIFORM_LIGHT_POSITION, &lightPos);
-    cx_shader_set_uniform (mesh2->shader, CX_SHADER_UNIFORM_EYE_POSITION, &eyePos);
+    cx_shader_set_uniform (globe2->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
+    cx_shader_set_uniform (globe2->shader, CX_SHADER_UNIFORM_LIGHT_POSITION, &lightPos);
+    cx_shader_set_uniform (globe2->shader, CX_SHADER_UNIFORM_EYE_POSITION, &eyePos);
     
-    cx_shader_end (mesh2->shader);
+    cx_globe_render (globe2);
+    
+    cx_shader_end (globe2->shader);
     
-    cx_mesh_render (mesh2);
     cx_gdi_enable_z_write (true);
   }
   
@@ -825,23 +1105,25 @@ static void earth_visual_render (const cx_vec4 *eye, const cx_date *date)
   cx_gdi_set_blend_mode (CX_GDI_BLEND_MODE_SRC_ALPHA, CX_GDI_BLEND_MODE_ONE_MINUS_SRC_ALPHA);
   cx_gdi_enable_z_write (true);
   
-  // get mesh
-  cx_mesh *mesh = g_earth->visual->mesh [0];
+  // get globe
+  cx_globe *globe = g_earth->visual->globe [0];
+  
+  earth_visual_update_globe (0, eye, &mvpMatrix);
   
   // use shader
-  cx_shader_begin (mesh->shader);
+  cx_shader_begin (globe->shader);
   
   // set matrices
-  cx_shader_set_uniform (mesh->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
-  cx_shader_set_uniform (mesh->shader, CX_SHADER_UNIFORM_TRANSFORM_N, &normalMatrix);
+  cx_shader_set_uniform (globe->shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
+  cx_shader_set_uniform (globe->shader, CX_SHADER_UNIFORM_TRANSFORM_N, &normalMatrix);
   
   // night map
   cx_texture *nightMap = g_earth->visual->nightMap;
-  cx_shader_set_texture (mesh->shader, "u_nightMap", nightMap, 3);
+  cx_shader_set_texture (globe->shader, "u_nightMap", nightMap, 3);
   
-  cx_mesh_render (mesh);
+  cx_globe_render (globe);
   
-  cx_shader_end (mesh->shader);
+  cx_shader_end (globe->shader);
   
   cx_gdi_enable_z_write (false);
 #endif
@@ -897,11 +1179,25 @@ static void earth_destroy (earth_t *earth)
 {
   CX_ASSERT (earth);
   
+  for (int i = 0; i < 3; ++i)
+  {
+    cx_varmod_unregister (&earth->visual->submitted [i]);
+    cx_varmod_unregister (&earth->visual->culled [i]);
+  }
+  
   // destroy SPHERES
   
-  cx_mesh_destroy (earth->visual->mesh [0]);
-  cx_mesh_destroy (earth->visual->mesh [1]);
-  cx_mesh_destroy (earth->visual->mesh [2]);
+  for (int i = 0; i < 3; ++i)
+  {
+    if (earth->visual->globe [i])
+    {
+      cx_globe_destroy (earth->visual->globe [i]);
+    }
+  }
+  
+  cx_free (earth->visual);
+  
+  earth_data_destroy (earth->data);
   
   cx_free (earth);
 }
@@ -941,6 +1237,30 @@ void earth_render (const cx_vec4 *eye, const cx_date *date)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void earth_render_scene (const cx_vec4 *eye, const cx_date *date, int pointCount, const cx_vec4 *points, 
+                         const cx_colour *colours, const cx_texture *pointTexture, float pointSize)
+{
+  // earth with the city points over it, shared by app_render_3d_earth and tools/golden.c
+  
+  earth_visual_render (eye, date);
+  
+  // points
+  cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_CULL | CX_GDI_RENDER_STATE_BLEND | CX_GDI_RENDER_STATE_DEPTH_TEST);
+  cx_gdi_set_blend_mode (CX_GDI_BLEND_MODE_SRC_ALPHA, CX_GDI_BLEND_MODE_ONE_MINUS_SRC_ALPHA);
+  cx_gdi_enable_z_write (false);
+  
+  if (pointCount > 0)
+  {
+    cx_draw_points (pointCount, points, colours, pointTexture, pointSize);
+  }
+  
+  cx_gdi_enable_z_write (true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 int earth_data_get_count (void)
 {
   CX_ASSERT (g_earth);
@@ -1083,7 +1403,9 @@ cx_vertex_data *earth_data_get_mesh_vertex_data (int meshIndex)
   CX_ASSERT (g_earth->visual);
   CX_ASSERT (meshIndex >= 0);
   
-  cx_vertex_data *vertexData = g_earth->visual->mesh [meshIndex]->vertexData;
+  CX_ASSERT (meshIndex < 3);
+  
+  cx_vertex_data *vertexData = g_earth->visual->globe [meshIndex]->vertexData;
   
   return vertexData;
 }
@@ -25,6 +25,8 @@
 bool        earth_init (const char *filename, const cx_date *date);
 void        earth_deinit (void);
 void        earth_render (const cx_vec4 *eye, const cx_date *date);
+void        earth_render_scene (const cx_vec4 *eye, const cx_date *date, int pointCount, const cx_vec4 *points, 
+                                const cx_colour *colours, const cx_texture *pointTexture, float pointSize);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
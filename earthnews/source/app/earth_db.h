@@ -0,0 +1,111 @@
+//
+//  earth_db.h
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NOW360_EARTH_DB_H
+#define NOW360_EARTH_DB_H
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../engine/system/cx_defines.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// precompiled city database (see tools/earthdb.c). little-endian, one header followed by
+// 16-byte aligned SoA sections so the file can be mapped and used in place.
+
+#define EARTH_DB_MAGIC            (0x31424445) // "EDB1"
+#define EARTH_DB_VERSION          (2)
+#define EARTH_DB_ALIGNMENT        (16)
+#define EARTH_DB_WEATHER_ID_LEN   (16)
+#define EARTH_DB_RADIUS_SCALE     (1.025f) // slightly extend radius (for point sprite rendering)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef enum earth_db_section
+{
+  EARTH_DB_SECTION_LOCATION,    // float [4] * count
+  EARTH_DB_SECTION_NORMAL,      // float [4] * count
+  EARTH_DB_SECTION_LATITUDE,    // float * count
+  EARTH_DB_SECTION_LONGITUDE,   // float * count
+  EARTH_DB_SECTION_UTC_OFFSET,  // int * count
+  EARTH_DB_SECTION_WEATHER_ID,  // char [EARTH_DB_WEATHER_ID_LEN] * count
+  EARTH_DB_SECTION_NAME,        // cxu32 string offset * count
+  EARTH_DB_SECTION_NEWS,        // cxu32 string offset * count
+  EARTH_DB_SECTION_TZ_NAME,     // cxu32 string offset * count
+  EARTH_DB_SECTION_STRINGS,     // nul-terminated strings
+  EARTH_DB_NUM_SECTIONS
+} earth_db_section;
+
+typedef struct earth_db_header
+{
+  cxu32 magic;
+  cxu32 version;
+  cxu32 size;                                     // total file size
+  cxu32 checksum;                                 // of everything after the header
+  cxu32 count;
+  cxf32 radius;                                   // sphere radius location was computed for
+  cxu32 sectionOffset [EARTH_DB_NUM_SECTIONS];    // from start of file
+  cxu32 sectionSize [EARTH_DB_NUM_SECTIONS];
+  cxu32 sourceSize;                               // json the database was compiled from (0 if synthetic)
+  cxu32 sourceHash;
+} earth_db_header;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE cxu32 earth_db_checksum (const cxu8 *data, cxu32 size)
+{
+  // fnv-1a over 32-bit words (sections are padded to EARTH_DB_ALIGNMENT)
+  
+  const cxu32 *words = (const cxu32 *) data;
+  
+  cxu32 hash = 2166136261u;
+  
+  for (cxu32 i = 0, c = size >> 2; i < c; ++i)
+  {
+    hash ^= words [i];
+    hash *= 16777619u;
+  }
+  
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE cxu32 earth_db_source_hash (const cxu8 *data, cxu32 size)
+{
+  // fnv-1a over bytes, the json source is not padded
+  
+  cxu32 hash = 2166136261u;
+  
+  for (cxu32 i = 0; i < size; ++i)
+  {
+    hash ^= data [i];
+    hash *= 16777619u;
+  }
+  
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
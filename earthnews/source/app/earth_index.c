@@ -0,0 +1,422 @@
+//
+//  earth_index.c
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#include "earth_index.h"
+#include <float.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define EARTH_INDEX_LEAF_SIZE (8)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// implicit balanced tree: the node for range [lo, hi) is the median at (lo + hi) / 2 with
+// its children in [lo, mid) and [mid + 1, hi). ranges of EARTH_INDEX_LEAF_SIZE or less
+// are leaves and are scanned linearly.
+
+struct earth_index_t
+{
+  float *points;  // xyz, in tree order
+  int *ids;       // tree order to original index
+  cxu8 *axes;     // split axis of node at mid
+  int count;
+  float radius;   // mean distance from origin
+};
+
+typedef struct earth_index_query_t
+{
+  const earth_index_t *index;
+  earth_index_filter_func filter;
+  void *userdata;
+  float p [3];
+  float distSq;
+  int best;
+  int *results;
+  int maxResults;
+  int numResults;
+} earth_index_query_t;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE void earth_index_swap (earth_index_t *index, int a, int b)
+{
+  float *pa = &index->points [a * 3];
+  float *pb = &index->points [b * 3];
+  
+  float x = pa [0], y = pa [1], z = pa [2];
+  
+  pa [0] = pb [0]; pa [1] = pb [1]; pa [2] = pb [2];
+  pb [0] = x; pb [1] = y; pb [2] = z;
+  
+  int id = index->ids [a];
+  index->ids [a] = index->ids [b];
+  index->ids [b] = id;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void earth_index_select (earth_index_t *index, int lo, int hi, int k, int axis)
+{
+  // quickselect: on return, element k is in its sorted position along axis and
+  // everything in [lo, k) is <= it and everything in (k, hi) is >= it
+  
+  const float *pts = index->points;
+  
+  hi = hi - 1;
+  
+  while (hi > lo)
+  {
+    int m = (lo + hi) >> 1;
+    
+    // median of three pivot, moved to hi
+    
+    if (pts [m * 3 + axis] < pts [lo * 3 + axis])
+    {
+      earth_index_swap (index, m, lo);
+    }
+    
+    if (pts [hi * 3 + axis] < pts [lo * 3 + axis])
+    {
+      earth_index_swap (index, hi, lo);
+    }
+    
+    if (pts [m * 3 + axis] < pts [hi * 3 + axis])
+    {
+      earth_index_swap (index, m, hi);
+    }
+    
+    float pivot = pts [hi * 3 + axis];
+    
+    int i = lo - 1;
+    int j = hi;
+    
+    for (;;)
+    {
+      while (pts [(++i) * 3 + axis] < pivot) {}
+      while ((j > lo) && (pts [(--j) * 3 + axis] > pivot)) {}
+      
+      if (i >= j)
+      {
+        break;
+      }
+      
+      earth_index_swap (index, i, j);
+    }
+    
+    earth_index_swap (index, i, hi);
+    
+    if (i == k)
+    {
+      break;
+    }
+    else if (k < i)
+    {
+      hi = i - 1;
+    }
+    else
+    {
+      lo = i + 1;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void earth_index_build (earth_index_t *index, int lo, int hi)
+{
+  while ((hi - lo) > EARTH_INDEX_LEAF_SIZE)
+  {
+    // split on axis of largest extent
+    
+    float bmin [3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float bmax [3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    
+    for (int i = lo; i < hi; ++i)
+    {
+      const float *p = &index->points [i * 3];
+      
+      for (int a = 0; a < 3; ++a)
+      {
+        bmin [a] = cx_min (bmin [a], p [a]);
+        bmax [a] = cx_max (bmax [a], p [a]);
+      }
+    }
+    
+    int axis = 0;
+    
+    if ((bmax [1] - bmin [1]) > (bmax [axis] - bmin [axis]))
+    {
+      axis = 1;
+    }
+    
+    if ((bmax [2] - bmin [2]) > (bmax [axis] - bmin [axis]))
+    {
+      axis = 2;
+    }
+    
+    int mid = (lo + hi) >> 1;
+    
+    earth_index_select (index, lo, hi, mid, axis);
+    
+    index->axes [mid] = (cxu8) axis;
+    
+    // recurse on smaller half, loop on the other
+    
+    if ((mid - lo) < (hi - mid - 1))
+    {
+      earth_index_build (index, lo, mid);
+      lo = mid + 1;
+    }
+    else
+    {
+      earth_index_build (index, mid + 1, hi);
+      hi = mid;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE void earth_index_visit (earth_index_query_t *query, int i)
+{
+  const float *p = &query->index->points [i * 3];
+  
+  float dx = p [0] - query->p [0];
+  float dy = p [1] - query->p [1];
+  float dz = p [2] - query->p [2];
+  
+  float distSq = (dx * dx) + (dy * dy) + (dz * dz);
+  
+  if (distSq <= query->distSq)
+  {
+    int id = query->index->ids [i];
+    
+    if (!query->filter || query->filter (id, query->userdata))
+    {
+      if (query->results)
+      {
+        if (query->numResults < query->maxResults)
+        {
+          query->results [query->numResults] = id;
+        }
+        
+        query->numResults++;
+      }
+      else if ((distSq < query->distSq) || (query->best == EARTH_INDEX_INVALID) || (id < query->best))
+      {
+        // ties go to the lower index so results don't depend on tree order
+        
+        query->distSq = distSq;
+        query->best = id;
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void earth_index_search (earth_index_query_t *query, int lo, int hi)
+{
+  if ((hi - lo) <= EARTH_INDEX_LEAF_SIZE)
+  {
+    for (int i = lo; i < hi; ++i)
+    {
+      earth_index_visit (query, i);
+    }
+    
+    return;
+  }
+  
+  int mid = (lo + hi) >> 1;
+  int axis = query->index->axes [mid];
+  
+  float d = query->p [axis] - query->index->points [mid * 3 + axis];
+  
+  earth_index_visit (query, mid);
+  
+  // near side first so the far side is more likely to be culled
+  
+  if (d < 0.0f)
+  {
+    earth_index_search (query, lo, mid);
+    
+    if ((d * d) <= query->distSq)
+    {
+      earth_index_search (query, mid + 1, hi);
+    }
+  }
+  else
+  {
+    earth_index_search (query, mid + 1, hi);
+    
+    if ((d * d) <= query->distSq)
+    {
+      earth_index_search (query, lo, mid);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+earth_index_t *earth_index_create (const cx_vec4 *points, int count)
+{
+  CX_ASSERT (points || (count == 0));
+  CX_ASSERT (count >= 0);
+  
+  earth_index_t *index = cx_malloc (sizeof (earth_index_t));
+  
+  index->points = cx_malloc (sizeof (float) * 3 * cx_max (count, 1));
+  index->ids = cx_malloc (sizeof (int) * cx_max (count, 1));
+  index->axes = cx_malloc (sizeof (cxu8) * cx_max (count, 1));
+  index->count = count;
+  index->radius = 0.0f;
+  
+  memset (index->axes, 0, sizeof (cxu8) * cx_max (count, 1));
+  
+  float radiusSum = 0.0f;
+  
+  for (int i = 0; i < count; ++i)
+  {
+    float *p = &index->points [i * 3];
+    
+    p [0] = points [i].x;
+    p [1] = points [i].y;
+    p [2] = points [i].z;
+    
+    index->ids [i] = i;
+    
+    radiusSum += cx_sqrt ((p [0] * p [0]) + (p [1] * p [1]) + (p [2] * p [2]));
+  }
+  
+  if (count > 0)
+  {
+    index->radius = radiusSum / (float) count;
+  }
+  
+  earth_index_build (index, 0, count);
+  
+  return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void earth_index_destroy (earth_index_t *index)
+{
+  CX_ASSERT (index);
+  
+  cx_free (index->points);
+  cx_free (index->ids);
+  cx_free (index->axes);
+  cx_free (index);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int earth_index_get_count (const earth_index_t *index)
+{
+  CX_ASSERT (index);
+  
+  return index->count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+float earth_index_get_radius (const earth_index_t *index)
+{
+  CX_ASSERT (index);
+  
+  return index->radius;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int earth_index_find_nearest (const earth_index_t *index, const cx_vec4 *point, float maxDist,
+                              earth_index_filter_func filter, void *userdata)
+{
+  CX_ASSERT (index);
+  CX_ASSERT (point);
+  CX_ASSERT (maxDist >= 0.0f);
+  
+  earth_index_query_t query;
+  
+  query.index = index;
+  query.filter = filter;
+  query.userdata = userdata;
+  query.p [0] = point->x;
+  query.p [1] = point->y;
+  query.p [2] = point->z;
+  query.distSq = maxDist * maxDist;
+  query.best = EARTH_INDEX_INVALID;
+  query.results = NULL;
+  query.maxResults = 0;
+  query.numResults = 0;
+  
+  earth_index_search (&query, 0, index->count);
+  
+  return query.best;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int earth_index_find_within (const earth_index_t *index, const cx_vec4 *point, float radius,
+                             int *results, int maxResults, earth_index_filter_func filter, void *userdata)
+{
+  // returns total number of matches; only the first maxResults (in no particular order) are written
+  
+  CX_ASSERT (index);
+  CX_ASSERT (point);
+  CX_ASSERT (results);
+  CX_ASSERT (radius >= 0.0f);
+  
+  earth_index_query_t query;
+  
+  query.index = index;
+  query.filter = filter;
+  query.userdata = userdata;
+  query.p [0] = point->x;
+  query.p [1] = point->y;
+  query.p [2] = point->z;
+  query.distSq = radius * radius;
+  query.best = EARTH_INDEX_INVALID;
+  query.results = results;
+  query.maxResults = maxResults;
+  query.numResults = 0;
+  
+  earth_index_search (&query, 0, index->count);
+  
+  return query.numResults;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,51 @@
+//
+//  earth_index.h
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NOW360_EARTH_INDEX_H
+#define NOW360_EARTH_INDEX_H
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../engine/cx_engine.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// static kd-tree over city positions for picking. points are copied in at creation, query
+// results are indices into the original array. distances are world space (straight line).
+
+#define EARTH_INDEX_INVALID (-1)
+
+typedef struct earth_index_t earth_index_t;
+
+typedef bool (*earth_index_filter_func) (int index, void *userdata);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+earth_index_t * earth_index_create (const cx_vec4 *points, int count);
+void            earth_index_destroy (earth_index_t *index);
+int             earth_index_get_count (const earth_index_t *index);
+float           earth_index_get_radius (const earth_index_t *index);
+int             earth_index_find_nearest (const earth_index_t *index, const cx_vec4 *point, float maxDist,
+                                          earth_index_filter_func filter, void *userdata);
+int             earth_index_find_within (const earth_index_t *index, const cx_vec4 *point, float radius,
+                                         int *results, int maxResults, earth_index_filter_func filter, void *userdata);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
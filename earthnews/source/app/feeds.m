@@ -131,6 +131,59 @@ static cx_texture *g_weatherIcons [NUM_WEATHER_CONDITION_CODES];
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#define FEED_SAX_TEXT_MAX_LEN (512)
+
+typedef struct feed_sax_text_t
+{
+  char buf [FEED_SAX_TEXT_MAX_LEN];
+  cxu32 len;
+} feed_sax_text_t;
+
+typedef enum
+{
+  FEED_NEWS_SAX_FIELD_NONE,
+  FEED_NEWS_SAX_FIELD_TITLE,
+  FEED_NEWS_SAX_FIELD_LINK,
+  FEED_NEWS_SAX_FIELD_PUBDATE,
+  FEED_NEWS_SAX_FIELD_CHANNEL_LINK,
+} feed_news_sax_field;
+
+typedef struct feed_news_sax_t
+{
+  feed_news_t *feed;
+  feed_news_sax_field field;
+  int fieldDepth;
+  feed_sax_text_t text;
+  char title [FEED_SAX_TEXT_MAX_LEN]; // raw, unescaped on item end
+  char link [FEED_NEWS_LINK_MAX_LEN];
+  char pubDate [64];
+  int depth;
+  bool inChannel;
+  bool inItem;
+  bool hasTitle;
+  bool hasLink;
+  bool hasPubDate;
+} feed_news_sax_t;
+
+typedef struct feed_weather_sax_t
+{
+  feed_sax_text_t text;
+  int depth;
+  int ttlSecs;
+  int tempCelsius;
+  int conditionCode;
+  bool inChannel;
+  bool inItem;
+  bool inTtl;
+  bool hasTtl;
+  bool hasItem;
+  bool hasCondition;
+} feed_weather_sax_t;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static bool feeds_news_parse (feed_news_t *feed, const char *data, int dataSize);
 static void feeds_news_clear (feed_news_t *feed);
 
@@ -306,149 +359,262 @@ void feeds_news_cancel_search (feed_news_t *feed)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static bool feeds_news_parse (feed_news_t *feed, const char *data, int dataSize)
+static void feeds_news_parse_pubdate (feed_news_item_t *rssItem, const char *d)
 {
-  CX_ASSERT (feed);
-  CX_ASSERT (data);
+  CX_ASSERT (rssItem);
+  CX_ASSERT (d);
   
-  bool success = false;
+  char day [32];
+  char monn [32];
+  char zone [32];
+  int mday = 0;
+  int year = 0;
+  int hour = 0;
+  int mins = 0;
+  int secs = 0;
+  
+  // "Sat, 23 Mar 2013 12:17:18 GMT"
+  sscanf (d, "%31s %d %31s %d %d:%d:%d %31s", day, &mday, monn, &year, &hour, &mins, &secs, zone);
+  
+  static const char *monthName [12] =
+  {
+    "Jan",
+    "Feb",
+    "Mar",
+    "Apr",
+    "May",
+    "Jun",
+    "Jul",
+    "Aug",
+    "Sep",
+    "Oct",
+    "Nov",
+    "Dec"
+  };
+  
+  int month = -1;
+  
+  for (int i = 0; i < 12; ++i)
+  {
+    if (strcmp (monn, monthName [i]) == 0)
+    {
+      month = i;
+      break;
+    }
+  }
+  
+  CX_ASSERT (month > -1);
+  
+  int seconds = (hour * 3600) + (mins * 60) + secs;
   
-  cx_xml_doc doc = cx_xml_doc_create (data, dataSize);
+  rssItem->pubDateInfo.mday = mday;
+  rssItem->pubDateInfo.mon = month;
+  rssItem->pubDateInfo.secs = seconds;
+}
 
-  if (doc)
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_sax_text_append (feed_sax_text_t *text, const char *str, cxu32 strLength)
+{
+  cxu32 avail = (FEED_SAX_TEXT_MAX_LEN - 1) - text->len;
+  cxu32 len = (strLength < avail) ? strLength : avail;
+  
+  memcpy (text->buf + text->len, str, len);
+  
+  text->len += len;
+  text->buf [text->len] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_news_sax_begin (void *userdata, const char *name, const char *nsprefix, const cx_xml_sax_attr *attrs, cxu32 attrCount)
+{
+  feed_news_sax_t *sax = (feed_news_sax_t *) userdata;
+  
+  int depth = sax->depth++; // rss = 0, channel = 1, item = 2
+  
+  if (sax->field != FEED_NEWS_SAX_FIELD_NONE)
+  {
+    return; // markup nested inside a field
+  }
+  
+  if ((depth == 1) && (strcmp (name, "channel") == 0))
   {
-    cx_xml_node rootNode = cx_xml_doc_root_node (doc);
-    cx_xml_node channelNode = cx_xml_node_child (rootNode, "channel", NULL);
-    cx_xml_node child = cx_xml_node_first_child (channelNode);
+    sax->inChannel = true;
+  }
+  else if (sax->inChannel && (depth == 2))
+  {
+    if (strcmp (name, "item") == 0)
+    {
+      sax->inItem = true;
+      sax->hasTitle = false;
+      sax->hasLink = false;
+      sax->hasPubDate = false;
+    }
+    else if (!nsprefix && (strcmp (name, "link") == 0))
+    {
+      sax->field = FEED_NEWS_SAX_FIELD_CHANNEL_LINK;
+    }
+  }
+  else if (sax->inItem && (depth == 3))
+  {
+    // first of each wins, as with the dom lookup
     
-    while (child)
+    if (!sax->hasTitle && (strcmp (name, "title") == 0))
     {
-      const char *name = cx_xml_node_name (child);
-            
-      if (strcmp (name, "item") == 0)
+      sax->field = FEED_NEWS_SAX_FIELD_TITLE;
+    }
+    else if (!sax->hasLink && (strcmp (name, "link") == 0))
+    {
+      sax->field = FEED_NEWS_SAX_FIELD_LINK;
+    }
+    else if (!sax->hasPubDate && (strcmp (name, "pubDate") == 0))
+    {
+      sax->field = FEED_NEWS_SAX_FIELD_PUBDATE;
+    }
+  }
+  
+  if (sax->field != FEED_NEWS_SAX_FIELD_NONE)
+  {
+    sax->fieldDepth = depth;
+    sax->text.len = 0;
+    sax->text.buf [0] = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_news_sax_end (void *userdata, const char *name, const char *nsprefix)
+{
+  feed_news_sax_t *sax = (feed_news_sax_t *) userdata;
+  
+  int depth = --sax->depth;
+  
+  if (sax->field != FEED_NEWS_SAX_FIELD_NONE)
+  {
+    if (depth != sax->fieldDepth)
+    {
+      return;
+    }
+    
+    switch (sax->field)
+    {
+      case FEED_NEWS_SAX_FIELD_TITLE:
       {
-        cx_xml_node titleNode = cx_xml_node_child (child, "title", NULL);
-        cx_xml_node linkNode = cx_xml_node_child (child, "link", NULL);
+        cx_strcpy (sax->title, FEED_SAX_TEXT_MAX_LEN, sax->text.buf);
+        sax->hasTitle = true;
+        break;
+      }
         
-        if (titleNode && linkNode)
-        {        
-          feed_news_item_t *rssItem = (feed_news_item_t *) cx_malloc (sizeof (feed_news_item_t));
-          memset (rssItem, 0, sizeof (feed_news_item_t));
-          
-          // title
-          char *title = cx_xml_node_content (titleNode);
-          cx_str_html_unescape (rssItem->title, FEED_NEWS_TITLE_MAX_LEN, title);
-          cx_free (title);
-      
-          // link
-          char *link = cx_xml_node_content (linkNode);
-#if 0
-          // strip out redirect url to speed up browser page loading
-          const char *http = "http://";
-          const char *c = link; // original
-          const char *s = link; // save
-          
-          while (c)
-          {
-            c = strstr (c, http);
-            
-            if (c)
-            {
-              s = c;
-              c += strlen (http);
-            }
-          }
-          
-          CX_ASSERT (s);
-          
-          if (!s)
-          {
-            s = link;
-          }
-          
-          cx_strcpy (rssItem->link, FEED_NEWS_LINK_MAX_LEN, s);
-#else
-          cx_strcpy (rssItem->link, FEED_NEWS_LINK_MAX_LEN, link);
-#endif
-          cx_free (link);
-          
-          // pubDate
-          
-          cx_xml_node pubDate = cx_xml_node_child (child, "pubDate", NULL);
-          
-          if (pubDate)
-          {
-            char *d = cx_xml_node_content (pubDate);
-            
-            char day [32];
-            char monn [32];
-            char zone [32];
-            int mday = 0;
-            int year = 0;
-            int hour = 0;
-            int mins = 0;
-            int secs = 0;
-            
-            // "Sat, 23 Mar 2013 12:17:18 GMT"
-            sscanf (d, "%s %d %s %d %d:%d:%d %s", day, &mday, monn, &year, &hour, &mins, &secs, zone);
-            
-            static const char *monthName [12] =
-            {
-              "Jan",
-              "Feb",
-              "Mar",
-              "Apr",
-              "May",
-              "Jun",
-              "Jul",
-              "Aug",
-              "Sep",
-              "Oct",
-              "Nov",
-              "Dec"
-            };
-            
-            int month = -1;
-            
-            for (int i = 0; i < 12; ++i)
-            {
-              if (strcmp (monn, monthName [i]) == 0)
-              {
-                month = i;
-                break;
-              }
-            }
-            
-            CX_ASSERT (month > -1);
-            
-            int seconds = (hour * 3600) + (mins * 60) + secs;
-            
-            rssItem->pubDateInfo.mday = mday;
-            rssItem->pubDateInfo.mon = month;
-            rssItem->pubDateInfo.secs = seconds;
-            
-            cx_free (d);
-          }
-          
-          // next
-          rssItem->next = feed->items;
-          feed->items = rssItem;
-        }
+      case FEED_NEWS_SAX_FIELD_LINK:
+      {
+        cx_strcpy (sax->link, FEED_NEWS_LINK_MAX_LEN, sax->text.buf);
+        sax->hasLink = true;
+        break;
       }
-      else if (strcmp (name, "link") == 0)
+        
+      case FEED_NEWS_SAX_FIELD_PUBDATE:
+      {
+        cx_strcpy (sax->pubDate, 64, sax->text.buf);
+        sax->hasPubDate = true;
+        break;
+      }
+        
+      case FEED_NEWS_SAX_FIELD_CHANNEL_LINK:
       {
         // feed link
-        char *link = cx_xml_node_content (child);
-        cx_strcpy (feed->link, FEED_NEWS_LINK_MAX_LEN, link);
-        cx_free (link);
+        cx_strcpy (sax->feed->link, FEED_NEWS_LINK_MAX_LEN, sax->text.buf);
+        break;
+      }
+        
+      default:
+      {
+        break;
       }
-      
-      child = cx_xml_node_next_sibling (child);
     }
     
-    success = true;
+    sax->field = FEED_NEWS_SAX_FIELD_NONE;
+  }
+  else if (sax->inItem && (depth == 2))
+  {
+    if (sax->hasTitle && sax->hasLink)
+    {
+      feed_news_item_t *rssItem = (feed_news_item_t *) cx_malloc (sizeof (feed_news_item_t));
+      memset (rssItem, 0, sizeof (feed_news_item_t));
+      
+      // title
+      cx_str_html_unescape (rssItem->title, FEED_NEWS_TITLE_MAX_LEN, sax->title);
+      
+      // link
+      cx_strcpy (rssItem->link, FEED_NEWS_LINK_MAX_LEN, sax->link);
+      
+      // pubDate
+      if (sax->hasPubDate)
+      {
+        feeds_news_parse_pubdate (rssItem, sax->pubDate);
+      }
+      
+      // next
+      rssItem->next = sax->feed->items;
+      sax->feed->items = rssItem;
+    }
     
-    cx_xml_doc_destroy (doc);
+    sax->inItem = false;
+  }
+  else if (depth == 1)
+  {
+    sax->inChannel = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_news_sax_characters (void *userdata, const char *text, cxu32 textLength)
+{
+  feed_news_sax_t *sax = (feed_news_sax_t *) userdata;
+  
+  if (sax->field != FEED_NEWS_SAX_FIELD_NONE)
+  {
+    feeds_sax_text_append (&sax->text, text, textLength);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool feeds_news_parse (feed_news_t *feed, const char *data, int dataSize)
+{
+  CX_ASSERT (feed);
+  CX_ASSERT (data);
+  
+  // streamed, pulls item title/link/pubDate without building a document tree
+  
+  feed_news_sax_t sax;
+  memset (&sax, 0, sizeof (sax));
+  
+  sax.feed = feed;
+  sax.field = FEED_NEWS_SAX_FIELD_NONE;
+  
+  cx_xml_sax_callbacks callbacks;
+  callbacks.element_begin = feeds_news_sax_begin;
+  callbacks.element_end = feeds_news_sax_end;
+  callbacks.characters = feeds_news_sax_characters;
+  
+  bool success = cx_xml_sax_parse (data, dataSize, &callbacks, &sax);
+  
+  if (!success)
+  {
+    // drop items linked before the parser gave up
+    feeds_news_clear (feed);
   }
   
   return success;
@@ -730,7 +896,7 @@ static bool feeds_twitter_parse (feed_twitter_t *feed, const char *data, int dat
   
   bool success = false;
   
-  cx_json_tree jsonTree = cx_json_tree_create (data, dataSize);
+  cx_json_tree jsonTree = cx_json_tree_create_ex (data, dataSize, CX_JSON_TREE_FLAG_ARENA | CX_JSON_TREE_FLAG_KEY_INDEX);
   
   if (jsonTree)
   {
@@ -958,6 +1124,102 @@ bool feeds_weather_search (feed_weather_t *feed, const char *query)
 static void feeds_weather_clear (feed_weather_t *feed)
 {
   CX_ASSERT (feed);
+  
+  feed->dataReady = false;
+  feed->conditionCode = WEATHER_CONDITION_CODE_INVALID;
+  feed->ttlSecs = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_weather_sax_begin (void *userdata, const char *name, const char *nsprefix, const cx_xml_sax_attr *attrs, cxu32 attrCount)
+{
+  feed_weather_sax_t *sax = (feed_weather_sax_t *) userdata;
+  
+  int depth = sax->depth++; // rss = 0, channel = 1, item = 2
+  
+  if ((depth == 1) && (strcmp (name, "channel") == 0))
+  {
+    sax->inChannel = true;
+  }
+  else if (sax->inChannel && (depth == 2))
+  {
+    if (!sax->hasTtl && (strcmp (name, "ttl") == 0))
+    {
+      sax->inTtl = true;
+      sax->text.len = 0;
+      sax->text.buf [0] = 0;
+    }
+    else if (!sax->hasItem && (strcmp (name, "item") == 0))
+    {
+      sax->inItem = true;
+      sax->hasItem = true;
+    }
+  }
+  else if (sax->inItem && (depth == 3) && !sax->hasCondition && 
+           nsprefix && (strcmp (nsprefix, "yweather") == 0) && (strcmp (name, "condition") == 0))
+  {
+    sax->hasCondition = true;
+    
+    for (cxu32 i = 0; i < attrCount; ++i)
+    {
+      char value [32];
+      cxu32 len = (attrs [i].valueLength < 31) ? attrs [i].valueLength : 31;
+      memcpy (value, attrs [i].value, len);
+      value [len] = 0;
+      
+      if (strcmp (attrs [i].name, "temp") == 0)
+      {
+        sax->tempCelsius = atoi (value);
+      }
+      else if (strcmp (attrs [i].name, "code") == 0)
+      {
+        sax->conditionCode = atoi (value);
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_weather_sax_end (void *userdata, const char *name, const char *nsprefix)
+{
+  feed_weather_sax_t *sax = (feed_weather_sax_t *) userdata;
+  
+  int depth = --sax->depth;
+  
+  if (sax->inTtl && (depth == 2))
+  {
+    sax->ttlSecs = atoi (sax->text.buf) * 60;
+    sax->hasTtl = true;
+    sax->inTtl = false;
+  }
+  else if (sax->inItem && (depth == 2))
+  {
+    sax->inItem = false;
+  }
+  else if (depth == 1)
+  {
+    sax->inChannel = false;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void feeds_weather_sax_characters (void *userdata, const char *text, cxu32 textLength)
+{
+  feed_weather_sax_t *sax = (feed_weather_sax_t *) userdata;
+  
+  if (sax->inTtl)
+  {
+    feeds_sax_text_append (&sax->text, text, textLength);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -975,60 +1237,34 @@ static bool feeds_weather_parse (feed_weather_t *feed, const char *data, int dat
   // find > read temperature
   // find http:
   
-  cx_xml_doc doc = cx_xml_doc_create (data, dataSize);
+  feed_weather_sax_t sax;
+  memset (&sax, 0, sizeof (sax));
   
-  if (doc)
-  {  
-    cx_xml_node rootNode = cx_xml_doc_root_node (doc);
-    cx_xml_node channelNode = cx_xml_node_child (rootNode, "channel", NULL);
-    
-    if (channelNode)
+  sax.conditionCode = WEATHER_CONDITION_CODE_INVALID;
+  
+  cx_xml_sax_callbacks callbacks;
+  callbacks.element_begin = feeds_weather_sax_begin;
+  callbacks.element_end = feeds_weather_sax_end;
+  callbacks.characters = feeds_weather_sax_characters;
+  
+  if (cx_xml_sax_parse (data, dataSize, &callbacks, &sax) && sax.hasItem)
+  {
+    if (sax.hasCondition)
     {
-      cx_xml_node ttlNode = cx_xml_node_child (channelNode, "ttl", NULL);
-      
-      int ttlSecs = 0;
-      
-      if (ttlNode)
-      {
-        char *ttl = cx_xml_node_content (ttlNode);
-        ttlSecs = atoi (ttl) * 60;
-        cx_free (ttl);
-      }
-      
-      cx_xml_node itemNode = cx_xml_node_child (channelNode, "item", NULL);
-      
-      if (itemNode)
-      {
-        cx_xml_node conditionNode = cx_xml_node_child (itemNode, "condition", "yweather");
-
-        int tempCelsius = 0;
-        int conditionCode = WEATHER_CONDITION_CODE_INVALID;
-        
-        if (conditionNode)
-        {
-          char *temp = cx_xml_node_attr (conditionNode, "temp");
-          char *code = cx_xml_node_attr (conditionNode, "code");
-          
-          tempCelsius = atoi (temp);
-          conditionCode = atoi (code);
-          
-          cx_free (temp);
-          cx_free (code);
-          
-          feed->ttlSecs = ttlSecs;
-          feed->celsius = tempCelsius;
-          feed->conditionCode = conditionCode;  
-        }
-        else
-        {
-          feed->ttlSecs = 0;
-        }
-        
-        success = true;
-      }
+      feed->ttlSecs = sax.ttlSecs;
+      feed->celsius = sax.tempCelsius;
+      feed->conditionCode = sax.conditionCode;
+    }
+    else
+    {
+      feed->ttlSecs = 0;
     }
     
-    cx_xml_doc_destroy (doc);
+    success = true;
+  }
+  else
+  {
+    feeds_weather_clear (feed);
   }
   
   return success;
@@ -17,7 +17,6 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define STATUS_BAR_DISPLAY_TIMER (5.0f)
-#define MAX_PROFANITY_WORD_COUNT (128)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -36,8 +35,7 @@ static cx_texture *g_status_msg_icon = NULL;
 static cx_colour g_status_msg_colour [NUM_STATUS_BAR_MSGS];
 static NSString *g_status_msg_text [NUM_STATUS_BAR_MSGS];
 
-static unsigned int g_profanityWordCount = 0;
-static char *g_profanityWords [MAX_PROFANITY_WORD_COUNT] = { NULL };
+static cx_word_filter *g_profanityFilter = NULL;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -421,7 +419,10 @@ device_type_t util_get_device_type (void)
 
 void util_profanity_filter (char *text)
 {
-  cx_util_word_filter (text, (const char **) g_profanityWords, g_profanityWordCount, '*');
+  if (g_profanityFilter)
+  {
+    cx_util_word_filter_apply (g_profanityFilter, text, '*');
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -516,15 +517,7 @@ static void util_deinit_screen_fade (void)
 
 static void util_init_create_fonts (void)
 {
-  // support CJK code points for mplus-1c-bold
-  cxu32 cjkCodePtStart = 19968;
-  cxu32 cjkCodePtEnd = 26230;
-  cxu32 cjkCodePtsCount = (cjkCodePtEnd - cjkCodePtStart) + 1;
-  cxu32 cjkCodePts [cjkCodePtsCount];
-  for (cxu32 i = cjkCodePtStart, c = 0; c < cjkCodePtsCount; ++i, ++c)
-  {
-    cjkCodePts [c] = i;
-  }
+  // glyphs are rasterised on first use, so the full CJK block costs nothing up front
   
   {
     const char *fontname = "data/fonts/mplus-1c-bold.ttf";
@@ -553,7 +546,7 @@ static void util_init_create_fonts (void)
   
     cx_str_unicode_block blocks0 [] =
     {
-      //CX_STR_UNICODE_BLOCK_CJK_FULL,
+      CX_STR_UNICODE_BLOCK_CJK_FULL,
       CX_STR_UNICODE_BLOCK_CYRILLIC,
       CX_STR_UNICODE_BLOCK_GREEK_COPTIC,
       CX_STR_UNICODE_BLOCK_LATIN_BASIC,
@@ -565,7 +558,7 @@ static void util_init_create_fonts (void)
     
     cxu32 blocksCount0 = sizeof (blocks0) / sizeof (cx_str_unicode_block);
     
-    g_font [FONT_ID_DEFAULT_16] = cx_font_create (fontname, 16.0f, blocks0, blocksCount0, cjkCodePts, cjkCodePtsCount);
+    g_font [FONT_ID_DEFAULT_16] = cx_font_create (fontname, 16.0f, blocks0, blocksCount0, NULL, 0);
   }
 
   {
@@ -600,7 +593,7 @@ static void util_init_create_fonts (void)
     
     cx_str_unicode_block blocks2 [] =
     {
-      //CX_STR_UNICODE_BLOCK_CJK_FULL,
+      CX_STR_UNICODE_BLOCK_CJK_FULL,
       CX_STR_UNICODE_BLOCK_CYRILLIC,
       CX_STR_UNICODE_BLOCK_GREEK_COPTIC,
       CX_STR_UNICODE_BLOCK_HEBREW,
@@ -617,7 +610,7 @@ static void util_init_create_fonts (void)
     
     cxu32 blocksCount2 = sizeof (blocks2) / sizeof (cx_str_unicode_block);
     
-    g_font [FONT_ID_TWITTER_16] = cx_font_create (fontname, 18.0f, blocks2, blocksCount2, cjkCodePts, cjkCodePtsCount);
+    g_font [FONT_ID_TWITTER_16] = cx_font_create (fontname, 18.0f, blocks2, blocksCount2, NULL, 0);
   }
   
 #if CX_DEBUG
@@ -686,8 +679,27 @@ static void util_init_profanity_filter (void)
   
   if (cx_file_storage_load_contents (&buffer, &bufferSize, "data/profanity.list", CX_FILE_STORAGE_BASE_RESOURCE))
   {
-    g_profanityWordCount = cx_str_explode (g_profanityWords, MAX_PROFANITY_WORD_COUNT, (const char *) buffer, ',');
+    // compile list once, words aren't needed after
+    
+    cxu32 maxWordCount = 1;
+    
+    for (cxu32 i = 0; i < bufferSize; ++i)
+    {
+      maxWordCount += (buffer [i] == ',') ? 1 : 0;
+    }
+    
+    char **words = cx_malloc (sizeof (char *) * (maxWordCount + 1));
+    
+    cxu32 wordCount = cx_str_explode (words, maxWordCount + 1, (const char *) buffer, ',');
+    
+    g_profanityFilter = cx_util_word_filter_create ((const char **) words, wordCount);
+    
+    for (cxu32 i = 0; i < wordCount; ++i)
+    {
+      cx_free (words [i]);
+    }
     
+    cx_free (words);
     cx_free (buffer);
   }
 
@@ -714,9 +726,10 @@ static void util_init_profanity_filter (void)
 
 static void util_deinit_profanity_filter (void)
 {
-  for (cxu32 i = 0; i < g_profanityWordCount; ++i)
+  if (g_profanityFilter)
   {
-    cx_free (g_profanityWords [i]);
+    cx_util_word_filter_destroy (g_profanityFilter);
+    g_profanityFilter = NULL;
   }
 }
 
@@ -7,6 +7,7 @@
 
 #include "worker.h"
 #include "../engine/cx_engine.h"
+#include <unistd.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -18,25 +19,58 @@ typedef struct task_t
   task_func func;
   void *userdata;
   task_status *status;
-  struct task_t *next;
+  task_priority priority;
+  volatile task_status state;
+  volatile int cancel;
+  volatile int refCount;
+  cx_timer timer;
+  struct task_t *continuations;
+  struct task_t *sibling;
 } task_t;
 
+typedef struct task_deque_t
+{
+  task_t **tasks;
+  int capacity;
+  int head; // owner pops the oldest task here
+  int tail; // push end, thieves pop the newest task here
+  cx_thread_mutex mutex;
+} task_deque_t;
+
+typedef struct worker_t
+{
+  int index;
+  cx_thread *thread;
+  task_deque_t deques [TASK_NUM_PRIORITIES];
+  unsigned int completed;
+  unsigned int cancelled;
+  unsigned int steals;
+  unsigned int latencyCount;
+  float latency [WORKER_LATENCY_SAMPLE_COUNT];
+} worker_t;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define TASK_MAX_COUNT (16)
+#define TASK_DEQUE_INITIAL_CAPACITY (64)
+
+static worker_t *g_workers = NULL;
+static int g_workerCount = 0;
+
+static cx_thread_monitor g_idleMonitor;
+static volatile int g_idleCount = 0;
+static volatile int g_pendingCount = 0;
+static volatile int g_pendingCountMax = 0;
+static volatile bool g_quit = false;
 
-static task_t *g_taskPoolArray = NULL;
+static cx_thread_monitor g_completeMonitor; // guards task state transitions and continuation lists
+static int g_completeWaiters = 0;
 
-static task_t *g_taskFreeList = NULL;
-static task_t *g_taskBusyList = NULL;
-static int g_taskFreeListCount = 0;
-static int g_taskBusyListCount = 0;
+static pthread_key_t g_currentTaskKey;
 
-static cx_thread *g_thread = NULL;
-static cx_thread_monitor g_threadMonitor;
-static cx_thread_mutex g_sharedDataMutex;
+static volatile unsigned int g_submitCounter = 0;
+static volatile unsigned int g_submitted = 0;
 
 static task_id g_taskIdFactory = 0;
 
@@ -44,83 +78,389 @@ static task_id g_taskIdFactory = 0;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static task_t *task_list_insert_back (task_t *head, task_t *task, int *count)
+static void task_finish (task_t *task, task_status state);
+static void task_release (task_t *task);
+static void worker_wake (bool all);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void task_deque_init (task_deque_t *deque)
+{
+  deque->capacity = TASK_DEQUE_INITIAL_CAPACITY;
+  deque->tasks = (task_t **) cx_malloc (sizeof (task_t *) * deque->capacity);
+  deque->head = 0;
+  deque->tail = 0;
+  
+  cx_thread_mutex_init (&deque->mutex);
+}
+
+static void task_deque_deinit (task_deque_t *deque)
+{
+  // called once worker threads have exited: anything still queued is cancelled
+  
+  while (deque->head != deque->tail)
+  {
+    task_t *task = deque->tasks [deque->head & (deque->capacity - 1)];
+    
+    task_finish (task, TASK_STATUS_CANCELLED);
+    task_release (task);
+    
+    deque->head++;
+  }
+  
+  cx_thread_mutex_deinit (&deque->mutex);
+  
+  cx_free (deque->tasks);
+  
+  deque->tasks = NULL;
+}
+
+static void task_deque_push_back (task_deque_t *deque, task_t *task)
 {
-  if (head)
+  cx_thread_mutex_lock (&deque->mutex);
+  
+  int count = deque->tail - deque->head;
+  
+  if (count == deque->capacity)
   {
-    task_t *curr = head;
+    // grow (capacity stays a power of 2)
+    
+    int capacity = deque->capacity * 2;
+    
+    task_t **tasks = (task_t **) cx_malloc (sizeof (task_t *) * capacity);
     
-    while (curr && curr->next)
+    for (int i = 0; i < count; ++i)
     {
-      curr = curr->next;
+      tasks [i] = deque->tasks [(deque->head + i) & (deque->capacity - 1)];
     }
     
-    curr->next = task;
+    cx_free (deque->tasks);
+    
+    deque->tasks = tasks;
+    deque->capacity = capacity;
+    deque->head = 0;
+    deque->tail = count;
   }
-  else
+  
+  deque->tasks [deque->tail & (deque->capacity - 1)] = task;
+  deque->tail++;
+  
+  cx_thread_mutex_unlock (&deque->mutex);
+}
+
+static task_t *task_deque_pop_front (task_deque_t *deque)
+{
+  task_t *task = NULL;
+  
+  cx_thread_mutex_lock (&deque->mutex);
+  
+  if (deque->head != deque->tail)
   {
-    head = task;
+    task = deque->tasks [deque->head & (deque->capacity - 1)];
+    deque->head++;
   }
+  
+  cx_thread_mutex_unlock (&deque->mutex);
+  
+  return task;
+}
 
-  ++(*count);
+static task_t *task_deque_pop_back (task_deque_t *deque)
+{
+  task_t *task = NULL;
+  
+  cx_thread_mutex_lock (&deque->mutex);
+  
+  if (deque->head != deque->tail)
+  {
+    deque->tail--;
+    task = deque->tasks [deque->tail & (deque->capacity - 1)];
+  }
   
-  return head;
+  cx_thread_mutex_unlock (&deque->mutex);
+  
+  return task;
 }
 
-static task_t *task_list_pop_front (task_t *head, task_t **front, int *count)
+static bool task_deque_cancel (task_deque_t *deque, task_id taskId)
 {
-  *front = head;
+  bool found = false;
+  
+  cx_thread_mutex_lock (&deque->mutex);
+  
+  for (int i = deque->head; i != deque->tail; ++i)
+  {
+    task_t *task = deque->tasks [i & (deque->capacity - 1)];
+    
+    if (task->id == taskId)
+    {
+      task->cancel = 1;
+      found = true;
+      break;
+    }
+  }
+  
+  cx_thread_mutex_unlock (&deque->mutex);
+  
+  return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-  if (head)
+static task_t *task_create (task_func func, void *userdata, task_priority priority, task_status *status, int refCount)
+{
+  CX_ASSERT (func);
+  CX_ASSERT ((priority >= TASK_PRIORITY_HIGH) && (priority < TASK_NUM_PRIORITIES));
+  
+  task_t *task = (task_t *) cx_malloc (sizeof (task_t));
+  
+  task->id = __sync_fetch_and_add (&g_taskIdFactory, 1);
+  task->func = func;
+  task->userdata = userdata;
+  task->status = status;
+  task->priority = priority;
+  task->state = TASK_STATUS_INPROGRESS;
+  task->cancel = 0;
+  task->refCount = refCount;
+  task->continuations = NULL;
+  task->sibling = NULL;
+  
+  if (status)
+  {
+    *status = TASK_STATUS_INPROGRESS;
+  }
+  
+  return task;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void task_release (task_t *task)
+{
+  CX_ASSERT (task);
+  CX_ASSERT (task->refCount > 0);
+  
+  if (__sync_sub_and_fetch (&task->refCount, 1) == 0)
   {
-    head = head->next;
+    cx_free (task);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-    --(*count);
+static void task_enqueue (task_t *task)
+{
+  CX_ASSERT (task);
+  
+  cx_time_start_timer (&task->timer);
+  
+  // round robin across worker deques, idle workers steal to balance
+  
+  unsigned int index = __sync_fetch_and_add (&g_submitCounter, 1) % (unsigned int) g_workerCount;
+  
+  task_deque_push_back (&g_workers [index].deques [task->priority], task);
+  
+  __sync_add_and_fetch (&g_submitted, 1);
+  
+  int pending = __sync_add_and_fetch (&g_pendingCount, 1);
+  int pendingMax = g_pendingCountMax;
+  
+  while ((pending > pendingMax) && !__sync_bool_compare_and_swap (&g_pendingCountMax, pendingMax, pending))
+  {
+    pendingMax = g_pendingCountMax;
   }
   
-  return head;
+  worker_wake (false);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static cx_thread_exit_status worker_thread_func (void *data)
+static void task_finish (task_t *task, task_status state)
 {
-  cx_thread_exit_status exitStatus = CX_THREAD_EXIT_STATUS_SUCCESS;
+  CX_ASSERT (task);
+  CX_ASSERT ((state == TASK_STATUS_COMPLETE) || (state == TASK_STATUS_CANCELLED));
+  
+  cx_thread_mutex_lock (&g_completeMonitor.mutex);
   
-  while (1)
+  task->state = state;
+  
+  if (task->status)
   {
-    cx_thread_monitor_wait (&g_threadMonitor);
-    
-    cx_thread_mutex_lock (&g_sharedDataMutex);
+    *task->status = state;
+  }
+  
+  task_t *cont = task->continuations;
+  task->continuations = NULL;
+  
+  if (g_completeWaiters > 0)
+  {
+    pthread_cond_broadcast (&g_completeMonitor.cond);
+  }
+  
+  cx_thread_mutex_unlock (&g_completeMonitor.mutex);
+  
+  // continuations run only if their parent completed, cancellation propagates down the chain
+  
+  while (cont)
+  {
+    task_t *next = cont->sibling;
+    cont->sibling = NULL;
     
-    task_t *task = NULL;
+    if ((state == TASK_STATUS_COMPLETE) && !cont->cancel && !g_quit)
+    {
+      task_enqueue (cont);
+    }
+    else
+    {
+      task_finish (cont, TASK_STATUS_CANCELLED);
+      task_release (cont);
+    }
     
-    g_taskBusyList = task_list_pop_front (g_taskBusyList, &task, &g_taskBusyListCount);
+    cont = next;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static task_t *worker_get_task (worker_t *worker)
+{
+  // highest priority first. within a priority the owner takes the oldest task from its
+  // own deque, thieves take the newest from others
+  
+  for (int p = 0; p < TASK_NUM_PRIORITIES; ++p)
+  {
+    task_t *task = task_deque_pop_front (&worker->deques [p]);
     
-    while (task)
+    for (int i = 1; !task && (i < g_workerCount); ++i)
     {
-      cx_thread_mutex_unlock (&g_sharedDataMutex);
+      worker_t *victim = &g_workers [(worker->index + i) % g_workerCount];
+      
+      task = task_deque_pop_back (&victim->deques [p]);
       
-      task->func (task->userdata);
+      if (task)
+      {
+        worker->steals++;
+      }
+    }
+    
+    if (task)
+    {
+      return task;
+    }
+  }
+  
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void worker_wait (void)
+{
+  // idle count is raised before pending is re-checked so that a concurrent submit either
+  // sees a sleeper and signals, or its pending increment is seen here.
+  
+  cx_thread_mutex_lock (&g_idleMonitor.mutex);
+  
+  __sync_add_and_fetch (&g_idleCount, 1);
+  
+  while ((__sync_fetch_and_add (&g_pendingCount, 0) == 0) && !g_quit)
+  {
+    pthread_cond_wait (&g_idleMonitor.cond, &g_idleMonitor.mutex);
+  }
+  
+  __sync_sub_and_fetch (&g_idleCount, 1);
+  
+  cx_thread_mutex_unlock (&g_idleMonitor.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void worker_wake (bool all)
+{
+  if (__sync_fetch_and_add (&g_idleCount, 0) > 0)
+  {
+    cx_thread_mutex_lock (&g_idleMonitor.mutex);
+    
+    if (all)
+    {
+      pthread_cond_broadcast (&g_idleMonitor.cond);
+    }
+    else
+    {
+      pthread_cond_signal (&g_idleMonitor.cond);
+    }
+    
+    cx_thread_mutex_unlock (&g_idleMonitor.mutex);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_thread_exit_status worker_thread_func (void *data)
+{
+  cx_thread_exit_status exitStatus = CX_THREAD_EXIT_STATUS_SUCCESS;
+  
+  worker_t *worker = (worker_t *) data;
+  CX_ASSERT (worker);
+  
+  while (!g_quit)
+  {
+    task_t *task = worker_get_task (worker);
     
-      if (task->status)
+    if (task)
+    {
+      __sync_sub_and_fetch (&g_pendingCount, 1);
+      
+      if (!task->cancel)
       {
-        *task->status = TASK_STATUS_COMPLETE;
+        pthread_setspecific (g_currentTaskKey, task);
+        
+        task->func (task->userdata);
+        
+        pthread_setspecific (g_currentTaskKey, NULL);
       }
       
-      task->func = NULL;
-      task->userdata = NULL;
-      task->next = NULL;
+      cx_time_stop_timer (&task->timer);
       
-      cx_thread_mutex_lock (&g_sharedDataMutex);
+      if (task->cancel)
+      {
+        worker->cancelled++;
+        
+        task_finish (task, TASK_STATUS_CANCELLED);
+      }
+      else
+      {
+        worker->latency [worker->latencyCount % WORKER_LATENCY_SAMPLE_COUNT] = (float) task->timer.elapsedTime;
+        worker->latencyCount++;
+        worker->completed++;
+        
+        task_finish (task, TASK_STATUS_COMPLETE);
+      }
       
-      g_taskFreeList = task_list_insert_back (g_taskFreeList, task, &g_taskFreeListCount);
-      g_taskBusyList = task_list_pop_front (g_taskBusyList, &task, &g_taskBusyListCount);
+      task_release (task);
+    }
+    else
+    {
+      worker_wait ();
     }
-    
-    cx_thread_mutex_unlock (&g_sharedDataMutex);
   }
   
   return exitStatus;
@@ -130,26 +470,67 @@ static cx_thread_exit_status worker_thread_func (void *data)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static int worker_cmp_latency (const void *a, const void *b)
+{
+  float la = *(const float *) a;
+  float lb = *(const float *) b;
+  
+  return (la > lb) - (la < lb);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void worker_init (void)
 {
-  g_taskPoolArray = (task_t *) cx_malloc (sizeof (task_t) * TASK_MAX_COUNT);
+  CX_ASSERT (!g_workers);
   
-  unsigned int i;
+  // leave a core for the main thread
   
-  for (i = 0; i < TASK_MAX_COUNT; ++i)
-  {
-    task_t *task = &g_taskPoolArray [i];
-    
-    g_taskFreeList = task_list_insert_back (g_taskFreeList, task, &g_taskFreeListCount);
-  }
+  int coreCount = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  
+  g_workerCount = coreCount - 1;
+  g_workerCount = (g_workerCount < 1) ? 1 : g_workerCount;
+  g_workerCount = (g_workerCount > WORKER_MAX_COUNT) ? WORKER_MAX_COUNT : g_workerCount;
   
-  cx_thread_mutex_init (&g_sharedDataMutex);
+  g_workers = (worker_t *) cx_malloc (sizeof (worker_t) * g_workerCount);
+  memset (g_workers, 0, sizeof (worker_t) * g_workerCount);
   
-  cx_thread_monitor_init (&g_threadMonitor);
+  g_quit = false;
+  g_idleCount = 0;
+  g_pendingCount = 0;
+  g_pendingCountMax = 0;
+  g_completeWaiters = 0;
+  g_submitCounter = 0;
+  g_submitted = 0;
   
-  g_thread = cx_thread_create ("earthnews worker thread", CX_THREAD_TYPE_JOINABLE, worker_thread_func, NULL);
+  cx_thread_monitor_init (&g_idleMonitor);
+  cx_thread_monitor_init (&g_completeMonitor);
   
-  cx_thread_start (g_thread);
+  pthread_key_create (&g_currentTaskKey, NULL);
+  
+  for (int i = 0; i < g_workerCount; ++i)
+  {
+    worker_t *worker = &g_workers [i];
+    
+    worker->index = i;
+    
+    for (int p = 0; p < TASK_NUM_PRIORITIES; ++p)
+    {
+      task_deque_init (&worker->deques [p]);
+    }
+  }
+  
+  for (int i = 0; i < g_workerCount; ++i)
+  {
+    worker_t *worker = &g_workers [i];
+    
+    worker->thread = cx_thread_create ("earthnews worker thread", CX_THREAD_TYPE_JOINABLE, worker_thread_func, worker);
+    CX_FATAL_ASSERT (worker->thread);
+    
+    cx_thread_start (worker->thread);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -158,15 +539,43 @@ void worker_init (void)
 
 void worker_deinit (void)
 {
-  cx_thread_destroy (g_thread);
+  CX_FATAL_ASSERT (g_workers);
   
-  cx_thread_monitor_deinit (&g_threadMonitor);
+  g_quit = true;
   
-  cx_thread_mutex_deinit (&g_sharedDataMutex);
+  __sync_synchronize ();
   
-  cx_free (g_taskPoolArray);
+  cx_thread_mutex_lock (&g_idleMonitor.mutex);
+  pthread_cond_broadcast (&g_idleMonitor.cond);
+  cx_thread_mutex_unlock (&g_idleMonitor.mutex);
   
-  g_thread = NULL;
+  for (int i = 0; i < g_workerCount; ++i)
+  {
+    worker_t *worker = &g_workers [i];
+    
+    cx_thread_join (worker->thread, NULL);
+    cx_thread_destroy (worker->thread);
+    
+    worker->thread = NULL;
+  }
+  
+  for (int i = 0; i < g_workerCount; ++i)
+  {
+    for (int p = 0; p < TASK_NUM_PRIORITIES; ++p)
+    {
+      task_deque_deinit (&g_workers [i].deques [p]);
+    }
+  }
+  
+  pthread_key_delete (g_currentTaskKey);
+  
+  cx_thread_monitor_deinit (&g_completeMonitor);
+  cx_thread_monitor_deinit (&g_idleMonitor);
+  
+  cx_free (g_workers);
+  
+  g_workers = NULL;
+  g_workerCount = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -175,16 +584,14 @@ void worker_deinit (void)
 
 void worker_update (void)
 {
-  CX_FATAL_ASSERT (g_thread);
+  CX_FATAL_ASSERT (g_workers);
   
-  cx_thread_mutex_lock (&g_sharedDataMutex);
+  // submit already wakes a sleeper, this is a safety net
   
-  if (g_taskBusyListCount > 0)
+  if (__sync_fetch_and_add (&g_pendingCount, 0) > 0)
   {
-    cx_thread_monitor_signal (&g_threadMonitor);
+    worker_wake (true);
   }
-  
-  cx_thread_mutex_unlock (&g_sharedDataMutex);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -193,44 +600,213 @@ void worker_update (void)
 
 task_id worker_add_task (task_func func, void *userdata, task_status *status)
 {
-  CX_FATAL_ASSERT (g_thread);
+  CX_FATAL_ASSERT (g_workers);
   CX_ASSERT (func);
   
-  task_id taskId = TASK_ID_INVALID;
+  task_t *task = task_create (func, userdata, TASK_PRIORITY_NORMAL, status, 1);
   
-  task_t *task = NULL;
+  task_id taskId = task->id;
+  
+  task_enqueue (task);
   
-  cx_thread_mutex_lock (&g_sharedDataMutex);
+  return taskId;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void worker_remove_task (task_id taskId)
+{
+  CX_FATAL_ASSERT (g_workers);
   
-  g_taskFreeList = task_list_pop_front (g_taskFreeList, &task, &g_taskFreeListCount);
+  // flags a queued task as cancelled, it is discarded when a worker reaches it.
+  // a task that is already running is unaffected, use a task handle to cancel those.
   
-  if (task)
+  bool found = false;
+  
+  for (int i = 0; !found && (i < g_workerCount); ++i)
   {
-    if (status)
+    for (int p = 0; !found && (p < TASK_NUM_PRIORITIES); ++p)
     {
-      *status = TASK_STATUS_INPROGRESS;
+      found = task_deque_cancel (&g_workers [i].deques [p], taskId);
     }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+task_handle worker_task_submit (task_func func, void *userdata, task_priority priority)
+{
+  CX_FATAL_ASSERT (g_workers);
+  CX_ASSERT (func);
+  
+  // one reference for the queue, one for the caller
+  
+  task_t *task = task_create (func, userdata, priority, NULL, 2);
+  
+  task_enqueue (task);
+  
+  return task;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+task_handle worker_task_then (task_handle parent, task_func func, void *userdata)
+{
+  CX_FATAL_ASSERT (g_workers);
+  CX_ASSERT (parent);
+  CX_ASSERT (func);
+  
+  task_t *task = task_create (func, userdata, parent->priority, NULL, 2);
+  
+  cx_thread_mutex_lock (&g_completeMonitor.mutex);
+  
+  task_status parentState = parent->state;
+  
+  if (parentState == TASK_STATUS_INPROGRESS)
+  {
+    task->sibling = parent->continuations;
+    parent->continuations = task;
+  }
+  
+  cx_thread_mutex_unlock (&g_completeMonitor.mutex);
+  
+  if (parentState == TASK_STATUS_COMPLETE)
+  {
+    task_enqueue (task);
+  }
+  else if (parentState == TASK_STATUS_CANCELLED)
+  {
+    task_finish (task, TASK_STATUS_CANCELLED);
+    task_release (task);
+  }
+  
+  return task;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void worker_task_cancel (task_handle task)
+{
+  CX_ASSERT (task);
+  
+  // cooperative: queued tasks are skipped, running tasks see worker_task_cancel_requested ()
+  
+  __sync_lock_test_and_set (&task->cancel, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool worker_task_cancel_requested (void)
+{
+  const task_t *task = (const task_t *) pthread_getspecific (g_currentTaskKey);
+  
+  return task && task->cancel;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+task_status worker_task_get_status (task_handle task)
+{
+  CX_ASSERT (task);
+  
+  return task->state;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+task_status worker_task_wait (task_handle task)
+{
+  CX_ASSERT (task);
+  CX_ASSERT (pthread_getspecific (g_currentTaskKey) != task);
+  
+  cx_thread_mutex_lock (&g_completeMonitor.mutex);
+  
+  g_completeWaiters++;
+  
+  while (task->state == TASK_STATUS_INPROGRESS)
+  {
+    pthread_cond_wait (&g_completeMonitor.cond, &g_completeMonitor.mutex);
+  }
+  
+  g_completeWaiters--;
+  
+  task_status state = task->state;
+  
+  cx_thread_mutex_unlock (&g_completeMonitor.mutex);
+  
+  return state;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void worker_task_release (task_handle task)
+{
+  task_release (task);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void worker_get_stats (worker_stats *stats)
+{
+  CX_FATAL_ASSERT (g_workers);
+  CX_ASSERT (stats);
+  
+  memset (stats, 0, sizeof (worker_stats));
+  
+  stats->workerCount = g_workerCount;
+  stats->queueDepth = g_pendingCount;
+  stats->queueDepthMax = g_pendingCountMax;
+  stats->tasksSubmitted = g_submitted;
+  
+  // latency samples are read while workers may be writing them, figures are approximate
+  
+  float *samples = (float *) cx_malloc (sizeof (float) * WORKER_LATENCY_SAMPLE_COUNT * g_workerCount);
+  unsigned int sampleCount = 0;
+  
+  for (int i = 0; i < g_workerCount; ++i)
+  {
+    const worker_t *worker = &g_workers [i];
     
-    task->id = g_taskIdFactory++;
-    task->func = func;
-    task->userdata = userdata;
-    task->status = status;
+    stats->tasksCompleted += worker->completed;
+    stats->tasksCancelled += worker->cancelled;
+    stats->steals += worker->steals;
     
-    g_taskBusyList = task_list_insert_back (g_taskBusyList, task, &g_taskBusyListCount);
+    unsigned int count = worker->latencyCount;
+    count = (count > WORKER_LATENCY_SAMPLE_COUNT) ? WORKER_LATENCY_SAMPLE_COUNT : count;
     
-    taskId = task->id;
+    memcpy (samples + sampleCount, worker->latency, sizeof (float) * count);
+    
+    sampleCount += count;
   }
-  else
+  
+  if (sampleCount > 0)
   {
-    if (status)
-    {
-      *status = TASK_STATUS_INVALID;
-    }
+    qsort (samples, sampleCount, sizeof (float), worker_cmp_latency);
+    
+    stats->latencyP50 = samples [(sampleCount * 50) / 100];
+    stats->latencyP90 = samples [(sampleCount * 90) / 100];
+    stats->latencyP99 = samples [(sampleCount * 99) / 100];
   }
   
-  cx_thread_mutex_unlock (&g_sharedDataMutex);
-  
-  return taskId;
+  cx_free (samples);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
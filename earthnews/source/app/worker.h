@@ -8,12 +8,17 @@
 #ifndef NOW360_WORKER_H
 #define NOW360_WORKER_H
 
+#include <stdbool.h>
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define TASK_ID_INVALID (-1)
 
+#define WORKER_MAX_COUNT              (8)
+#define WORKER_LATENCY_SAMPLE_COUNT   (256)
+
 typedef int task_id;
 
 typedef enum
@@ -21,8 +26,33 @@ typedef enum
   TASK_STATUS_INVALID,
   TASK_STATUS_INPROGRESS,
   TASK_STATUS_COMPLETE,
+  TASK_STATUS_CANCELLED,
 } task_status;
 
+typedef enum
+{
+  TASK_PRIORITY_HIGH,
+  TASK_PRIORITY_NORMAL,
+  TASK_PRIORITY_LOW,
+  TASK_NUM_PRIORITIES
+} task_priority;
+
+typedef struct task_t *task_handle;
+
+typedef struct worker_stats
+{
+  int workerCount;
+  int queueDepth;
+  int queueDepthMax;
+  unsigned int tasksSubmitted;
+  unsigned int tasksCompleted;
+  unsigned int tasksCancelled;
+  unsigned int steals;
+  float latencyP50; // milliseconds, submit to completion
+  float latencyP90;
+  float latencyP99;
+} worker_stats;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,6 +71,16 @@ void worker_update (void);
 task_id worker_add_task (task_func func, void *userdata, task_status *status);
 void worker_remove_task (task_id taskId);
 
+task_handle worker_task_submit (task_func func, void *userdata, task_priority priority);
+task_handle worker_task_then (task_handle parent, task_func func, void *userdata);
+void worker_task_cancel (task_handle task);
+bool worker_task_cancel_requested (void);
+task_status worker_task_get_status (task_handle task);
+task_status worker_task_wait (task_handle task);
+void worker_task_release (task_handle task);
+
+void worker_get_stats (worker_stats *stats);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +35,8 @@
    #define json_char char
 #endif
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 
    #include <string.h>
@@ -49,6 +51,16 @@ typedef struct
    unsigned long max_memory;
    int settings;
 
+   /* Custom allocator support (leave null to use malloc/free)
+    */
+
+   void * (* mem_alloc) (size_t, int zero, void * user_data);
+   void (* mem_free) (void *, void * user_data);
+
+   void * user_data;  /* will be passed to mem_alloc and mem_free */
+
+   size_t value_extra;  /* how much extra space to allocate for values? */
+
 } json_settings;
 
 #define json_relaxed_commas 1
@@ -183,6 +195,13 @@ json_value * json_parse_ex
 void json_value_free (json_value *);
 
 
+/* Not usually necessary, unless you used a custom mem_alloc and now want to
+ * use a custom mem_free.
+ */
+void json_value_free_ex (json_settings * settings,
+                         json_value *);
+
+
 #ifdef __cplusplus
    } /* extern "C" */
 #endif
@@ -65,6 +65,7 @@
 
 #ifndef STBI_malloc
 #define STBI_malloc(x)  cx_malloc(x)
+#define STBI_realloc(x,y) cx_realloc(x,y)
 #define STBI_free(x)    x ? cx_free(x) : (void)x
 #endif
 
@@ -1848,7 +1849,7 @@ static int expand(zbuf *z, int n)  // need to make room for n bytes
    limit = (int) (z->zout_end - z->zout_start);
    while (cur + n > limit)
       limit *= 2;
-   q = (char *) realloc(z->zout_start, limit);
+   q = (char *) STBI_realloc(z->zout_start, limit);
    if (q == NULL) return e("outofmem", "Out of memory");
    z->zout_start = q;
    z->zout       = q + cur;
@@ -2509,7 +2510,7 @@ static int parse_png_file(png *z, int scan, int req_comp)
                if (idata_limit == 0) idata_limit = c.length > 4096 ? c.length : 4096;
                while (ioff + c.length > idata_limit)
                   idata_limit *= 2;
-               p = (uint8 *) realloc(z->idata, idata_limit); if (p == NULL) return e("outofmem", "Out of memory");
+               p = (uint8 *) STBI_realloc(z->idata, idata_limit); if (p == NULL) return e("outofmem", "Out of memory");
                z->idata = p;
             }
             if (!getn(s, z->idata+ioff,c.length)) return e("outofdata","Corrupt PNG");
@@ -18,6 +18,7 @@
 #include "graphics/cx_gdi.h"
 #include "graphics/cx_font.h"
 #include "graphics/cx_mesh.h"
+#include "graphics/cx_globe.h"
 #include "graphics/cx_draw.h"
 #include "network/cx_http.h"
 
@@ -69,6 +70,8 @@ static CX_INLINE void cx_engine_init (cx_engine_init_flags flags, cx_engine_init
     
     _cx_shader_init ();
     _cx_gdi_init (params->graphics.context, params->graphics.screenWidth, params->graphics.screenHeight);
+    _cx_draw_init ();
+    _cx_texture_init ();
   }
   
   if (flags & CX_ENGINE_INIT_NETWORK)
@@ -84,6 +87,8 @@ static CX_INLINE void cx_engine_init (cx_engine_init_flags flags, cx_engine_init
 static CX_INLINE void cx_engine_deinit (void)
 {
   // graphics
+  _cx_texture_deinit ();
+  _cx_draw_deinit ();
   _cx_shader_deinit ();
   _cx_gdi_deinit ();
   
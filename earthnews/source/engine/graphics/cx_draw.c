@@ -4,11 +4,12 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
+#include <float.h>
 
 #include "../system/cx_vector2.h"
 #include "../system/cx_matrix4x4.h"
+#include "../system/cx_util.h"
 #include "cx_draw.h"
 #include "cx_gdi.h"
 #include "cx_shader.h"
@@ -17,212 +18,726 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void cx_draw_quad_colour (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, const cx_colour *colour);
-static void cx_draw_quad_texture (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, cxf32 u1, cxf32 v1,
-                                  cxf32 u2, cxf32 v2, const cx_colour *colour, const cx_texture *texture);
+#define CX_DRAW_BATCH_MAX_QUADS         (16384)   // per draw, 16-bit indices
+#define CX_DRAW_BATCH_MAX_VERTICES      (65536)   // queued before a forced flush
+#define CX_DRAW_BATCH_LOOKBACK          (32)      // runs searched for a matching key
+#define CX_DRAW_BATCH_VBO_SIZE          (CX_DRAW_BATCH_MAX_VERTICES * sizeof (cx_draw_vertex))
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_draw_lines (cxi32 numLines, const cx_line *lines, const cx_colour *colour, cxf32 scale)
+typedef struct cx_draw_vertex
 {
-  CX_ASSERT (numLines > 0);
-  CX_ASSERT (scale > 0.0f);
-  CX_ASSERT (lines);
-  CX_ASSERT (colour);
+  cxf32 x, y, z;
+  cxf32 u, v;
+  cxu8 rgba [4];
+} cx_draw_vertex;
+
+typedef struct cx_draw_key
+{
+  cx_shader_built_in shader;
+  const cx_texture *texture;
+  cxf32 size;                     // line width or point scale
+} cx_draw_key;
+
+// vertices of one cx_draw call, chained to the next command of the same run
+
+typedef struct cx_draw_command
+{
+  cxu32 first;
+  cxu32 count;
+  cxi32 next;
+} cx_draw_command;
+
+// commands sharing a key, drawn with one call. a command may join an earlier run only if its
+// clip space bounds don't overlap any run queued after it, so the blended result is unchanged.
+
+typedef struct cx_draw_run
+{
+  cx_draw_key key;
+  cxf32 bounds [4];               // clip space min x, min y, max x, max y
+  cxi32 head;
+  cxi32 tail;
+  cxu32 vertexCount;
+  cxu32 first;                    // first vertex in vbo, set at flush
+} cx_draw_run;
+
+// draw batch. while active, draws are queued and sorted into runs and submitted from the
+// stream vbo at the end. a change of render state or transform flushes what is queued
+// first. otherwise every draw is flushed straight away.
+
+typedef struct cx_draw_batch
+{
+  cx_draw_vertex *vertices;       // submission order
+  cx_draw_vertex *stream;         // run order, only needed when commands were moved
+  cx_draw_command *commands;
+  cx_draw_run *runs;
+  cxu32 vertexCount;
+  cxu32 vertexCapacity;
+  cxu32 commandCount;
+  cxu32 commandCapacity;
+  cxu32 runCount;
+  cxu32 runCapacity;
+  cx_mat4x4 transforms [CX_NUM_GDI_TRANSFORMS];
+  cx_gdi_renderstate renderstate;
+  GLuint vbo;                     // stream buffer of CX_DRAW_BATCH_VBO_SIZE, written from vboOffset
+  cxu32 vboOffset;
+  GLuint ibo;                     // shared quad indices (0, 1, 2, 2, 1, 3) + 4n
+  bool reordered;
+  bool active;
+  cx_draw_batch_stats stats;
+} cx_draw_batch;
+
+static cx_draw_batch g_drawBatch;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool _cx_draw_init (void)
+{
+  memset (&g_drawBatch, 0, sizeof (g_drawBatch));
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool _cx_draw_deinit (void)
+{
+  cx_draw_batch *batch = &g_drawBatch;
+  
+  CX_ASSERT (!batch->active);
+  
+  if (batch->vbo)
+  {
+    glDeleteBuffers (1, &batch->vbo);
+  }
+  
+  if (batch->ibo)
+  {
+    glDeleteBuffers (1, &batch->ibo);
+  }
+  
+  if (batch->vertices)
+  {
+    cx_free (batch->vertices);
+  }
+  
+  if (batch->stream)
+  {
+    cx_free (batch->stream);
+  }
+  
+  if (batch->commands)
+  {
+    cx_free (batch->commands);
+  }
+  
+  if (batch->runs)
+  {
+    cx_free (batch->runs);
+  }
+  
+  memset (batch, 0, sizeof (g_drawBatch));
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE void cx_draw_colour_to_rgba (const cx_colour *colour, cxu8 *rgba)
+{
+  rgba [0] = (cxu8) cx_util_roundup_int (cx_clamp (colour->r, 0.0f, 1.0f) * 255.0f);
+  rgba [1] = (cxu8) cx_util_roundup_int (cx_clamp (colour->g, 0.0f, 1.0f) * 255.0f);
+  rgba [2] = (cxu8) cx_util_roundup_int (cx_clamp (colour->b, 0.0f, 1.0f) * 255.0f);
+  rgba [3] = (cxu8) cx_util_roundup_int (cx_clamp (colour->a, 0.0f, 1.0f) * 255.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_draw_batch_bounds (const cx_vec2 *pos, cxu32 count, cxf32 z, cxf32 *bounds)
+{
+  // clip space xy extent of pos. false if any point is on or behind the eye
+  
+  const cxf32 *m = g_drawBatch.transforms [CX_GDI_TRANSFORM_MVP].f16;
+  
+  bounds [0] = FLT_MAX;
+  bounds [1] = FLT_MAX;
+  bounds [2] = -FLT_MAX;
+  bounds [3] = -FLT_MAX;
+  
+  for (cxu32 i = 0; i < count; ++i)
+  {
+    cxf32 x = pos [i].x;
+    cxf32 y = pos [i].y;
+    
+    cxf32 cx = (m [0] * x) + (m [4] * y) + (m [8] * z) + m [12];
+    cxf32 cy = (m [1] * x) + (m [5] * y) + (m [9] * z) + m [13];
+    cxf32 cw = (m [3] * x) + (m [7] * y) + (m [11] * z) + m [15];
+    
+    if (cw <= FLT_EPSILON)
+    {
+      return false;
+    }
+    
+    cx = cx / cw;
+    cy = cy / cw;
+    
+    bounds [0] = cx_min (bounds [0], cx);
+    bounds [1] = cx_min (bounds [1], cy);
+    bounds [2] = cx_max (bounds [2], cx);
+    bounds [3] = cx_max (bounds [3], cy);
+  }
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_draw_batch_index_buffer_create (void)
+{
+  cx_draw_batch *batch = &g_drawBatch;
+  
+  CX_ASSERT (batch->ibo == 0);
   
-  cx_mat4x4 mvp;
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
+  cxu16 *indices = (cxu16 *) cx_malloc (sizeof (cxu16) * 6 * CX_DRAW_BATCH_MAX_QUADS);
   
-  cxi32 numSegments = numLines * 2;
+  for (cxu32 q = 0; q < CX_DRAW_BATCH_MAX_QUADS; ++q)
+  {
+    cxu16 v = (cxu16) (q * 4);
+    cxu16 *i = &indices [q * 6];
+    
+    i [0] = v + 0;
+    i [1] = v + 1;
+    i [2] = v + 2;
+    i [3] = v + 2;
+    i [4] = v + 1;
+    i [5] = v + 3;
+  }
+  
+  glGenBuffers (1, &batch->ibo);
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, batch->ibo);
+  glBufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (cxu16) * 6 * CX_DRAW_BATCH_MAX_QUADS, indices, GL_STATIC_DRAW);
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+  cx_gdi_assert_no_errors ();
+  
+  cx_free (indices);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_draw_batch_render_run (const cx_draw_run *run, const cxu8 *data)
+{
+  cx_draw_batch *batch = &g_drawBatch;
   
-  cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_DRAW_LINES);
+  cx_shader *shader = cx_shader_get_built_in (run->key.shader);
   CX_ASSERT (shader);
   
   cx_shader_begin (shader);
   
-  // set mvp
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
+  if (run->key.texture)
+  {
+    cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, run->key.texture);
+  }
   
-  // line width
-  glLineWidth (scale);
+  GLenum mode;
+  GLsizei count = run->vertexCount;
   
-  glVertexAttrib4fv (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], colour->f4);
-  cx_gdi_assert_no_errors ();
+  switch (run->key.shader)
+  {
+    case CX_SHADER_BUILT_IN_DRAW_POINTS:
+    case CX_SHADER_BUILT_IN_DRAW_POINTS_TEX:
+    {
+      cxf32 sceneWidth = cx_gdi_get_screen_height () * 0.5f;
+      
+      cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MV, &batch->transforms [CX_GDI_TRANSFORM_MV]);
+      cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_P, &batch->transforms [CX_GDI_TRANSFORM_P]);
+      cxf32 pointWidth = run->key.size;
+      
+      cx_shader_set_float (shader, "u_sw", &sceneWidth, 1);
+      cx_shader_set_float (shader, "u_pw", &pointWidth, 1);
+      
+      mode = GL_POINTS;
+      break;
+    }
+    
+    case CX_SHADER_BUILT_IN_DRAW_LINES:
+    {
+      cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &batch->transforms [CX_GDI_TRANSFORM_MVP]);
+      
+      glLineWidth (run->key.size);
+      
+      mode = GL_LINES;
+      break;
+    }
+    
+    default:
+    {
+      cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &batch->transforms [CX_GDI_TRANSFORM_MVP]);
+      
+      mode = GL_TRIANGLES;
+      break;
+    }
+  }
+  
+  // no base vertex in es2, so the attribute pointers are offset to the start of the run instead.
+  // data is client memory or an offset into the bound vbo.
+  
+  GLsizei stride = sizeof (cx_draw_vertex);
+  const cxu8 *base = data + (run->first * sizeof (cx_draw_vertex));
+  
+  GLint position = shader->attributes [CX_SHADER_ATTRIBUTE_POSITION];
+  GLint texcoord = shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD];
+  GLint colour = shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR];
+  
+  glVertexAttribPointer (position, 3, GL_FLOAT, GL_FALSE, stride, (base + offsetof (cx_draw_vertex, x)));
+  glVertexAttribPointer (colour, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (base + offsetof (cx_draw_vertex, rgba)));
+  glEnableVertexAttribArray (position);
+  glEnableVertexAttribArray (colour);
+  
+  if (texcoord >= 0)
+  {
+    glVertexAttribPointer (texcoord, 2, GL_FLOAT, GL_FALSE, stride, (base + offsetof (cx_draw_vertex, u)));
+    glEnableVertexAttribArray (texcoord);
+  }
   
-  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 4, GL_FLOAT, GL_FALSE, 0, lines);
   cx_gdi_assert_no_errors ();
   
-  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
+  if (mode == GL_TRIANGLES)
+  {
+    glDrawElements (GL_TRIANGLES, (count / 4) * 6, GL_UNSIGNED_SHORT, (const void *) 0);
+  }
+  else
+  {
+    glDrawArrays (mode, 0, count);
+  }
+  
   cx_gdi_assert_no_errors ();
   
-  glDrawArrays (GL_LINES, 0, numSegments);
+  glDisableVertexAttribArray (position);
+  glDisableVertexAttribArray (colour);
   
-  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
+  if (texcoord >= 0)
+  {
+    glDisableVertexAttribArray (texcoord);
+  }
   
   cx_shader_end (shader);
+  
+  batch->stats.drawCalls++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_draw_points (cxi32 numPoints, const cx_vec4 *points, const cx_colour *colours, const cx_texture *texture, cxf32 scale)
+void cx_draw_batch_flush (void)
 {
-  CX_ASSERT (numPoints > 0);
-  CX_ASSERT (points);
-  CX_ASSERT (colours);
+  cx_draw_batch *batch = &g_drawBatch;
   
-  cx_shader_built_in shaderType = texture ? CX_SHADER_BUILT_IN_DRAW_POINTS_TEX : CX_SHADER_BUILT_IN_DRAW_POINTS;
+  if (batch->runCount == 0)
+  {
+    return;
+  }
   
-  cx_shader *shader = cx_shader_get_built_in (shaderType);
-  CX_ASSERT (shader);
+  // lay out vertices in run order. if no command joined an earlier run they already are.
   
-  cx_shader_begin (shader);
+  const cx_draw_vertex *vertices = batch->vertices;
   
-  if (texture)
+  if (batch->reordered)
   {
-    cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, texture);
+    cxu32 offset = 0;
+    
+    for (cxu32 r = 0; r < batch->runCount; ++r)
+    {
+      cx_draw_run *run = &batch->runs [r];
+      
+      run->first = offset;
+      
+      for (cxi32 c = run->head; c >= 0; c = batch->commands [c].next)
+      {
+        const cx_draw_command *cmd = &batch->commands [c];
+        
+        memcpy (&batch->stream [offset], &batch->vertices [cmd->first], sizeof (cx_draw_vertex) * cmd->count);
+        
+        offset += cmd->count;
+      }
+    }
+    
+    CX_ASSERT (offset == batch->vertexCount);
+    
+    vertices = batch->stream;
+  }
+  else
+  {
+    for (cxu32 r = 0; r < batch->runCount; ++r)
+    {
+      cx_draw_run *run = &batch->runs [r];
+      
+      run->first = batch->commands [run->head].first;
+    }
   }
   
-  // set mvp
-  cx_mat4x4 p, mv;
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_MV, &mv);
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_P, &p);
+  // batches are appended to the stream vbo, which is only orphaned when full so flushes don't
+  // reallocate storage each time. single draws outside a batch are drawn from client memory.
   
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MV, &mv);
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_P, &p);
+  cxu32 bytes = batch->vertexCount * sizeof (cx_draw_vertex);
   
-  // set scene width
-  cxf32 sceneWidth = cx_gdi_get_screen_height () * 0.5f;
-  cx_shader_set_float (shader, "u_sw", &sceneWidth, 1);
+  const cxu8 *data = (const cxu8 *) vertices;
   
-  // set scale
-  cx_shader_set_float (shader, "u_pw", &scale, 1);
+  if (batch->ibo == 0)
+  {
+    cx_draw_batch_index_buffer_create ();
+  }
   
-  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 4, GL_FLOAT, GL_FALSE, 0, points);
-  cx_gdi_assert_no_errors ();
+  if (batch->active)
+  {
+    if (batch->vbo == 0)
+    {
+      glGenBuffers (1, &batch->vbo);
+      glBindBuffer (GL_ARRAY_BUFFER, batch->vbo);
+      glBufferData (GL_ARRAY_BUFFER, CX_DRAW_BATCH_VBO_SIZE, NULL, GL_STREAM_DRAW);
+      
+      batch->vboOffset = 0;
+    }
+    else
+    {
+      glBindBuffer (GL_ARRAY_BUFFER, batch->vbo);
+    }
+    
+    if ((batch->vboOffset + bytes) > CX_DRAW_BATCH_VBO_SIZE)
+    {
+      glBufferData (GL_ARRAY_BUFFER, CX_DRAW_BATCH_VBO_SIZE, NULL, GL_STREAM_DRAW);
+      
+      batch->vboOffset = 0;
+    }
+    
+    glBufferSubData (GL_ARRAY_BUFFER, batch->vboOffset, bytes, vertices);
+    
+    data = (const cxu8 *) (uintptr_t) batch->vboOffset;
+    
+    batch->vboOffset += bytes;
+    batch->stats.bytes += bytes;
+  }
+  else
+  {
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+  }
   
-  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], 4, GL_FLOAT, GL_FALSE, 0, colours);
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, batch->ibo);
   cx_gdi_assert_no_errors ();
   
-  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-  cx_gdi_assert_no_errors ();
+  // draw with the render state the commands were queued under
   
-  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
-  cx_gdi_assert_no_errors ();
+  cx_gdi_renderstate renderstate;
+  cx_gdi_get_renderstate (&renderstate);
   
-  glDrawArrays (GL_POINTS, 0, numPoints);
+  if (renderstate != batch->renderstate)
+  {
+    cx_gdi_set_renderstate (batch->renderstate);
+  }
   
-  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
+  for (cxu32 r = 0; r < batch->runCount; ++r)
+  {
+    cx_draw_batch_render_run (&batch->runs [r], data);
+  }
   
-  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
+  if (renderstate != batch->renderstate)
+  {
+    cx_gdi_set_renderstate (renderstate);
+  }
   
-  cx_shader_end (shader);
+  glBindBuffer (GL_ARRAY_BUFFER, 0);
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+  
+  batch->stats.flushes++;
+  batch->stats.commands += batch->commandCount;
+  batch->stats.vertices += batch->vertexCount;
+  
+  batch->vertexCount = 0;
+  batch->commandCount = 0;
+  batch->runCount = 0;
+  batch->reordered = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_draw_quad_colour (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, const cx_colour *colour)
+static void cx_draw_batch_sync (void)
 {
-  CX_ASSERT (colour);
+  // queued commands were transformed under the captured state. flush them if it has changed.
   
-  cx_mat4x4 mvp;
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
+  cx_draw_batch *batch = &g_drawBatch;
   
-  cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_DRAW_QUAD);
+  cx_gdi_renderstate renderstate;
+  cx_mat4x4 transforms [CX_NUM_GDI_TRANSFORMS];
   
-  // enable shader
-  cx_shader_begin (shader);
+  cx_gdi_get_renderstate (&renderstate);
+  
+  for (int i = 0; i < CX_NUM_GDI_TRANSFORMS; ++i)
+  {
+    cx_gdi_get_transform (i, &transforms [i]);
+  }
   
-  // set mvp
+  if (batch->runCount > 0)
+  {
+    if ((renderstate == batch->renderstate) && (memcmp (transforms, batch->transforms, sizeof (transforms)) == 0))
+    {
+      return;
+    }
+    
+    cx_draw_batch_flush ();
+  }
+  
+  batch->renderstate = renderstate;
+  
+  memcpy (batch->transforms, transforms, sizeof (transforms));
+}
 
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_draw_vertex *cx_draw_batch_alloc (const cx_draw_key *key, cxu32 vertexCount, const cxf32 *bounds)
+{
+  // bounds is null if the command can't be moved past anything (points, lines)
   
-  // set depth
-  cx_shader_set_float (shader, "u_z", &z, 1);
+  CX_ASSERT (key);
+  CX_ASSERT ((vertexCount > 0) && (vertexCount <= CX_DRAW_BATCH_MAX_VERTICES));
   
-  // position attribute
-  cx_vec2 pos [4];
+  cx_draw_batch *batch = &g_drawBatch;
   
-  pos [0].x = x1;
-  pos [0].y = y1;
-  pos [1].x = x1;
-  pos [1].y = y2;
-  pos [2].x = x2;
-  pos [2].y = y1;
-  pos [3].x = x2;
-  pos [3].y = y2;
+  if ((batch->vertexCount + vertexCount) > CX_DRAW_BATCH_MAX_VERTICES)
+  {
+    cx_draw_batch_flush ();
+  }
   
-  // rotation by r radians about the origin ox, oy
-  cxf32 ox = (x1 + x2) * 0.5f;
-  cxf32 oy = (y1 + y2) * 0.5f;
+  if (batch->vertexCapacity < (batch->vertexCount + vertexCount))
+  {
+    batch->vertexCapacity = cx_util_roundup_pow2 (batch->vertexCount + vertexCount);
+    batch->vertices = (cx_draw_vertex *) cx_realloc (batch->vertices, sizeof (cx_draw_vertex) * batch->vertexCapacity);
+    batch->stream = (cx_draw_vertex *) cx_realloc (batch->stream, sizeof (cx_draw_vertex) * batch->vertexCapacity);
+  }
+  
+  if (batch->commandCapacity < (batch->commandCount + 1))
+  {
+    batch->commandCapacity = cx_util_roundup_pow2 (batch->commandCount + 1);
+    batch->commands = (cx_draw_command *) cx_realloc (batch->commands, sizeof (cx_draw_command) * batch->commandCapacity);
+  }
+  
+  // search back for a run with the same key, stopping at the first one this command overlaps
   
-  cxf32 sin = cx_sin (r);
-  cxf32 cos = cx_cos (r);
+  bool quads = (key->shader == CX_SHADER_BUILT_IN_DRAW_QUAD) || (key->shader == CX_SHADER_BUILT_IN_DRAW_QUAD_TEX);
+  cxi32 target = -1;
   
-  for (cxu8 i = 0; i < 4; ++i)
+  for (cxi32 r = batch->runCount - 1, n = 0; (r >= 0) && (n < CX_DRAW_BATCH_LOOKBACK); --r, ++n)
   {
-    cxf32 vx = pos [i].x - ox;
-    cxf32 vy = pos [i].y - oy;
+    const cx_draw_run *run = &batch->runs [r];
     
-    cxf32 rx = (cos * vx) - (sin * vy);
-    cxf32 ry = (sin * vx) + (cos * vy);
+    if ((run->key.shader == key->shader) && (run->key.texture == key->texture) && (run->key.size == key->size) &&
+        (!quads || ((run->vertexCount + vertexCount) <= (CX_DRAW_BATCH_MAX_QUADS * 4))))
+    {
+      target = r;
+      break;
+    }
     
-    pos [i].x = rx + ox;
-    pos [i].y = ry + oy;
+    if (!bounds || ((bounds [0] < run->bounds [2]) && (run->bounds [0] < bounds [2]) &&
+                    (bounds [1] < run->bounds [3]) && (run->bounds [1] < bounds [3])))
+    {
+      break;
+    }
   }
   
-  glVertexAttrib4fv (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], colour->f4);
-  cx_gdi_assert_no_errors ();
+  cxi32 c = batch->commandCount++;
   
-  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 2, GL_FLOAT, GL_FALSE, 0, pos);
-  cx_gdi_assert_no_errors ();
+  cx_draw_command *cmd = &batch->commands [c];
   
-  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-  cx_gdi_assert_no_errors ();
+  cmd->first = batch->vertexCount;
+  cmd->count = vertexCount;
+  cmd->next = -1;
   
-  glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
-  cx_gdi_assert_no_errors ();
+  cx_draw_run *run;
   
-  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
+  if (target >= 0)
+  {
+    run = &batch->runs [target];
+    
+    batch->commands [run->tail].next = c;
+    
+    if (target != (cxi32) (batch->runCount - 1))
+    {
+      batch->reordered = true;
+    }
+  }
+  else
+  {
+    if (batch->runCapacity < (batch->runCount + 1))
+    {
+      batch->runCapacity = cx_util_roundup_pow2 (batch->runCount + 1);
+      batch->runs = (cx_draw_run *) cx_realloc (batch->runs, sizeof (cx_draw_run) * batch->runCapacity);
+    }
+    
+    run = &batch->runs [batch->runCount++];
+    
+    run->key = *key;
+    run->bounds [0] = FLT_MAX;
+    run->bounds [1] = FLT_MAX;
+    run->bounds [2] = -FLT_MAX;
+    run->bounds [3] = -FLT_MAX;
+    run->head = c;
+    run->vertexCount = 0;
+    run->first = 0;
+  }
   
-  cx_shader_end (shader);
+  run->tail = c;
+  run->vertexCount += vertexCount;
+  
+  if (bounds)
+  {
+    run->bounds [0] = cx_min (run->bounds [0], bounds [0]);
+    run->bounds [1] = cx_min (run->bounds [1], bounds [1]);
+    run->bounds [2] = cx_max (run->bounds [2], bounds [2]);
+    run->bounds [3] = cx_max (run->bounds [3], bounds [3]);
+  }
+  else
+  {
+    run->bounds [0] = -FLT_MAX;
+    run->bounds [1] = -FLT_MAX;
+    run->bounds [2] = FLT_MAX;
+    run->bounds [3] = FLT_MAX;
+  }
+  
+  cx_draw_vertex *vertices = &batch->vertices [batch->vertexCount];
+  
+  batch->vertexCount += vertexCount;
+  
+  return vertices;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_draw_quad_texture (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, 
-                           cxf32 u1, cxf32 v1, cxf32 u2, cxf32 v2, const cx_colour *colour, const cx_texture *texture)
+void cx_draw_lines (cxi32 numLines, const cx_line *lines, const cx_colour *colour, cxf32 scale)
 {
+  CX_ASSERT (numLines > 0);
+  CX_ASSERT (scale > 0.0f);
+  CX_ASSERT (lines);
   CX_ASSERT (colour);
-  CX_ASSERT (texture);
   
-  // get mvp
-  cx_mat4x4 mvp;
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
+  cx_draw_batch_sync ();
   
-  cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_DRAW_QUAD_TEX);
+  cx_draw_key key;
   
-  // enable shader
-  cx_shader_begin (shader);
+  key.shader = CX_SHADER_BUILT_IN_DRAW_LINES;
+  key.texture = NULL;
+  key.size = scale;
   
-  // render texture
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, texture);
+  cxu8 rgba [4];
+  cx_draw_colour_to_rgba (colour, rgba);
   
-  // set mvp
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
+  // split into calls that fit the batch
   
-  // set depth
-  cx_shader_set_float (shader, "u_z", &z, 1);
+  const cxi32 maxLines = CX_DRAW_BATCH_MAX_VERTICES / 2;
   
-  cx_vec2 uv [4], pos [4];
+  for (cxi32 l = 0; l < numLines; l += maxLines)
+  {
+    cxi32 count = cx_min (numLines - l, maxLines);
+    
+    cx_draw_vertex *v = cx_draw_batch_alloc (&key, count * 2, NULL);
+    
+    for (cxi32 i = 0; i < count; ++i)
+    {
+      const cx_line *line = &lines [l + i];
+      
+      for (cxu32 e = 0; e < 2; ++e, ++v)
+      {
+        const cx_vec4 *p = e ? &line->end : &line->start;
+        
+        v->x = p->x;
+        v->y = p->y;
+        v->z = p->z;
+        v->u = 0.0f;
+        v->v = 0.0f;
+        memcpy (v->rgba, rgba, sizeof (rgba));
+      }
+    }
+  }
+  
+  if (!g_drawBatch.active)
+  {
+    cx_draw_batch_flush ();
+  }
+}
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_draw_points (cxi32 numPoints, const cx_vec4 *points, const cx_colour *colours, const cx_texture *texture, cxf32 scale)
+{
+  CX_ASSERT (numPoints > 0);
+  CX_ASSERT (points);
+  CX_ASSERT (colours);
+  
+  cx_draw_batch_sync ();
+  
+  cx_draw_key key;
+  
+  key.shader = texture ? CX_SHADER_BUILT_IN_DRAW_POINTS_TEX : CX_SHADER_BUILT_IN_DRAW_POINTS;
+  key.texture = texture;
+  key.size = scale;
+  
+  for (cxi32 p = 0; p < numPoints; p += CX_DRAW_BATCH_MAX_VERTICES)
+  {
+    cxi32 count = cx_min (numPoints - p, CX_DRAW_BATCH_MAX_VERTICES);
+    
+    cx_draw_vertex *v = cx_draw_batch_alloc (&key, count, NULL);
+    
+    for (cxi32 i = p, c = p + count; i < c; ++i, ++v)
+    {
+      v->x = points [i].x;
+      v->y = points [i].y;
+      v->z = points [i].z;
+      v->u = 0.0f;
+      v->v = 0.0f;
+      
+      cx_draw_colour_to_rgba (&colours [i], v->rgba);
+    }
+  }
+  
+  if (!g_drawBatch.active)
+  {
+    cx_draw_batch_flush ();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_draw_quad_add (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r,
+                              cxf32 u1, cxf32 v1, cxf32 u2, cxf32 v2, const cx_colour *colour, const cx_texture *texture)
+{
+  CX_ASSERT (colour);
+  
+  cx_draw_batch_sync ();
+  
+  cx_vec2 uv [4], pos [4];
+  
   uv [0].x = u1;
   uv [0].y = v1;
   uv [1].x = u1;
@@ -241,65 +756,56 @@ void cx_draw_quad_texture (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf3
   pos [3].x = x2;
   pos [3].y = y2;
   
-  cxf32 ox = (x1 + x2) * 0.5f;
-  cxf32 oy = (y1 + y2) * 0.5f;
-  
-  cxf32 sin = cx_sin (r);
-  cxf32 cos = cx_cos (r);
-  
-  for (cxu8 i = 0; i < 4; ++i)
+  if (r != 0.0f)
   {
-    cxf32 vx = pos [i].x - ox;
-    cxf32 vy = pos [i].y - oy;
+    // rotation by r radians about the origin ox, oy
+    cxf32 ox = (x1 + x2) * 0.5f;
+    cxf32 oy = (y1 + y2) * 0.5f;
     
-    cxf32 rx = (cos * vx) - (sin * vy);
-    cxf32 ry = (sin * vx) + (cos * vy);
+    cxf32 sin = cx_sin (r);
+    cxf32 cos = cx_cos (r);
     
-    pos [i].x = rx + ox;
-    pos [i].y = ry + oy;
-  }
-  
-  /*
-  // top left = (0,0)
-  uv [0].x = 0.0f;
-  uv [0].y = 0.0f;
-  uv [1].x = 0.0f;
-  uv [1].y = 1.0f;
-  uv [2].x = 1.0f;
-  uv [2].y = 0.0f;
-  uv [3].x = 1.0f;
-  uv [3].y = 1.0f;
-  */
-  
-  /*
-   // bottom left = (0,0)
-   uv [0].x = 0.0f;
-   uv [0].y = 1.0f;
-   uv [1].x = 0.0f;
-   uv [1].y = 0.0f;
-   uv [2].x = 1.0f;
-   uv [2].y = 1.0f;
-   uv [3].x = 1.0f;
-   uv [3].y = 0.0f;
-   */
-  
-  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
-  
-  glVertexAttrib4fv (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], colour->f4);
-  cx_gdi_assert_no_errors ();
+    for (cxu8 i = 0; i < 4; ++i)
+    {
+      cxf32 vx = pos [i].x - ox;
+      cxf32 vy = pos [i].y - oy;
+      
+      cxf32 rx = (cos * vx) - (sin * vy);
+      cxf32 ry = (sin * vx) + (cos * vy);
+      
+      pos [i].x = rx + ox;
+      pos [i].y = ry + oy;
+    }
+  }
   
-  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 2, GL_FLOAT, GL_FALSE, 0, pos);
-  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, 0, uv);
-  cx_gdi_assert_no_errors ();
+  cx_draw_key key;
   
-  glDrawArrays (GL_TRIANGLE_STRIP, 0, 4);
-  cx_gdi_assert_no_errors ();
+  key.shader = texture ? CX_SHADER_BUILT_IN_DRAW_QUAD_TEX : CX_SHADER_BUILT_IN_DRAW_QUAD;
+  key.texture = texture;
+  key.size = 0.0f;
   
-  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
+  cxf32 bounds [4];
+  bool bounded = cx_draw_batch_bounds (pos, 4, z, bounds);
   
-  cx_shader_end (shader);
+  cx_draw_vertex *v = cx_draw_batch_alloc (&key, 4, bounded ? bounds : NULL);
+  
+  cxu8 rgba [4];
+  cx_draw_colour_to_rgba (colour, rgba);
+  
+  for (cxu32 i = 0; i < 4; ++i, ++v)
+  {
+    v->x = pos [i].x;
+    v->y = pos [i].y;
+    v->z = z;
+    v->u = uv [i].x;
+    v->v = uv [i].y;
+    memcpy (v->rgba, rgba, sizeof (rgba));
+  }
+  
+  if (!g_drawBatch.active)
+  {
+    cx_draw_batch_flush ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -308,29 +814,65 @@ void cx_draw_quad_texture (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf3
 
 void cx_draw_quad (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, const cx_colour *colour, const cx_texture *texture)
 {
-  if (texture)
-  {
-    cx_draw_quad_texture (x1, y1, x2, y2, z, r, 0.0f, 0.0f, 1.0f, 1.0f, colour, texture);
-  }
-  else 
-  {
-    cx_draw_quad_colour (x1, y1, x2, y2, z, r, colour);
-  }
+  cx_draw_quad_add (x1, y1, x2, y2, z, r, 0.0f, 0.0f, 1.0f, 1.0f, colour, texture);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_draw_quad_uv (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, cxf32 u1, cxf32 v1, cxf32 u2, cxf32 v2, 
+void cx_draw_quad_uv (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 r, cxf32 u1, cxf32 v1, cxf32 u2, cxf32 v2,
                     const cx_colour *colour, const cx_texture *texture)
 {
   CX_ASSERT (texture);
   
-  cx_draw_quad_texture (x1, y1, x2, y2, z, r, u1, v1, u2, v2, colour, texture);
+  cx_draw_quad_add (x1, y1, x2, y2, z, r, u1, v1, u2, v2, colour, texture);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void cx_draw_batch_begin (void)
+{
+  CX_ASSERT (!g_drawBatch.active);
+  
+  g_drawBatch.active = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_draw_batch_end (void)
+{
+  CX_ASSERT (g_drawBatch.active);
+  
+  cx_draw_batch_flush ();
+  
+  g_drawBatch.active = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_draw_get_batch_stats (cx_draw_batch_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  *stats = g_drawBatch.stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_draw_reset_batch_stats (void)
+{
+  memset (&g_drawBatch.stats, 0, sizeof (g_drawBatch.stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
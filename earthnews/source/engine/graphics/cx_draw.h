@@ -27,6 +27,15 @@ struct cx_line
 
 typedef struct cx_line cx_line;
 
+typedef struct cx_draw_batch_stats
+{
+  cxu32 drawCalls;
+  cxu32 flushes;
+  cxu32 commands;
+  cxu32 vertices;
+  cxu32 bytes;
+} cx_draw_batch_stats;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -40,9 +49,25 @@ void cx_draw_quad (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 rot,
 
 void cx_draw_quad_uv (cxf32 x1, cxf32 y1, cxf32 x2, cxf32 y2, cxf32 z, cxf32 rot, cxf32 u1, cxf32 v1, cxf32 u2, cxf32 v2, 
                     const cx_colour *colour, const cx_texture *texture);
+
+// between begin and end draws are queued and submitted with as few draw calls as possible.
+// any other rendering inside a batch must call cx_draw_batch_flush first to keep draw order.
+
+void cx_draw_batch_begin (void);
+void cx_draw_batch_end (void);
+void cx_draw_batch_flush (void);
+void cx_draw_get_batch_stats (cx_draw_batch_stats *stats);
+void cx_draw_reset_batch_stats (void);
                     
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+bool _cx_draw_init (void);
+bool _cx_draw_deinit (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 #endif
@@ -8,47 +8,100 @@
 #include "../system/cx_matrix4x4.h"
 #include "../system/cx_vector2.h"
 #include "../system/cx_util.h"
+#include "../system/cx_thread.h"
+#include "../system/cx_time.h"
 #include "../3rdparty/stb/stb_truetype.h"
 
 #include "cx_font.h"
+#include "cx_draw.h"
 #include "cx_gdi.h"
 #include "cx_shader.h"
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
+#include <stddef.h>
+#include <unistd.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define CX_FONT_DEBUG_USE_VBO       (0)
-#define CX_FONT_DEBUG_ENABLE_CHAIN  (0)
-#define CX_FONT_MAX_TEXT_LENGTH     (512)
+#define CX_FONT_DEBUG_ENABLE_CHAIN          (0)
+#define CX_FONT_MAX_TEXT_LENGTH             (512)
+#define CX_FONT_RUN_CACHE_DEFAULT_CAPACITY  (512)
+#define CX_FONT_RUN_CACHE_MAX_TEXT_LENGTH   (256)
+#define CX_FONT_BATCH_MAX_QUADS             (16384) // 16-bit indices
+#define CX_FONT_ATLAS_MIN_SIZE              (256)
+#define CX_FONT_ATLAS_MAX_SIZE              (2048)
+#define CX_FONT_BAKE_MAX_THREADS            (3)
+#define CX_FONT_BAKE_PARALLEL_MIN           (32)    // pending glyphs per thread before a bake is split
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+typedef struct cx_font_vertex
+{
+  cxf32 x, y, z;
+  cxf32 u, v;
+  cxu8 rgba [4];
+} cx_font_vertex;
+
+typedef enum cx_font_glyph_state
+{
+  CX_FONT_GLYPH_STATE_UNLOADED,
+  CX_FONT_GLYPH_STATE_METRICS,          // advance and bitmap box known, no atlas space
+  CX_FONT_GLYPH_STATE_PENDING,          // atlas space assigned, waiting to be rasterised
+  CX_FONT_GLYPH_STATE_READY,
+  CX_FONT_GLYPH_STATE_NO_SPACE,         // atlas is full, advance only
+} cx_font_glyph_state;
+
+typedef struct cx_font_glyph
+{
+  cxu16 x, y, w, h;                     // atlas rect
+  cxi16 xoff, yoff;
+  cxf32 xadvance;
+  cxi32 index;                          // truetype glyph index
+  cxu8 state;
+} cx_font_glyph;
+
+typedef struct cx_font_skyline_node
+{
+  cxi32 x, y, w;
+} cx_font_skyline_node;
+
 typedef struct cx_font_impl_stb
 {
-  stbtt_bakedchar *ttfCharData; 
-  cx_texture *texture;
-  cxu32 textureWidth, textureHeight;
+  stbtt_fontinfo fontInfo;
+  const cxu8 *fileData;                 // mapped for the lifetime of the font
+  cxu32 fileDataSize;
+  cxf32 pixelScale;
+  cx_texture *texture;                  // texture->data is kept as the cpu copy of the atlas
   cxf32 scaleX, scaleY;
   cxf32 height;
   cxu32 *unicodePts;
   cxu32  unicodePtsSize;
   
+  // glyphs (parallel to unicodePts) are loaded on first use
+  cx_font_glyph *glyphs;
+  cx_font_skyline_node *skyline;
+  cxu32 skylineCount;
+  cxu32 skylineCapacity;
+  cxu32 *pending;
+  cxu32 pendingCount;
+  cxu32 pendingCapacity;
+  cxu32 dirtyMinY, dirtyMaxY;
+  
 #if CX_FONT_DEBUG_ENABLE_CHAIN
   const cx_font *chain;
 #endif
-#if CX_FONT_DEBUG_USE_VBO
-  cx_vec2 pos [2048];
-  cx_vec2 uv [2048];
-  cx_colour col [2048];
-  cxu16 indices [6138];
-  GLuint vbos [4];
-#endif
+  
+  // queued glyph quads, drawn from a single vbo
+  cx_font_vertex *batchVertices;
+  cxu32 batchVertexCapacity;
+  cxu32 batchQuadCount;
+  GLuint batchVbo;
+  bool batchQueued;
+  struct cx_font_impl_stb *batchNext;
 } cx_font_impl;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -240,558 +293,1597 @@ static cxu32 *cx_font_create_unicode_codepoints (cx_str_unicode_block *unicodeBl
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void cx_font_get_texture_dims (cxu32 unicodePtsSize, cxu32 *width, cxu32 *height)
+// glyph atlas. glyphs are rasterised on first use into a skyline packed atlas that starts at
+// CX_FONT_ATLAS_MIN_SIZE and doubles up to CX_FONT_ATLAS_MAX_SIZE. metrics and atlas space are
+// assigned as text is laid out, bitmaps are rasterised (split across the bake threads when there
+// are enough of them) and uploaded just before the font is drawn. rects never move when the atlas
+// grows, so laid out uvs are kept in texels and only normalised when quads are queued.
+
+typedef struct cx_font_bake_job
 {
-  CX_ASSERT (width);
-  CX_ASSERT (height);
-  
-  cxu32 size = unicodePtsSize / 2;
-  size = cx_util_roundup_pow2 (size);
+  const stbtt_fontinfo *fontInfo;
+  const cx_font_glyph *glyphs;
+  const cxu32 *pending;
+  cxu8 *pixels;
+  cxi32 pitch;
+  cxf32 scale;
+  cxi32 count;
+  volatile cxi32 next;
+} cx_font_bake_job;
+
+typedef struct cx_font_baker
+{
+  cx_thread *threads [CX_FONT_BAKE_MAX_THREADS];
+  cxi32 threadCount;
+  cx_thread_mutex mutex;          // guards everything below except initialised
+  pthread_cond_t work;            // helpers: new generation with claims left, or quit
+  pthread_cond_t done;            // bake: no helper active
+  cx_font_bake_job *job;
+  cxu32 generation;               // bumped per parallel bake
+  cxi32 claims;                   // helpers still wanted for this generation
+  cxi32 active;                   // helpers running the job
+  bool quit;
+  bool initialised;
+} cx_font_baker;
+
+static cx_font_baker g_fontBaker;
+static cx_font_atlas_stats g_fontAtlasStats;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_bake_job_run (cx_font_bake_job *job)
+{
+  cxi32 i;
   
-  *width = cx_clamp (size, 128, 2048);
-  *height = cx_clamp (size, 128, 2048);
+  while ((i = __sync_fetch_and_add (&job->next, 1)) < job->count)
+  {
+    const cx_font_glyph *glyph = &job->glyphs [job->pending [i]];
+    
+    cxu8 *dst = job->pixels + glyph->x + (glyph->y * job->pitch);
+    
+    stbtt_MakeGlyphBitmap (job->fontInfo, dst, glyph->w, glyph->h, job->pitch, job->scale, job->scale, glyph->index);
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-cx_font * cx_font_create (const char *filename, cxf32 fontsize,
-                          cx_str_unicode_block *unicodeBlocks, cxu32 unicodeBlockCount,
-                          cxu32 *extraUnicodeCodepts, cxu32 extraUnicodeCodeptsCount){
-  CX_ASSERT (filename);
+static cx_thread_exit_status cx_font_baker_thread_func (void *userdata)
+{
+  // a helper joins each generation at most once, and only takes the job while holding a claim, 
+  // so it can't touch a job the bake has already returned from
   
-  cx_font *font = NULL;
+  cx_font_baker *baker = (cx_font_baker *) userdata;
+  CX_ASSERT (baker);
   
-  cxu8 *filedata = NULL;
-  cxu32 filedataSize = 0;
+  cxu32 generation = 0;
   
-  if (cx_file_storage_load_contents (&filedata, &filedataSize, filename, CX_FILE_STORAGE_BASE_RESOURCE))
-  {
-    cxu32 unicodePtsSize = 0;
-    cxu32 *unicodePts = cx_font_create_unicode_codepoints (unicodeBlocks, unicodeBlockCount,
-                                                           extraUnicodeCodepts, extraUnicodeCodeptsCount,
-                                                           &unicodePtsSize);
-    cxu32 textureWidth = 0;
-    cxu32 textureHeight = 0;
-    cx_font_get_texture_dims (unicodePtsSize, &textureWidth, &textureHeight);
-
-    cx_font_impl *fontImpl = (cx_font_impl *) cx_malloc (sizeof (cx_font_impl));
-    memset (fontImpl, 0, sizeof (cx_font_impl));
+  cx_thread_mutex_lock (&baker->mutex);
   
-    fontImpl->unicodePts     = unicodePts;
-    fontImpl->unicodePtsSize = unicodePtsSize;
-    fontImpl->textureWidth   = textureWidth;
-    fontImpl->textureHeight  = textureWidth;
-    fontImpl->scaleX         = 1.0f;
-    fontImpl->scaleY         = 1.0f;
-    fontImpl->height         = fontsize;
-    fontImpl->ttfCharData    = (stbtt_bakedchar *) cx_malloc (fontImpl->unicodePtsSize * sizeof (stbtt_bakedchar));
-    fontImpl->texture        = cx_texture_create (fontImpl->textureWidth, fontImpl->textureHeight, CX_TEXTURE_FORMAT_ALPHA);
-    
-    cxi32 ret = stbtt_BakeFontBitmap2 (filedata,
-                                       0,
-                                       fontsize,
-                                       fontImpl->texture->data,
-                                       fontImpl->textureWidth,
-                                       fontImpl->textureHeight,
-                                       fontImpl->unicodePts,
-                                       fontImpl->unicodePtsSize,
-                                       fontImpl->ttfCharData);
-    CX_ASSERT (ret != -1);
-    CX_REF_UNUSED (ret);
-    
-    cx_texture_gpu_init (fontImpl->texture, true);
-    cx_texture_data_destroy (fontImpl->texture);
+  for (;;)
+  {
+    while (!baker->quit && ((baker->claims == 0) || (baker->generation == generation)))
+    {
+      pthread_cond_wait (&baker->work, &baker->mutex);
+    }
     
-    font = (cx_font *) cx_malloc (sizeof (cx_font));
-    font->fontdata = fontImpl;
+    if (baker->quit)
+    {
+      break;
+    }
+    
+    generation = baker->generation;
+    
+    cx_font_bake_job *job = baker->job;
+    
+    baker->claims--;
+    baker->active++;
     
-    cx_free (filedata);
+    cx_thread_mutex_unlock (&baker->mutex);
+    
+    cx_font_bake_job_run (job);
+    
+    cx_thread_mutex_lock (&baker->mutex);
+    
+    if (--baker->active == 0)
+    {
+      pthread_cond_signal (&baker->done);
+    }
   }
   
-  return font;
+  cx_thread_mutex_unlock (&baker->mutex);
+  
+  return CX_THREAD_EXIT_STATUS_SUCCESS;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_font_destroy (cx_font *font)
+static void cx_font_baker_init (void)
 {
-  CX_ASSERT (font);
-  CX_ASSERT (font->fontdata);
+  cx_font_baker *baker = &g_fontBaker;
   
-  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
+  CX_ASSERT (!baker->initialised);
   
-  cx_texture_destroy (fontImpl->texture);
-  cx_free (fontImpl->unicodePts);
-  cx_free (fontImpl->ttfCharData);
+  // the render thread always takes a share, so leave it a core
   
-  cx_free (font->fontdata);
-  cx_free (font);
+  cxi32 coreCount = (cxi32) sysconf (_SC_NPROCESSORS_ONLN);
+  
+  baker->threadCount = cx_clamp (coreCount - 1, 0, CX_FONT_BAKE_MAX_THREADS);
+  baker->job = NULL;
+  baker->generation = 0;
+  baker->claims = 0;
+  baker->active = 0;
+  baker->quit = false;
+  
+  cx_thread_mutex_init (&baker->mutex);
+  pthread_cond_init (&baker->work, NULL);
+  pthread_cond_init (&baker->done, NULL);
+  
+  for (cxi32 i = 0; i < baker->threadCount; ++i)
+  {
+    baker->threads [i] = cx_thread_create ("cx_font bake thread", CX_THREAD_TYPE_JOINABLE, cx_font_baker_thread_func, baker);
+    CX_FATAL_ASSERT (baker->threads [i]);
+    
+    cx_thread_start (baker->threads [i]);
+  }
+  
+  baker->initialised = true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_font_set_scale (const cx_font *font, cxf32 x, cxf32 y)
+static void cx_font_baker_deinit (void)
 {
-  CX_ASSERT (font);
+  cx_font_baker *baker = &g_fontBaker;
   
-  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
-#if 0
-  fontImpl->scaleX = cx_clamp (x, 0.0f, 1.0f);
-  fontImpl->scaleY = cx_clamp (y, 0.0f, 1.0f);
-#else
-  fontImpl->scaleX = x;
-  fontImpl->scaleY = y;
-#endif
+  CX_ASSERT (baker->initialised);
+  
+  cx_thread_mutex_lock (&baker->mutex);
+  
+  baker->quit = true;
+  
+  pthread_cond_broadcast (&baker->work);
+  
+  cx_thread_mutex_unlock (&baker->mutex);
+  
+  for (cxi32 i = 0; i < baker->threadCount; ++i)
+  {
+    cx_thread_join (baker->threads [i], NULL);
+    cx_thread_destroy (baker->threads [i]);
+    
+    baker->threads [i] = NULL;
+  }
+  
+  pthread_cond_destroy (&baker->work);
+  pthread_cond_destroy (&baker->done);
+  cx_thread_mutex_deinit (&baker->mutex);
+  
+  baker->threadCount = 0;
+  baker->initialised = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_font_chain (cx_font *dst, const cx_font *src)
+static cxu32 cx_font_atlas_get_bytes (const cx_texture *texture)
 {
-  CX_ASSERT (dst);
-  CX_ASSERT (src);
-  CX_ASSERT (dst != src);
+  // cpu copy plus gpu copy with mip chain
   
-#if CX_FONT_DEBUG_ENABLE_CHAIN
-  cx_font_impl *fontImpl = (cx_font_impl *) dst->fontdata;
-
-  fontImpl->chain = src;
-#else
-  CX_ERROR ("cx_font_chain: not implemented");
-#endif
+  cxu32 size = texture->width * texture->height;
+  
+  return size + ((size * 4) / 3);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#if CX_FONT_DEBUG_USE_VBO
-void cx_font_render (const cx_font *font, const char *text, cxf32 x, cxf32 y, cxf32 z,
-                     cx_font_alignment alignment, const cx_colour *colour)
+static void cx_font_atlas_skyline_insert (cx_font_impl *fontImpl, cxu32 index, cxi32 x, cxi32 y, cxi32 w)
 {
-  CX_ASSERT (font);
-  CX_ASSERT (font->fontdata);
-  CX_ASSERT (text);
-  CX_ASSERT (colour);
+  if (fontImpl->skylineCount == fontImpl->skylineCapacity)
+  {
+    fontImpl->skylineCapacity = cx_max (fontImpl->skylineCapacity * 2, 16);
+    fontImpl->skyline = (cx_font_skyline_node *) cx_realloc (fontImpl->skyline, 
+                                                             sizeof (cx_font_skyline_node) * fontImpl->skylineCapacity);
+  }
   
-  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
-  cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_FONT);
+  cx_font_skyline_node *nodes = fontImpl->skyline;
   
-  // use shader
-  cx_shader_begin (shader);
+  memmove (&nodes [index + 1], &nodes [index], sizeof (cx_font_skyline_node) * (fontImpl->skylineCount - index));
   
-  // set texture
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, fontImpl->texture);
+  nodes [index].x = x;
+  nodes [index].y = y;
+  nodes [index].w = w;
   
-  // set mvp
-  cx_mat4x4 mvp;
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
+  fontImpl->skylineCount++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_atlas_skyline_remove (cx_font_impl *fontImpl, cxu32 index)
+{
+  cx_font_skyline_node *nodes = fontImpl->skyline;
   
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
-  cx_shader_set_float (shader, "u_z", &z, 1);
+  fontImpl->skylineCount--;
   
-  cxf32 sx = fontImpl->scaleX;
-  cxf32 sy = fontImpl->scaleY;
-  cxf32 px = x;
-  cxf32 py = y + (fontImpl->height * sy);
+  memmove (&nodes [index], &nodes [index + 1], sizeof (cx_font_skyline_node) * (fontImpl->skylineCount - index));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_font_atlas_skyline_fit (const cx_font_impl *fontImpl, cxu32 index, cxi32 w, cxi32 h, cxi32 *y)
+{
+  // lowest y a w x h rect can sit at with its left edge on node index
   
-  if (alignment & CX_FONT_ALIGNMENT_CENTRE_X)
-  {
-    cxf32 tw = cx_font_get_text_width (font, text);
-    px = px - (tw * 0.5f);
-  }
-  else if (alignment & CX_FONT_ALIGNMENT_RIGHT_X)
-  {
-    cxf32 tw = cx_font_get_text_width (font, text);
-    px = px + (tw * 0.5f);
-  }
+  const cx_font_skyline_node *nodes = fontImpl->skyline;
   
-  if (alignment & CX_FONT_ALIGNMENT_CENTRE_Y)
+  cxi32 atlasWidth = (cxi32) fontImpl->texture->width;
+  cxi32 atlasHeight = (cxi32) fontImpl->texture->height;
+  
+  if ((nodes [index].x + w) > atlasWidth)
   {
-    cxf32 th = cx_font_get_height (font);
-    py = py - (th * 0.5f);
+    return false;
   }
   
-  // gather vertices
+  cxi32 top = nodes [index].y;
+  cxi32 widthLeft = w;
   
-  cxu32 srcSize = strlen (text); // data length
-  const cxu8 *src = (const cxu8 *) text;
-  
-  cxi32 ss = srcSize;
-  cxi32 ds = 0;
-
-  cxu32 vcount = CX_FONT_MAX_TEXT_LENGTH * 4; // 2048
-  
-  if (fontImpl->vbos [0] == 0)
+  while (widthLeft > 0)
   {
-    cxu32 numTri = vcount - 2; // 2046
-    cxu32 icount = numTri * 3; // 6138
-    
-    glGenBuffers (4, fontImpl->vbos);
-    
-    glBindBuffer (GL_ARRAY_BUFFER, fontImpl->vbos [0]);
-    glBufferData (GL_ARRAY_BUFFER, vcount * sizeof (cx_vec2), NULL, GL_DYNAMIC_DRAW);
-    cx_gdi_assert_no_errors ();
+    CX_ASSERT (index < fontImpl->skylineCount);
     
-    glBindBuffer (GL_ARRAY_BUFFER, fontImpl->vbos [1]);
-    glBufferData (GL_ARRAY_BUFFER, vcount * sizeof (cx_vec2), NULL, GL_DYNAMIC_DRAW);
-    cx_gdi_assert_no_errors ();
+    top = cx_max (top, nodes [index].y);
     
-    glBindBuffer (GL_ARRAY_BUFFER, fontImpl->vbos [2]);
-    glBufferData (GL_ARRAY_BUFFER, vcount * sizeof (cx_vec4), NULL, GL_DYNAMIC_DRAW);
-    cx_gdi_assert_no_errors ();
+    if ((top + h) > atlasHeight)
+    {
+      return false;
+    }
     
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, fontImpl->vbos [3]);
-    glBufferData (GL_ELEMENT_ARRAY_BUFFER, icount * sizeof (cxu16), NULL, GL_DYNAMIC_DRAW);
-    cx_gdi_assert_no_errors ();
+    widthLeft -= nodes [index].w;
+    index++;
   }
   
-#if 0
-  cx_vec2 pos [vcount];
-  cx_vec2 uv [vcount];
-  cx_colour col [vcount];
-  cxu16 indices [icount];
-#endif
+  *y = top;
   
-  cxu32 qcount = 0;
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_atlas_skyline_add (cx_font_impl *fontImpl, cxu32 index, cxi32 x, cxi32 y, cxi32 w)
+{
+  cx_font_atlas_skyline_insert (fontImpl, index, x, y, w);
   
-  while (ss > 0)
+  cx_font_skyline_node *nodes = fontImpl->skyline;
+  
+  // trim the nodes now covered by the new one
+  
+  cxu32 i = index + 1;
+  
+  while (i < fontImpl->skylineCount)
   {
-    cxu32 cp = 0;
-    cxu32 offset = cx_str_utf8_decode (&cp, src);
-    cxi32 cIndex = cx_util_bsearch_int (cp, fontImpl->unicodePts, fontImpl->unicodePtsSize);
+    cxi32 right = nodes [i - 1].x + nodes [i - 1].w;
     
-    if (cIndex > -1)
+    if (nodes [i].x >= right)
     {
-      stbtt_aligned_quad quad;
-      stbtt_GetBakedQuad (fontImpl->ttfCharData, fontImpl->textureWidth, fontImpl->textureHeight,
-                          cIndex, sx, sy, &px, &py, &quad, 1);
-      
-      cxu32 i = qcount * 4;
-      
-      CX_ASSERT ((i + 3) < (CX_FONT_MAX_TEXT_LENGTH * 4));
-      
-      fontImpl->pos [i + 0].x = quad.x0;
-      fontImpl->pos [i + 0].y = quad.y0;
-      fontImpl->pos [i + 1].x = quad.x0;
-      fontImpl->pos [i + 1].y = quad.y1;
-      fontImpl->pos [i + 2].x = quad.x1;
-      fontImpl->pos [i + 2].y = quad.y0;
-      fontImpl->pos [i + 3].x = quad.x1;
-      fontImpl->pos [i + 3].y = quad.y1;
-      
-      fontImpl->uv [i + 0].x = quad.s0;
-      fontImpl->uv [i + 0].y = quad.t0;
-      fontImpl->uv [i + 1].x = quad.s0;
-      fontImpl->uv [i + 1].y = quad.t1;
-      fontImpl->uv [i + 2].x = quad.s1;
-      fontImpl->uv [i + 2].y = quad.t0;
-      fontImpl->uv [i + 3].x = quad.s1;
-      fontImpl->uv [i + 3].y = quad.t1;
-
-      fontImpl->col [i + 0] = *colour;
-      fontImpl->col [i + 1] = *colour;
-      fontImpl->col [i + 2] = *colour;
-      fontImpl->col [i + 3] = *colour;
-      
-      ++qcount;
+      break;
     }
     
-    src += offset;
-    ss -= offset;
+    cxi32 shrink = right - nodes [i].x;
+    
+    nodes [i].x += shrink;
+    nodes [i].w -= shrink;
+    
+    if (nodes [i].w > 0)
+    {
+      break;
+    }
     
-    ds++;
+    cx_font_atlas_skyline_remove (fontImpl, i);
   }
   
-  // render text
+  // merge neighbours at the same height
+  
+  i = 0;
   
-  if (qcount > 0)
+  while ((i + 1) < fontImpl->skylineCount)
   {
-    cxu32 numTri = (qcount * 4) - 2;
-    cxu32 tri = 0;
-    cxu16 tript = 0;
-    cxu32 ni = 0;
-    
-    const cx_colour *null = cx_colour_null ();
-    
-    bool spacing = false; // space between characters
-    
-    while (tri < numTri)
+    if (nodes [i].y == nodes [i + 1].y)
     {
-      cxu16 sa0 = tript;      // 0
-      cxu16 sa1 = sa0 + 1;    // 1
-      cxu16 sa2 = sa1 + 1;    // 2
-      
-      cxu16 sa3 = sa2;        // 2
-      cxu16 sa4 = sa1;        // 1
-      cxu16 sa5 = sa3 + 1;    // 3
-
-#if 0
-      fontImpl->col [sa0] = spacing ? *null : *colour;
-      fontImpl->col [sa1] = spacing ? *null : *colour;
-      fontImpl->col [sa2] = spacing ? *null : *colour;
-      fontImpl->col [sa3] = spacing ? *null : *colour;
-      fontImpl->col [sa4] = spacing ? *null : *colour;
-      fontImpl->col [sa5] = spacing ? *null : *colour;
-#endif
-      if (0) //(1 || spacing)
-      {
-        fontImpl->col [sa0] = *null;
-        fontImpl->col [sa1] = *null;
-        fontImpl->col [sa2] = *null;
-        fontImpl->col [sa3] = *null;
-        fontImpl->col [sa4] = *null;
-        fontImpl->col [sa5] = *null;
-      }
-      
-      fontImpl->indices [ni++] = sa0;
-      fontImpl->indices [ni++] = sa1;
-      fontImpl->indices [ni++] = sa2;
-      fontImpl->indices [ni++] = sa3;
-      fontImpl->indices [ni++] = sa4;
-      fontImpl->indices [ni++] = sa5;
+      nodes [i].w += nodes [i + 1].w;
       
-      tript = sa3;
-      
-      tri += 2;
-      
-      spacing = !spacing;
+      cx_font_atlas_skyline_remove (fontImpl, i + 1);
+    }
+    else
+    {
+      i++;
     }
-    
-    glBindBuffer (GL_ARRAY_BUFFER, fontImpl->vbos [0]);
-    glBufferSubData (GL_ARRAY_BUFFER, 0, qcount * 4 * sizeof (cx_vec2), fontImpl->pos);
-    glVertexAttribPointer (shader->attributes[CX_SHADER_ATTRIBUTE_POSITION], 2, GL_FLOAT, GL_FALSE, 0, (const void *) 0);
-    glEnableVertexAttribArray (shader->attributes[CX_SHADER_ATTRIBUTE_POSITION]);
-    
-    glBindBuffer (GL_ARRAY_BUFFER, fontImpl->vbos [1]);
-    glBufferSubData (GL_ARRAY_BUFFER, 0, qcount * 4 * sizeof (cx_vec2), fontImpl->uv);
-    glVertexAttribPointer (shader->attributes[CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, 0, (const void *) 0);
-    glEnableVertexAttribArray (shader->attributes[CX_SHADER_ATTRIBUTE_TEXCOORD]);
-    
-    glBindBuffer (GL_ARRAY_BUFFER, fontImpl->vbos [2]);
-    glBufferSubData (GL_ARRAY_BUFFER, 0, qcount * 4 * sizeof (cx_vec4), fontImpl->col);
-    glVertexAttribPointer (shader->attributes[CX_SHADER_ATTRIBUTE_COLOUR], 4, GL_FLOAT, GL_FALSE, 0, (const void *) 0);
-    glEnableVertexAttribArray (shader->attributes[CX_SHADER_ATTRIBUTE_COLOUR]);
-    
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, fontImpl->vbos [3]);
-    glBufferSubData (GL_ELEMENT_ARRAY_BUFFER, 0, ni * sizeof (cxu16), fontImpl->indices);
-    glDrawElements (GL_TRIANGLE_STRIP, ni, GL_UNSIGNED_SHORT, (const void *) 0);
-    
-    glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-    glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
-    glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
-    
-    glBindBuffer (GL_ARRAY_BUFFER, 0);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
   }
-  
-  cx_shader_end (shader);
 }
-#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#if !CX_FONT_DEBUG_USE_VBO
-void cx_font_render (const cx_font *font, const char *text, cxf32 x, cxf32 y, cxf32 z,
-                     cx_font_alignment alignment, const cx_colour *colour)
+static bool cx_font_atlas_grow (cx_font_impl *fontImpl)
 {
-  CX_ASSERT (font);
-  CX_ASSERT (font->fontdata);
-  CX_ASSERT (text);
-  CX_ASSERT (colour);
+  cx_texture *texture = fontImpl->texture;
   
-  cxu32 srcSize = strlen (text); // data length
+  cxu32 width = texture->width;
+  cxu32 height = texture->height;
   
-  if (srcSize > 0)
+  if ((width >= CX_FONT_ATLAS_MAX_SIZE) && (height >= CX_FONT_ATLAS_MAX_SIZE))
   {
-    cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
-    cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_FONT);
-    
-    // use shader
-    cx_shader_begin (shader);
-    
-    // set texture
-    cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, fontImpl->texture);
-    
-    // set mvp
-    cx_mat4x4 mvp;
-    cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
-    
-    cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
-    cx_shader_set_float (shader, "u_z", &z, 1);
-    
-    cxf32 sx = fontImpl->scaleX;
-    cxf32 sy = fontImpl->scaleY;
-    cxf32 px = x;
-    cxf32 py = y + (fontImpl->height * sy);
-    
-    if (alignment & CX_FONT_ALIGNMENT_CENTRE_X)
-    {
-      cxf32 tw = cx_font_get_text_width (font, text);
-      px = px - (tw * 0.5f);
-    }
-    else if (alignment & CX_FONT_ALIGNMENT_RIGHT_X)
-    {
-      cxf32 tw = cx_font_get_text_width (font, text);
-      px = px + (tw * 0.5f);
-    }
-    
-    if (alignment & CX_FONT_ALIGNMENT_CENTRE_Y)
-    {
-      cxf32 th = cx_font_get_height (font);
-      py = py - (th * 0.5f);
-    }
-    
-    // gather vertices
-    const cxu8 *src = (const cxu8 *) text;
-    
-    cxi32 ss = srcSize;
-    cxi32 ds = 0;
-    
-    cxu32 vcount = srcSize * 4;
+    return false;
+  }
+  
+  cxu32 newWidth = (height < width) ? width : (width * 2);
+  cxu32 newHeight = (height < width) ? (height * 2) : height;
+  
+  g_fontAtlasStats.bytes -= cx_font_atlas_get_bytes (texture);
+  
+  cxu8 *data = (cxu8 *) cx_malloc (newWidth * newHeight);
+  memset (data, 0, newWidth * newHeight);
+  
+  for (cxu32 y = 0; y < height; ++y)
+  {
+    memcpy (data + (y * newWidth), texture->data + (y * width), width);
+  }
+  
+  cx_texture_data_destroy (texture);
+  
+  texture->data = data;
+  texture->dataSize = newWidth * newHeight;
+  texture->imageData [0] = texture->data;
+  texture->imageDataSize [0] = texture->dataSize;
+  texture->width = newWidth;
+  texture->height = newHeight;
+  
+  if (texture->id)
+  {
+    // respecified in full on next draw
+    cx_texture_gpu_deinit (texture);
+  }
+  
+  if (newWidth > width)
+  {
+    cx_font_atlas_skyline_add (fontImpl, fontImpl->skylineCount, width, 1, newWidth - width);
+  }
+  
+  // queued quads were normalised against the old size
+  
+  cxf32 su = (cxf32) width / (cxf32) newWidth;
+  cxf32 sv = (cxf32) height / (cxf32) newHeight;
+  
+  for (cxu32 i = 0, c = fontImpl->batchQuadCount * 4; i < c; ++i)
+  {
+    fontImpl->batchVertices [i].u *= su;
+    fontImpl->batchVertices [i].v *= sv;
+  }
+  
+  fontImpl->dirtyMinY = 0;
+  fontImpl->dirtyMaxY = 0;
+  
+  g_fontAtlasStats.bytes += cx_font_atlas_get_bytes (texture);
+  g_fontAtlasStats.grows++;
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_font_atlas_alloc (cx_font_impl *fontImpl, cxi32 w, cxi32 h, cxi32 *x, cxi32 *y)
+{
+  // bottom-left skyline: lowest top edge wins, then narrowest node
+  
+  for (;;)
+  {
+    cxi32 bestIndex = -1;
+    cxi32 bestTop = 0x7fffffff;
+    cxi32 bestWidth = 0x7fffffff;
+    cxi32 bestY = 0;
+    
+    for (cxu32 i = 0; i < fontImpl->skylineCount; ++i)
+    {
+      cxi32 top;
+      
+      if (cx_font_atlas_skyline_fit (fontImpl, i, w, h, &top))
+      {
+        const cx_font_skyline_node *node = &fontImpl->skyline [i];
+        
+        if (((top + h) < bestTop) || (((top + h) == bestTop) && (node->w < bestWidth)))
+        {
+          bestIndex = (cxi32) i;
+          bestTop = top + h;
+          bestWidth = node->w;
+          bestY = top;
+        }
+      }
+    }
+    
+    if (bestIndex > -1)
+    {
+      *x = fontImpl->skyline [bestIndex].x;
+      *y = bestY;
+      
+      cx_font_atlas_skyline_add (fontImpl, (cxu32) bestIndex, *x, bestY + h, w);
+      
+      return true;
+    }
+    
+    if (!cx_font_atlas_grow (fontImpl))
+    {
+      return false;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const cx_font_glyph *cx_font_glyph_get (cx_font_impl *fontImpl, cxi32 cIndex, bool bitmap)
+{
+  // metrics are loaded on first use, atlas space only once the glyph is drawn
+  
+  CX_ASSERT ((cIndex > -1) && ((cxu32) cIndex < fontImpl->unicodePtsSize));
+  
+  cx_font_glyph *glyph = &fontImpl->glyphs [cIndex];
+  
+  if (glyph->state == CX_FONT_GLYPH_STATE_UNLOADED)
+  {
+    cxf32 scale = fontImpl->pixelScale;
+    
+    int advance, lsb, x0, y0, x1, y1;
+    
+    glyph->index = stbtt_FindGlyphIndex (&fontImpl->fontInfo, fontImpl->unicodePts [cIndex]);
+    
+    stbtt_GetGlyphHMetrics (&fontImpl->fontInfo, glyph->index, &advance, &lsb);
+    stbtt_GetGlyphBitmapBox (&fontImpl->fontInfo, glyph->index, scale, scale, &x0, &y0, &x1, &y1);
+    
+    glyph->w = (cxu16) (x1 - x0);
+    glyph->h = (cxu16) (y1 - y0);
+    glyph->xoff = (cxi16) x0;
+    glyph->yoff = (cxi16) y0;
+    glyph->xadvance = scale * advance;
+    glyph->state = CX_FONT_GLYPH_STATE_METRICS;
+  }
+  
+  if (bitmap && (glyph->state == CX_FONT_GLYPH_STATE_METRICS))
+  {
+    if ((glyph->w == 0) || (glyph->h == 0))
+    {
+      glyph->state = CX_FONT_GLYPH_STATE_READY;
+    }
+    else
+    {
+      // one texel gap right and below so neighbours don't bleed
+      
+      cxi32 x, y;
+      
+      if (cx_font_atlas_alloc (fontImpl, glyph->w + 1, glyph->h + 1, &x, &y))
+      {
+        glyph->x = (cxu16) x;
+        glyph->y = (cxu16) y;
+        glyph->state = CX_FONT_GLYPH_STATE_PENDING;
+        
+        if (fontImpl->pendingCount == fontImpl->pendingCapacity)
+        {
+          fontImpl->pendingCapacity = cx_max (fontImpl->pendingCapacity * 2, 64);
+          fontImpl->pending = (cxu32 *) cx_realloc (fontImpl->pending, sizeof (cxu32) * fontImpl->pendingCapacity);
+        }
+        
+        fontImpl->pending [fontImpl->pendingCount++] = (cxu32) cIndex;
+      }
+      else
+      {
+        CX_LOG_CONSOLE (CX_DEBUG, "cx_font: atlas full, dropping code point [%d]", fontImpl->unicodePts [cIndex]);
+        
+        glyph->state = CX_FONT_GLYPH_STATE_NO_SPACE;
+        
+        g_fontAtlasStats.failed++;
+      }
+    }
+  }
+  
+  return glyph;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_font_glyph_get_quad (cx_font_impl *fontImpl, cxi32 cIndex, cxf32 sx, cxf32 sy, 
+                                    cxf32 *xpos, cxf32 *ypos, stbtt_aligned_quad *q)
+{
+  // as stbtt_GetBakedQuad but with uvs in texels. returns false if the glyph has nothing to draw
+  
+  const cx_font_glyph *glyph = cx_font_glyph_get (fontImpl, cIndex, true);
+  
+  bool drawable = (glyph->state != CX_FONT_GLYPH_STATE_NO_SPACE) && (glyph->w > 0) && (glyph->h > 0);
+  
+  if (drawable)
+  {
+    cxf32 xoff = (cxf32) cx_util_roundup_int (glyph->xoff * sx);
+    cxf32 yoff = (cxf32) cx_util_roundup_int (glyph->yoff * sy);
+    
+    cxi32 round_x = cx_util_roundup_int ((*xpos + xoff) + 0.5f);
+    cxi32 round_y = cx_util_roundup_int ((*ypos + yoff) + 0.5f);
+    
+    cxf32 w = (cxf32) cx_util_roundup_int (glyph->w * sx);
+    cxf32 h = (cxf32) cx_util_roundup_int (glyph->h * sy);
+    
+    q->x0 = round_x;
+    q->y0 = round_y;
+    q->x1 = round_x + w;
+    q->y1 = round_y + h;
+    
+    q->s0 = glyph->x;
+    q->t0 = glyph->y;
+    q->s1 = glyph->x + glyph->w;
+    q->t1 = glyph->y + glyph->h;
+  }
+  
+  *xpos += (glyph->xadvance * sx);
+  
+  return drawable;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_atlas_bake (cx_font_impl *fontImpl)
+{
+  CX_ASSERT (fontImpl->pendingCount > 0);
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  cx_font_baker *baker = &g_fontBaker;
+  
+  cx_font_bake_job job;
+  
+  job.fontInfo = &fontImpl->fontInfo;
+  job.glyphs = fontImpl->glyphs;
+  job.pending = fontImpl->pending;
+  job.pixels = fontImpl->texture->data;
+  job.pitch = (cxi32) fontImpl->texture->width;
+  job.scale = fontImpl->pixelScale;
+  job.count = (cxi32) fontImpl->pendingCount;
+  job.next = 0;
+  
+  // glyph rects don't overlap so threads can write the atlas directly
+  
+  cxi32 helpers = 0;
+  
+  if (job.count >= (CX_FONT_BAKE_PARALLEL_MIN * 2))
+  {
+    if (!baker->initialised)
+    {
+      cx_font_baker_init ();
+    }
+    
+    helpers = cx_min (baker->threadCount, (job.count / CX_FONT_BAKE_PARALLEL_MIN) - 1);
+  }
+  
+  if (helpers > 0)
+  {
+    cx_thread_mutex_lock (&baker->mutex);
+    
+    baker->job = &job;
+    baker->generation++;
+    baker->claims = helpers;
+    
+    pthread_cond_broadcast (&baker->work);
+    
+    cx_thread_mutex_unlock (&baker->mutex);
+  }
+  
+  cx_font_bake_job_run (&job);
+  
+  if (helpers > 0)
+  {
+    // helpers that haven't woken yet aren't needed, the job is done once the active ones finish
+    
+    cx_thread_mutex_lock (&baker->mutex);
+    
+    baker->claims = 0;
+    
+    while (baker->active > 0)
+    {
+      pthread_cond_wait (&baker->done, &baker->mutex);
+    }
+    
+    baker->job = NULL;
+    
+    cx_thread_mutex_unlock (&baker->mutex);
+  }
+  
+  cxu32 minY = fontImpl->dirtyMinY;
+  cxu32 maxY = fontImpl->dirtyMaxY;
+  
+  if (maxY == 0)
+  {
+    minY = fontImpl->texture->height;
+  }
+  
+  for (cxu32 i = 0; i < fontImpl->pendingCount; ++i)
+  {
+    cx_font_glyph *glyph = &fontImpl->glyphs [fontImpl->pending [i]];
+    
+    CX_ASSERT (glyph->state == CX_FONT_GLYPH_STATE_PENDING);
+    
+    glyph->state = CX_FONT_GLYPH_STATE_READY;
+    
+    minY = cx_min (minY, glyph->y);
+    maxY = cx_max (maxY, (cxu32) (glyph->y + glyph->h));
+  }
+  
+  fontImpl->dirtyMinY = minY;
+  fontImpl->dirtyMaxY = maxY;
+  
+  cx_time_stop_timer (&timer);
+  
+  g_fontAtlasStats.glyphs += fontImpl->pendingCount;
+  g_fontAtlasStats.bakeTime += (cxf32) timer.elapsedTime;
+  
+  fontImpl->pendingCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_atlas_commit (cx_font_impl *fontImpl)
+{
+  // rasterise anything laid out since the last draw and bring the texture up to date
+  
+  if (fontImpl->pendingCount > 0)
+  {
+    cx_font_atlas_bake (fontImpl);
+  }
+  
+  cx_texture *texture = fontImpl->texture;
+  
+  if (texture->id == 0)
+  {
+    cx_texture_gpu_init (texture, true);
+    
+    g_fontAtlasStats.uploads++;
+    g_fontAtlasStats.uploadBytes += texture->dataSize;
+  }
+  else if (fontImpl->dirtyMaxY > fontImpl->dirtyMinY)
+  {
+    // whole rows, es2 can't upload a sub rect of a wider image
+    
+    cxu32 y = fontImpl->dirtyMinY;
+    cxu32 h = fontImpl->dirtyMaxY - fontImpl->dirtyMinY;
+    
+    glBindTexture (GL_TEXTURE_2D, texture->id);
+    glTexSubImage2D (GL_TEXTURE_2D, 0, 0, y, texture->width, h, GL_ALPHA, GL_UNSIGNED_BYTE, 
+                     texture->data + (y * texture->width));
+    glGenerateMipmap (GL_TEXTURE_2D);
+    cx_gdi_assert_no_errors ();
+    
+    g_fontAtlasStats.uploads++;
+    g_fontAtlasStats.uploadBytes += texture->width * h;
+  }
+  
+  fontImpl->dirtyMinY = 0;
+  fontImpl->dirtyMaxY = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// shaped run cache. runs are laid out at the origin so they can be reused at any position, keyed
+// by (font, scale, text) and evicted least recently used first. render thread only.
+
+typedef struct cx_font_run
+{
+  const cx_font *font;
+  cxf32 scaleX, scaleY;
+  cxu32 hash;
+  cxu32 textLen;
+  char *text;
+  cx_vec2 *pos;                   // quadCount * 4, owns the allocation for uv and text
+  cx_vec2 *uv;                    // quadCount * 4
+  cxu32 quadCount;
+  cxu32 bytes;
+  cxf32 width;
+  struct cx_font_run *prev;       // lru, most recent at head
+  struct cx_font_run *next;
+  struct cx_font_run *chain;      // hash bucket
+} cx_font_run;
+
+typedef struct cx_font_run_cache
+{
+  cx_font_run *runs;
+  cx_font_run **buckets;
+  cx_font_run *head;
+  cx_font_run *tail;
+  cx_font_run *free;
+  cx_font_run scratch;            // for uncached runs
+  cxu32 bucketMask;
+  bool initialised;
+  cx_font_run_cache_stats stats;
+  
+} cx_font_run_cache;
+
+// text batch. while active, glyph quads are queued per font and each font is drawn with one
+// indexed draw at the end. otherwise every render call is flushed straight away.
+
+typedef struct cx_font_batch
+{
+  cx_font_impl *head;             // fonts with queued quads, in order of first use
+  cx_font_impl *tail;
+  GLuint ibo;                     // shared quad indices (0, 1, 2, 2, 1, 3) + 4n
+  cxu32 iboQuadCount;
+  cxu32 fontCount;
+  bool active;
+  cx_font_batch_stats stats;
+} cx_font_batch;
+
+static cx_font_run_cache g_fontRunCache;
+static cx_font_batch g_fontBatch;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_font_run_hash (const cx_font *font, cxf32 sx, cxf32 sy, const char *text, cxu32 len)
+{
+  // fnv-1a
+  
+  union { cxf32 f; cxu32 u; } fx, fy;
+  
+  fx.f = sx;
+  fy.f = sy;
+  
+  cxu32 hash = 2166136261u;
+  
+  hash = (hash ^ (cxu32) (uintptr_t) font) * 16777619u;
+  hash = (hash ^ fx.u) * 16777619u;
+  hash = (hash ^ fy.u) * 16777619u;
+  
+  for (cxu32 i = 0; i < len; ++i)
+  {
+    hash = (hash ^ (cxu8) text [i]) * 16777619u;
+  }
+  
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_layout (cx_font_run *run, const cx_font *font, const char *text, cxu32 len)
+{
+  // run->pos/uv must have room for len quads (decoded length <= len). uvs are in texels
+  
+  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
+  
+  cxf32 sx = fontImpl->scaleX;
+  cxf32 sy = fontImpl->scaleY;
+  cxf32 px = 0.0f;
+  cxf32 py = fontImpl->height * sy;
+  
+  const cxu8 *src = (const cxu8 *) text;
+  cxi32 ss = len;
+  
+  cxu32 qcount = 0;
+  
+  while (ss > 0)
+  {
+    cxu32 cp = 0;
+    cxu32 offset = cx_str_utf8_decode (&cp, src);
+    cxi32 cIndex = cx_font_bsearch_codepoint_index (cp, fontImpl->unicodePts, fontImpl->unicodePtsSize);
+    
+    stbtt_aligned_quad quad;
+    
+    if ((cIndex > -1) && cx_font_glyph_get_quad (fontImpl, cIndex, sx, sy, &px, &py, &quad))
+    {
+      cxu32 i = qcount * 4;
+      
+      CX_ASSERT ((i + 3) < (len * 4));
+      
+      run->pos [i + 0].x = quad.x0;
+      run->pos [i + 0].y = quad.y0;
+      run->pos [i + 1].x = quad.x0;
+      run->pos [i + 1].y = quad.y1;
+      run->pos [i + 2].x = quad.x1;
+      run->pos [i + 2].y = quad.y0;
+      run->pos [i + 3].x = quad.x1;
+      run->pos [i + 3].y = quad.y1;
+      
+      run->uv [i + 0].x = quad.s0;
+      run->uv [i + 0].y = quad.t0;
+      run->uv [i + 1].x = quad.s0;
+      run->uv [i + 1].y = quad.t1;
+      run->uv [i + 2].x = quad.s1;
+      run->uv [i + 2].y = quad.t0;
+      run->uv [i + 3].x = quad.s1;
+      run->uv [i + 3].y = quad.t1;
+      
+      ++qcount;
+    }
+    
+    src += offset;
+    ss -= offset;
+  }
+  
+  run->quadCount = qcount;
+  run->width = px;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_lru_unlink (cx_font_run *run)
+{
+  cx_font_run_cache *cache = &g_fontRunCache;
+  
+  if (run->prev)
+  {
+    run->prev->next = run->next;
+  }
+  else
+  {
+    cache->head = run->next;
+  }
+  
+  if (run->next)
+  {
+    run->next->prev = run->prev;
+  }
+  else
+  {
+    cache->tail = run->prev;
+  }
+  
+  run->prev = NULL;
+  run->next = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_lru_push (cx_font_run *run)
+{
+  cx_font_run_cache *cache = &g_fontRunCache;
+  
+  run->prev = NULL;
+  run->next = cache->head;
+  
+  if (cache->head)
+  {
+    cache->head->prev = run;
+  }
+  else
+  {
+    cache->tail = run;
+  }
+  
+  cache->head = run;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_remove (cx_font_run *run)
+{
+  // unlink from bucket and lru, free data and return to free list
+  
+  cx_font_run_cache *cache = &g_fontRunCache;
+  
+  cx_font_run **link = &cache->buckets [run->hash & cache->bucketMask];
+  
+  while (*link != run)
+  {
+    CX_ASSERT (*link);
+    link = &(*link)->chain;
+  }
+  
+  *link = run->chain;
+  
+  cx_font_run_lru_unlink (run);
+  
+  cache->stats.count--;
+  cache->stats.bytes -= run->bytes;
+  
+  cx_free (run->pos);
+  
+  memset (run, 0, sizeof (cx_font_run));
+  
+  run->chain = cache->free;
+  cache->free = run;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_cache_init (cxu32 capacity)
+{
+  cx_font_run_cache *cache = &g_fontRunCache;
+  
+  cxu32 bucketCount = cx_util_roundup_pow2 (cx_max (capacity * 2, 2));
+  
+  cache->runs = (capacity > 0) ? cx_malloc (sizeof (cx_font_run) * capacity) : NULL;
+  cache->buckets = cx_malloc (sizeof (cx_font_run *) * bucketCount);
+  cache->bucketMask = bucketCount - 1;
+  cache->head = NULL;
+  cache->tail = NULL;
+  cache->free = NULL;
+  cache->stats.count = 0;
+  cache->stats.bytes = 0;
+  cache->stats.capacity = capacity;
+  cache->initialised = true;
+  
+  memset (cache->buckets, 0, sizeof (cx_font_run *) * bucketCount);
+  
+  for (cxu32 i = capacity; i > 0; --i)
+  {
+    cx_font_run *run = &cache->runs [i - 1];
+    
+    memset (run, 0, sizeof (cx_font_run));
+    
+    run->chain = cache->free;
+    cache->free = run;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_cache_deinit (void)
+{
+  cx_font_run_cache *cache = &g_fontRunCache;
+  
+  while (cache->head)
+  {
+    cx_font_run_remove (cache->head);
+  }
+  
+  if (cache->runs)
+  {
+    cx_free (cache->runs);
+  }
+  
+  cx_free (cache->buckets);
+  
+  if (cache->scratch.pos)
+  {
+    cx_free (cache->scratch.pos);
+  }
+  
+  memset (&cache->scratch, 0, sizeof (cx_font_run));
+  
+  cache->runs = NULL;
+  cache->buckets = NULL;
+  cache->free = NULL;
+  cache->initialised = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_font_run *cx_font_run_scratch_reserve (cxu32 quadCount)
+{
+  // grow-only quad buffer for runs that aren't cached, contents are only valid until the next call
+  
+  cx_font_run *run = &g_fontRunCache.scratch;
+  
+  if (run->textLen < quadCount)
+  {
+    if (run->pos)
+    {
+      cx_free (run->pos);
+    }
+    
+    run->pos = cx_malloc (sizeof (cx_vec2) * quadCount * 8);
+    run->uv = run->pos + (quadCount * 4);
+    run->textLen = quadCount; // capacity
+  }
+  
+  return run;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const cx_font_run *cx_font_run_get (const cx_font *font, const char *text, cxu32 len)
+{
+  cx_font_run_cache *cache = &g_fontRunCache;
+  
+  if (!cache->initialised)
+  {
+    cx_font_run_cache_init (CX_FONT_RUN_CACHE_DEFAULT_CAPACITY);
+  }
+  
+  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
+  
+  cxf32 sx = fontImpl->scaleX;
+  cxf32 sy = fontImpl->scaleY;
+  cxu32 hash = cx_font_run_hash (font, sx, sy, text, len);
+  
+  cx_font_run *run = cache->buckets [hash & cache->bucketMask];
+  
+  while (run)
+  {
+    if ((run->hash == hash) && (run->font == font) && (run->textLen == len) && 
+        (run->scaleX == sx) && (run->scaleY == sy) && (memcmp (run->text, text, len) == 0))
+    {
+      if (run != cache->head)
+      {
+        cx_font_run_lru_unlink (run);
+        cx_font_run_lru_push (run);
+      }
+      
+      cache->stats.hits++;
+      
+      return run;
+    }
+    
+    run = run->chain;
+  }
+  
+  cache->stats.misses++;
+  
+  if ((cache->stats.capacity == 0) || (len > CX_FONT_RUN_CACHE_MAX_TEXT_LENGTH))
+  {
+    // lay out into scratch
+    
+    run = cx_font_run_scratch_reserve (len);
+    
+    cx_font_run_layout (run, font, text, len);
+    
+    return run;
+  }
+  
+  if (!cache->free)
+  {
+    cache->stats.evictions++;
+    
+    cx_font_run_remove (cache->tail);
+  }
+  
+  CX_ASSERT (cache->free);
+  
+  run = cache->free;
+  cache->free = run->chain;
+  
+  // text and quads in one block (quads first for alignment)
+  
+  run->bytes = (sizeof (cx_vec2) * len * 8) + len;
+  run->pos = cx_malloc (run->bytes);
+  run->uv = run->pos + (len * 4);
+  run->text = (char *) (run->uv + (len * 4));
+  run->textLen = len;
+  run->font = font;
+  run->scaleX = sx;
+  run->scaleY = sy;
+  run->hash = hash;
+  
+  memcpy (run->text, text, len);
+  
+  cx_font_run_layout (run, font, text, len);
+  
+  run->chain = cache->buckets [hash & cache->bucketMask];
+  cache->buckets [hash & cache->bucketMask] = run;
+  
+  cx_font_run_lru_push (run);
+  
+  cache->stats.count++;
+  cache->stats.bytes += run->bytes;
+  
+  return run;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_batch_index_buffer_reserve (cxu32 quadCount)
+{
+  cx_font_batch *batch = &g_fontBatch;
+  
+  if (batch->iboQuadCount < quadCount)
+  {
+    cxu32 count = cx_min (cx_util_roundup_pow2 (quadCount), CX_FONT_BATCH_MAX_QUADS);
+    cxu16 *indices = (cxu16 *) cx_malloc (sizeof (cxu16) * 6 * count);
+    
+    for (cxu32 q = 0; q < count; ++q)
+    {
+      cxu16 v = (cxu16) (q * 4);
+      cxu16 *i = &indices [q * 6];
+      
+      i [0] = v + 0;
+      i [1] = v + 1;
+      i [2] = v + 2;
+      i [3] = v + 2;
+      i [4] = v + 1;
+      i [5] = v + 3;
+    }
+    
+    if (batch->ibo == 0)
+    {
+      glGenBuffers (1, &batch->ibo);
+    }
+    
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, batch->ibo);
+    glBufferData (GL_ELEMENT_ARRAY_BUFFER, sizeof (cxu16) * 6 * count, indices, GL_STATIC_DRAW);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+    cx_gdi_assert_no_errors ();
+    
+    batch->iboQuadCount = count;
+    
+    cx_free (indices);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_batch_flush_font (cx_font_impl *fontImpl)
+{
+  CX_ASSERT (fontImpl);
+  CX_ASSERT (fontImpl->batchQuadCount > 0);
+  
+  cx_font_batch *batch = &g_fontBatch;
+  
+  cxu32 quadCount = fontImpl->batchQuadCount;
+  cxu32 bytes = quadCount * 4 * sizeof (cx_font_vertex);
+  
+  // anything cx_draw has queued goes first
+  cx_draw_batch_flush ();
+  
+  cx_font_atlas_commit (fontImpl);
+  
+  cx_font_batch_index_buffer_reserve (quadCount);
+  
+  cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_FONT);
+  
+  // use shader
+  cx_shader_begin (shader);
+  
+  // set texture
+  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, fontImpl->texture);
+  
+  // set mvp
+  cx_mat4x4 mvp;
+  cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
+  
+  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
+  
+  // respecify the whole buffer every flush so the driver can orphan the storage in flight
+  
+  if (fontImpl->batchVbo == 0)
+  {
+    glGenBuffers (1, &fontImpl->batchVbo);
+  }
+  
+  glBindBuffer (GL_ARRAY_BUFFER, fontImpl->batchVbo);
+  glBufferData (GL_ARRAY_BUFFER, bytes, fontImpl->batchVertices, GL_STREAM_DRAW);
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, batch->ibo);
+  cx_gdi_assert_no_errors ();
+  
+  GLsizei stride = sizeof (cx_font_vertex);
+  
+  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 3, GL_FLOAT, GL_FALSE, stride, 
+                         (const void *) offsetof (cx_font_vertex, x));
+  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, stride, 
+                         (const void *) offsetof (cx_font_vertex, u));
+  glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, 
+                         (const void *) offsetof (cx_font_vertex, rgba));
+  
+  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
+  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
+  glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
+  cx_gdi_assert_no_errors ();
+  
+  glDrawElements (GL_TRIANGLES, quadCount * 6, GL_UNSIGNED_SHORT, (const void *) 0);
+  cx_gdi_assert_no_errors ();
+  
+  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
+  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
+  glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
+  
+  glBindBuffer (GL_ARRAY_BUFFER, 0);
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, 0);
+  
+  cx_shader_end (shader);
+  
+  batch->stats.drawCalls++;
+  batch->stats.quads += quadCount;
+  batch->stats.bytes += bytes;
+  
+  fontImpl->batchQuadCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_font_vertex *cx_font_batch_alloc (cx_font_impl *fontImpl, cxu32 quadCount)
+{
+  CX_ASSERT (fontImpl);
+  CX_ASSERT ((quadCount > 0) && (quadCount <= CX_FONT_BATCH_MAX_QUADS));
+  
+  cx_font_batch *batch = &g_fontBatch;
+  
+  if ((fontImpl->batchQuadCount + quadCount) > CX_FONT_BATCH_MAX_QUADS)
+  {
+    cx_font_batch_flush_font (fontImpl);
+  }
+  
+  cxu32 vertexCount = (fontImpl->batchQuadCount + quadCount) * 4;
+  
+  if (fontImpl->batchVertexCapacity < vertexCount)
+  {
+    fontImpl->batchVertexCapacity = cx_util_roundup_pow2 (vertexCount);
+    fontImpl->batchVertices = (cx_font_vertex *) cx_realloc (fontImpl->batchVertices, 
+                                                             sizeof (cx_font_vertex) * fontImpl->batchVertexCapacity);
+  }
+  
+  if (batch->active && !fontImpl->batchQueued)
+  {
+    fontImpl->batchQueued = true;
+    fontImpl->batchNext = NULL;
+    
+    if (batch->tail)
+    {
+      batch->tail->batchNext = fontImpl;
+    }
+    else
+    {
+      batch->head = fontImpl;
+    }
+    
+    batch->tail = fontImpl;
+  }
+  
+  cx_font_vertex *vertices = &fontImpl->batchVertices [fontImpl->batchQuadCount * 4];
+  
+  fontImpl->batchQuadCount += quadCount;
+  
+  return vertices;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_batch_add (cx_font_impl *fontImpl, const cx_vec2 *pos, const cx_vec2 *uv, cxu32 quadCount,
+                               cxf32 tx, cxf32 ty, cxf32 z, const cx_colour *colour)
+{
+  cx_font_vertex *v = cx_font_batch_alloc (fontImpl, quadCount);
+  
+  cxf32 iw = 1.0f / (cxf32) fontImpl->texture->width;
+  cxf32 ih = 1.0f / (cxf32) fontImpl->texture->height;
+  
+  cxu8 rgba [4];
+  
+  rgba [0] = (cxu8) cx_util_roundup_int (cx_clamp (colour->r, 0.0f, 1.0f) * 255.0f);
+  rgba [1] = (cxu8) cx_util_roundup_int (cx_clamp (colour->g, 0.0f, 1.0f) * 255.0f);
+  rgba [2] = (cxu8) cx_util_roundup_int (cx_clamp (colour->b, 0.0f, 1.0f) * 255.0f);
+  rgba [3] = (cxu8) cx_util_roundup_int (cx_clamp (colour->a, 0.0f, 1.0f) * 255.0f);
+  
+  for (cxu32 i = 0, c = quadCount * 4; i < c; ++i, ++v)
+  {
+    v->x = pos [i].x + tx;
+    v->y = pos [i].y + ty;
+    v->z = z;
+    v->u = uv [i].x * iw;
+    v->v = uv [i].y * ih;
+    v->rgba [0] = rgba [0];
+    v->rgba [1] = rgba [1];
+    v->rgba [2] = rgba [2];
+    v->rgba [3] = rgba [3];
+  }
+  
+  if (!g_fontBatch.active)
+  {
+    cx_font_batch_flush_font (fontImpl);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_batch_unqueue (cx_font_impl *fontImpl)
+{
+  // font is being destroyed mid batch
+  
+  cx_font_batch *batch = &g_fontBatch;
+  
+  cx_font_impl *prev = NULL;
+  cx_font_impl *curr = batch->head;
+  
+  while (curr && (curr != fontImpl))
+  {
+    prev = curr;
+    curr = curr->batchNext;
+  }
+  
+  if (curr)
+  {
+    if (prev)
+    {
+      prev->batchNext = curr->batchNext;
+    }
+    else
+    {
+      batch->head = curr->batchNext;
+    }
+    
+    if (batch->tail == curr)
+    {
+      batch->tail = prev;
+    }
+  }
+  
+  fontImpl->batchQueued = false;
+  fontImpl->batchQuadCount = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_font_run_cache_purge (const cx_font *font)
+{
+  cx_font_run *run = g_fontRunCache.head;
+  
+  while (run)
+  {
+    cx_font_run *next = run->next;
+    
+    if (run->font == font)
+    {
+      cx_font_run_remove (run);
+    }
+    
+    run = next;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_font * cx_font_create (const char *filename, cxf32 fontsize,
+                          cx_str_unicode_block *unicodeBlocks, cxu32 unicodeBlockCount,
+                          cxu32 *extraUnicodeCodepts, cxu32 extraUnicodeCodeptsCount){
+  CX_ASSERT (filename);
+  
+  cx_font *font = NULL;
+  
+  const cxu8 *filedata = NULL;
+  cxu32 filedataSize = 0;
+  
+  if (cx_file_storage_map_contents (&filedata, &filedataSize, filename, CX_FILE_STORAGE_BASE_RESOURCE))
+  {
+    cxu32 unicodePtsSize = 0;
+    cxu32 *unicodePts = cx_font_create_unicode_codepoints (unicodeBlocks, unicodeBlockCount,
+                                                           extraUnicodeCodepts, extraUnicodeCodeptsCount,
+                                                           &unicodePtsSize);
+    
+    cx_font_impl *fontImpl = (cx_font_impl *) cx_malloc (sizeof (cx_font_impl));
+    memset (fontImpl, 0, sizeof (cx_font_impl));
+    
+    stbtt_InitFont (&fontImpl->fontInfo, filedata, 0);
     
-    cx_vec2 pos [vcount]; // unicode decoded strlen <= srcSize
-    cx_vec2 uv [vcount];
+    // nothing is rasterised here, glyphs are added to the atlas as they are first drawn
+    
+    fontImpl->fileData       = filedata;
+    fontImpl->fileDataSize   = filedataSize;
+    fontImpl->pixelScale     = stbtt_ScaleForPixelHeight (&fontImpl->fontInfo, fontsize);
+    fontImpl->unicodePts     = unicodePts;
+    fontImpl->unicodePtsSize = unicodePtsSize;
+    fontImpl->scaleX         = 1.0f;
+    fontImpl->scaleY         = 1.0f;
+    fontImpl->height         = fontsize;
+    fontImpl->glyphs         = (cx_font_glyph *) cx_malloc (fontImpl->unicodePtsSize * sizeof (cx_font_glyph));
+    fontImpl->texture        = cx_texture_create (CX_FONT_ATLAS_MIN_SIZE, CX_FONT_ATLAS_MIN_SIZE, CX_TEXTURE_FORMAT_ALPHA);
+    
+    memset (fontImpl->glyphs, 0, fontImpl->unicodePtsSize * sizeof (cx_font_glyph));
+    memset (fontImpl->texture->data, 0, fontImpl->texture->dataSize);
+    
+    // one texel border on the top and left
+    cx_font_atlas_skyline_insert (fontImpl, 0, 1, 1, CX_FONT_ATLAS_MIN_SIZE - 1);
+    
+    g_fontAtlasStats.bytes += cx_font_atlas_get_bytes (fontImpl->texture);
+    
+    font = (cx_font *) cx_malloc (sizeof (cx_font));
+    font->fontdata = fontImpl;
+    
+    g_fontBatch.fontCount++;
+  }
+  
+  return font;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_destroy (cx_font *font)
+{
+  CX_ASSERT (font);
+  CX_ASSERT (font->fontdata);
+  
+  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
+  
+  if (g_fontRunCache.initialised)
+  {
+    cx_font_run_cache_purge (font);
+  }
+  
+  if (fontImpl->batchQueued)
+  {
+    cx_font_batch_unqueue (fontImpl);
+  }
+  
+  if (fontImpl->batchVbo)
+  {
+    glDeleteBuffers (1, &fontImpl->batchVbo);
+  }
+  
+  if (fontImpl->batchVertices)
+  {
+    cx_free (fontImpl->batchVertices);
+  }
+  
+  CX_ASSERT (g_fontBatch.fontCount > 0);
+  
+  if (--g_fontBatch.fontCount == 0)
+  {
+    if (g_fontBatch.ibo)
+    {
+      glDeleteBuffers (1, &g_fontBatch.ibo);
+    }
     
-    cxu32 qcount = 0;
+    g_fontBatch.ibo = 0;
+    g_fontBatch.iboQuadCount = 0;
     
-    while (ss > 0)
+    if (g_fontBaker.initialised)
     {
-      cxu32 cp = 0;
-      cxu32 offset = cx_str_utf8_decode (&cp, src);
-      cxi32 cIndex = cx_font_bsearch_codepoint_index (cp, fontImpl->unicodePts, fontImpl->unicodePtsSize);
-      
-      if (cIndex > -1)
-      {
-        stbtt_aligned_quad quad;
-        stbtt_GetBakedQuad (fontImpl->ttfCharData, fontImpl->textureWidth, fontImpl->textureHeight,
-                            cIndex, sx, sy, &px, &py, &quad, 1);
-        
-        cxu32 i = qcount * 4;
-        
-        CX_ASSERT ((i + 3) < (srcSize * 4));
-        
-        pos [i + 0].x = quad.x0;
-        pos [i + 0].y = quad.y0;
-        pos [i + 1].x = quad.x0;
-        pos [i + 1].y = quad.y1;
-        pos [i + 2].x = quad.x1;
-        pos [i + 2].y = quad.y0;
-        pos [i + 3].x = quad.x1;
-        pos [i + 3].y = quad.y1;
-        
-        uv [i + 0].x = quad.s0;
-        uv [i + 0].y = quad.t0;
-        uv [i + 1].x = quad.s0;
-        uv [i + 1].y = quad.t1;
-        uv [i + 2].x = quad.s1;
-        uv [i + 2].y = quad.t0;
-        uv [i + 3].x = quad.s1;
-        uv [i + 3].y = quad.t1;
-        
-        ++qcount;
-      }
-      
-      src += offset;
-      ss -= offset;
-      
-      ds++;
+      cx_font_baker_deinit ();
     }
+  }
+  
+  g_fontAtlasStats.bytes -= cx_font_atlas_get_bytes (fontImpl->texture);
+  
+  if (fontImpl->pending)
+  {
+    cx_free (fontImpl->pending);
+  }
+  
+  cx_texture_destroy (fontImpl->texture);
+  cx_free (fontImpl->unicodePts);
+  cx_free (fontImpl->glyphs);
+  cx_free (fontImpl->skyline);
+  
+  cx_file_storage_unmap_contents (fontImpl->fileData, fontImpl->fileDataSize);
+  
+  cx_free (font->fontdata);
+  cx_free (font);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_set_scale (const cx_font *font, cxf32 x, cxf32 y)
+{
+  CX_ASSERT (font);
+  
+  cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
+#if 0
+  fontImpl->scaleX = cx_clamp (x, 0.0f, 1.0f);
+  fontImpl->scaleY = cx_clamp (y, 0.0f, 1.0f);
+#else
+  fontImpl->scaleX = x;
+  fontImpl->scaleY = y;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_chain (cx_font *dst, const cx_font *src)
+{
+  CX_ASSERT (dst);
+  CX_ASSERT (src);
+  CX_ASSERT (dst != src);
+  
+#if CX_FONT_DEBUG_ENABLE_CHAIN
+  cx_font_impl *fontImpl = (cx_font_impl *) dst->fontdata;
+
+  fontImpl->chain = src;
+#else
+  CX_ERROR ("cx_font_chain: not implemented");
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_render (const cx_font *font, const char *text, cxf32 x, cxf32 y, cxf32 z,
+                     cx_font_alignment alignment, const cx_colour *colour)
+{
+  CX_ASSERT (font);
+  CX_ASSERT (font->fontdata);
+  CX_ASSERT (text);
+  CX_ASSERT (colour);
+  
+  cxu32 srcSize = strlen (text); // data length
+  
+  if (srcSize > 0)
+  {
+    cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
     
-    // render text
+    // get laid out quads (relative to origin)
+    const cx_font_run *run = cx_font_run_get (font, text, srcSize);
     
-    if (qcount > 0)
+    if (run->quadCount > 0)
     {
-      // batch triangestrip points
-      //(012) (213) (234) (435) ... total number of trianges == points - 2 == (len * 4) - 2
-      cxu32 numTri = (qcount * 4) - 2;
-      cxu32 numPoints = numTri * 3;
-      
-      cx_vec2 pos2 [numPoints];
-      cx_vec2 uv2 [numPoints];
-      cx_colour col [numPoints];
+      cxf32 px = x;
+      cxf32 py = y;
       
-      cxu32 tri = 0;
-      cxu32 tript = 0;
-      cxu32 ni = 0;
-      
-      const cx_colour *null = cx_colour_null ();
-      
-      bool spacing = false; // space between characters
-      
-      while (tri < numTri)
+      if (alignment & CX_FONT_ALIGNMENT_CENTRE_X)
       {
-        cxu32 sa0 = tript;      // 0
-        cxu32 sa1 = sa0 + 1;    // 1
-        cxu32 sa2 = sa1 + 1;    // 2
-        
-        cxu32 sa3 = sa2;        // 2
-        cxu32 sa4 = sa1;        // 1
-        cxu32 sa5 = sa3 + 1;    // 3
-        
-        col [ni] = spacing ? *null : *colour;
-        pos2 [ni] = pos [sa0];
-        uv2 [ni++] = uv [sa0];
-        
-        col [ni] = spacing ? *null : *colour;
-        pos2 [ni] = pos [sa1];
-        uv2 [ni++] = uv [sa1];
-        
-        col [ni] = spacing ? *null : *colour;
-        pos2 [ni] = pos [sa2];
-        uv2 [ni++] = uv [sa2];
-        
-        col [ni] = spacing ? *null : *colour;
-        pos2 [ni] = pos [sa3];
-        uv2 [ni++] = uv [sa3];
-        
-        col [ni] = spacing ? *null : *colour;
-        pos2 [ni] = pos [sa4];
-        uv2 [ni++] = uv [sa4];
-        
-        col [ni] = spacing ? *null : *colour;
-        pos2 [ni] = pos [sa5];
-        uv2 [ni++] = uv [sa5];
-        
-        tript = sa3;
-        
-        tri += 2;
-        
-        spacing = !spacing;
+        px = px - (run->width * 0.5f);
+      }
+      else if (alignment & CX_FONT_ALIGNMENT_RIGHT_X)
+      {
+        px = px + (run->width * 0.5f);
       }
-
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
-      cx_gdi_assert_no_errors ();
       
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 2, GL_FLOAT, GL_FALSE, 0, pos2);
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, 0, uv2);
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], 4, GL_FLOAT, GL_FALSE, 0, col);
-      cx_gdi_assert_no_errors ();
+      if (alignment & CX_FONT_ALIGNMENT_CENTRE_Y)
+      {
+        cxf32 th = cx_font_get_height (font);
+        py = py - (th * 0.5f);
+      }
       
-      glDrawArrays (GL_TRIANGLE_STRIP, 0, numPoints);
-      cx_gdi_assert_no_errors ();
+      // quads are snapped to whole pixels relative to the origin, so keep the offset whole too
+      px = (cxf32) cx_util_roundup_int (px);
+      py = (cxf32) cx_util_roundup_int (py);
       
-      glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-      glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
-      glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
+      cx_font_batch_add (fontImpl, run->pos, run->uv, run->quadCount, px, py, z, colour);
     }
-    
-    cx_shader_end (shader);
   }
 }
-#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -811,21 +1903,7 @@ cxi32 cx_font_render_word_wrap (const cx_font *font, const char *text, cxf32 x,
 #endif
   
   cx_font_impl *fontImpl = (cx_font_impl *) font->fontdata;
-  cx_shader *shader = cx_shader_get_built_in (CX_SHADER_BUILT_IN_FONT);
-  
-  // use shader
-  cx_shader_begin (shader);
-  
-  // set texture
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_DIFFUSE_MAP, fontImpl->texture);
-  
-  // set mvp
-  cx_mat4x4 mvp;
-  cx_gdi_get_transform (CX_GDI_TRANSFORM_MVP, &mvp);
   
-  cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvp);
-  cx_shader_set_float (shader, "u_z", &z, 1);
-    
   cxf32 sx = fontImpl->scaleX;
   cxf32 sy = fontImpl->scaleY;
   cxf32 px = x;
@@ -855,7 +1933,6 @@ cxi32 cx_font_render_word_wrap (const cx_font *font, const char *text, cxf32 x,
   // convert from utf8 to unicode
   cxu32 textBuffer [CX_FONT_MAX_TEXT_LENGTH];
   cxu32 tLen = cx_str_utf8_to_unicode (textBuffer, CX_FONT_MAX_TEXT_LENGTH, text);
-  CX_REF_UNUSED (tLen);
   
   // set up newlines
   cxu32 c = 0;
@@ -867,8 +1944,8 @@ cxi32 cx_font_render_word_wrap (const cx_font *font, const char *text, cxf32 x,
     
     if (cIndex > -1)
     {
-      stbtt_bakedchar *bakedChar = fontImpl->ttfCharData + cIndex;
-      tw += bakedChar->xadvance * sx;
+      const cx_font_glyph *glyph = cx_font_glyph_get (fontImpl, cIndex, false);
+      tw += glyph->xadvance * sx;
       
       if (c == 0x20)
       {
@@ -886,8 +1963,9 @@ cxi32 cx_font_render_word_wrap (const cx_font *font, const char *text, cxf32 x,
   }
   
   // now draw text
-  cx_vec2 pos [tLen * 4];
-  cx_vec2 uv [tLen * 4];
+  cx_font_run *run = cx_font_run_scratch_reserve (cx_max (tLen, 1));
+  cx_vec2 *pos = run->pos;
+  cx_vec2 *uv = run->uv;
   cxu32 vcount = 0;
   
   cxi32 newlines = 0;
@@ -906,12 +1984,10 @@ cxi32 cx_font_render_word_wrap (const cx_font *font, const char *text, cxf32 x,
     {
       cxi32 cIndex = cx_font_bsearch_codepoint_index (c, fontImpl->unicodePts, fontImpl->unicodePtsSize);
       
-      if (cIndex > -1)
+      stbtt_aligned_quad quad;
+      
+      if ((cIndex > -1) && cx_font_glyph_get_quad (fontImpl, cIndex, sx, sy, &px, &py, &quad))
       {
-        stbtt_aligned_quad quad;
-        stbtt_GetBakedQuad (fontImpl->ttfCharData, fontImpl->textureWidth, fontImpl->textureHeight,
-                            cIndex, sx, sy, &px, &py, &quad, 1);
-        
         cxu32 i = vcount * 4;
         
         pos [i + 0].x = quad.x0;
@@ -939,81 +2015,8 @@ cxi32 cx_font_render_word_wrap (const cx_font *font, const char *text, cxf32 x,
   
   if (vcount > 0)
   {
-    cxu32 numTri = (vcount * 4) - 2;
-    cxu32 numPoints = numTri * 3;
-    
-    cx_vec2 pos2 [numPoints];
-    cx_vec2 uv2 [numPoints];
-    cx_colour col [numPoints];
-    
-    cxu32 tri = 0;
-    cxu32 tript = 0;
-    cxu32 ni = 0;
-    
-    const cx_colour *null = cx_colour_null ();
-    
-    bool spacing = false; // space between characters
-    
-    while (tri < numTri)
-    {
-      cxu32 sa0 = tript;      // 0
-      cxu32 sa1 = sa0 + 1;    // 1
-      cxu32 sa2 = sa1 + 1;    // 2
-      
-      cxu32 sa3 = sa2;        // 2
-      cxu32 sa4 = sa1;        // 1
-      cxu32 sa5 = sa3 + 1;    // 3
-      
-      col [ni] = spacing ? *null : *colour;
-      pos2 [ni] = pos [sa0];
-      uv2 [ni++] = uv [sa0];
-      
-      col [ni] = spacing ? *null : *colour;
-      pos2 [ni] = pos [sa1];
-      uv2 [ni++] = uv [sa1];
-      
-      col [ni] = spacing ? *null : *colour;
-      pos2 [ni] = pos [sa2];
-      uv2 [ni++] = uv [sa2];
-      
-      col [ni] = spacing ? *null : *colour;
-      pos2 [ni] = pos [sa3];
-      uv2 [ni++] = uv [sa3];
-      
-      col [ni] = spacing ? *null : *colour;
-      pos2 [ni] = pos [sa4];
-      uv2 [ni++] = uv [sa4];
-      
-      col [ni] = spacing ? *null : *colour;
-      pos2 [ni] = pos [sa5];
-      uv2 [ni++] = uv [sa5];
-      
-      tript = sa3;
-      
-      tri += 2;
-      
-      spacing = !spacing;
-    }
-    
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
-    cx_gdi_assert_no_errors ();
-    
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 2, GL_FLOAT, GL_FALSE, 0, pos2);
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, 0, uv2);
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR], 4, GL_FLOAT, GL_FALSE, 0, col);
-    cx_gdi_assert_no_errors ();
-    
-    glDrawArrays (GL_TRIANGLE_STRIP, 0, numPoints);
-    cx_gdi_assert_no_errors ();
-    
-    glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-    glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]);
-    glDisableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_COLOUR]);
+    cx_font_batch_add (fontImpl, pos, uv, vcount, 0.0f, 0.0f, z, colour);
   }
-
-  cx_shader_end (shader);
   
   return newlines;
 }
@@ -1044,8 +2047,8 @@ cxf32 cx_font_get_text_width (const cx_font *font, const char *text)
     
     if (cIndex > -1)
     {
-      stbtt_bakedchar *bakedChar = fontImpl->ttfCharData + cIndex;
-      width += bakedChar->xadvance * sx;
+      const cx_font_glyph *glyph = cx_font_glyph_get (fontImpl, cIndex, false);
+      width += glyph->xadvance * sx;
     }
     src += offset;
     ss -= offset;
@@ -1071,3 +2074,138 @@ cxf32 cx_font_get_height (const cx_font *font)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_set_run_cache_capacity (cxu32 capacity)
+{
+  // drops all cached runs
+  
+  if (g_fontRunCache.initialised)
+  {
+    cx_font_run_cache_deinit ();
+  }
+  
+  cx_font_run_cache_init (capacity);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_get_run_cache_stats (cx_font_run_cache_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  *stats = g_fontRunCache.stats;
+  
+  if (!g_fontRunCache.initialised)
+  {
+    stats->capacity = CX_FONT_RUN_CACHE_DEFAULT_CAPACITY;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_reset_run_cache_stats (void)
+{
+  g_fontRunCache.stats.hits = 0;
+  g_fontRunCache.stats.misses = 0;
+  g_fontRunCache.stats.evictions = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_batch_begin (void)
+{
+  CX_ASSERT (!g_fontBatch.active);
+  
+  g_fontBatch.active = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_batch_end (void)
+{
+  // draw queued fonts in the order they were first used. mvp is read here.
+  
+  CX_ASSERT (g_fontBatch.active);
+  
+  cx_font_batch *batch = &g_fontBatch;
+  
+  cx_font_impl *fontImpl = batch->head;
+  
+  while (fontImpl)
+  {
+    cx_font_impl *next = fontImpl->batchNext;
+    
+    if (fontImpl->batchQuadCount > 0)
+    {
+      cx_font_batch_flush_font (fontImpl);
+    }
+    
+    fontImpl->batchQueued = false;
+    fontImpl->batchNext = NULL;
+    
+    fontImpl = next;
+  }
+  
+  batch->head = NULL;
+  batch->tail = NULL;
+  batch->active = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_get_batch_stats (cx_font_batch_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  *stats = g_fontBatch.stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_reset_batch_stats (void)
+{
+  memset (&g_fontBatch.stats, 0, sizeof (cx_font_batch_stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_get_atlas_stats (cx_font_atlas_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  *stats = g_fontAtlasStats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_font_reset_atlas_stats (void)
+{
+  // bytes is a running total, not reset
+  
+  g_fontAtlasStats.glyphs = 0;
+  g_fontAtlasStats.failed = 0;
+  g_fontAtlasStats.grows = 0;
+  g_fontAtlasStats.uploads = 0;
+  g_fontAtlasStats.uploadBytes = 0;
+  g_fontAtlasStats.bakeTime = 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
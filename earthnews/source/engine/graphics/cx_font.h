@@ -34,6 +34,34 @@ typedef struct cx_font
   void *fontdata;
 } cx_font;
 
+typedef struct cx_font_run_cache_stats
+{
+  cxu32 hits;
+  cxu32 misses;
+  cxu32 evictions;
+  cxu32 count;
+  cxu32 capacity;
+  cxu32 bytes;
+} cx_font_run_cache_stats;
+
+typedef struct cx_font_atlas_stats
+{
+  cxu32 glyphs;       // rasterised
+  cxu32 failed;       // no room left in the atlas
+  cxu32 grows;
+  cxu32 uploads;
+  cxu32 uploadBytes;
+  cxu32 bytes;        // all atlases, cpu copy plus gpu texture and mips
+  cxf32 bakeTime;     // ms
+} cx_font_atlas_stats;
+
+typedef struct cx_font_batch_stats
+{
+  cxu32 drawCalls;
+  cxu32 quads;
+  cxu32 bytes;
+} cx_font_batch_stats;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -71,6 +99,34 @@ cxf32     cx_font_get_height (const cx_font *font);
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void      cx_font_set_run_cache_capacity (cxu32 capacity);
+void      cx_font_get_run_cache_stats (cx_font_run_cache_stats *stats);
+void      cx_font_reset_run_cache_stats (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// glyphs are rasterised into each font's atlas the first time they are drawn, not at create
+
+void      cx_font_get_atlas_stats (cx_font_atlas_stats *stats);
+void      cx_font_reset_atlas_stats (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// between begin and end, render calls queue their quads and each font is drawn once at end
+
+void      cx_font_batch_begin (void);
+void      cx_font_batch_end (void);
+void      cx_font_get_batch_stats (cx_font_batch_stats *stats);
+void      cx_font_reset_batch_stats (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
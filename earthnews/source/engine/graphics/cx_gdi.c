@@ -4,8 +4,7 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
 
 #include "cx_gdi.h"
 #include "cx_file.h"
@@ -54,7 +53,9 @@ static cx_mat4x4 g_transforms [CX_NUM_GDI_TRANSFORMS];
 static cx_gdi_extension_info g_extensionInfoArray [CX_NUM_GDI_EXTENSIONS] =
 {
   { "GL_IMG_texture_compression_pvrtc", false }, //CX_GDI_EXTENSION_PVRTC,
-  { "GL_ARB_texture_non_power_of_two", false }   //CX_GDI_EXTENSION_NPOT,
+  { "GL_ARB_texture_non_power_of_two", false },  //CX_GDI_EXTENSION_NPOT,
+  { "GL_OES_vertex_half_float", false },         //CX_GDI_EXTENSION_VERTEX_HALF_FLOAT,
+  { "GL_OES_element_index_uint", false }         //CX_GDI_EXTENSION_ELEMENT_INDEX_UINT,
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
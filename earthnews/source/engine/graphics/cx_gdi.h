@@ -64,6 +64,8 @@ typedef enum
   CX_GDI_EXTENSION_INVALID = -1,
   CX_GDI_EXTENSION_PVRTC,
   CX_GDI_EXTENSION_NPOT,
+  CX_GDI_EXTENSION_VERTEX_HALF_FLOAT,
+  CX_GDI_EXTENSION_ELEMENT_INDEX_UINT,
   CX_NUM_GDI_EXTENSIONS
 } cx_gdi_extension;
 
@@ -0,0 +1,966 @@
+//
+//  cx_globe.c
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#include "cx_opengl.h"
+
+#include "cx_globe.h"
+#include "cx_gdi.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define CX_GLOBE_FACE_SEGMENTS    (CX_GLOBE_FACE_PATCHES * CX_GLOBE_PATCH_SEGMENTS)
+#define CX_GLOBE_MAX_INDICES      (CX_GLOBE_PATCH_SEGMENTS * CX_GLOBE_PATCH_SEGMENTS * 6)
+
+#define CX_GLOBE_EDGE_BOTTOM      0
+#define CX_GLOBE_EDGE_RIGHT       1
+#define CX_GLOBE_EDGE_TOP         2
+#define CX_GLOBE_EDGE_LEFT        3
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct cx_globe_face
+{
+  cxf32 n [3];
+  cxf32 u [3];
+  cxf32 v [3];
+} cx_globe_face;
+
+// u x v = n so grid triangles wind counter-clockwise seen from outside
+
+static const cx_globe_face g_globeFaces [CX_GLOBE_FACE_COUNT] =
+{
+  { {  1.0f,  0.0f,  0.0f }, {  0.0f,  0.0f, -1.0f }, {  0.0f,  1.0f,  0.0f } },
+  { { -1.0f,  0.0f,  0.0f }, {  0.0f,  0.0f,  1.0f }, {  0.0f,  1.0f,  0.0f } },
+  { {  0.0f,  1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f }, {  0.0f,  0.0f, -1.0f } },
+  { {  0.0f, -1.0f,  0.0f }, {  1.0f,  0.0f,  0.0f }, {  0.0f,  0.0f,  1.0f } },
+  { {  0.0f,  0.0f,  1.0f }, {  1.0f,  0.0f,  0.0f }, {  0.0f,  1.0f,  0.0f } },
+  { {  0.0f,  0.0f, -1.0f }, { -1.0f,  0.0f,  0.0f }, {  0.0f,  1.0f,  0.0f } },
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxf32 cx_globe_warp (cxi32 k);
+static void cx_globe_face_point (cx_vec4 *point, cxi32 face, cxf32 a, cxf32 b);
+static void cx_globe_create_vertices (cx_globe *globe, cx_vertex_data *vertexData);
+static void cx_globe_create_indices (cx_globe *globe, cx_vertex_data *vertexData);
+static void cx_globe_create_bounds (cx_globe *globe, const cx_vertex_data *vertexData);
+static void cx_globe_create_cones (cx_globe *globe, const cx_vertex_data *vertexData);
+static void cx_globe_create_neighbours (cx_globe *globe);
+static cxi16 cx_globe_find_patch (const cx_vec4 *point);
+static void cx_globe_cull_patches (cx_globe *globe, const cx_vec4 *eye, const cx_mat4x4 *mvp);
+static void cx_globe_update_stats (cx_globe *globe);
+static void cx_globe_gpu_init (cx_globe *globe);
+static void cx_globe_gpu_deinit (cx_globe *globe);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_globe *cx_globe_create (cxf32 radius, cx_vertex_format format, cx_shader *shader, cx_material *material)
+{
+  CX_ASSERT (shader);
+  CX_ASSERT (radius > 0.0f);
+  CX_ASSERT ((CX_GLOBE_FACE_PATCHES & 1) == 0);
+  CX_ASSERT ((2 << (CX_GLOBE_LEVEL_COUNT - 1)) == CX_GLOBE_PATCH_SEGMENTS);
+  CX_ASSERT ((CX_GLOBE_PATCH_COUNT * CX_GLOBE_PATCH_VERTICES) <= 0xffff);
+  
+  cx_globe *globe = (cx_globe *) cx_malloc (sizeof (cx_globe));
+  
+  memset (globe, 0, sizeof (cx_globe));
+  
+  globe->shader = shader;
+  globe->material = material;
+  globe->radius = radius;
+  globe->maxError = CX_GLOBE_DEFAULT_MAX_ERROR;
+  globe->culling = true;
+  
+  cx_vertex_data *vertexData = (cx_vertex_data *) cx_malloc (sizeof (cx_vertex_data));
+  
+  memset (vertexData, 0, sizeof (cx_vertex_data));
+  
+  vertexData->format = format;
+  
+  cx_globe_create_vertices (globe, vertexData);
+  cx_globe_create_indices (globe, vertexData);
+  cx_globe_create_bounds (globe, vertexData);
+  cx_globe_create_cones (globe, vertexData);
+  cx_globe_create_neighbours (globe);
+  
+  globe->vertexData = vertexData;
+  
+  // finest everywhere until the first update
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    globe->patches [i].level = CX_GLOBE_LEVEL_COUNT - 1;
+    globe->patches [i].stitch = 0;
+    globe->patches [i].culled = CX_GLOBE_CULL_NONE;
+  }
+  
+  cx_globe_update_stats (globe);
+  
+  return globe;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_globe_destroy (cx_globe *globe)
+{
+  CX_ASSERT (globe);
+  
+  cx_globe_gpu_deinit (globe);
+  
+  cx_vertex_data *vertexData = globe->vertexData;
+  
+  if (vertexData->vertices)
+  {
+    cx_free (vertexData->vertices);
+  }
+  
+  if (vertexData->indices)
+  {
+    cx_free (vertexData->indices);
+  }
+  
+  cx_free (vertexData);
+  
+  cx_free (globe);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_globe_set_max_error (cx_globe *globe, cxf32 pixels)
+{
+  CX_ASSERT (globe);
+  CX_ASSERT (pixels > 0.0f);
+  
+  globe->maxError = pixels;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_globe_set_culling (cx_globe *globe, bool enable)
+{
+  CX_ASSERT (globe);
+  
+  globe->culling = enable;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_globe_update (cx_globe *globe, const cx_vec4 *eye, const cx_mat4x4 *mvp)
+{
+  CX_ASSERT (globe);
+  CX_ASSERT (eye);
+  CX_ASSERT (mvp);
+  
+  // eye and mvp are in globe (model) space
+  
+  // pixels per world unit at distance 1
+  
+  cx_mat4x4 projection;
+  cx_gdi_get_transform (CX_GDI_TRANSFORM_P, &projection);
+  
+  cxf32 scale = projection.f16 [5] * cx_gdi_get_screen_height () * 0.5f;
+  cxf32 minDistance = globe->radius * 0.001f;
+  
+  // coarsest level within the error threshold
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    cx_globe_patch *patch = &globe->patches [i];
+    
+    cx_vec4 centre = patch->bounds;
+    centre.w = 1.0f;
+    
+    cx_vec4 diff;
+    cx_vec4_sub (&diff, &centre, eye);
+    
+    cxf32 distance = cx_vec4_length (&diff) - patch->bounds.w;
+    distance = cx_max (distance, minDistance);
+    
+    cxf32 threshold = globe->maxError * distance / scale;
+    
+    cxu32 level = 0;
+    
+    while ((level < (CX_GLOBE_LEVEL_COUNT - 1)) && (patch->error [level] > threshold))
+    {
+      level++;
+    }
+    
+    patch->level = (cxu8) level;
+  }
+  
+  // raise patches until no neighbour is more than one level finer
+  
+  bool changed = true;
+  
+  while (changed)
+  {
+    changed = false;
+    
+    for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+    {
+      cx_globe_patch *patch = &globe->patches [i];
+      
+      for (cxu32 e = 0; e < 4; ++e)
+      {
+        const cx_globe_patch *neighbour = &globe->patches [patch->neighbours [e]];
+        
+        if (neighbour->level > (patch->level + 1))
+        {
+          patch->level = neighbour->level - 1;
+          changed = true;
+        }
+      }
+    }
+  }
+  
+  // stitch edges shared with a coarser neighbour
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    cx_globe_patch *patch = &globe->patches [i];
+    
+    cxu8 stitch = 0;
+    
+    for (cxu32 e = 0; e < 4; ++e)
+    {
+      const cx_globe_patch *neighbour = &globe->patches [patch->neighbours [e]];
+      
+      if (neighbour->level < patch->level)
+      {
+        stitch |= (1 << e);
+      }
+    }
+    
+    patch->stitch = stitch;
+  }
+  
+  // levels are picked for every patch above so visible ones still stitch against culled neighbours
+  
+  cx_globe_cull_patches (globe, eye, mvp);
+  
+  cx_globe_update_stats (globe);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_globe_render (cx_globe *globe)
+{
+  CX_ASSERT (globe);
+  CX_ASSERT (globe->shader);
+  
+  if (!globe->gpu)
+  {
+    // opengl vaos can't be shared across contexts
+    cx_globe_gpu_init (globe);
+  }
+  
+  if (globe->material)
+  {
+    cx_material_render (globe->material, globe->shader);
+  }
+  
+  glBindVertexArrayOES (globe->vao);
+  glBindBuffer (GL_ARRAY_BUFFER, globe->vbos [0]);
+  
+  // patches share one vertex buffer, offset the attributes to reuse the per level index lists
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    const cx_globe_patch *patch = &globe->patches [i];
+    
+    if (patch->culled != CX_GLOBE_CULL_NONE)
+    {
+      continue;
+    }
+    
+    cxu32 count = globe->indexCounts [patch->level][patch->stitch];
+    cxu32 offset = globe->indexOffsets [patch->level][patch->stitch];
+    
+    cx_mesh_set_vertex_layout (&globe->layout, globe->shader, i * CX_GLOBE_PATCH_VERTICES * globe->layout.stride, false);
+    
+    glDrawElements (GL_TRIANGLES, count, GL_UNSIGNED_SHORT, (const void *) (offset * sizeof (cxu16)));
+  }
+  
+  glBindVertexArrayOES (0);
+  glBindBuffer (GL_ARRAY_BUFFER, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_globe_get_stats (const cx_globe *globe, cx_globe_stats *stats)
+{
+  CX_ASSERT (globe);
+  CX_ASSERT (stats);
+  
+  *stats = globe->stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxf32 cx_globe_warp (cxi32 k)
+{
+  // equal angle mapping of face grid line k, keeps cells close to square towards the face edges.
+  // symmetric and exact at the edges so points shared by two faces come out identical.
+  
+  cxi32 d = (2 * k) - CX_GLOBE_FACE_SEGMENTS;
+  cxi32 ad = (d < 0) ? -d : d;
+  
+  cxf32 w = 0.0f;
+  
+  if (ad == CX_GLOBE_FACE_SEGMENTS)
+  {
+    w = 1.0f;
+  }
+  else if (ad > 0)
+  {
+    w = cx_tan (((cxf32) ad / (cxf32) CX_GLOBE_FACE_SEGMENTS) * (CX_PI * 0.25f));
+  }
+  
+  return (d < 0) ? -w : w;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_face_point (cx_vec4 *point, cxi32 face, cxf32 a, cxf32 b)
+{
+  const cx_globe_face *f = &g_globeFaces [face];
+  
+  point->x = f->n [0] + (a * f->u [0]) + (b * f->v [0]);
+  point->y = f->n [1] + (a * f->u [1]) + (b * f->v [1]);
+  point->z = f->n [2] + (a * f->u [2]) + (b * f->v [2]);
+  point->w = 1.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_create_vertices (cx_globe *globe, cx_vertex_data *vertexData)
+{
+  // matches the texture mapping and tangent frame of cx_vertex_data_create_sphere.
+  // u is unwrapped around each patch centre, so patches on the seam run slightly past 0 or 1.
+  
+  cxi32 numVertices = CX_GLOBE_PATCH_COUNT * CX_GLOBE_PATCH_VERTICES;
+  
+  vertexData->vertices = (cx_vertex *) cx_malloc (sizeof (cx_vertex) * numVertices);
+  vertexData->numVertices = numVertices;
+  
+  cxf32 radius = globe->radius;
+  cxf32 warp [CX_GLOBE_FACE_SEGMENTS + 1];
+  
+  for (cxi32 k = 0; k <= CX_GLOBE_FACE_SEGMENTS; ++k)
+  {
+    warp [k] = cx_globe_warp (k);
+  }
+  
+  cx_vertex *vertex = vertexData->vertices;
+  
+  for (cxi32 face = 0; face < CX_GLOBE_FACE_COUNT; ++face)
+  {
+    for (cxi32 pr = 0; pr < CX_GLOBE_FACE_PATCHES; ++pr)
+    {
+      for (cxi32 pc = 0; pc < CX_GLOBE_FACE_PATCHES; ++pc)
+      {
+        cxi32 row0 = pr * CX_GLOBE_PATCH_SEGMENTS;
+        cxi32 col0 = pc * CX_GLOBE_PATCH_SEGMENTS;
+        
+        // patch centre longitude (never a pole, those sit on patch corners)
+        
+        cx_vec4 centre;
+        cx_globe_face_point (&centre, face, warp [col0 + (CX_GLOBE_PATCH_SEGMENTS >> 1)], warp [row0 + (CX_GLOBE_PATCH_SEGMENTS >> 1)]);
+        
+        cxf32 centreLon = cx_atan2 (centre.x, centre.z);
+        cxf32 centreU = centreLon / (2.0f * CX_PI);
+        centreU = (centreU < 0.0f) ? (centreU + 1.0f) : centreU;
+        
+        cx_vertex *patchVertices = vertex;
+        cxf32 maxU = 0.0f;
+        
+        for (cxi32 r = 0; r <= CX_GLOBE_PATCH_SEGMENTS; ++r)
+        {
+          for (cxi32 c = 0; c <= CX_GLOBE_PATCH_SEGMENTS; ++c)
+          {
+            cx_vec4 p;
+            cx_globe_face_point (&p, face, warp [col0 + c], warp [row0 + r]);
+            
+            cxf32 invLen = 1.0f / cx_sqrt ((p.x * p.x) + (p.y * p.y) + (p.z * p.z));
+            
+            cx_vec4 *normal = &vertex->normal;
+            cx_vec4_set (normal, p.x * invLen, p.y * invLen, p.z * invLen, 0.0f);
+            
+            cx_vec4 *position = &vertex->position;
+            cx_vec4_set (position, normal->x * radius, normal->y * radius, normal->z * radius, 1.0f);
+            
+            // tex coord
+            
+            cxf32 rho = cx_sqrt ((normal->x * normal->x) + (normal->z * normal->z));
+            cxf32 u = centreU;
+            
+            if (rho > 1.0e-6f)
+            {
+              u = cx_atan2 (normal->x, normal->z) / (2.0f * CX_PI);
+              
+              if ((u - centreU) > 0.5f)
+              {
+                u -= 1.0f;
+              }
+              else if ((u - centreU) < -0.5f)
+              {
+                u += 1.0f;
+              }
+              
+              cx_vec4_set (&vertex->tangent, normal->z / rho, 0.0f, -normal->x / rho, 0.0f);
+              cx_vec4_set (&vertex->bitangent, (normal->y * normal->x) / rho, -rho, (normal->y * normal->z) / rho, 0.0f);
+            }
+            else
+            {
+              cxf32 s = cx_sin (centreLon);
+              cxf32 t = cx_cos (centreLon);
+              
+              cx_vec4_set (&vertex->tangent, t, 0.0f, -s, 0.0f);
+              cx_vec4_set (&vertex->bitangent, normal->y * s, 0.0f, normal->y * t, 0.0f);
+            }
+            
+            vertex->texCoord.x = u;
+            vertex->texCoord.y = cx_acos (cx_clamp (normal->y, -1.0f, 1.0f)) / CX_PI;
+            
+            maxU = cx_max (maxU, u);
+            
+            vertex++;
+          }
+        }
+        
+        // keep u within [-1, 1] so it packs to snorm16, the texture repeats horizontally
+        
+        if (maxU > 1.0f)
+        {
+          for (cx_vertex *v = patchVertices; v < vertex; ++v)
+          {
+            v->texCoord.x -= 1.0f;
+          }
+        }
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu16 cx_globe_stitch_index (cxi32 r, cxi32 c, cxi32 step, cxu32 stitch)
+{
+  // odd vertices on an edge next to a coarser patch collapse onto the previous even vertex,
+  // which turns that edge into the neighbour's edge and leaves zero area triangles behind.
+  
+  const cxi32 s = CX_GLOBE_PATCH_SEGMENTS;
+  
+  if ((stitch & (1 << CX_GLOBE_EDGE_BOTTOM)) && (r == 0) && ((c / step) & 1))
+  {
+    c -= step;
+  }
+  
+  if ((stitch & (1 << CX_GLOBE_EDGE_TOP)) && (r == s) && ((c / step) & 1))
+  {
+    c -= step;
+  }
+  
+  if ((stitch & (1 << CX_GLOBE_EDGE_LEFT)) && (c == 0) && ((r / step) & 1))
+  {
+    r -= step;
+  }
+  
+  if ((stitch & (1 << CX_GLOBE_EDGE_RIGHT)) && (c == s) && ((r / step) & 1))
+  {
+    r -= step;
+  }
+  
+  return (cxu16) ((r * (s + 1)) + c);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_create_indices (cx_globe *globe, cx_vertex_data *vertexData)
+{
+  // index lists are relative to a patch and shared by all of them, one per level and stitch mask
+  
+  cxi32 maxIndices = CX_GLOBE_LEVEL_COUNT * CX_GLOBE_STITCH_COUNT * CX_GLOBE_MAX_INDICES;
+  
+  vertexData->indices = (cxu32 *) cx_malloc (sizeof (cxu32) * maxIndices);
+  
+  cxu32 *indices = vertexData->indices;
+  cxu32 numIndices = 0;
+  
+  for (cxu32 level = 0; level < CX_GLOBE_LEVEL_COUNT; ++level)
+  {
+    cxi32 step = CX_GLOBE_PATCH_SEGMENTS >> (level + 1);
+    cxi32 segments = 2 << level;
+    
+    for (cxu32 stitch = 0; stitch < CX_GLOBE_STITCH_COUNT; ++stitch)
+    {
+      globe->indexOffsets [level][stitch] = numIndices;
+      
+      for (cxi32 i = 0; i < segments; ++i)
+      {
+        for (cxi32 j = 0; j < segments; ++j)
+        {
+          cxi32 r0 = i * step, r1 = r0 + step;
+          cxi32 c0 = j * step, c1 = c0 + step;
+          
+          cxu16 quad [6] =
+          {
+            cx_globe_stitch_index (r0, c0, step, stitch),
+            cx_globe_stitch_index (r0, c1, step, stitch),
+            cx_globe_stitch_index (r1, c1, step, stitch),
+            cx_globe_stitch_index (r0, c0, step, stitch),
+            cx_globe_stitch_index (r1, c1, step, stitch),
+            cx_globe_stitch_index (r1, c0, step, stitch),
+          };
+          
+          for (cxu32 t = 0; t < 6; t += 3)
+          {
+            cxu16 i0 = quad [t], i1 = quad [t + 1], i2 = quad [t + 2];
+            
+            if ((i0 != i1) && (i1 != i2) && (i2 != i0))
+            {
+              indices [numIndices++] = i0;
+              indices [numIndices++] = i1;
+              indices [numIndices++] = i2;
+            }
+          }
+        }
+      }
+      
+      globe->indexCounts [level][stitch] = numIndices - globe->indexOffsets [level][stitch];
+      
+      cx_vertex_data_optimise_indices (indices + globe->indexOffsets [level][stitch], globe->indexCounts [level][stitch], 
+                                       CX_GLOBE_PATCH_VERTICES, CX_VERTEX_CACHE_SIZE);
+    }
+  }
+  
+  CX_ASSERT (numIndices <= (cxu32) maxIndices);
+  
+  vertexData->numIndices = numIndices;
+  vertexData->numTriangles = numIndices / 3;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_create_bounds (cx_globe *globe, const cx_vertex_data *vertexData)
+{
+  const cxi32 s = CX_GLOBE_PATCH_SEGMENTS;
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    cx_globe_patch *patch = &globe->patches [i];
+    
+    const cx_vertex *vertices = vertexData->vertices + (i * CX_GLOBE_PATCH_VERTICES);
+    
+    // bounding sphere around the vertex average
+    
+    cx_vec4 sum;
+    cx_vec4_set (&sum, 0.0f, 0.0f, 0.0f, 0.0f);
+    
+    for (cxu32 v = 0; v < CX_GLOBE_PATCH_VERTICES; ++v)
+    {
+      cx_vec4 next;
+      cx_vec4_add (&next, &sum, &vertices [v].position);
+      sum = next;
+    }
+    
+    cx_vec4 centre;
+    cx_vec4_mul (&centre, 1.0f / (cxf32) CX_GLOBE_PATCH_VERTICES, &sum);
+    centre.w = 1.0f;
+    
+    cxf32 radius = 0.0f;
+    
+    for (cxu32 v = 0; v < CX_GLOBE_PATCH_VERTICES; ++v)
+    {
+      cx_vec4 diff;
+      cx_vec4_sub (&diff, &vertices [v].position, &centre);
+      
+      radius = cx_max (radius, cx_vec4_length (&diff));
+    }
+    
+    patch->bounds = centre;
+    patch->bounds.w = radius;
+    
+    // geometric error per level, deepest point of any cell below the sphere (at its diagonals)
+    
+    for (cxu32 level = 0; level < CX_GLOBE_LEVEL_COUNT; ++level)
+    {
+      cxi32 step = s >> (level + 1);
+      cxf32 error = 0.0f;
+      
+      for (cxi32 r = 0; r < s; r += step)
+      {
+        for (cxi32 c = 0; c < s; c += step)
+        {
+          const cx_vec4 *p00 = &vertices [(r * (s + 1)) + c].position;
+          const cx_vec4 *p01 = &vertices [(r * (s + 1)) + c + step].position;
+          const cx_vec4 *p10 = &vertices [((r + step) * (s + 1)) + c].position;
+          const cx_vec4 *p11 = &vertices [((r + step) * (s + 1)) + c + step].position;
+          
+          cx_vec4 mid0, mid1;
+          cx_vec4_add (&mid0, p00, p11);
+          cx_vec4_add (&mid1, p01, p10);
+          
+          mid0.w = 0.0f;
+          mid1.w = 0.0f;
+          
+          cxf32 depth0 = globe->radius - (cx_vec4_length (&mid0) * 0.5f);
+          cxf32 depth1 = globe->radius - (cx_vec4_length (&mid1) * 0.5f);
+          
+          error = cx_max (error, cx_max (depth0, depth1));
+        }
+      }
+      
+      patch->error [level] = error;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_create_cones (cx_globe *globe, const cx_vertex_data *vertexData)
+{
+  // cone around the face normals of every triangle the patch can draw (any level or stitch),
+  // flat triangles lean further than the vertex normals so those alone aren't conservative.
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    cx_globe_patch *patch = &globe->patches [i];
+    
+    const cx_vertex *vertices = vertexData->vertices + (i * CX_GLOBE_PATCH_VERTICES);
+    
+    cx_vec4 axis = patch->bounds;
+    axis.w = 0.0f;
+    
+    cx_vec4_normalize (&axis);
+    
+    cxf32 minDot = 1.0f;
+    cxf32 minPlane = globe->radius;
+    
+    for (cxi32 t = 0; t < vertexData->numIndices; t += 3)
+    {
+      const cx_vec4 *p0 = &vertices [vertexData->indices [t + 0]].position;
+      const cx_vec4 *p1 = &vertices [vertexData->indices [t + 1]].position;
+      const cx_vec4 *p2 = &vertices [vertexData->indices [t + 2]].position;
+      
+      cx_vec4 e0, e1, n;
+      cx_vec4_sub (&e0, p1, p0);
+      cx_vec4_sub (&e1, p2, p0);
+      cx_vec4_cross (&n, &e0, &e1);
+      cx_vec4_normalize (&n);
+      
+      cxf32 plane = (n.x * p0->x) + (n.y * p0->y) + (n.z * p0->z);
+      
+      minDot = cx_min (minDot, cx_vec4_dot (&n, &axis));
+      minPlane = cx_min (minPlane, plane);
+    }
+    
+    CX_ASSERT (minPlane > 0.0f);
+    
+    // small margin for float error in the triangle normals
+    
+    patch->cone = axis;
+    patch->cone.w = cx_acos (cx_clamp (minDot, -1.0f, 1.0f)) + 0.001f;
+    patch->plane = minPlane * 0.9999f;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxi16 cx_globe_find_patch (const cx_vec4 *point)
+{
+  // patch containing a point on or just off the unwarped cube
+  
+  cxf32 ax = fabsf (point->x), ay = fabsf (point->y), az = fabsf (point->z);
+  cxf32 m = cx_max (ax, cx_max (ay, az));
+  
+  cx_vec4 p;
+  cx_vec4_set (&p, point->x / m, point->y / m, point->z / m, 0.0f);
+  
+  cxi32 face = 0;
+  
+  for (cxi32 f = 0; f < CX_GLOBE_FACE_COUNT; ++f)
+  {
+    const cxf32 *n = g_globeFaces [f].n;
+    
+    if (((n [0] * p.x) + (n [1] * p.y) + (n [2] * p.z)) > 0.999f)
+    {
+      face = f;
+      break;
+    }
+  }
+  
+  const cx_globe_face *f = &g_globeFaces [face];
+  
+  cxf32 a = (f->u [0] * p.x) + (f->u [1] * p.y) + (f->u [2] * p.z);
+  cxf32 b = (f->v [0] * p.x) + (f->v [1] * p.y) + (f->v [2] * p.z);
+  
+  cxi32 pc = (cxi32) ((a + 1.0f) * 0.5f * (cxf32) CX_GLOBE_FACE_PATCHES);
+  cxi32 pr = (cxi32) ((b + 1.0f) * 0.5f * (cxf32) CX_GLOBE_FACE_PATCHES);
+  
+  pc = cx_clamp (pc, 0, CX_GLOBE_FACE_PATCHES - 1);
+  pr = cx_clamp (pr, 0, CX_GLOBE_FACE_PATCHES - 1);
+  
+  return (cxi16) ((face * CX_GLOBE_FACE_PATCHES * CX_GLOBE_FACE_PATCHES) + (pr * CX_GLOBE_FACE_PATCHES) + pc);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_create_neighbours (cx_globe *globe)
+{
+  // step just past the middle of each edge and see which patch that lands in
+  
+  const cxf32 size = 2.0f / (cxf32) CX_GLOBE_FACE_PATCHES;
+  const cxf32 offsets [4][2] = { { 0.0f, -1.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { -1.0f, 0.0f } };
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    cxi32 face = i / (CX_GLOBE_FACE_PATCHES * CX_GLOBE_FACE_PATCHES);
+    cxi32 pr = (i / CX_GLOBE_FACE_PATCHES) % CX_GLOBE_FACE_PATCHES;
+    cxi32 pc = i % CX_GLOBE_FACE_PATCHES;
+    
+    cxf32 a = -1.0f + ((cxf32) pc + 0.5f) * size;
+    cxf32 b = -1.0f + ((cxf32) pr + 0.5f) * size;
+    
+    for (cxu32 e = 0; e < 4; ++e)
+    {
+      cx_vec4 probe;
+      cx_globe_face_point (&probe, face, a + (offsets [e][0] * size * 0.75f), b + (offsets [e][1] * size * 0.75f));
+      
+      cxi16 neighbour = cx_globe_find_patch (&probe);
+      
+      CX_ASSERT (neighbour != (cxi16) i);
+      
+      globe->patches [i].neighbours [e] = neighbour;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_cull_patches (cx_globe *globe, const cx_vec4 *eye, const cx_mat4x4 *mvp)
+{
+  if (!globe->culling)
+  {
+    for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+    {
+      globe->patches [i].culled = CX_GLOBE_CULL_NONE;
+    }
+    
+    return;
+  }
+  
+  // frustum planes from the rows of the mvp (xyz is normal, w is distance)
+  
+  const cxf32 *m = mvp->f16;
+  cx_vec4 planes [6];
+  
+  for (cxu32 p = 0; p < 6; ++p)
+  {
+    cxu32 row = p >> 1;
+    cxf32 sign = (p & 1) ? -1.0f : 1.0f;
+    
+    cx_vec4 plane;
+    cx_vec4_set (&plane, m [3] + (sign * m [row]), m [7] + (sign * m [4 + row]),
+                 m [11] + (sign * m [8 + row]), m [15] + (sign * m [12 + row]));
+    
+    cxf32 len = cx_sqrt ((plane.x * plane.x) + (plane.y * plane.y) + (plane.z * plane.z));
+    
+    cx_vec4_mul (&planes [p], 1.0f / len, &plane);
+  }
+  
+  cx_vec4 view = *eye;
+  view.w = 0.0f;
+  
+  cxf32 eyeDistance = cx_vec4_length (&view);
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    cx_globe_patch *patch = &globe->patches [i];
+    
+    patch->culled = CX_GLOBE_CULL_NONE;
+    
+    // horizon: every triangle faces away once the eye is further than the cone half angle plus
+    // the angle at which the closest triangle plane is seen edge on
+    
+    if (eyeDistance > patch->plane)
+    {
+      cxf32 horizon = cx_acos (patch->plane / eyeDistance) + patch->cone.w;
+      
+      if (horizon < CX_PI)
+      {
+        cxf32 d = cx_vec4_dot (&patch->cone, &view) / eyeDistance;
+        cxf32 angle = cx_acos (cx_clamp (d, -1.0f, 1.0f));
+        
+        if (angle > horizon)
+        {
+          patch->culled = CX_GLOBE_CULL_HORIZON;
+          continue;
+        }
+      }
+    }
+    
+    // frustum: bounding sphere fully outside any plane
+    
+    for (cxu32 p = 0; p < 6; ++p)
+    {
+      const cx_vec4 *plane = &planes [p];
+      const cx_vec4 *centre = &patch->bounds;
+      
+      cxf32 distance = (plane->x * centre->x) + (plane->y * centre->y) + (plane->z * centre->z) + plane->w;
+      
+      if (distance < -centre->w)
+      {
+        patch->culled = CX_GLOBE_CULL_FRUSTUM;
+        break;
+      }
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_update_stats (cx_globe *globe)
+{
+  cx_globe_stats *stats = &globe->stats;
+  
+  memset (stats, 0, sizeof (cx_globe_stats));
+  
+  for (cxu32 i = 0; i < CX_GLOBE_PATCH_COUNT; ++i)
+  {
+    const cx_globe_patch *patch = &globe->patches [i];
+    
+    cxu32 segments = 2 << patch->level;
+    
+    stats->patches++;
+    stats->horizonCulled += (patch->culled == CX_GLOBE_CULL_HORIZON) ? 1 : 0;
+    stats->frustumCulled += (patch->culled == CX_GLOBE_CULL_FRUSTUM) ? 1 : 0;
+    
+    if (patch->culled != CX_GLOBE_CULL_NONE)
+    {
+      continue;
+    }
+    
+    stats->submitted++;
+    stats->triangles += globe->indexCounts [patch->level][patch->stitch] / 3;
+    stats->vertices += (segments + 1) * (segments + 1);
+    stats->levels [patch->level]++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_gpu_init (cx_globe *globe)
+{
+  CX_ASSERT (globe);
+  CX_ASSERT (globe->vertexData);
+  
+  cx_vertex_data *vertexData = globe->vertexData;
+  
+  glGenVertexArraysOES (1, &globe->vao);
+  glBindVertexArrayOES (globe->vao);
+  
+  glGenBuffers (2, globe->vbos);
+  
+  bool halfFloat = cx_gdi_get_extension_supported (CX_GDI_EXTENSION_VERTEX_HALF_FLOAT);
+  
+  cxu8 *packed = cx_vertex_data_pack (vertexData, halfFloat, &globe->layout);
+  
+  glBindBuffer (GL_ARRAY_BUFFER, globe->vbos [0]);
+  glBufferData (GL_ARRAY_BUFFER, vertexData->numVertices * globe->layout.stride, packed, GL_STATIC_DRAW);
+  
+  cxu16 *indices = cx_vertex_data_pack_indices16 (vertexData->indices, vertexData->numIndices);
+  
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, globe->vbos [1]);
+  glBufferData (GL_ELEMENT_ARRAY_BUFFER, vertexData->numIndices * sizeof (cxu16), indices, GL_STATIC_DRAW);
+  
+  cx_free (packed);
+  cx_free (indices);
+  
+  cx_mesh_set_vertex_layout (&globe->layout, globe->shader, 0, true);
+  
+  glBindVertexArrayOES (0);
+  glBindBuffer (GL_ARRAY_BUFFER, 0);
+  
+  cx_gdi_assert_no_errors ();
+  
+  // keep the format, the rest lives on the gpu now
+  
+  cx_free (vertexData->vertices);
+  cx_free (vertexData->indices);
+  
+  vertexData->vertices = NULL;
+  vertexData->indices = NULL;
+  
+  globe->gpu = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_globe_gpu_deinit (cx_globe *globe)
+{
+  CX_ASSERT (globe);
+  
+  if (globe->gpu)
+  {
+    glDeleteBuffers (2, globe->vbos);
+    glDeleteVertexArraysOES (1, &globe->vao);
+  }
+  
+  globe->vao = 0;
+  globe->gpu = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
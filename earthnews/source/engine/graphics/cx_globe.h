@@ -0,0 +1,107 @@
+//
+//  cx_globe.h
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#ifndef CX_GLOBE_H
+#define CX_GLOBE_H
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../system/cx_system.h"
+#include "../system/cx_vector4.h"
+#include "../system/cx_matrix4x4.h"
+#include "cx_shader.h"
+#include "cx_material.h"
+#include "cx_vertex_data.h"
+#include "cx_mesh.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// cube-sphere split into patches. each patch picks a grid resolution from its projected error,
+// neighbouring patches differ by at most one level and the finer side snaps its edge to match.
+// patches entirely behind the horizon (all triangles back facing) or outside the frustum are not drawn.
+
+#define CX_GLOBE_FACE_COUNT           6
+#define CX_GLOBE_FACE_PATCHES         4     // patches along a cube face edge (even, keeps poles on patch corners)
+#define CX_GLOBE_PATCH_SEGMENTS       16    // grid segments along a patch edge at the finest level
+#define CX_GLOBE_LEVEL_COUNT          4     // 2, 4, 8 and 16 segments
+#define CX_GLOBE_PATCH_COUNT          (CX_GLOBE_FACE_COUNT * CX_GLOBE_FACE_PATCHES * CX_GLOBE_FACE_PATCHES)
+#define CX_GLOBE_PATCH_VERTICES       ((CX_GLOBE_PATCH_SEGMENTS + 1) * (CX_GLOBE_PATCH_SEGMENTS + 1))
+#define CX_GLOBE_STITCH_COUNT         16    // one bit per patch edge with a coarser neighbour
+#define CX_GLOBE_DEFAULT_MAX_ERROR    1.0f  // pixels
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef enum cx_globe_cull
+{
+  CX_GLOBE_CULL_NONE,
+  CX_GLOBE_CULL_HORIZON,
+  CX_GLOBE_CULL_FRUSTUM,
+} cx_globe_cull;
+
+typedef struct cx_globe_patch
+{
+  cx_vec4 bounds;                             // bounding sphere, w is radius
+  cx_vec4 cone;                               // triangle normal cone, w is half angle (radians)
+  cxf32 plane;                                // nearest triangle plane to the centre
+  cxf32 error [CX_GLOBE_LEVEL_COUNT];         // world space distance to the sphere
+  cxi16 neighbours [4];                       // bottom, right, top, left
+  cxu8 level;
+  cxu8 stitch;
+  cxu8 culled;                                // cx_globe_cull
+} cx_globe_patch;
+
+typedef struct cx_globe_stats
+{
+  cxu32 patches;
+  cxu32 submitted;
+  cxu32 horizonCulled;
+  cxu32 frustumCulled;
+  cxu32 triangles;
+  cxu32 vertices;
+  cxu32 levels [CX_GLOBE_LEVEL_COUNT];
+} cx_globe_stats;
+
+typedef struct cx_globe
+{
+  cx_globe_patch patches [CX_GLOBE_PATCH_COUNT];
+  cxu32 indexOffsets [CX_GLOBE_LEVEL_COUNT][CX_GLOBE_STITCH_COUNT];
+  cxu32 indexCounts [CX_GLOBE_LEVEL_COUNT][CX_GLOBE_STITCH_COUNT];
+  cxu32 vbos [2];
+  cxu32 vao;
+  cx_vertex_data *vertexData;
+  cx_vertex_layout layout;
+  cx_shader *shader;
+  cx_material *material;
+  cx_globe_stats stats;
+  cxf32 radius;
+  cxf32 maxError;
+  bool culling;
+  bool gpu;
+} cx_globe;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_globe * cx_globe_create (cxf32 radius, cx_vertex_format format, cx_shader *shader, cx_material *material);
+void       cx_globe_destroy (cx_globe *globe);
+void       cx_globe_set_max_error (cx_globe *globe, cxf32 pixels);
+void       cx_globe_set_culling (cx_globe *globe, bool enable);
+void       cx_globe_update (cx_globe *globe, const cx_vec4 *eye, const cx_mat4x4 *mvp);
+void       cx_globe_render (cx_globe *globe);
+void       cx_globe_get_stats (const cx_globe *globe, cx_globe_stats *stats);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -4,8 +4,7 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
 
 #include "cx_material.h"
 #include "cx_gdi.h"
@@ -4,8 +4,7 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
 
 #include "../system/cx_string.h"
 #include "cx_mesh.h"
@@ -18,6 +17,10 @@
 #define ENABLE_VAO 1
 #define ENABLE_CONSTANT_ARRAY 1
 
+#ifndef GL_HALF_FLOAT_OES
+#define GL_HALF_FLOAT_OES 0x8D61
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -25,7 +28,7 @@
 static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader);
 static void cx_mesh_gpu_deinit (cx_mesh *mesh);
 static void cx_mesh_vertex_data_destroy (cx_mesh *mesh);
-static void cx_mesh_get_attributes (cx_vertex_format format, bool attr [static CX_NUM_SHADER_ATTRIBUTES]);
+static void cx_mesh_upload_indices (cx_mesh *mesh);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,6 +44,7 @@ cx_mesh *cx_mesh_create (cx_vertex_data *vertexData, cx_shader *shader, cx_mater
   mesh->shader = shader;
   mesh->material = material;
   mesh->vertexData = vertexData;
+  mesh->indexType = GL_UNSIGNED_SHORT;
   mesh->vao = 0;
   mesh->gpu = 0;
   
@@ -71,61 +75,6 @@ void cx_mesh_destroy (cx_mesh *mesh)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void cx_mesh_get_attributes (cx_vertex_format format, bool attr [static CX_NUM_SHADER_ATTRIBUTES])
-{  
-  memset (attr, false, sizeof (bool) * CX_NUM_SHADER_ATTRIBUTES);
-  
-  switch (format) 
-  {
-    case CX_VERTEX_FORMAT_P:
-    {
-      attr [CX_SHADER_ATTRIBUTE_POSITION] = true;
-      break;
-    }
-      
-    case CX_VERTEX_FORMAT_PN:
-    {
-      attr [CX_SHADER_ATTRIBUTE_POSITION] = true;
-      attr [CX_SHADER_ATTRIBUTE_NORMAL] = true;
-      break;
-    }
-      
-    case CX_VERTEX_FORMAT_PT:
-    {
-      attr [CX_SHADER_ATTRIBUTE_POSITION] = true;
-      attr [CX_SHADER_ATTRIBUTE_TEXCOORD] = true;
-      break;
-    }
-      
-    case CX_VERTEX_FORMAT_PTN:
-    {
-      attr [CX_SHADER_ATTRIBUTE_POSITION] = true;
-      attr [CX_SHADER_ATTRIBUTE_TEXCOORD] = true;
-      attr [CX_SHADER_ATTRIBUTE_NORMAL] = true;
-      break;
-    }
-      
-    case CX_VERTEX_FORMAT_PTNTB:
-    {
-      attr [CX_SHADER_ATTRIBUTE_POSITION] = true;
-      attr [CX_SHADER_ATTRIBUTE_TEXCOORD] = true;
-      attr [CX_SHADER_ATTRIBUTE_NORMAL] = true;
-      attr [CX_SHADER_ATTRIBUTE_TANGENT] = true;
-      attr [CX_SHADER_ATTRIBUTE_BITANGENT] = true;
-      break;
-    }
-      
-    default:
-    {
-      break;
-    }
-  }
-}
-
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////////////////////////////
-
 static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader)
 {
   // create vertex buffers
@@ -138,7 +87,6 @@ static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader)
   
   cx_vertex_data * CX_RESTRICT vertexData = mesh->vertexData;
   
-  cxi32 numIndices = vertexData->numIndices;
   cxi32 numVertices = vertexData->numVertices;
   
 #if ENABLE_VAO
@@ -147,9 +95,6 @@ static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader)
   cx_gdi_assert_no_errors ();
 #endif
   
-  bool enabled [CX_NUM_SHADER_ATTRIBUTES];
-  cx_mesh_get_attributes (mesh->vertexData->format, enabled);
-  
   {
     glGenBuffers (CX_VERTEX_BUFFER_COUNT, mesh->vbos);
     
@@ -157,54 +102,26 @@ static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader)
 #if CX_VERTEX_DATA_AOS
     ////////////////////////////////////////////////////////////////////////////////////////////////////////
     
-    cxu32 offset = 0;
-    cxu32 vstride = sizeof (cx_vertex);
+    // convert to the packed gpu layout (see cx_vertex_data_pack)
     
-    glBindBuffer (GL_ARRAY_BUFFER, mesh->vbos [0]);
-    glBufferData (GL_ARRAY_BUFFER, numVertices * vstride, vertexData->vertices, GL_STATIC_DRAW);
-    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mesh->vbos [1]);
-    glBufferData (GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof (cxu16), vertexData->indices, GL_STATIC_DRAW);
+    bool halfFloat = cx_gdi_get_extension_supported (CX_GDI_EXTENSION_VERTEX_HALF_FLOAT);
     
-    cx_gdi_assert_no_errors ();
-    
-    if (enabled [CX_SHADER_ATTRIBUTE_POSITION])
-    {
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-    }
-
-    offset += sizeof (cx_vec4);
+    cxu8 *packed = cx_vertex_data_pack (vertexData, halfFloat, &mesh->layout);
     
-    if (enabled [CX_SHADER_ATTRIBUTE_NORMAL])
-    {
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_NORMAL], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_NORMAL]);
-    }
-    
-    offset += sizeof (cx_vec4);
+    glBindBuffer (GL_ARRAY_BUFFER, mesh->vbos [0]);
+    glBufferData (GL_ARRAY_BUFFER, numVertices * mesh->layout.stride, packed, GL_STATIC_DRAW);
+    glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mesh->vbos [1]);
+    cx_mesh_upload_indices (mesh);
     
-    if (enabled [CX_SHADER_ATTRIBUTE_TANGENT])
-    {
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TANGENT], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TANGENT]);
-    }
+    cx_free (packed);
     
-    offset += sizeof (cx_vec4);
+    cx_gdi_assert_no_errors ();
     
-    if (enabled [CX_SHADER_ATTRIBUTE_BITANGENT])
-    {
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_BITANGENT], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_BITANGENT]);
-    }
+    CX_LOG_CONSOLE (CX_MESH_DEBUG_LOG, "cx_mesh: %d vertices, %u bytes (stride %u, was %u)", 
+                    numVertices, numVertices * mesh->layout.stride, mesh->layout.stride, (cxu32) sizeof (cx_vertex));
     
-    offset += sizeof (cx_vec4);
+    cx_mesh_set_vertex_layout (&mesh->layout, shader, 0, true);
     
-    if (enabled [CX_SHADER_ATTRIBUTE_TEXCOORD])
-    {
-      glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-      glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]); 
-    }
-
     ////////////////////////////////////////////////////////////////////////////////////////////////////////
 #else // if CX_VERTEX_DATA_SOA
     ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -219,7 +136,7 @@ static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader)
     glBufferData (GL_ARRAY_BUFFER, numVertices * CX_VERTEX_TEXCOORD_SIZE * sizeof (cxf32), vertexData->texCoords, GL_STATIC_DRAW);
     
     glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mesh->vbos [3]);
-    glBufferData (GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof (cxu16), vertexData->indices, GL_STATIC_DRAW);
+    cx_mesh_upload_indices (mesh);
     
     glBindBuffer (GL_ARRAY_BUFFER, mesh->vbos [0]);
     glVertexAttribPointer (shader->attributes[CX_SHADER_ATTRIBUTE_POSITION], CX_VERTEX_POSITION_SIZE, GL_FLOAT, GL_FALSE, 0, (const void *) 0);
@@ -245,6 +162,38 @@ static void cx_mesh_gpu_init (cx_mesh *mesh, const cx_shader *shader)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static void cx_mesh_upload_indices (cx_mesh *mesh)
+{
+  // 16 bit indices unless the vertex count needs more (GL_OES_element_index_uint)
+  
+  const cx_vertex_data *vertexData = mesh->vertexData;
+  
+  cxi32 numIndices = vertexData->numIndices;
+  
+  if (vertexData->numVertices <= 0x10000)
+  {
+    cxu16 *indices = cx_vertex_data_pack_indices16 (vertexData->indices, numIndices);
+    
+    glBufferData (GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof (cxu16), indices, GL_STATIC_DRAW);
+    
+    cx_free (indices);
+    
+    mesh->indexType = GL_UNSIGNED_SHORT;
+  }
+  else
+  {
+    CX_FATAL_ASSERT (cx_gdi_get_extension_supported (CX_GDI_EXTENSION_ELEMENT_INDEX_UINT));
+    
+    glBufferData (GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof (cxu32), vertexData->indices, GL_STATIC_DRAW);
+    
+    mesh->indexType = GL_UNSIGNED_INT;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static void cx_mesh_gpu_deinit (cx_mesh *mesh)
 {
   CX_ASSERT (mesh);
@@ -335,69 +284,71 @@ void cx_mesh_render (cx_mesh *mesh)
 #if ENABLE_VAO
   glBindVertexArrayOES (mesh->vao);
   
-  glDrawElements (GL_TRIANGLES, mesh->vertexData->numIndices, GL_UNSIGNED_SHORT, 0);
+  glDrawElements (GL_TRIANGLES, mesh->vertexData->numIndices, mesh->indexType, 0);
   
   glBindVertexArrayOES (0);
 #endif
   
 #if !ENABLE_VAO
   
-  bool enabled [CX_NUM_SHADER_ATTRIBUTES];
-  cx_mesh_get_attributes (mesh->vertexData->format, enabled);
-  
-  cxu32 offset = 0;
-  cxu32 vstride = sizeof (cx_vertex);
-  
   glBindBuffer (GL_ARRAY_BUFFER, mesh->vbos [0]);
   
   cx_gdi_assert_no_errors ();
   
-  cx_shader *shader = mesh->shader;
+  cx_mesh_set_vertex_layout (&mesh->layout, mesh->shader, 0, true);
   
-  if (enabled [CX_SHADER_ATTRIBUTE_POSITION])
-  {
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_POSITION]);
-  }
+  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mesh->vbos [1]);
   
-  offset += sizeof (cx_vec4);
+  glDrawElements (GL_TRIANGLES, mesh->vertexData->numIndices, mesh->indexType, 0);
   
-  if (enabled [CX_SHADER_ATTRIBUTE_NORMAL])
-  {
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_NORMAL], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_NORMAL]);
-  }
-  
-  offset += sizeof (cx_vec4);
+#endif
   
-  if (enabled [CX_SHADER_ATTRIBUTE_TANGENT])
-  {
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TANGENT], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TANGENT]);
-  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_mesh_set_vertex_layout (const cx_vertex_layout *layout, const cx_shader *shader, cxu32 base, bool enable)
+{
+  // attribute pointers for a packed layout, base is a byte offset into the bound vertex buffer
   
-  offset += sizeof (cx_vec4);
+  CX_ASSERT (layout);
+  CX_ASSERT (shader);
   
-  if (enabled [CX_SHADER_ATTRIBUTE_BITANGENT])
+  static const GLenum types [NUM_VERTEX_ELEMENT_TYPES] = 
   {
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_BITANGENT], 4, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_BITANGENT]);
-  }
-  
-  offset += sizeof (cx_vec4);
+    0, GL_FLOAT, GL_HALF_FLOAT_OES, GL_SHORT, GL_UNSIGNED_SHORT, GL_SHORT
+  };
   
-  if (enabled [CX_SHADER_ATTRIBUTE_TEXCOORD])
+  static const GLboolean normalised [NUM_VERTEX_ELEMENT_TYPES] = 
   {
-    glVertexAttribPointer (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD], 2, GL_FLOAT, GL_FALSE, vstride, (const void *) offset);
-    glEnableVertexAttribArray (shader->attributes [CX_SHADER_ATTRIBUTE_TEXCOORD]); 
-  }
+    GL_FALSE, GL_FALSE, GL_FALSE, GL_TRUE, GL_TRUE, GL_TRUE
+  };
   
-  glBindBuffer (GL_ELEMENT_ARRAY_BUFFER, mesh->vbos [1]);
-  
-  glDrawElements (GL_TRIANGLES, mesh->vertexData->numIndices, GL_UNSIGNED_SHORT, 0);
+  const cx_vertex_element *elements [CX_NUM_SHADER_ATTRIBUTES] = { NULL };
   
-#endif
+  elements [CX_SHADER_ATTRIBUTE_POSITION] = &layout->position;
+  elements [CX_SHADER_ATTRIBUTE_NORMAL] = &layout->normal;
+  elements [CX_SHADER_ATTRIBUTE_TANGENT] = &layout->tangent;
+  elements [CX_SHADER_ATTRIBUTE_BITANGENT] = &layout->bitangent;
+  elements [CX_SHADER_ATTRIBUTE_TEXCOORD] = &layout->texCoord;
   
+  for (cxu32 i = 0; i < CX_NUM_SHADER_ATTRIBUTES; ++i)
+  {
+    const cx_vertex_element *element = elements [i];
+    
+    if (element && (element->type != CX_VERTEX_ELEMENT_TYPE_NONE))
+    {
+      glVertexAttribPointer (shader->attributes [i], element->components, types [element->type], normalised [element->type], 
+                             layout->stride, (const void *) (uintptr_t) (base + element->offset));
+      
+      if (enable)
+      {
+        glEnableVertexAttribArray (shader->attributes [i]);
+      }
+    }
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
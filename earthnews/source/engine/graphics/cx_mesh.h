@@ -41,6 +41,8 @@ typedef struct cx_mesh
   cxu32 vbos [CX_VERTEX_BUFFER_COUNT];
   cxu32 vao;
   cx_vertex_data *vertexData;
+  cx_vertex_layout layout;
+  cxu32 indexType;
   cx_shader *shader;
   cx_material *material;
   bool gpu;
@@ -50,10 +52,16 @@ typedef struct cx_mesh
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// vertexData is owned by the mesh and uploaded in the order given, call cx_vertex_data_optimise
+// first to reorder it for the post-transform vertex cache. the earth, clouds and atmosphere are
+// cx_globe meshes, which order their own patch indices, so only other meshes need the call.
+
 cx_mesh * cx_mesh_create (cx_vertex_data *vertexData, cx_shader *shader, cx_material *material);
 void      cx_mesh_destroy (cx_mesh *mesh);
 void      cx_mesh_render (cx_mesh *mesh);
 
+void      cx_mesh_set_vertex_layout (const cx_vertex_layout *layout, const cx_shader *shader, cxu32 base, bool enable);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,32 @@
+//
+//  cx_opengl.h
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#ifndef CX_OPENGL_H
+#define CX_OPENGL_H
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// opengl es 2.0 headers. ios links the framework, elsewhere (headless linux) the khronos headers
+// and libGLESv2, with the oes extension entry points resolved by cx_native_linux.
+
+#if defined (__APPLE__)
+#include <OpenGLES/ES2/gl.h>
+#include <OpenGLES/ES2/glext.h>
+#else
+#ifndef GL_GLEXT_PROTOTYPES
+#define GL_GLEXT_PROTOTYPES 1
+#endif
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
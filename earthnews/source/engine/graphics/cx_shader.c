@@ -4,8 +4,7 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
 
 #include "../system/cx_file.h"
 #include "../system/cx_json.h"
@@ -21,6 +20,12 @@
 #define CX_SHADER_VERTEX_SHADER_FILE_EXTENSION    "vsh"
 #define CX_SHADER_FRAGMENT_SHADER_FILE_EXTENSION  "fsh"
 #define CX_SHADER_CONFIGURATION_FILE_EXTENSION    "cfg"
+#define CX_SHADER_UNIFORM_NAME_MAX                (32)
+#define CX_SHADER_UNIFORM_CACHE_SIZE              (16) // floats, fits a mat4x4
+
+#if !defined (__APPLE__)
+#define CX_SHADER_UNIFORM_SLOT_STRIPPED           (-2) // mesa strips the "u_name; // unused" statements
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -92,6 +97,29 @@ static struct cx_shader *g_builtInShaders [CX_NUM_BUILT_IN_SHADERS];
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// uniform values are program state, so the last value uploaded is kept per uniform and repeats
+// are skipped. bound program and active texture unit are context state, tracked for the render
+// thread's context only.
+
+struct cx_shader_uniform_info
+{
+  char name [CX_SHADER_UNIFORM_NAME_MAX];
+  cxu32 hash;
+  GLint location;
+  GLint size;
+  GLenum type;
+  cxu32 cacheBytes;               // 0 if nothing cached
+  cxf32 cache [CX_SHADER_UNIFORM_CACHE_SIZE];
+};
+
+static GLuint g_currentProgram = 0;
+static GLenum g_activeTextureUnit = 0;
+static cx_shader_stats g_stats;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static void cx_shader_built_in_init (void);
 static void cx_shader_built_in_deinit (void);
 static cxi32 cx_shader_get_uniform_sampler (cx_shader_uniform uniform);
@@ -105,6 +133,10 @@ bool _cx_shader_init (void)
   CX_ASSERT (!g_initialised);
   
   memset (g_builtInShaders, 0, sizeof (g_builtInShaders));
+  memset (&g_stats, 0, sizeof (g_stats));
+  
+  g_currentProgram = 0;
+  g_activeTextureUnit = 0;
   
   cx_shader_built_in_init ();
   
@@ -154,7 +186,7 @@ static cx_shader_attribute cx_get_shader_attribute_from_string (const char *str)
 
 static cx_shader_uniform cx_get_shader_uniform_from_string (const char *str)
 {
-  for (int i = 0, c = sizeof (g_uniformEnumStrings); i < c; ++i)
+  for (int i = 0, c = sizeof (g_uniformEnumStrings) / sizeof (g_uniformEnumStrings [0]); i < c; ++i)
   {
     if (strcmp (str, g_uniformEnumStrings [i]) == 0)
     {
@@ -169,6 +201,136 @@ static cx_shader_uniform cx_get_shader_uniform_from_string (const char *str)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static cxu32 cx_shader_uniform_hash (const char *name)
+{
+  cxu32 hash = 2166136261u;
+  
+  while (*name)
+  {
+    hash = (hash ^ (cxu8) *name++) * 16777619u;
+  }
+  
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_shader_build_uniform_table (cx_shader *shader)
+{
+  GLint activeUniforms = 0;
+  glGetProgramiv (shader->program, GL_ACTIVE_UNIFORMS, &activeUniforms);
+  
+  shader->uniformTableSize = (cxu32) activeUniforms;
+  shader->uniformTable = NULL;
+  
+  if (activeUniforms > 0)
+  {
+    shader->uniformTable = (struct cx_shader_uniform_info *) cx_malloc (sizeof (struct cx_shader_uniform_info) * activeUniforms);
+    memset (shader->uniformTable, 0, sizeof (struct cx_shader_uniform_info) * activeUniforms);
+  }
+  
+  for (GLint i = 0; i < activeUniforms; ++i)
+  {
+    struct cx_shader_uniform_info *info = &shader->uniformTable [i];
+    
+    GLsizei length = 0;
+    glGetActiveUniform (shader->program, i, CX_SHADER_UNIFORM_NAME_MAX, &length, &info->size, &info->type, info->name);
+    CX_ASSERT (length < (CX_SHADER_UNIFORM_NAME_MAX - 1));
+    
+    // arrays are reported as name[0]
+    char *bracket = strchr (info->name, '[');
+    
+    if (bracket)
+    {
+      *bracket = 0;
+    }
+    
+    info->hash = cx_shader_uniform_hash (info->name);
+    info->location = glGetUniformLocation (shader->program, info->name);
+    info->cacheBytes = 0;
+    
+    CX_LOG_CONSOLE (CX_SHADER_DEBUG_LOG_ENABLED, "uniform %s [%d]", info->name, info->location);
+  }
+  
+  cx_gdi_assert_no_errors ();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static struct cx_shader_uniform_info *cx_shader_find_uniform (const cx_shader *shader, const char *name)
+{
+  cxu32 hash = cx_shader_uniform_hash (name);
+  
+  for (cxu32 i = 0; i < shader->uniformTableSize; ++i)
+  {
+    struct cx_shader_uniform_info *info = &shader->uniformTable [i];
+    
+    if ((info->hash == hash) && (strcmp (info->name, name) == 0))
+    {
+      return info;
+    }
+  }
+  
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_shader_uniform_dirty (struct cx_shader_uniform_info *info, const void *data, cxu32 bytes)
+{
+  // false if the program already holds this value, otherwise remember it for next time
+  
+  if ((info->cacheBytes == bytes) && (memcmp (info->cache, data, bytes) == 0))
+  {
+    g_stats.uniformUploadsSkipped++;
+    
+    return false;
+  }
+  
+  if (bytes <= sizeof (info->cache))
+  {
+    memcpy (info->cache, data, bytes);
+    info->cacheBytes = bytes;
+  }
+  else
+  {
+    info->cacheBytes = 0;
+  }
+  
+  g_stats.uniformUploads++;
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_shader_set_active_texture_unit (GLenum textureUnit)
+{
+  if (g_activeTextureUnit != textureUnit)
+  {
+    glActiveTexture (textureUnit);
+    cx_gdi_assert_no_errors ();
+    
+    g_activeTextureUnit = textureUnit;
+  }
+  else
+  {
+    g_stats.textureUnitsSkipped++;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static bool cx_shader_compile (GLuint *shader, GLenum type, const char *buffer, cxi32 bufferSize)
 {
   GLuint outShader = 0;
@@ -364,14 +526,25 @@ static bool cx_shader_configure (const char *buffer, unsigned int bufferSize, cx
         if (uniformIdx != CX_SHADER_UNIFORM_USER_DEFINED)
         {
           const char *uniformName = cx_json_value_string (uniformNode);
-          int uniformLocation = glGetUniformLocation (shader->program, uniformName);
+          struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, uniformName);
           
-          CX_ASSERT ((uniformLocation >= 0) && "unused uniform");
+#if defined (__APPLE__)
+          CX_ASSERT (info && "unused uniform");
+#endif
           
-          shader->uniforms [uniformIdx] = uniformLocation;
+          if (info)
+          {
+            shader->uniforms [uniformIdx] = info->location;
+            shader->uniformSlots [uniformIdx] = (cxi32) (info - shader->uniformTable);
+          }
+#if !defined (__APPLE__)
+          else
+          {
+            shader->uniformSlots [uniformIdx] = CX_SHADER_UNIFORM_SLOT_STRIPPED;
+          }
+#endif
           
-          cx_gdi_assert_no_errors ();
-          CX_LOG_CONSOLE (CX_SHADER_DEBUG_LOG_ENABLED, "%s: %s [%d]", uniformStr, uniformName, uniformLocation);
+          CX_LOG_CONSOLE (CX_SHADER_DEBUG_LOG_ENABLED, "%s: %s [%d]", uniformStr, uniformName, shader->uniforms [uniformIdx]);
         }
       }
       
@@ -454,6 +627,9 @@ cx_shader *cx_shader_create (const char *name, const char *dir)
   
   memset (shader->attributes, -1, sizeof (shader->attributes));
   memset (shader->uniforms, -1, sizeof (shader->uniforms));
+  memset (shader->uniformSlots, -1, sizeof (shader->uniformSlots));
+  
+  cx_shader_build_uniform_table (shader);
   
   success = cx_shader_configure ((const char *) scData, scDataSize, shader);
   CX_FATAL_ASSERT (success);
@@ -473,8 +649,18 @@ void cx_shader_destroy (cx_shader *shader)
 {
   CX_ASSERT (shader);
   
+  if (g_currentProgram == shader->program)
+  {
+    g_currentProgram = 0;
+  }
+  
   glDeleteProgram (shader->program);
   
+  if (shader->uniformTable)
+  {
+    cx_free (shader->uniformTable);
+  }
+  
   cx_free (shader->name);
   cx_free (shader);
 }
@@ -488,8 +674,18 @@ void cx_shader_begin (cx_shader *shader)
   CX_ASSERT (shader);
   CX_ASSERT (!shader->enabled);
   
-  glUseProgram (shader->program);
-  cx_gdi_assert_no_errors ();
+  if (g_currentProgram != shader->program)
+  {
+    glUseProgram (shader->program);
+    cx_gdi_assert_no_errors ();
+    
+    g_currentProgram = shader->program;
+    g_stats.programBinds++;
+  }
+  else
+  {
+    g_stats.programBindsSkipped++;
+  }
   
   shader->enabled = true;
 }
@@ -516,9 +712,21 @@ void cx_shader_set_uniform (const cx_shader *shader, enum cx_shader_uniform unif
   CX_ASSERT (data);
   CX_ASSERT ((uniform > CX_SHADER_UNIFORM_INVALID) && (uniform < CX_NUM_SHADER_UNIFORMS));
   
+#if !defined (__APPLE__)
+  if (shader->uniformSlots [uniform] == CX_SHADER_UNIFORM_SLOT_STRIPPED)
+  {
+    return;
+  }
+#endif
+  
   GLint location = shader->uniforms [uniform];
   CX_ASSERT (location >= 0);
   
+  cxi32 slot = shader->uniformSlots [uniform];
+  CX_ASSERT ((slot >= 0) && (slot < (cxi32) shader->uniformTableSize));
+  
+  struct cx_shader_uniform_info *info = &shader->uniformTable [slot];
+  
   switch (uniform)
   {
     case CX_SHADER_UNIFORM_TRANSFORM_P:
@@ -526,16 +734,24 @@ void cx_shader_set_uniform (const cx_shader *shader, enum cx_shader_uniform unif
     case CX_SHADER_UNIFORM_TRANSFORM_MVP:
     {
       cx_mat4x4 *mat4 = (cx_mat4x4 *) data;
-      glUniformMatrix4fv (location, 1, GL_FALSE, mat4->f16);
-      cx_gdi_assert_no_errors ();
+      
+      if (cx_shader_uniform_dirty (info, mat4->f16, sizeof (mat4->f16)))
+      {
+        glUniformMatrix4fv (location, 1, GL_FALSE, mat4->f16);
+        cx_gdi_assert_no_errors ();
+      }
       break;
     }
       
     case CX_SHADER_UNIFORM_TRANSFORM_N:
     {
       cx_mat3x3 *mat3 = (cx_mat3x3 *) data;
-      glUniformMatrix3fv (location, 1, GL_FALSE, mat3->f9);
-      cx_gdi_assert_no_errors ();
+      
+      if (cx_shader_uniform_dirty (info, mat3->f9, sizeof (mat3->f9)))
+      {
+        glUniformMatrix3fv (location, 1, GL_FALSE, mat3->f9);
+        cx_gdi_assert_no_errors ();
+      }
       break;
     }
       
@@ -543,8 +759,12 @@ void cx_shader_set_uniform (const cx_shader *shader, enum cx_shader_uniform unif
     case CX_SHADER_UNIFORM_LIGHT_POSITION:
     {
       cx_vec4 *vec4 = (cx_vec4 *) data;
-      glUniform4fv (location, 1, vec4->f4);
-      cx_gdi_assert_no_errors ();
+      
+      if (cx_shader_uniform_dirty (info, vec4->f4, sizeof (vec4->f4)))
+      {
+        glUniform4fv (location, 1, vec4->f4);
+        cx_gdi_assert_no_errors ();
+      }
       break;
     }
       
@@ -556,14 +776,17 @@ void cx_shader_set_uniform (const cx_shader *shader, enum cx_shader_uniform unif
       cxi32 sampler = cx_shader_get_uniform_sampler (uniform);
       GLenum textureUnit = g_glTextureUnits [sampler];
       
-      glActiveTexture (textureUnit);
-      cx_gdi_assert_no_errors ();
+      cx_shader_set_active_texture_unit (textureUnit);
       
+      // always bind, textures rebind themselves on upload and unbind on delete
       glBindTexture (GL_TEXTURE_2D, tex->id);
       cx_gdi_assert_no_errors ();
       
-      glUniform1i (location, sampler);
-      cx_gdi_assert_no_errors ();
+      if (cx_shader_uniform_dirty (info, &sampler, sizeof (sampler)))
+      {
+        glUniform1i (location, sampler);
+        cx_gdi_assert_no_errors ();
+      }
       
       break;
     }
@@ -587,11 +810,16 @@ void cx_shader_set_float (const cx_shader *shader, const char *name, cxf32 *f, c
   CX_ASSERT (f);
   CX_ASSERT (count > 0);
   
-  GLint location = glGetUniformLocation (shader->program, name);
-  CX_ASSERT (location >= 0);
+  struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, name);
+  CX_ASSERT (info);
   
-  glUniform1fv (location, count, f); 
-  cx_gdi_assert_no_errors ();
+  g_stats.locationLookupsSkipped++;
+  
+  if (cx_shader_uniform_dirty (info, f, sizeof (cxf32) * count))
+  {
+    glUniform1fv (info->location, count, f); 
+    cx_gdi_assert_no_errors ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -605,11 +833,16 @@ void cx_shader_set_vector2 (const cx_shader *shader, const char *name, const cx_
   CX_ASSERT (vec2);
   CX_ASSERT (count > 0);
   
-  GLint location = glGetUniformLocation (shader->program, name);
-  CX_ASSERT (location >= 0);
-
-  glUniform2fv (location, count, vec2->f2);
-  cx_gdi_assert_no_errors ();
+  struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, name);
+  CX_ASSERT (info);
+  
+  g_stats.locationLookupsSkipped++;
+  
+  if (cx_shader_uniform_dirty (info, vec2, sizeof (cx_vec2) * count))
+  {
+    glUniform2fv (info->location, count, vec2->f2);
+    cx_gdi_assert_no_errors ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -623,11 +856,16 @@ void cx_shader_set_vector4 (const cx_shader *shader, const char *name, const cx_
   CX_ASSERT (vec4);
   CX_ASSERT (count > 0);
   
-  GLint location = glGetUniformLocation (shader->program, name);
-  CX_ASSERT (location >= 0);
+  struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, name);
+  CX_ASSERT (info);
   
-  glUniform4fv (location, count, vec4->f4);
-  cx_gdi_assert_no_errors ();
+  g_stats.locationLookupsSkipped++;
+  
+  if (cx_shader_uniform_dirty (info, vec4, sizeof (cx_vec4) * count))
+  {
+    glUniform4fv (info->location, count, vec4->f4);
+    cx_gdi_assert_no_errors ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -641,11 +879,16 @@ void cx_shader_set_matrix3x3 (const cx_shader *shader, const char *name, const c
   CX_ASSERT (mat3x3);
   CX_ASSERT (count > 0);
   
-  GLint location = glGetUniformLocation (shader->program, name);
-  CX_ASSERT (location >= 0);
-
-  glUniform4fv (location, count, mat3x3->f9);
-  cx_gdi_assert_no_errors ();
+  struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, name);
+  CX_ASSERT (info);
+  
+  g_stats.locationLookupsSkipped++;
+  
+  if (cx_shader_uniform_dirty (info, mat3x3, sizeof (cx_mat3x3) * count))
+  {
+    glUniformMatrix3fv (info->location, count, GL_FALSE, mat3x3->f9);
+    cx_gdi_assert_no_errors ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -659,11 +902,16 @@ void cx_shader_set_matrix4x4 (const cx_shader *shader, const char *name, const c
   CX_ASSERT (mat4x4);
   CX_ASSERT (count > 0);
   
-  GLint location = glGetUniformLocation (shader->program, name);
-  CX_ASSERT (location >= 0);
+  struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, name);
+  CX_ASSERT (info);
   
-  glUniform4fv (location, count, mat4x4->f16);
-  cx_gdi_assert_no_errors ();
+  g_stats.locationLookupsSkipped++;
+  
+  if (cx_shader_uniform_dirty (info, mat4x4, sizeof (cx_mat4x4) * count))
+  {
+    glUniformMatrix4fv (info->location, count, GL_FALSE, mat4x4->f16);
+    cx_gdi_assert_no_errors ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -677,8 +925,10 @@ void cx_shader_set_texture (const cx_shader *shader, const char *name, const cx_
   CX_ASSERT (texture);
   CX_ASSERT ((sampler >= 0) && (sampler < (cxi32) (sizeof (g_glTextureUnits) / sizeof (GLenum))));
   
-  GLint location = glGetUniformLocation (shader->program, name);
-  CX_ASSERT (location >= 0);
+  struct cx_shader_uniform_info *info = cx_shader_find_uniform (shader, name);
+  CX_ASSERT (info);
+  
+  g_stats.locationLookupsSkipped++;
   
 #if CX_SHADER_DEBUG
   for (int i = CX_SHADER_UNIFORM_DIFFUSE_MAP; i <= CX_SHADER_UNIFORM_BUMP_MAP; ++i)
@@ -694,14 +944,16 @@ void cx_shader_set_texture (const cx_shader *shader, const char *name, const cx_
   
   GLenum textureUnit = g_glTextureUnits [sampler];
   
-  glActiveTexture (textureUnit);
-  cx_gdi_assert_no_errors ();
+  cx_shader_set_active_texture_unit (textureUnit);
   
   glBindTexture (GL_TEXTURE_2D, texture->id);
   cx_gdi_assert_no_errors ();
   
-  glUniform1i (location, sampler);
-  cx_gdi_assert_no_errors ();
+  if (cx_shader_uniform_dirty (info, &sampler, sizeof (sampler)))
+  {
+    glUniform1i (info->location, sampler);
+    cx_gdi_assert_no_errors ();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -720,6 +972,26 @@ cx_shader *cx_shader_get_built_in (cx_shader_built_in type)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void cx_shader_get_stats (cx_shader_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  *stats = g_stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_shader_reset_stats (void)
+{
+  memset (&g_stats, 0, sizeof (g_stats));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static void cx_shader_built_in_init (void)
 {
   // create built in shaders
@@ -88,11 +88,24 @@ typedef struct cx_shader
   cxu32 program;
   cxi32 attributes [CX_NUM_SHADER_ATTRIBUTES];
   cxi32 uniforms [CX_NUM_SHADER_UNIFORMS];
+  cxi32 uniformSlots [CX_NUM_SHADER_UNIFORMS];   // index into uniformTable
+  struct cx_shader_uniform_info *uniformTable;    // active uniforms, resolved at link time
+  cxu32 uniformTableSize;
   char *name;
   bool enabled;
   
 } cx_shader;
 
+typedef struct cx_shader_stats
+{
+  cxu32 programBinds;
+  cxu32 programBindsSkipped;
+  cxu32 uniformUploads;
+  cxu32 uniformUploadsSkipped;
+  cxu32 textureUnitsSkipped;
+  cxu32 locationLookupsSkipped;
+} cx_shader_stats;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -124,6 +137,13 @@ cx_shader *cx_shader_get_built_in (cx_shader_built_in type);
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void cx_shader_get_stats (cx_shader_stats *stats);
+void cx_shader_reset_stats (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 bool _cx_shader_init (void);
 bool _cx_shader_deinit (void);
 
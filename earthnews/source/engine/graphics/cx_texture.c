@@ -4,13 +4,15 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
-#include <OpenGLES/ES2/gl.h>
-#include <OpenGLES/ES2/glext.h>
+#include "cx_opengl.h"
 
 #include "../system/cx_util.h"
 #include "../system/cx_string.h"
+#include "../system/cx_thread.h"
+#include "../system/cx_time.h"
 
 #include "cx_texture.h"
+#include "cx_draw.h"
 #include "cx_gdi.h"
 
 #include "../3rdparty/stb/stb_image.h"
@@ -21,6 +23,8 @@
 
 #define CX_PVRTC_LEGACY 0
 
+#define CX_TEXTURE_CACHE_NUM_BUCKETS (64) // power of 2
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -44,11 +48,58 @@ static cxu8 g_texture_format_pixel_size [CX_TEXTURE_NUM_FORMATS] =
 
 typedef struct cx_texture_node 
 {
-  cx_texture texture;
-  const char *filename;
-  struct cx_texture_node *next;
+  cx_texture texture; // first, so a cached texture can be cast to its node
+  char *filename;
+  cxu32 hash;
+  cxu32 bytes;
+  cxi32 refCount;
+  cx_file_storage_base storage;
+  bool mipmaps;
+  struct cx_texture_node *next;     // bucket chain
+  struct cx_texture_node *lruPrev;  // unreferenced list
+  struct cx_texture_node *lruNext;
 } cx_texture_node;
 
+typedef struct cx_texture_cache
+{
+  cx_texture_node *buckets [CX_TEXTURE_CACHE_NUM_BUCKETS];
+  cx_texture_node *lruHead; // least recently released
+  cx_texture_node *lruTail;
+  cx_texture_cache_stats stats;
+  cx_thread_mutex mutex;
+} cx_texture_cache;
+
+static cx_texture_cache g_texture_cache;
+
+typedef enum cx_texture_stream_state
+{
+  CX_TEXTURE_STREAM_STATE_DECODING,
+  CX_TEXTURE_STREAM_STATE_DECODED,
+  CX_TEXTURE_STREAM_STATE_FAILED,
+} cx_texture_stream_state;
+
+typedef struct cx_texture_stream
+{
+  cx_texture *texture;
+  cx_thread_monitor decoded;  // signalled once by the decode task
+  cx_texture_stream_state state;
+  cxf32 decodeTime;
+  bool joined;                // decoded has been waited on
+  cxu32 previewLevel;         // finest level in the preview
+  cxi32 level;                // next full level to upload, counts down to 0
+  cxu32 row;                  // next row in level
+  GLuint streamId;            // full texture, swapped in when level 0 is done
+  struct cx_texture_stream *next;
+} cx_texture_stream;
+
+typedef struct cx_texture_streamer
+{
+  cx_texture_stream *streams;
+  cx_texture_stream_stats stats;
+  cx_thread_mutex mutex;      // serialises the gl side, decode tasks don't take it
+} cx_texture_streamer;
+
+static cx_texture_streamer g_texture_streamer;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -65,11 +116,18 @@ static cx_texture *cx_texture_load_img_xxx (const char *filename, cx_file_storag
 {
   cx_texture *texture = NULL;
   
-  char path [512];
-  cx_file_storage_path (path, 512, filename, storage);
+  const cxu8 *filedata = NULL;
+  cxu32 filedataSize = 0;
   
+  cxu8 *data = NULL;
   int w, h, ch;
-  cxu8 *data = stbi_load (path, &w, &h, &ch, STBI_default);
+  
+  if (cx_file_storage_map_contents (&filedata, &filedataSize, filename, storage))
+  {
+    data = stbi_load_from_memory (filedata, (int) filedataSize, &w, &h, &ch, STBI_default);
+    
+    cx_file_storage_unmap_contents (filedata, filedataSize);
+  }
   
   if (data)
   {
@@ -477,228 +535,907 @@ static cx_texture *cx_texture_load_img_pvr (const char *filename, cx_file_storag
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-cx_texture *cx_texture_create (cxu32 width, cxu32 height, cx_texture_format format)
+static cxu32 cx_texture_cache_hash (const char *filename, cx_file_storage_base storage, bool mipmaps)
 {
-  CX_ASSERT ((format > CX_TEXTURE_FORMAT_INVALID) && (format < CX_TEXTURE_NUM_FORMATS));
+  // fnv-1a
   
-  cx_texture *texture = (cx_texture *) cx_malloc (sizeof (cx_texture));
-  memset (texture, 0, sizeof (cx_texture));
-
-  texture->id                = 0;
-  texture->width             = width;
-  texture->height            = height;
-  texture->format            = format;
-  texture->compressed        = (format <= CX_TEXTURE_FORMAT_RGBA) ? 0 : 1;
-  texture->dataSize          = width * height * sizeof (cxu8) * g_texture_format_pixel_size [format];
-  texture->data              = (cxu8 *) cx_malloc (texture->dataSize);
-  texture->imageData [0]     = texture->data;
-  texture->imageDataSize [0] = texture->dataSize;
-  texture->mipmapCount       = 1;
+  cxu32 hash = 2166136261u;
   
-  return texture;
+  while (*filename)
+  {
+    hash ^= (cxu8) *filename++;
+    hash *= 16777619u;
+  }
+  
+  hash ^= ((cxu32) storage << 1) | (mipmaps ? 1 : 0);
+  hash *= 16777619u;
+  
+  return hash;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-cx_texture *cx_texture_create_from_file (const char *filename, cx_file_storage_base storage, bool genMipmaps)
+static cxu32 cx_texture_cache_bytes (const cx_texture *texture, bool mipmaps)
 {
-  CX_ASSERT (filename);
+  // gpu size estimate, generated mip chains add a third
   
-  cx_texture *texture = cx_texture_load_img_xxx (filename, storage);
+  cxu32 bytes = 0;
   
-  if (texture == NULL)
+  for (cxu32 i = 0; i < texture->mipmapCount; ++i)
   {
-    texture = cx_texture_load_img_pvr (filename, storage);
+    bytes += texture->imageDataSize [i];
   }
   
-  if (texture)
+  if (mipmaps && (texture->mipmapCount == 1))
   {
-    cx_texture_gpu_init (texture, genMipmaps);
-    cx_texture_data_destroy (texture);
+    bytes += bytes / 3;
   }
+  
+  return bytes;
+}
 
-  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE && !texture, "cx_texture_create: failed to load [%s]", filename);
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_cache_lru_remove (cx_texture_node *node)
+{
+  if (node->lruPrev)
+  {
+    node->lruPrev->lruNext = node->lruNext;
+  }
+  else
+  {
+    g_texture_cache.lruHead = node->lruNext;
+  }
   
-  return texture;
+  if (node->lruNext)
+  {
+    node->lruNext->lruPrev = node->lruPrev;
+  }
+  else
+  {
+    g_texture_cache.lruTail = node->lruPrev;
+  }
+  
+  node->lruPrev = NULL;
+  node->lruNext = NULL;
+  
+  g_texture_cache.stats.unreferenced--;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_texture_data_destroy (cx_texture *texture)
+static void cx_texture_cache_lru_append (cx_texture_node *node)
 {
-  CX_ASSERT (texture);
+  node->lruPrev = g_texture_cache.lruTail;
+  node->lruNext = NULL;
   
-  if (texture->data)
+  if (g_texture_cache.lruTail)
   {
-    cx_free (texture->data);
-    texture->data = NULL;
+    g_texture_cache.lruTail->lruNext = node;
+  }
+  else
+  {
+    g_texture_cache.lruHead = node;
   }
+  
+  g_texture_cache.lruTail = node;
+  
+  g_texture_cache.stats.unreferenced++;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_texture_destroy (cx_texture *texture)
+static cx_texture_node *cx_texture_cache_acquire (cxu32 hash, const char *filename, cx_file_storage_base storage, bool mipmaps)
 {
-  CX_ASSERT (texture);
+  // mutex must be held. mipmap flag is part of the key, the same image with and without
+  // a mip chain are different gpu textures
   
-  cx_texture_gpu_deinit (texture);
-  cx_texture_data_destroy (texture);
+  cx_texture_node *node = g_texture_cache.buckets [hash & (CX_TEXTURE_CACHE_NUM_BUCKETS - 1)];
   
-  cx_free (texture);
+  while (node)
+  {
+    if ((node->hash == hash) && (node->storage == storage) && (node->mipmaps == mipmaps) && (strcmp (node->filename, filename) == 0))
+    {
+      if (node->refCount++ == 0)
+      {
+        cx_texture_cache_lru_remove (node);
+      }
+      
+      g_texture_cache.stats.hits++;
+      
+      break;
+    }
+    
+    node = node->next;
+  }
+  
+  return node;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_texture_gpu_init (cx_texture *texture, bool genMipmaps)
+static void cx_texture_cache_evict (cx_texture_node *node)
 {
-  CX_ASSERT (texture);
-  CX_ASSERT (texture->data);
-  CX_ASSERT (texture->id == 0);
-  CX_ASSERT (texture->width > 0);
-  CX_ASSERT (texture->height > 0);
-  CX_ASSERT (texture->mipmapCount <= CX_TEXTURE_MAX_MIPMAP_COUNT);
+  // mutex must be held
   
-  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->width  [%d]", texture->width);
-  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->height [%d]", texture->height);
-  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->format [%d]", texture->format);
-  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->compressed [%s]", texture->compressed ? "true" : "false");
+  cx_texture_node **link = &g_texture_cache.buckets [node->hash & (CX_TEXTURE_CACHE_NUM_BUCKETS - 1)];
   
-  if (texture->compressed)
+  while (*link != node)
   {
-    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    CX_ASSERT (*link);
+    link = &(*link)->next;
   }
   
-  glGenTextures (1, &texture->id);
-  cx_gdi_assert_no_errors ();
+  *link = node->next;
   
-  glBindTexture (GL_TEXTURE_2D, texture->id);
-  cx_gdi_assert_no_errors ();
+  if (node->refCount == 0)
+  {
+    cx_texture_cache_lru_remove (node);
+  }
+  
+  g_texture_cache.stats.count--;
+  g_texture_cache.stats.bytes -= node->bytes;
+  g_texture_cache.stats.evictions++;
+  
+  cx_texture_gpu_deinit (&node->texture);
+  
+  cx_free (node->filename);
+  cx_free (node);
+}
 
-  if (!genMipmaps)
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_cache_trim (cxu32 budget)
+{
+  // mutex must be held. only unreferenced textures are evicted, so the cache can stay over budget
+  
+  while ((g_texture_cache.stats.bytes > budget) && g_texture_cache.lruHead)
   {
-    // override mipmap count
-    texture->mipmapCount = 1;
+    cx_texture_cache_evict (g_texture_cache.lruHead);
   }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_cache_release (cx_texture_node *node)
+{
+  // mutex must be held
   
-  for (cxu32 i = 0, c = texture->mipmapCount; i < c; ++i)
+  CX_ASSERT (node->refCount > 0);
+  
+  if (--node->refCount == 0)
   {
-    cxu8 *imageData = texture->imageData [i];
-    cxu32 imageDataSize = texture->imageDataSize [i];
-    
-    cxu32 w = cx_max (1, texture->width >> i);
-    cxu32 h = cx_max (1, texture->height >> i);
-    
-    CX_ASSERT (imageData);
-    CX_ASSERT (imageDataSize > 0);
+    cx_texture_cache_lru_append (node);
+    cx_texture_cache_trim (g_texture_cache.stats.budget);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static GLenum cx_texture_gl_format (cx_texture_format format)
+{
+  switch (format)
+  {
+    case CX_TEXTURE_FORMAT_ALPHA:           { return GL_ALPHA; }
+    case CX_TEXTURE_FORMAT_LUMINANCE:       { return GL_LUMINANCE; }
+    case CX_TEXTURE_FORMAT_LUMINANCE_ALPHA: { return GL_LUMINANCE_ALPHA; }
+    case CX_TEXTURE_FORMAT_RGB:             { return GL_RGB; }
+    case CX_TEXTURE_FORMAT_RGBA:            { return GL_RGBA; }
+    default:                                { CX_ERROR ("Invalid texture format"); return GL_RGBA; }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_stream_downsample (cxu8 *dst, const cxu8 *src, cxu32 srcWidth, cxu32 srcHeight, cxu32 pixelSize)
+{
+  // 2x2 box filter, a dimension of 1 is repeated
+  
+  cxu32 w = cx_max (1, srcWidth >> 1);
+  cxu32 h = cx_max (1, srcHeight >> 1);
+  
+  cxu32 dx = (srcWidth > 1) ? pixelSize : 0;
+  cxu32 dy = (srcHeight > 1) ? (srcWidth * pixelSize) : 0;
+  
+  for (cxu32 y = 0; y < h; ++y)
+  {
+    const cxu8 *row = src + (y * 2 * srcWidth * pixelSize);
     
-    if (texture->compressed)
-    {
-      switch (texture->format)
-      {
-        case CX_TEXTURE_FORMAT_RGBA_PVR_4BPP:
-        {
-          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, w, h, 0, imageDataSize, imageData);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_RGBA_PVR_2BPP:
-        {
-          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG, w, h, 0, imageDataSize, imageData);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_RGB_PVR_4BPP:
-        {
-          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, w, h, 0, imageDataSize, imageData);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_RGB_PVR_2BPP:
-        {
-          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG, w, h, 0, imageDataSize, imageData);
-          break;
-        }
-          
-        default:
-        {
-          CX_ERROR ("cx_texture_gpu_init: Invalid texture format");
-          break;
-        }
-      }
-    }
-    else
+    for (cxu32 x = 0; x < w; ++x)
     {
-      switch (texture->format)
+      const cxu8 *p = row + (x * 2 * pixelSize);
+      
+      for (cxu32 c = 0; c < pixelSize; ++c)
       {
-        case CX_TEXTURE_FORMAT_RGB:
-        {
-          glTexImage2D (GL_TEXTURE_2D, i, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, texture->data);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_RGBA:
-        {
-          glTexImage2D (GL_TEXTURE_2D, i, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture->data);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_ALPHA:
-        {
-          glTexImage2D (GL_TEXTURE_2D, i, GL_ALPHA, w, h, 0, GL_ALPHA, GL_UNSIGNED_BYTE, texture->data);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_LUMINANCE:
-        {
-          glTexImage2D (GL_TEXTURE_2D, i, GL_LUMINANCE, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, texture->data);
-          break;
-        }
-          
-        case CX_TEXTURE_FORMAT_LUMINANCE_ALPHA:
-        {
-          glTexImage2D (GL_TEXTURE_2D, i, GL_LUMINANCE_ALPHA, w, h, 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, texture->data);
-          break;
-        }
-          
-        default:
-        {
-          CX_ERROR ("cx_texture_gpu_init: Invalid texture format");
-          break;
-        }
+        *dst++ = (cxu8) ((p [c] + p [c + dx] + p [c + dy] + p [c + dx + dy] + 2) >> 2);
       }
     }
-    
-    cx_gdi_assert_no_errors ();
   }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_stream_decode (cxu8 *buffer, cxu32 size, void *userdata)
+{
+  // runs on the file async dispatcher's thread. decodes and builds the full mip chain in one block
   
+  cx_texture_stream *stream = (cx_texture_stream *) userdata;
+  cx_texture *texture = stream->texture;
   
-  bool npotTexture = (!cx_util_is_pow2 (texture->width)) || (!cx_util_is_pow2 (texture->height));
+  cx_timer timer;
+  cx_time_start_timer (&timer);
   
-  if (texture->mipmapCount > 1)
+  cxu8 *data = NULL;
+  int w = 0, h = 0, ch = 0;
+  
+  if (buffer)
   {
-    CX_ASSERT (!npotTexture);
-    
-    // set up filters
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    cx_gdi_assert_no_errors ();
+    data = stbi_load_from_memory (buffer, (int) size, &w, &h, &ch, STBI_default);
     
-    // set up coordinate wrapping
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    cx_free (buffer);
   }
-  else // mipmapCount == 1
+  
+  bool decoded = data && cx_util_is_pow2 ((cxu32) w) && cx_util_is_pow2 ((cxu32) h);
+  
+  if (decoded)
   {
-    CX_ASSERT (texture->mipmapCount == 1);
-    
+    switch (ch)
+    {
+      case STBI_grey:       { texture->format = CX_TEXTURE_FORMAT_LUMINANCE; break; }
+      case STBI_grey_alpha: { texture->format = CX_TEXTURE_FORMAT_LUMINANCE_ALPHA; break; }
+      case STBI_rgb:        { texture->format = CX_TEXTURE_FORMAT_RGB; break; }
+      case STBI_rgb_alpha:  { texture->format = CX_TEXTURE_FORMAT_RGBA; break; }
+      default:              { CX_ERROR ("Invalid texture format"); break; }
+    }
+    
+    cxu32 pixelSize = g_texture_format_pixel_size [texture->format];
+    cxu32 levelCount = 0;
+    cxu32 dataSize = 0;
+    
+    for (cxu32 lw = (cxu32) w, lh = (cxu32) h; ; lw = cx_max (1, lw >> 1), lh = cx_max (1, lh >> 1))
+    {
+      texture->imageDataSize [levelCount++] = lw * lh * pixelSize;
+      dataSize += lw * lh * pixelSize;
+      
+      if ((lw == 1) && (lh == 1))
+      {
+        break;
+      }
+    }
+    
+    CX_ASSERT (levelCount <= CX_TEXTURE_MAX_MIPMAP_COUNT);
+    
+    data = (cxu8 *) cx_realloc (data, dataSize);
+    
+    texture->data = data;
+    texture->dataSize = dataSize;
+    texture->width = (cxu32) w;
+    texture->height = (cxu32) h;
+    texture->mipmapCount = levelCount;
+    texture->imageData [0] = data;
+    
+    for (cxu32 i = 1; i < levelCount; ++i)
+    {
+      texture->imageData [i] = texture->imageData [i - 1] + texture->imageDataSize [i - 1];
+      
+      cx_texture_stream_downsample (texture->imageData [i], texture->imageData [i - 1], 
+                                    cx_max (1, texture->width >> (i - 1)), cx_max (1, texture->height >> (i - 1)), pixelSize);
+    }
+    
+    cxu32 previewLevel = 0;
+    
+    while ((cx_max (texture->width, texture->height) >> previewLevel) > CX_TEXTURE_STREAM_PREVIEW_SIZE)
+    {
+      previewLevel++;
+    }
+    
+    stream->previewLevel = previewLevel;
+    stream->level = (cxi32) previewLevel - 1;
+  }
+  else if (data)
+  {
+    cx_free (data);
+  }
+  
+  cx_time_stop_timer (&timer);
+  
+  stream->decodeTime = timer.elapsedTime;
+  stream->state = decoded ? CX_TEXTURE_STREAM_STATE_DECODED : CX_TEXTURE_STREAM_STATE_FAILED;
+  
+  // the monitor's mutex orders the writes above before the gl side's wait
+  
+  cx_thread_monitor_signal (&stream->decoded);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_texture_stream_join (cx_texture_stream *stream, bool block)
+{
+  // mutex must be held
+  
+  if (!stream->joined)
+  {
+    if (block)
+    {
+      cx_thread_monitor_wait (&stream->decoded);
+      
+      stream->joined = true;
+    }
+    else
+    {
+      stream->joined = cx_thread_monitor_wait_timed (&stream->decoded, 0);
+    }
+    
+    if (stream->joined)
+    {
+      g_texture_streamer.stats.decodeTime += stream->decodeTime;
+    }
+  }
+  
+  return stream->joined;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_texture_stream_gl_init (const cx_texture *texture, GLuint *id, cxu32 baseLevel, cxu32 firstLevel)
+{
+  // uploads levels firstLevel and coarser as gl levels counted from baseLevel
+  
+  GLenum format = cx_texture_gl_format (texture->format);
+  
+  cxu32 bytes = 0;
+  
+  glGenTextures (1, id);
+  cx_gdi_assert_no_errors ();
+  
+  glBindTexture (GL_TEXTURE_2D, *id);
+  cx_gdi_assert_no_errors ();
+  
+  glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+  
+  for (cxu32 i = firstLevel; i < texture->mipmapCount; ++i)
+  {
+    cxu32 w = cx_max (1, texture->width >> i);
+    cxu32 h = cx_max (1, texture->height >> i);
+    
+    glTexImage2D (GL_TEXTURE_2D, i - baseLevel, format, w, h, 0, format, GL_UNSIGNED_BYTE, texture->imageData [i]);
+    cx_gdi_assert_no_errors ();
+    
+    bytes += texture->imageDataSize [i];
+  }
+  
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  cx_gdi_assert_no_errors ();
+  
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_texture_stream_upload (cx_texture_stream *stream, cxu32 budget)
+{
+  // mutex must be held. the preview always goes up, full levels only within budget (at least a row)
+  
+  cx_texture *texture = stream->texture;
+  
+  cxu32 bytes = 0;
+  
+  if (texture->id == 0)
+  {
+    bytes += cx_texture_stream_gl_init (texture, &texture->id, stream->previewLevel, stream->previewLevel);
+  }
+  
+  if ((stream->level >= 0) && (budget > 0))
+  {
+    if (stream->streamId == 0)
+    {
+      bytes += cx_texture_stream_gl_init (texture, &stream->streamId, 0, stream->previewLevel);
+    }
+    else
+    {
+      glBindTexture (GL_TEXTURE_2D, stream->streamId);
+      cx_gdi_assert_no_errors ();
+      
+      glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    }
+    
+    GLenum format = cx_texture_gl_format (texture->format);
+    
+    cxu32 pixelSize = g_texture_format_pixel_size [texture->format];
+    
+    do
+    {
+      cxu32 level = (cxu32) stream->level;
+      cxu32 w = cx_max (1, texture->width >> level);
+      cxu32 h = cx_max (1, texture->height >> level);
+      cxu32 rowSize = w * pixelSize;
+      
+      if (stream->row == 0)
+      {
+        glTexImage2D (GL_TEXTURE_2D, level, format, w, h, 0, format, GL_UNSIGNED_BYTE, NULL);
+        cx_gdi_assert_no_errors ();
+      }
+      
+      cxu32 rows = (budget > bytes) ? ((budget - bytes) / rowSize) : 0;
+      
+      rows = cx_clamp (rows, 1, h - stream->row);
+      
+      glTexSubImage2D (GL_TEXTURE_2D, level, 0, stream->row, w, rows, format, GL_UNSIGNED_BYTE, 
+                       texture->imageData [level] + (stream->row * rowSize));
+      cx_gdi_assert_no_errors ();
+      
+      bytes += rows * rowSize;
+      
+      stream->row += rows;
+      
+      if (stream->row == h)
+      {
+        stream->level--;
+        stream->row = 0;
+      }
+    } while ((stream->level >= 0) && (bytes < budget));
+    
+    if (stream->level < 0)
+    {
+      glDeleteTextures (1, &texture->id);
+      cx_gdi_assert_no_errors ();
+      
+      texture->id = stream->streamId;
+      stream->streamId = 0;
+    }
+  }
+  
+  g_texture_streamer.stats.uploadBytes += bytes;
+  
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_stream_detach (cx_texture_stream **link)
+{
+  // mutex must be held, stream must be joined
+  
+  cx_texture_stream *stream = *link;
+  
+  CX_ASSERT (stream->joined);
+  
+  *link = stream->next;
+  
+  if (stream->streamId)
+  {
+    glDeleteTextures (1, &stream->streamId);
+    cx_gdi_assert_no_errors ();
+  }
+  
+  stream->texture->streaming = 0;
+  
+  g_texture_streamer.stats.pending--;
+  
+  cx_thread_monitor_deinit (&stream->decoded);
+  
+  cx_free (stream);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_texture_stream_process (cx_texture_stream **link, cxu32 budget, bool block)
+{
+  // mutex must be held. returns bytes uploaded, detaches the stream when done
+  
+  cx_texture_stream *stream = *link;
+  cx_texture *texture = stream->texture;
+  
+  if (!cx_texture_stream_join (stream, block))
+  {
+    return 0;
+  }
+  
+  cxu32 bytes = 0;
+  
+  if (stream->state == CX_TEXTURE_STREAM_STATE_FAILED)
+  {
+    CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_stream: failed to load texture");
+    
+    g_texture_streamer.stats.failed++;
+    
+    cx_texture_stream_detach (link);
+  }
+  else
+  {
+    bytes = cx_texture_stream_upload (stream, budget);
+    
+    if (stream->level < 0)
+    {
+      g_texture_streamer.stats.completed++;
+      
+      cx_texture_stream_detach (link);
+      cx_texture_data_destroy (texture);
+    }
+  }
+  
+  return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_texture_stream_cancel (cx_texture *texture)
+{
+  cx_thread_mutex_lock (&g_texture_streamer.mutex);
+  
+  cx_texture_stream **link = &g_texture_streamer.streams;
+  
+  while (*link && ((*link)->texture != texture))
+  {
+    link = &(*link)->next;
+  }
+  
+  CX_ASSERT (*link);
+  
+  // decode task can't be cancelled, it has to finish writing to the texture first
+  
+  cx_texture_stream_join (*link, true);
+  cx_texture_stream_detach (link);
+  
+  cx_thread_mutex_unlock (&g_texture_streamer.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_texture *cx_texture_create (cxu32 width, cxu32 height, cx_texture_format format)
+{
+  CX_ASSERT ((format > CX_TEXTURE_FORMAT_INVALID) && (format < CX_TEXTURE_NUM_FORMATS));
+  
+  cx_texture *texture = (cx_texture *) cx_malloc (sizeof (cx_texture));
+  memset (texture, 0, sizeof (cx_texture));
+
+  texture->id                = 0;
+  texture->width             = width;
+  texture->height            = height;
+  texture->format            = format;
+  texture->compressed        = (format <= CX_TEXTURE_FORMAT_RGBA) ? 0 : 1;
+  texture->dataSize          = width * height * sizeof (cxu8) * g_texture_format_pixel_size [format];
+  texture->data              = (cxu8 *) cx_malloc (texture->dataSize);
+  texture->imageData [0]     = texture->data;
+  texture->imageDataSize [0] = texture->dataSize;
+  texture->mipmapCount       = 1;
+  
+  return texture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_texture *cx_texture_create_from_file (const char *filename, cx_file_storage_base storage, bool genMipmaps)
+{
+  CX_ASSERT (filename);
+  
+  cxu32 hash = cx_texture_cache_hash (filename, storage, genMipmaps);
+  
+  cx_thread_mutex_lock (&g_texture_cache.mutex);
+  
+  cx_texture_node *node = cx_texture_cache_acquire (hash, filename, storage, genMipmaps);
+  
+  cx_thread_mutex_unlock (&g_texture_cache.mutex);
+  
+  if (node)
+  {
+    return &node->texture;
+  }
+  
+  // miss: decode and upload outside the lock
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  cx_texture *texture = cx_texture_load_img_xxx (filename, storage);
+  
+  if (texture == NULL)
+  {
+    texture = cx_texture_load_img_pvr (filename, storage);
+  }
+  
+  cxu32 bytes = 0;
+  
+  if (texture)
+  {
+    bytes = cx_texture_cache_bytes (texture, genMipmaps);
+    
+    cx_texture_gpu_init (texture, genMipmaps);
+    cx_texture_data_destroy (texture);
+  }
+  
+  cx_time_stop_timer (&timer);
+
+  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE && !texture, "cx_texture_create: failed to load [%s]", filename);
+  
+  if (texture == NULL)
+  {
+    return NULL;
+  }
+  
+  node = (cx_texture_node *) cx_malloc (sizeof (cx_texture_node));
+  memset (node, 0, sizeof (cx_texture_node));
+  
+  node->texture = *texture;
+  node->texture.cached = 1;
+  node->filename = cx_strdup (filename, (cxu32) strlen (filename));
+  node->hash = hash;
+  node->bytes = bytes;
+  node->refCount = 1;
+  node->storage = storage;
+  node->mipmaps = genMipmaps;
+  
+  cx_free (texture);
+  
+  cx_thread_mutex_lock (&g_texture_cache.mutex);
+  
+  g_texture_cache.stats.misses++;
+  g_texture_cache.stats.decodeTime += timer.elapsedTime;
+  
+  // another thread may have loaded the same file in the meantime
+  
+  cx_texture_node *dup = cx_texture_cache_acquire (hash, filename, storage, genMipmaps);
+  
+  if (dup == NULL)
+  {
+    cxu32 b = hash & (CX_TEXTURE_CACHE_NUM_BUCKETS - 1);
+    
+    node->next = g_texture_cache.buckets [b];
+    g_texture_cache.buckets [b] = node;
+    
+    g_texture_cache.stats.count++;
+    g_texture_cache.stats.bytes += node->bytes;
+    
+    cx_texture_cache_trim (g_texture_cache.stats.budget);
+  }
+  
+  cx_thread_mutex_unlock (&g_texture_cache.mutex);
+  
+  if (dup)
+  {
+    cx_texture_gpu_deinit (&node->texture);
+    cx_free (node->filename);
+    cx_free (node);
+    
+    node = dup;
+  }
+  
+  return &node->texture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_data_destroy (cx_texture *texture)
+{
+  CX_ASSERT (texture);
+  
+  if (texture->data)
+  {
+    cx_free (texture->data);
+    texture->data = NULL;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_destroy (cx_texture *texture)
+{
+  CX_ASSERT (texture);
+  
+  // queued draws may still reference it
+  cx_draw_batch_flush ();
+  
+  if (texture->streaming)
+  {
+    cx_texture_stream_cancel (texture);
+  }
+  
+  if (texture->cached)
+  {
+    cx_thread_mutex_lock (&g_texture_cache.mutex);
+    
+    cx_texture_cache_release ((cx_texture_node *) texture);
+    
+    cx_thread_mutex_unlock (&g_texture_cache.mutex);
+    
+    return;
+  }
+  
+  cx_texture_gpu_deinit (texture);
+  cx_texture_data_destroy (texture);
+  
+  cx_free (texture);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_gpu_init (cx_texture *texture, bool genMipmaps)
+{
+  CX_ASSERT (texture);
+  CX_ASSERT (texture->data);
+  CX_ASSERT (texture->id == 0);
+  CX_ASSERT (texture->width > 0);
+  CX_ASSERT (texture->height > 0);
+  CX_ASSERT (texture->mipmapCount <= CX_TEXTURE_MAX_MIPMAP_COUNT);
+  
+  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->width  [%d]", texture->width);
+  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->height [%d]", texture->height);
+  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->format [%d]", texture->format);
+  CX_LOG_CONSOLE (CX_TEXTURE_DEBUG_LOG_ENABLE, "cx_texture_gpu_init: texture->compressed [%s]", texture->compressed ? "true" : "false");
+  
+  if (texture->compressed)
+  {
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+  }
+  
+  glGenTextures (1, &texture->id);
+  cx_gdi_assert_no_errors ();
+  
+  glBindTexture (GL_TEXTURE_2D, texture->id);
+  cx_gdi_assert_no_errors ();
+
+  if (!genMipmaps)
+  {
+    // override mipmap count
+    texture->mipmapCount = 1;
+  }
+  
+  for (cxu32 i = 0, c = texture->mipmapCount; i < c; ++i)
+  {
+    cxu8 *imageData = texture->imageData [i];
+    cxu32 imageDataSize = texture->imageDataSize [i];
+    
+    cxu32 w = cx_max (1, texture->width >> i);
+    cxu32 h = cx_max (1, texture->height >> i);
+    
+    CX_ASSERT (imageData);
+    CX_ASSERT (imageDataSize > 0);
+    
+    if (texture->compressed)
+    {
+      switch (texture->format)
+      {
+        case CX_TEXTURE_FORMAT_RGBA_PVR_4BPP:
+        {
+          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG, w, h, 0, imageDataSize, imageData);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_RGBA_PVR_2BPP:
+        {
+          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG, w, h, 0, imageDataSize, imageData);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_RGB_PVR_4BPP:
+        {
+          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, w, h, 0, imageDataSize, imageData);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_RGB_PVR_2BPP:
+        {
+          glCompressedTexImage2D (GL_TEXTURE_2D, i, GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG, w, h, 0, imageDataSize, imageData);
+          break;
+        }
+          
+        default:
+        {
+          CX_ERROR ("cx_texture_gpu_init: Invalid texture format");
+          break;
+        }
+      }
+    }
+    else
+    {
+      switch (texture->format)
+      {
+        case CX_TEXTURE_FORMAT_RGB:
+        {
+          glTexImage2D (GL_TEXTURE_2D, i, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, texture->data);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_RGBA:
+        {
+          glTexImage2D (GL_TEXTURE_2D, i, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture->data);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_ALPHA:
+        {
+          glTexImage2D (GL_TEXTURE_2D, i, GL_ALPHA, w, h, 0, GL_ALPHA, GL_UNSIGNED_BYTE, texture->data);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_LUMINANCE:
+        {
+          glTexImage2D (GL_TEXTURE_2D, i, GL_LUMINANCE, w, h, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, texture->data);
+          break;
+        }
+          
+        case CX_TEXTURE_FORMAT_LUMINANCE_ALPHA:
+        {
+          glTexImage2D (GL_TEXTURE_2D, i, GL_LUMINANCE_ALPHA, w, h, 0, GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, texture->data);
+          break;
+        }
+          
+        default:
+        {
+          CX_ERROR ("cx_texture_gpu_init: Invalid texture format");
+          break;
+        }
+      }
+    }
+    
+    cx_gdi_assert_no_errors ();
+  }
+  
+  
+  bool npotTexture = (!cx_util_is_pow2 (texture->width)) || (!cx_util_is_pow2 (texture->height));
+  
+  if (texture->mipmapCount > 1)
+  {
+    CX_ASSERT (!npotTexture);
+    
+    // set up filters
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    cx_gdi_assert_no_errors ();
+    
+    // set up coordinate wrapping
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  }
+  else // mipmapCount == 1
+  {
+    CX_ASSERT (texture->mipmapCount == 1);
+    
     bool npotExtensionSupported = cx_gdi_get_extension_supported (CX_GDI_EXTENSION_NPOT);
     
     if (npotTexture && !npotExtensionSupported)
@@ -795,3 +1532,257 @@ void cx_texture_set_wrap_mode (cx_texture *texture, cx_texture_wrap_mode mode)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool _cx_texture_init (void)
+{
+  memset (&g_texture_cache, 0, sizeof (g_texture_cache));
+  
+  memset (&g_texture_streamer, 0, sizeof (g_texture_streamer));
+  
+  g_texture_cache.stats.budget = CX_TEXTURE_CACHE_DEFAULT_BUDGET;
+  
+  bool success = cx_thread_mutex_init (&g_texture_cache.mutex);
+  
+  success &= cx_thread_mutex_init (&g_texture_streamer.mutex);
+  
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool _cx_texture_deinit (void)
+{
+  // textures still referenced are owned by the cache and go too
+  
+  for (cxu32 i = 0; i < CX_TEXTURE_CACHE_NUM_BUCKETS; ++i)
+  {
+    while (g_texture_cache.buckets [i])
+    {
+      cx_texture_cache_evict (g_texture_cache.buckets [i]);
+    }
+  }
+  
+  CX_ASSERT (g_texture_cache.stats.count == 0);
+  
+  // pending streams are left to their textures' owners
+  
+  while (g_texture_streamer.streams)
+  {
+    cx_texture_stream_join (g_texture_streamer.streams, true);
+    cx_texture_stream_detach (&g_texture_streamer.streams);
+  }
+  
+  bool success = cx_thread_mutex_deinit (&g_texture_cache.mutex);
+  
+  success &= cx_thread_mutex_deinit (&g_texture_streamer.mutex);
+  
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_cache_set_budget (cxu32 bytes)
+{
+  cx_thread_mutex_lock (&g_texture_cache.mutex);
+  
+  g_texture_cache.stats.budget = bytes;
+  
+  cx_texture_cache_trim (bytes);
+  
+  cx_thread_mutex_unlock (&g_texture_cache.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_cache_purge (void)
+{
+  // evicts every unreferenced texture
+  
+  cx_thread_mutex_lock (&g_texture_cache.mutex);
+  
+  cx_texture_cache_trim (0);
+  
+  cx_thread_mutex_unlock (&g_texture_cache.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_cache_get_stats (cx_texture_cache_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  cx_thread_mutex_lock (&g_texture_cache.mutex);
+  
+  *stats = g_texture_cache.stats;
+  
+  cx_thread_mutex_unlock (&g_texture_cache.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_cache_reset_stats (void)
+{
+  // counters only, residency is kept
+  
+  cx_thread_mutex_lock (&g_texture_cache.mutex);
+  
+  g_texture_cache.stats.hits = 0;
+  g_texture_cache.stats.misses = 0;
+  g_texture_cache.stats.evictions = 0;
+  g_texture_cache.stats.decodeTime = 0.0f;
+  
+  cx_thread_mutex_unlock (&g_texture_cache.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_texture *cx_texture_create_from_file_streamed (const char *filename, cx_file_storage_base storage)
+{
+  CX_ASSERT (filename);
+  
+  cx_texture *texture = (cx_texture *) cx_malloc (sizeof (cx_texture));
+  memset (texture, 0, sizeof (cx_texture));
+  
+  texture->streaming = 1;
+  
+  cx_texture_stream *stream = (cx_texture_stream *) cx_malloc (sizeof (cx_texture_stream));
+  memset (stream, 0, sizeof (cx_texture_stream));
+  
+  stream->texture = texture;
+  stream->state = CX_TEXTURE_STREAM_STATE_DECODING;
+  
+  cx_thread_monitor_init (&stream->decoded);
+  
+  cx_thread_mutex_lock (&g_texture_streamer.mutex);
+  
+  stream->next = g_texture_streamer.streams;
+  g_texture_streamer.streams = stream;
+  g_texture_streamer.stats.pending++;
+  
+  cx_thread_mutex_unlock (&g_texture_streamer.mutex);
+  
+  cx_file_storage_load_contents_async (filename, storage, cx_texture_stream_decode, stream);
+  
+  return texture;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool cx_texture_stream_wait (void)
+{
+  // blocks until every queued texture is decoded and has its preview. false if any failed
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  cx_thread_mutex_lock (&g_texture_streamer.mutex);
+  
+  cxu32 failed = g_texture_streamer.stats.failed;
+  
+  cx_texture_stream **link = &g_texture_streamer.streams;
+  
+  while (*link)
+  {
+    cx_texture_stream *stream = *link;
+    
+    cx_texture_stream_process (link, 0, true);
+    
+    if (*link == stream)
+    {
+      link = &stream->next;
+    }
+  }
+  
+  bool success = (g_texture_streamer.stats.failed == failed);
+  
+  cx_time_stop_timer (&timer);
+  
+  g_texture_streamer.stats.waitTime += timer.elapsedTime;
+  
+  cx_thread_mutex_unlock (&g_texture_streamer.mutex);
+  
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool cx_texture_stream_update (cxu32 uploadBudget)
+{
+  // uploads up to uploadBudget bytes of full resolution levels. true while anything is pending
+  
+  cx_thread_mutex_lock (&g_texture_streamer.mutex);
+  
+  cxu32 bytes = 0;
+  
+  cx_texture_stream **link = &g_texture_streamer.streams;
+  
+  while (*link)
+  {
+    cx_texture_stream *stream = *link;
+    
+    bytes += cx_texture_stream_process (link, (uploadBudget > bytes) ? (uploadBudget - bytes) : 0, false);
+    
+    if (*link == stream)
+    {
+      link = &stream->next;
+    }
+  }
+  
+  bool pending = (g_texture_streamer.streams != NULL);
+  
+  cx_thread_mutex_unlock (&g_texture_streamer.mutex);
+  
+  return pending;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_get_stream_stats (cx_texture_stream_stats *stats)
+{
+  CX_ASSERT (stats);
+  
+  cx_thread_mutex_lock (&g_texture_streamer.mutex);
+  
+  *stats = g_texture_streamer.stats;
+  
+  cx_thread_mutex_unlock (&g_texture_streamer.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_texture_reset_stream_stats (void)
+{
+  cx_thread_mutex_lock (&g_texture_streamer.mutex);
+  
+  g_texture_streamer.stats.completed = 0;
+  g_texture_streamer.stats.failed = 0;
+  g_texture_streamer.stats.uploadBytes = 0;
+  g_texture_streamer.stats.decodeTime = 0.0f;
+  g_texture_streamer.stats.waitTime = 0.0f;
+  
+  cx_thread_mutex_unlock (&g_texture_streamer.mutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
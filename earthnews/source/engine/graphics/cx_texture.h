@@ -26,6 +26,8 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define CX_TEXTURE_MAX_MIPMAP_COUNT        (13)
+#define CX_TEXTURE_CACHE_DEFAULT_BUDGET    (32 * 1024 * 1024)
+#define CX_TEXTURE_STREAM_PREVIEW_SIZE     (512)
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -82,9 +84,33 @@ typedef struct cx_texture
   cx_texture_format format;
   
   cxu32 compressed : 1;
+  cxu32 cached : 1;
+  cxu32 streaming : 1;
   
 } cx_texture;
 
+typedef struct cx_texture_cache_stats
+{
+  cxu32 hits;
+  cxu32 misses;
+  cxu32 evictions;
+  cxu32 count;          // resident
+  cxu32 unreferenced;   // resident, evictable
+  cxu32 bytes;          // resident, gpu estimate
+  cxu32 budget;
+  cxf32 decodeTime;     // ms, decode and upload on misses
+} cx_texture_cache_stats;
+
+typedef struct cx_texture_stream_stats
+{
+  cxu32 pending;        // decoding or uploading
+  cxu32 completed;
+  cxu32 failed;
+  cxu32 uploadBytes;
+  cxf32 decodeTime;     // ms, summed over decode threads
+  cxf32 waitTime;       // ms, blocked in cx_texture_stream_wait
+} cx_texture_stream_stats;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -103,4 +129,40 @@ void cx_texture_gpu_deinit (cx_texture *texture);
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// textures from cx_texture_create_from_file are shared by (filename, storage, mipmaps) and reference
+// counted, cx_texture_destroy releases a reference. unreferenced textures stay resident until the
+// cache goes over budget, then the least recently released go first. don't modify shared textures.
+
+void cx_texture_cache_set_budget (cxu32 bytes);
+void cx_texture_cache_purge (void);
+void cx_texture_cache_get_stats (cx_texture_cache_stats *stats);
+void cx_texture_cache_reset_stats (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// streamed textures are loaded, decoded and mipmapped on the file async dispatcher, so several decode
+// in parallel. the texture id is 0 until the preview (the mip levels up to CX_TEXTURE_STREAM_PREVIEW_SIZE)
+// is uploaded by cx_texture_stream_wait or cx_texture_stream_update. the finer levels then upload in row
+// bands over calls to cx_texture_stream_update and replace the preview once level 0 is complete. both
+// need a gl context on the calling thread. streamed textures always have mipmaps and aren't cached.
+
+cx_texture *cx_texture_create_from_file_streamed (const char *filename, cx_file_storage_base storage);
+bool cx_texture_stream_wait (void);
+bool cx_texture_stream_update (cxu32 uploadBudget);
+void cx_texture_get_stream_stats (cx_texture_stream_stats *stats);
+void cx_texture_reset_stream_stats (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool _cx_texture_init (void);
+bool _cx_texture_deinit (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 #endif
@@ -35,14 +35,14 @@ void cx_vertex_data_create_sphere_aos (cxf32 radius, cxu16 numSlices, cxu16 numP
   CX_ASSERT (vertexData);
   
   cxu16 i, j;
-  cxu16 vertex;
+  cxi32 vertex;
   cxi32 numVertices = (numParallels + 1) * (numSlices + 1);
   cxi32 numIndices = numParallels * numSlices * 6;
   cxi32 numTriangles = numParallels * numSlices * 2;
   cxf32 angleStep = (2.0f * CX_PI) / (cxf32) numSlices;
   
   // Allocate memory for buffers
-  vertexData->indices = (cxu16 *) cx_malloc (sizeof (cxu16) * numIndices);
+  vertexData->indices = (cxu32 *) cx_malloc (sizeof (cxu32) * numIndices);
   vertexData->vertices = (cx_vertex *) cx_malloc (sizeof (cx_vertex) * numVertices);
   
   // Generate vertex data
@@ -72,7 +72,7 @@ void cx_vertex_data_create_sphere_aos (cxf32 radius, cxu16 numSlices, cxu16 numP
   }
   
   // Generate the indices
-  cxu16 *indexBuf = vertexData->indices;
+  cxu32 *indexBuf = vertexData->indices;
   
   for (i = 0; i < numParallels; ++i)
   {
@@ -119,11 +119,11 @@ void cx_vertex_data_sphere_compute_tangents_aos (struct cx_vertex_data_aos *vert
   for (cxi32 i = 0; i < triCount; ++i)
   {
     CX_ASSERT (index < vertexData->numIndices);
-    cxu16 i0 = vertexData->indices [index++];
+    cxu32 i0 = vertexData->indices [index++];
     CX_ASSERT (index < vertexData->numIndices);
-    cxu16 i1 = vertexData->indices [index++];
+    cxu32 i1 = vertexData->indices [index++];
     CX_ASSERT (index < vertexData->numIndices);
-    cxu16 i2 = vertexData->indices [index++];
+    cxu32 i2 = vertexData->indices [index++];
     
     const cx_vec4 *pos0 = &vertexData->vertices [i0].position;
     const cx_vec4 *pos1 = &vertexData->vertices [i1].position;
@@ -255,7 +255,7 @@ void cx_vertex_data_create_sphere_soa (cxf32 radius, cxu16 numSlices, cxu16 numP
   CX_ASSERT (vertexData);
   
   cxu16 i, j;
-  cxu16 vertex;
+  cxi32 vertex;
   cxi32 numVertices = (numParallels + 1) * (numSlices + 1);
   cxi32 numIndices = numParallels * numSlices * 6;
   cxi32 numTriangles = numParallels * numSlices * 2;
@@ -265,7 +265,7 @@ void cx_vertex_data_create_sphere_soa (cxf32 radius, cxu16 numSlices, cxu16 numP
   vertexData->positions = cx_malloc (sizeof (cxf32) * CX_VERTEX_POSITION_SIZE * numVertices);
   vertexData->normals = cx_malloc (sizeof (cxf32) * CX_VERTEX_NORMAL_SIZE * numVertices);
   vertexData->texCoords = cx_malloc (sizeof (cxf32) * CX_VERTEX_TEXCOORD_SIZE * numVertices);
-  vertexData->indices = cx_malloc (sizeof (cxu16) * numIndices);
+  vertexData->indices = cx_malloc (sizeof (cxu32) * numIndices);
   
   // Generate vertex data
   for (i = 0; i < numParallels + 1; ++i)
@@ -296,7 +296,7 @@ void cx_vertex_data_create_sphere_soa (cxf32 radius, cxu16 numSlices, cxu16 numP
   }
   
   // Generate the indices
-  cxu16 *indexBuf = vertexData->indices;
+  cxu32 *indexBuf = vertexData->indices;
   
   for (i = 0; i < numParallels; ++i)
   {
@@ -372,3 +372,551 @@ void cx_vertex_data_destroy (cx_vertex_data *vertexData)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if CX_VERTEX_DATA_AOS
+static cxu16 cx_vertex_data_pack_half (cxf32 f)
+{
+  // round to nearest even, values below the smallest normal half flush to zero
+  
+  union { cxf32 f; cxu32 u; } bits;
+  bits.f = f;
+  
+  cxu32 sign = (bits.u >> 16) & 0x8000;
+  cxi32 exponent = (cxi32) ((bits.u >> 23) & 0xff) - 127 + 15;
+  cxu32 mantissa = bits.u & 0x7fffff;
+  
+  if (exponent <= 0)
+  {
+    return (cxu16) sign;
+  }
+  
+  if (exponent >= 31)
+  {
+    return (cxu16) (sign | 0x7c00);
+  }
+  
+  cxu32 half = sign | ((cxu32) exponent << 10) | (mantissa >> 13);
+  cxu32 remainder = mantissa & 0x1fff;
+  
+  if ((remainder > 0x1000) || ((remainder == 0x1000) && (half & 1)))
+  {
+    half++;
+  }
+  
+  return (cxu16) half;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxi16 cx_vertex_data_pack_snorm16 (cxf32 f)
+{
+  return (cxi16) lrintf (cx_clamp (f, -1.0f, 1.0f) * 32767.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu16 cx_vertex_data_pack_unorm16 (cxf32 f)
+{
+  return (cxu16) lrintf (cx_clamp (f, 0.0f, 1.0f) * 65535.0f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_vertex_data_pack_oct16 (cxi16 *dst, const cx_vec4 *v)
+{
+  // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half over the upper.
+  // must match oct_decode in the vertex shaders, zero vectors come back as +z.
+  
+  cxf32 x = 0.0f;
+  cxf32 y = 0.0f;
+  cxf32 l1 = fabsf (v->x) + fabsf (v->y) + fabsf (v->z);
+  
+  if (l1 > 0.0f)
+  {
+    x = v->x / l1;
+    y = v->y / l1;
+    
+    if (v->z < 0.0f)
+    {
+      cxf32 ox = x;
+      
+      x = (1.0f - fabsf (y)) * ((ox >= 0.0f) ? 1.0f : -1.0f);
+      y = (1.0f - fabsf (ox)) * ((y >= 0.0f) ? 1.0f : -1.0f);
+    }
+  }
+  
+  dst [0] = cx_vertex_data_pack_snorm16 (x);
+  dst [1] = cx_vertex_data_pack_snorm16 (y);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_vertex_data_pack_element (cx_vertex_element *element, cx_vertex_element_type type, cxu32 components, cxu32 offset)
+{
+  static const cxu32 sizes [NUM_VERTEX_ELEMENT_TYPES] = { 0, 4, 2, 2, 2, 2 };
+  
+  element->type = (cxu8) type;
+  element->components = (cxu8) components;
+  element->offset = (cxu16) offset;
+  
+  return offset + (sizes [type] * components);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_vertex_data_pack_vec (cxu8 *dst, const cx_vertex_element *element, const cxf32 *src)
+{
+  // positions are written with w = 1, elements stay 4 byte aligned
+  
+  switch (element->type)
+  {
+    case CX_VERTEX_ELEMENT_TYPE_FLOAT:
+    {
+      memcpy (dst, src, sizeof (cxf32) * element->components);
+      break;
+    }
+      
+    case CX_VERTEX_ELEMENT_TYPE_HALF:
+    {
+      cxu16 *h = (cxu16 *) dst;
+      
+      for (cxu32 i = 0; i < element->components; ++i)
+      {
+        h [i] = cx_vertex_data_pack_half (src [i]);
+      }
+      break;
+    }
+      
+    case CX_VERTEX_ELEMENT_TYPE_SNORM16:
+    {
+      cxi16 *s = (cxi16 *) dst;
+      
+      for (cxu32 i = 0; i < element->components; ++i)
+      {
+        s [i] = cx_vertex_data_pack_snorm16 (src [i]);
+      }
+      break;
+    }
+      
+    case CX_VERTEX_ELEMENT_TYPE_UNORM16:
+    {
+      cxu16 *u = (cxu16 *) dst;
+      
+      for (cxu32 i = 0; i < element->components; ++i)
+      {
+        u [i] = cx_vertex_data_pack_unorm16 (src [i]);
+      }
+      break;
+    }
+      
+    default:
+    {
+      CX_FATAL_ASSERT (0);
+      break;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cxu8 *cx_vertex_data_pack (const cx_vertex_data *vertexData, bool halfFloat, cx_vertex_layout *layout)
+{
+  // picks the smallest type that covers each element's range: snorm16 positions inside the unit
+  // cube, half (or float) outside it. unorm16 tex coords in [0, 1], snorm16 in [-1, 1].
+  
+  CX_ASSERT (vertexData);
+  CX_ASSERT (vertexData->vertices);
+  CX_ASSERT (layout);
+  
+  cx_vertex_format format = vertexData->format;
+  
+  bool hasNormal = (format == CX_VERTEX_FORMAT_PN) || (format == CX_VERTEX_FORMAT_PTN) || (format == CX_VERTEX_FORMAT_PTNTB);
+  bool hasTexCoord = (format == CX_VERTEX_FORMAT_PT) || (format == CX_VERTEX_FORMAT_PTN) || (format == CX_VERTEX_FORMAT_PTNTB);
+  bool hasTangents = (format == CX_VERTEX_FORMAT_PTNTB);
+  
+  cxf32 positionMax = 0.0f;
+  cxf32 texCoordMin = 0.0f;
+  cxf32 texCoordMax = 0.0f;
+  
+  for (cxi32 i = 0; i < vertexData->numVertices; ++i)
+  {
+    const cx_vertex *vertex = &vertexData->vertices [i];
+    
+    positionMax = cx_max (positionMax, fabsf (vertex->position.x));
+    positionMax = cx_max (positionMax, fabsf (vertex->position.y));
+    positionMax = cx_max (positionMax, fabsf (vertex->position.z));
+    
+    texCoordMin = cx_min (texCoordMin, cx_min (vertex->texCoord.x, vertex->texCoord.y));
+    texCoordMax = cx_max (texCoordMax, cx_max (vertex->texCoord.x, vertex->texCoord.y));
+  }
+  
+  memset (layout, 0, sizeof (cx_vertex_layout));
+  
+  cx_vertex_element_type positionType = CX_VERTEX_ELEMENT_TYPE_FLOAT;
+  
+  if (positionMax <= 1.0f)
+  {
+    positionType = CX_VERTEX_ELEMENT_TYPE_SNORM16;
+  }
+  else if (halfFloat && (positionMax < 65504.0f))
+  {
+    positionType = CX_VERTEX_ELEMENT_TYPE_HALF;
+  }
+  
+  cxu32 offset = cx_vertex_data_pack_element (&layout->position, positionType, 4, 0);
+  
+  if (hasNormal)
+  {
+    offset = cx_vertex_data_pack_element (&layout->normal, CX_VERTEX_ELEMENT_TYPE_OCT16, 2, offset);
+  }
+  
+  if (hasTangents)
+  {
+    offset = cx_vertex_data_pack_element (&layout->tangent, CX_VERTEX_ELEMENT_TYPE_OCT16, 2, offset);
+    offset = cx_vertex_data_pack_element (&layout->bitangent, CX_VERTEX_ELEMENT_TYPE_OCT16, 2, offset);
+  }
+  
+  if (hasTexCoord)
+  {
+    cx_vertex_element_type texCoordType = CX_VERTEX_ELEMENT_TYPE_FLOAT;
+    
+    if ((texCoordMin >= 0.0f) && (texCoordMax <= 1.0f))
+    {
+      texCoordType = CX_VERTEX_ELEMENT_TYPE_UNORM16;
+    }
+    else if ((texCoordMin >= -1.0f) && (texCoordMax <= 1.0f))
+    {
+      texCoordType = CX_VERTEX_ELEMENT_TYPE_SNORM16;
+    }
+    else if (halfFloat)
+    {
+      texCoordType = CX_VERTEX_ELEMENT_TYPE_HALF;
+    }
+    
+    offset = cx_vertex_data_pack_element (&layout->texCoord, texCoordType, 2, offset);
+  }
+  
+  layout->stride = offset;
+  
+  cxu8 *packed = (cxu8 *) cx_malloc (layout->stride * vertexData->numVertices);
+  
+  for (cxi32 i = 0; i < vertexData->numVertices; ++i)
+  {
+    const cx_vertex *vertex = &vertexData->vertices [i];
+    
+    cxu8 *dst = packed + (i * layout->stride);
+    
+    cxf32 position [4] = { vertex->position.x, vertex->position.y, vertex->position.z, 1.0f };
+    
+    cx_vertex_data_pack_vec (dst + layout->position.offset, &layout->position, position);
+    
+    if (hasNormal)
+    {
+      cx_vertex_data_pack_oct16 ((cxi16 *) (dst + layout->normal.offset), &vertex->normal);
+    }
+    
+    if (hasTangents)
+    {
+      cx_vertex_data_pack_oct16 ((cxi16 *) (dst + layout->tangent.offset), &vertex->tangent);
+      cx_vertex_data_pack_oct16 ((cxi16 *) (dst + layout->bitangent.offset), &vertex->bitangent);
+    }
+    
+    if (hasTexCoord)
+    {
+      cxf32 texCoord [2] = { vertex->texCoord.x, vertex->texCoord.y };
+      
+      cx_vertex_data_pack_vec (dst + layout->texCoord.offset, &layout->texCoord, texCoord);
+    }
+  }
+  
+  return packed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_vertex_data_optimise (cx_vertex_data *vertexData)
+{
+  // cache order for the indices, then renumber the vertices by first use so fetches walk forwards.
+  
+  CX_ASSERT (vertexData);
+  CX_ASSERT (vertexData->vertices);
+  CX_ASSERT (vertexData->indices);
+  
+  cxi32 numVertices = vertexData->numVertices;
+  cxi32 numIndices = vertexData->numIndices;
+  
+  cx_vertex_data_optimise_indices (vertexData->indices, numIndices, numVertices, CX_VERTEX_CACHE_SIZE);
+  
+  cxi32 *remap = (cxi32 *) cx_malloc (sizeof (cxi32) * numVertices);
+  cx_vertex *vertices = (cx_vertex *) cx_malloc (sizeof (cx_vertex) * numVertices);
+  
+  memset (remap, 0xff, sizeof (cxi32) * numVertices);
+  
+  cxi32 count = 0;
+  
+  for (cxi32 i = 0; i < numIndices; ++i)
+  {
+    cxu32 index = vertexData->indices [i];
+    
+    if (remap [index] < 0)
+    {
+      vertices [count] = vertexData->vertices [index];
+      remap [index] = count++;
+    }
+    
+    vertexData->indices [i] = (cxu32) remap [index];
+  }
+  
+  // unreferenced vertices keep their order at the end
+  
+  for (cxi32 i = 0; i < numVertices; ++i)
+  {
+    if (remap [i] < 0)
+    {
+      vertices [count++] = vertexData->vertices [i];
+    }
+  }
+  
+  CX_ASSERT (count == numVertices);
+  
+  cx_free (vertexData->vertices);
+  cx_free (remap);
+  
+  vertexData->vertices = vertices;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+#endif
+
+cxu16 *cx_vertex_data_pack_indices16 (const cxu32 *indices, cxi32 numIndices)
+{
+  CX_ASSERT (indices);
+  
+  cxu16 *packed = (cxu16 *) cx_malloc (sizeof (cxu16) * numIndices);
+  
+  for (cxi32 i = 0; i < numIndices; ++i)
+  {
+    CX_ASSERT (indices [i] <= 0xffff);
+    
+    packed [i] = (cxu16) indices [i];
+  }
+  
+  return packed;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_vertex_data_optimise_indices (cxu32 *indices, cxi32 numIndices, cxi32 numVertices, cxu32 cacheSize)
+{
+  // tipsify (sander, nehab and barczak 2007). emits every triangle around a fanning vertex, then moves
+  // to the neighbour that will still be in a fifo of cacheSize entries after its remaining triangles,
+  // oldest first. falls back to recently used vertices (dead-end stack) and then to input order.
+  // triangles keep their winding.
+  
+  CX_ASSERT (indices);
+  CX_ASSERT ((numIndices % 3) == 0);
+  CX_ASSERT (cacheSize > 0);
+  
+  cxi32 numTriangles = numIndices / 3;
+  
+  if (numTriangles == 0)
+  {
+    return;
+  }
+  
+  cxi32 *live = (cxi32 *) cx_malloc (sizeof (cxi32) * numVertices);
+  cxi32 *timestamps = (cxi32 *) cx_malloc (sizeof (cxi32) * numVertices);
+  cxi32 *offsets = (cxi32 *) cx_malloc (sizeof (cxi32) * (numVertices + 1));
+  cxi32 *adjacency = (cxi32 *) cx_malloc (sizeof (cxi32) * numIndices);
+  cxi32 *deadEnd = (cxi32 *) cx_malloc (sizeof (cxi32) * numIndices);
+  cxi32 *candidates = (cxi32 *) cx_malloc (sizeof (cxi32) * numIndices);
+  cxu32 *output = (cxu32 *) cx_malloc (sizeof (cxu32) * numIndices);
+  bool *emitted = (bool *) cx_malloc (sizeof (bool) * numTriangles);
+  
+  memset (live, 0, sizeof (cxi32) * numVertices);
+  memset (timestamps, 0, sizeof (cxi32) * numVertices);
+  memset (emitted, 0, sizeof (bool) * numTriangles);
+  
+  // vertex to triangle adjacency, live is the number of triangles still to emit per vertex
+  
+  for (cxi32 i = 0; i < numIndices; ++i)
+  {
+    CX_ASSERT (indices [i] < (cxu32) numVertices);
+    
+    live [indices [i]]++;
+  }
+  
+  offsets [0] = 0;
+  
+  for (cxi32 i = 0; i < numVertices; ++i)
+  {
+    offsets [i + 1] = offsets [i] + live [i];
+  }
+  
+  for (cxi32 i = 0; i < numIndices; ++i)
+  {
+    cxu32 v = indices [i];
+    
+    adjacency [offsets [v] + timestamps [v]++] = i / 3;
+  }
+  
+  memset (timestamps, 0, sizeof (cxi32) * numVertices);
+  
+  cxi32 time = (cxi32) cacheSize + 1;
+  cxi32 cursor = 0;
+  cxi32 numDeadEnd = 0;
+  cxi32 numOutput = 0;
+  cxi32 fanning = 0;
+  
+  while (fanning >= 0)
+  {
+    cxi32 numCandidates = 0;
+    
+    for (cxi32 a = offsets [fanning]; a < offsets [fanning + 1]; ++a)
+    {
+      cxi32 t = adjacency [a];
+      
+      if (!emitted [t])
+      {
+        for (cxi32 k = 0; k < 3; ++k)
+        {
+          cxu32 v = indices [(t * 3) + k];
+          
+          output [numOutput++] = v;
+          deadEnd [numDeadEnd++] = (cxi32) v;
+          candidates [numCandidates++] = (cxi32) v;
+          
+          live [v]--;
+          
+          if ((time - timestamps [v]) > (cxi32) cacheSize)
+          {
+            timestamps [v] = time++;
+          }
+        }
+        
+        emitted [t] = true;
+      }
+    }
+    
+    // next fanning vertex
+    
+    cxi32 next = -1;
+    cxi32 best = -1;
+    
+    for (cxi32 c = 0; c < numCandidates; ++c)
+    {
+      cxi32 v = candidates [c];
+      
+      if (live [v] > 0)
+      {
+        cxi32 priority = 0;
+        
+        if (((time - timestamps [v]) + (2 * live [v])) <= (cxi32) cacheSize)
+        {
+          priority = time - timestamps [v];
+        }
+        
+        if (priority > best)
+        {
+          best = priority;
+          next = v;
+        }
+      }
+    }
+    
+    while ((next < 0) && (numDeadEnd > 0))
+    {
+      cxi32 v = deadEnd [--numDeadEnd];
+      
+      next = (live [v] > 0) ? v : -1;
+    }
+    
+    while ((next < 0) && (cursor < numVertices))
+    {
+      next = (live [cursor] > 0) ? cursor : -1;
+      cursor++;
+    }
+    
+    fanning = next;
+  }
+  
+  CX_ASSERT (numOutput == numIndices);
+  
+  memcpy (indices, output, sizeof (cxu32) * numIndices);
+  
+  cx_free (live);
+  cx_free (timestamps);
+  cx_free (offsets);
+  cx_free (adjacency);
+  cx_free (deadEnd);
+  cx_free (candidates);
+  cx_free (output);
+  cx_free (emitted);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_vertex_data_get_cache_stats (const cxu32 *indices, cxi32 numIndices, cxi32 numVertices, cxu32 cacheSize, cxf32 *acmr, cxf32 *atvr)
+{
+  // fifo post-transform cache. acmr is misses per triangle (about 0.5 at best on a closed grid),
+  // atvr is misses per referenced vertex (1 at best).
+  
+  CX_ASSERT (indices);
+  CX_ASSERT (acmr);
+  CX_ASSERT (atvr);
+  
+  cxi32 *timestamps = (cxi32 *) cx_malloc (sizeof (cxi32) * numVertices);
+  
+  for (cxi32 i = 0; i < numVertices; ++i)
+  {
+    timestamps [i] = -(cxi32) cacheSize - 1;
+  }
+  
+  cxi32 misses = 0;
+  
+  for (cxi32 i = 0; i < numIndices; ++i)
+  {
+    cxu32 v = indices [i];
+    
+    if ((misses - timestamps [v]) > (cxi32) cacheSize)
+    {
+      timestamps [v] = misses++;
+    }
+  }
+  
+  cxi32 referenced = 0;
+  
+  for (cxi32 i = 0; i < numVertices; ++i)
+  {
+    referenced += (timestamps [i] >= 0) ? 1 : 0;
+  }
+  
+  cx_free (timestamps);
+  
+  *acmr = (numIndices > 0) ? ((cxf32) misses / (cxf32) (numIndices / 3)) : 0.0f;
+  *atvr = (referenced > 0) ? ((cxf32) misses / (cxf32) referenced) : 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -19,6 +19,7 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define CX_VERTEX_DATA_AOS        1 // array of structs
+#define CX_VERTEX_CACHE_SIZE      16 // post-transform cache entries assumed by the optimiser
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -46,6 +47,37 @@ typedef enum cx_vertex_format
   NUM_VERTEX_FORMATS
 } cx_vertex_format;
 
+// packed gpu layout, built from the float vertices at upload. normals, tangents and bitangents
+// are octahedral encoded and need decoding in the vertex shader.
+
+typedef enum cx_vertex_element_type
+{
+  CX_VERTEX_ELEMENT_TYPE_NONE,
+  CX_VERTEX_ELEMENT_TYPE_FLOAT,     // 32 bit float
+  CX_VERTEX_ELEMENT_TYPE_HALF,      // 16 bit float
+  CX_VERTEX_ELEMENT_TYPE_SNORM16,   // normalised [-1, 1]
+  CX_VERTEX_ELEMENT_TYPE_UNORM16,   // normalised [0, 1]
+  CX_VERTEX_ELEMENT_TYPE_OCT16,     // unit vector, octahedral snorm16 x 2
+  NUM_VERTEX_ELEMENT_TYPES
+} cx_vertex_element_type;
+
+typedef struct cx_vertex_element
+{
+  cxu16 offset;
+  cxu8 type;
+  cxu8 components;
+} cx_vertex_element;
+
+typedef struct cx_vertex_layout
+{
+  cx_vertex_element position;
+  cx_vertex_element normal;
+  cx_vertex_element tangent;
+  cx_vertex_element bitangent;
+  cx_vertex_element texCoord;
+  cxu32 stride;
+} cx_vertex_layout;
+
 #if CX_VERTEX_DATA_AOS
 
 typedef struct cx_vertex
@@ -60,7 +92,7 @@ typedef struct cx_vertex
 struct cx_vertex_data_aos
 {
   cx_vertex *vertices;
-  cxu16 *indices;
+  cxu32 *indices;
   cxi32 numVertices;
   cxi32 numIndices;
   cxi32 numTriangles;
@@ -75,7 +107,7 @@ struct cx_vertex_data_soa
   cxf32 *normals;
   cxf32 *tangents;
   cxf32 *bitangents;
-  cxu16 *indices;
+  cxu32 *indices;
   cxi32 numVertices;
   cxi32 numIndices;
   cxi32 numTriangles;
@@ -92,6 +124,16 @@ cx_vertex_data *cx_vertex_data_create_sphere (cxf32 radius, cxu16 slices, cx_ver
 
 void cx_vertex_data_destroy (cx_vertex_data *vertexData);
 
+#if CX_VERTEX_DATA_AOS
+cxu8 *cx_vertex_data_pack (const cx_vertex_data *vertexData, bool halfFloat, cx_vertex_layout *layout);
+void cx_vertex_data_optimise (cx_vertex_data *vertexData);
+#endif
+
+cxu16 *cx_vertex_data_pack_indices16 (const cxu32 *indices, cxi32 numIndices);
+
+void cx_vertex_data_optimise_indices (cxu32 *indices, cxi32 numIndices, cxi32 numVertices, cxu32 cacheSize);
+void cx_vertex_data_get_cache_stats (const cxu32 *indices, cxi32 numIndices, cxi32 numVertices, cxu32 cacheSize, cxf32 *acmr, cxf32 *atvr);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -8,7 +8,12 @@
 #include <sys/types.h>
 #include <signal.h>
 #include <unistd.h>
+#if defined (__APPLE__)
 #include <sys/sysctl.h>
+#else
+#include <stdio.h>
+#include <string.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -16,6 +21,7 @@
 
 #if CX_DEBUG
 
+#if defined (__APPLE__)
 static BOOL in_debugger (void)
 {
   // Reference: http://developer.apple.com/library/ios/#qa/qa1361/_index.html
@@ -51,6 +57,33 @@ static BOOL in_debugger (void)
   
   return ((info.kp_proc.p_flag & P_TRACED) != 0);
 }
+#else
+static bool in_debugger (void)
+{
+  // linux: a non-zero TracerPid in /proc/self/status
+  
+  int tracer = 0;
+  char line [128];
+  
+  FILE *status = fopen ("/proc/self/status", "r");
+  
+  if (status)
+  {
+    while (fgets (line, sizeof (line), status))
+    {
+      if (strncmp (line, "TracerPid:", 10) == 0)
+      {
+        tracer = atoi (line + 10);
+        break;
+      }
+    }
+    
+    fclose (status);
+  }
+  
+  return (tracer != 0);
+}
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -5,14 +5,140 @@
 //
 
 #include "cx_file.h"
+#include "cx_math.h"
 #include "cx_string.h"
+#include "cx_thread.h"
+#include "cx_time.h"
 #include "cx_native_ios.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define CX_FILE_MAX_FILE_PATHNAME 512
+#define CX_FILE_IO_STATS_ENABLED 1
+#define CX_FILE_IO_STATS_MAX_FILES 64
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef enum cx_file_io_type
+{
+  CX_FILE_IO_TYPE_LOAD,
+  CX_FILE_IO_TYPE_MAP,
+  CX_FILE_IO_TYPE_ASYNC,
+} cx_file_io_type;
+
+typedef struct cx_file_async_request
+{
+  char filename [CX_FILENAME_MAX];
+  cx_file_storage_base base;
+  cx_file_load_callback callback;
+  void *userdata;
+} cx_file_async_request;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_file_async_dispatcher g_asyncDispatcher = NULL;
+
+#if CX_FILE_IO_STATS_ENABLED
+static cx_thread_mutex g_ioStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+static cx_file_io_stats g_ioStats [CX_FILE_IO_STATS_MAX_FILES];
+static cxu32 g_ioStatsCount = 0;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_file_io_stats_record (const char *filename, cx_file_io_type type, cxu32 bytes, const cx_timer *timer)
+{
+#if CX_FILE_IO_STATS_ENABLED
+  CX_ASSERT (filename);
+  
+  cx_thread_mutex_lock (&g_ioStatsMutex);
+  
+  cx_file_io_stats *stats = NULL;
+  
+  for (cxu32 i = 0; i < g_ioStatsCount; ++i)
+  {
+    if (strncmp (g_ioStats [i].filename, filename, sizeof (g_ioStats [i].filename) - 1) == 0)
+    {
+      stats = &g_ioStats [i];
+      break;
+    }
+  }
+  
+  if (!stats && (g_ioStatsCount < CX_FILE_IO_STATS_MAX_FILES))
+  {
+    stats = &g_ioStats [g_ioStatsCount++];
+    
+    memset (stats, 0, sizeof (cx_file_io_stats));
+    
+    cx_strcpy (stats->filename, sizeof (stats->filename), filename);
+  }
+  
+  if (stats)
+  {
+    switch (type)
+    {
+      case CX_FILE_IO_TYPE_LOAD:  { stats->loadCount++; break; }
+      case CX_FILE_IO_TYPE_MAP:   { stats->mapCount++; break; }
+      case CX_FILE_IO_TYPE_ASYNC: { stats->asyncCount++; break; }
+      default:                    { break; }
+    }
+    
+    stats->bytes += bytes;
+    
+    if (timer)
+    {
+      stats->totalTime += timer->elapsedTime;
+      stats->maxTime = cx_max (stats->maxTime, timer->elapsedTime);
+    }
+  }
+  
+  cx_thread_mutex_unlock (&g_ioStatsMutex);
+#else
+  CX_REF_UNUSED (filename);
+  CX_REF_UNUSED (type);
+  CX_REF_UNUSED (bytes);
+  CX_REF_UNUSED (timer);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_file_storage_load_async_func (void *userdata)
+{
+  cx_file_async_request *request = (cx_file_async_request *) userdata;
+  
+  CX_ASSERT (request);
+  CX_ASSERT (request->callback);
+  
+  cxu8 *buffer = NULL;
+  cxu32 size = 0;
+  
+  if (!cx_file_storage_load_contents (&buffer, &size, request->filename, request->base))
+  {
+    buffer = NULL;
+    size = 0;
+  }
+  
+  cx_file_io_stats_record (request->filename, CX_FILE_IO_TYPE_ASYNC, 0, NULL);
+  
+  request->callback (buffer, size, request->userdata);
+  
+  cx_free (request);
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -185,6 +311,8 @@ bool cx_file_storage_exists (const char *filename, cx_file_storage_base base)
 
 bool cx_file_storage_load_contents (cxu8 **buffer, cxu32 *size, const char *filename, cx_file_storage_base base)
 {
+  CX_ASSERT (buffer);
+  CX_ASSERT (size);
   CX_ASSERT (filename);
   
   bool loaded = false;
@@ -193,28 +321,166 @@ bool cx_file_storage_load_contents (cxu8 **buffer, cxu32 *size, const char *file
   
   cx_file_storage_path (storagePath, CX_FILE_MAX_FILE_PATHNAME, filename, base);
   
-  cx_file file;
+  cx_timer timer;
+  cx_time_start_timer (&timer);
   
-  if (cx_file_open (&file, storagePath, CX_FILE_MODE_READ))
+  // single fstat + read straight into the destination (no stdio buffering or seek/tell sizing)
+  
+  int fd = open (storagePath, O_RDONLY);
+  
+  if (fd >= 0)
   {
-    cxu32 sz = cx_file_size (&file);
-    cxu8 *buf = cx_malloc (sizeof (cxu8) * (sz + 1));
-    cxu32 read = cx_file_read (&file, buf, sizeof (cxu8), sz);
+    struct stat st;
     
-    CX_ASSERT (read == sz);
-    CX_REF_UNUSED (read);
+    if (fstat (fd, &st) == 0)
+    {
+      cxu32 sz = (cxu32) st.st_size;
+      cxu8 *buf = cx_malloc (sizeof (cxu8) * (sz + 1));
+      cxu32 read = 0;
+      
+      while (read < sz)
+      {
+        ssize_t r = pread (fd, buf + read, sz - read, read);
+        
+        if (r <= 0)
+        {
+          break;
+        }
+        
+        read += (cxu32) r;
+      }
+      
+      CX_ASSERT (read == sz);
+      
+      if (read == sz)
+      {
+        buf [sz] = 0;
+        
+        *buffer = buf;
+        *size = sz;
+        
+        loaded = true;
+      }
+      else
+      {
+        cx_free (buf);
+      }
+    }
     
-    buf [sz] = 0;
+    close (fd);
+  }
+  
+  cx_time_stop_timer (&timer);
+  
+  if (loaded)
+  {
+    cx_file_io_stats_record (filename, CX_FILE_IO_TYPE_LOAD, *size, &timer);
+  }
   
-    *buffer = buf;
-    *size = sz;
+  return loaded;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_file_storage_load_contents_async (const char *filename, cx_file_storage_base base, cx_file_load_callback callback, void *userdata)
+{
+  CX_ASSERT (filename);
+  CX_ASSERT (callback);
+  
+  cx_file_async_request *request = (cx_file_async_request *) cx_malloc (sizeof (cx_file_async_request));
+  
+  cx_strcpy (request->filename, CX_FILENAME_MAX, filename);
+  
+  request->base = base;
+  request->callback = callback;
+  request->userdata = userdata;
+  
+  // completes (and calls back) on the dispatcher's thread, or inline if none is set
+  
+  if (g_asyncDispatcher)
+  {
+    g_asyncDispatcher (cx_file_storage_load_async_func, request);
+  }
+  else
+  {
+    cx_file_storage_load_async_func (request);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_file_storage_set_async_dispatcher (cx_file_async_dispatcher dispatcher)
+{
+  g_asyncDispatcher = dispatcher;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool cx_file_storage_map_contents (const cxu8 **buffer, cxu32 *size, const char *filename, cx_file_storage_base base)
+{
+  CX_ASSERT (buffer);
+  CX_ASSERT (size);
+  CX_ASSERT (filename);
+  
+  bool mapped = false;
+  
+  char storagePath [CX_FILE_MAX_FILE_PATHNAME];
+  
+  cx_file_storage_path (storagePath, CX_FILE_MAX_FILE_PATHNAME, filename, base);
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  int fd = open (storagePath, O_RDONLY);
+  
+  if (fd >= 0)
+  {
+    struct stat st;
     
-    cx_file_close (&file);
+    if ((fstat (fd, &st) == 0) && (st.st_size > 0))
+    {
+      // read-only, pages are faulted in on first access and can be dropped by the os under pressure
+      
+      void *mapping = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      
+      if (mapping != MAP_FAILED)
+      {
+        *buffer = (const cxu8 *) mapping;
+        *size = (cxu32) st.st_size;
+        
+        mapped = true;
+      }
+    }
     
-    loaded = true;
+    close (fd);
   }
   
-  return loaded;
+  cx_time_stop_timer (&timer);
+  
+  if (mapped)
+  {
+    cx_file_io_stats_record (filename, CX_FILE_IO_TYPE_MAP, *size, &timer);
+  }
+  
+  return mapped;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_file_storage_unmap_contents (const cxu8 *buffer, cxu32 size)
+{
+  CX_ASSERT (buffer);
+  CX_ASSERT (size > 0);
+  
+  munmap ((void *) buffer, size);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -278,3 +544,43 @@ bool cx_file_storage_move (const char *tofilename, cx_file_storage_base tobase,
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cxu32 cx_file_storage_get_io_stats (cx_file_io_stats *stats, cxu32 maxCount)
+{
+  CX_ASSERT (stats);
+  
+  cxu32 count = 0;
+  
+#if CX_FILE_IO_STATS_ENABLED
+  cx_thread_mutex_lock (&g_ioStatsMutex);
+  
+  count = cx_min (g_ioStatsCount, maxCount);
+  
+  memcpy (stats, g_ioStats, sizeof (cx_file_io_stats) * count);
+  
+  cx_thread_mutex_unlock (&g_ioStatsMutex);
+#else
+  CX_REF_UNUSED (maxCount);
+#endif
+  
+  return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_file_storage_reset_io_stats (void)
+{
+#if CX_FILE_IO_STATS_ENABLED
+  cx_thread_mutex_lock (&g_ioStatsMutex);
+  
+  g_ioStatsCount = 0;
+  
+  cx_thread_mutex_unlock (&g_ioStatsMutex);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -53,6 +53,21 @@ typedef enum
 
 typedef FILE *cx_file;
 
+typedef struct cx_file_io_stats
+{
+  char filename [64];
+  cxu32 loadCount;
+  cxu32 mapCount;
+  cxu32 asyncCount;
+  cxu64 bytes;
+  cxf64 totalTime; /* milliseconds */
+  cxf64 maxTime; /* milliseconds */
+} cx_file_io_stats;
+
+typedef void (*cx_file_load_callback) (cxu8 *buffer, cxu32 size, void *userdata);
+typedef void (*cx_file_async_func) (void *userdata);
+typedef void (*cx_file_async_dispatcher) (cx_file_async_func func, void *userdata);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +87,10 @@ cxu32 cx_file_size (cx_file *file);
 void cx_file_storage_path (char *dstpath, int dstpathSize, const char *filename, cx_file_storage_base base);
 bool cx_file_storage_exists (const char *filename, cx_file_storage_base base);
 bool cx_file_storage_load_contents (cxu8 **buffer, cxu32 *size, const char *filename, cx_file_storage_base base);
+void cx_file_storage_load_contents_async (const char *filename, cx_file_storage_base base, cx_file_load_callback callback, void *userdata);
+void cx_file_storage_set_async_dispatcher (cx_file_async_dispatcher dispatcher);
+bool cx_file_storage_map_contents (const cxu8 **buffer, cxu32 *size, const char *filename, cx_file_storage_base base);
+void cx_file_storage_unmap_contents (const cxu8 *buffer, cxu32 size);
 bool cx_file_storage_save_contents (const cxu8 *buffer, cxu32 size, const char *filename, cx_file_storage_base base);
 bool cx_file_storage_create_dir (const char *dirname, cx_file_storage_base base);
 bool cx_file_storage_delete (const char *dirname, cx_file_storage_base base);                                 
@@ -80,6 +99,9 @@ bool cx_file_storage_copy (const char *tofilename, cx_file_storage_base tobase,
 bool cx_file_storage_move (const char *tofilename, cx_file_storage_base tobase, 
                            const char *frmfilename, cx_file_storage_base frmbase);
 
+cxu32 cx_file_storage_get_io_stats (cx_file_io_stats *stats, cxu32 maxCount);
+void  cx_file_storage_reset_io_stats (void);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -6,6 +6,7 @@
 
 #include "cx_json.h"
 #include "cx_string.h"
+#include "cx_util.h"
 #include "../3rdparty/json-parser/json.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -18,37 +19,311 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#define CX_JSON_ARENA_BLOCK_SIZE_MIN    (16 * 1024)
+#define CX_JSON_ARENA_BLOCK_SIZE_GROW   (64 * 1024)
+#define CX_JSON_KEY_INDEX_MIN_LENGTH    8
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct cx_json_arena_block
+{
+  struct cx_json_arena_block *next;
+  cxu32 size;
+  cxu32 used;
+} cx_json_arena_block;
+
+typedef struct cx_json_key_slot
+{
+  cxu32 hash;
+  cxu32 index; // child index + 1 (0 = empty)
+} cx_json_key_slot;
+
+typedef struct cx_json_key_index
+{
+  cxu32 mask;
+  cx_json_key_slot slots [1];
+} cx_json_key_index;
+
+typedef struct cx_json_node_ext
+{
+  cx_json_key_index *keyIndex;
+} cx_json_node_ext;
+
 typedef struct
 {
   json_value *root;
+  json_settings settings;
+  cx_json_arena_block *arena;
+  cxu32 arenaBlockSize;
+  cxu32 flags;
+  cx_json_tree_stats stats;
 } cx_json_tree_internal;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static CX_INLINE cx_json_node_ext *cx_json_node_get_ext (const json_value *jnode)
+{
+  return (cx_json_node_ext *) ((char *) jnode + sizeof (json_value));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE cxu32 cx_json_key_hash (const char *key)
+{
+  // fnv-1a
+  
+  cxu32 hash = 2166136261u;
+  
+  while (*key)
+  {
+    hash ^= (cxu8) *key++;
+    hash *= 16777619u;
+  }
+  
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void *cx_json_arena_alloc (cx_json_tree_internal *tree, size_t size)
+{
+  CX_ASSERT (tree);
+  
+  size = (size + 7) & ~((size_t) 7);
+  
+  cx_json_arena_block *block = tree->arena;
+  
+  if (!block || ((block->used + size) > block->size))
+  {
+    cxu32 blockSize = tree->arenaBlockSize;
+    
+    while (blockSize < size)
+    {
+      blockSize <<= 1;
+    }
+    
+    block = (cx_json_arena_block *) cx_malloc (sizeof (cx_json_arena_block) + blockSize);
+    
+    block->next = tree->arena;
+    block->size = blockSize;
+    block->used = 0;
+    
+    tree->arena = block;
+    tree->arenaBlockSize = CX_JSON_ARENA_BLOCK_SIZE_GROW;
+    tree->stats.allocCount++;
+    tree->stats.allocBytes += blockSize;
+  }
+  
+  void *mem = (char *) (block + 1) + block->used;
+  
+  block->used += (cxu32) size;
+  
+  return mem;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_json_arena_free_all (cx_json_tree_internal *tree)
+{
+  CX_ASSERT (tree);
+  
+  cx_json_arena_block *block = tree->arena;
+  
+  while (block)
+  {
+    cx_json_arena_block *next = block->next;
+    
+    cx_free (block);
+    
+    block = next;
+  }
+  
+  tree->arena = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void *cx_json_mem_alloc (size_t size, int zero, void *userdata)
+{
+  cx_json_tree_internal *tree = (cx_json_tree_internal *) userdata;
+  
+  void *mem = NULL;
+  
+  if (tree->flags & CX_JSON_TREE_FLAG_ARENA)
+  {
+    mem = cx_json_arena_alloc (tree, size);
+  }
+  else
+  {
+    mem = cx_malloc (size);
+    
+    tree->stats.allocCount++;
+    tree->stats.allocBytes += (cxu32) size;
+  }
+  
+  if (zero)
+  {
+    memset (mem, 0, size);
+  }
+  
+  return mem;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_json_mem_free (void *ptr, void *userdata)
+{
+  cx_json_tree_internal *tree = (cx_json_tree_internal *) userdata;
+  
+  if (!(tree->flags & CX_JSON_TREE_FLAG_ARENA))
+  {
+    cx_free (ptr);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_json_key_index_build (cx_json_tree_internal *tree, json_value *jnode)
+{
+  CX_ASSERT (tree);
+  CX_ASSERT (jnode);
+  
+  switch (jnode->type)
+  {
+    case json_object:
+    {
+      cxu32 length = jnode->u.object.length;
+      
+      if (length >= CX_JSON_KEY_INDEX_MIN_LENGTH)
+      {
+        cxu32 slotCount = cx_util_roundup_pow2 (length << 1);
+        
+        cx_json_key_index *keyIndex = (cx_json_key_index *) cx_json_arena_alloc (tree, 
+          sizeof (cx_json_key_index) + (sizeof (cx_json_key_slot) * (slotCount - 1)));
+        
+        memset (keyIndex->slots, 0, sizeof (cx_json_key_slot) * slotCount);
+        
+        keyIndex->mask = slotCount - 1;
+        
+        for (cxu32 i = 0; i < length; ++i)
+        {
+          cxu32 hash = cx_json_key_hash (jnode->u.object.values [i].name);
+          cxu32 s = hash & keyIndex->mask;
+          
+          while (keyIndex->slots [s].index)
+          {
+            s = (s + 1) & keyIndex->mask;
+          }
+          
+          keyIndex->slots [s].hash = hash;
+          keyIndex->slots [s].index = i + 1;
+        }
+        
+        cx_json_node_get_ext (jnode)->keyIndex = keyIndex;
+        
+        tree->stats.keyIndexCount++;
+      }
+      
+      for (cxu32 i = 0; i < length; ++i)
+      {
+        cx_json_key_index_build (tree, jnode->u.object.values [i].value);
+      }
+      
+      break;
+    }
+    
+    case json_array:
+    {
+      for (cxu32 i = 0, c = jnode->u.array.length; i < c; ++i)
+      {
+        cx_json_key_index_build (tree, jnode->u.array.values [i]);
+      }
+      
+      break;
+    }
+    
+    default:
+    {
+      break;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 cx_json_tree cx_json_tree_create (const char *data, cxu32 size)
+{
+  return cx_json_tree_create_ex (data, size, CX_JSON_TREE_FLAG_NONE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_json_tree cx_json_tree_create_ex (const char *data, cxu32 size, cxu32 flags)
 {
   CX_ASSERT (data);
   
-  cx_json_tree_internal *tree = NULL;
+  cx_json_tree_internal *tree = cx_malloc (sizeof (cx_json_tree_internal));
   
-  json_settings settings;
+  memset (tree, 0, sizeof (cx_json_tree_internal));
   
-  memset (&settings, 0, sizeof(settings));
+  tree->flags = flags;
+  tree->arenaBlockSize = CX_JSON_ARENA_BLOCK_SIZE_MIN;
+  
+  if (flags & CX_JSON_TREE_FLAG_ARENA)
+  {
+    // nodes and unescaped strings need about 3-4 times the source size
+    
+    tree->arenaBlockSize = cx_max (tree->arenaBlockSize, size * 4);
+  }
+  
+  tree->settings.mem_alloc = cx_json_mem_alloc;
+  tree->settings.mem_free = cx_json_mem_free;
+  tree->settings.user_data = tree;
+  tree->settings.value_extra = sizeof (cx_json_node_ext);
   
   char errorBuffer [512];
   
-  json_value *root = json_parse_ex (&settings, data, size, errorBuffer, 512);
+  json_value *root = json_parse_ex (&tree->settings, data, size, errorBuffer, 512);
+  
+  CX_LOG_CONSOLE (CX_JSON_DEBUG_LOG_ENABLED && (root == NULL), errorBuffer);
   
   if (root)
   {
-    tree = cx_malloc (sizeof (cx_json_tree_internal));
-    
     tree->root = root;
+    
+    if (flags & CX_JSON_TREE_FLAG_KEY_INDEX)
+    {
+      cx_json_key_index_build (tree, root);
+    }
+  }
+  else
+  {
+    cx_json_arena_free_all (tree);
+    
+    cx_free (tree);
+    
+    tree = NULL;
   }
-  
-  CX_LOG_CONSOLE (CX_JSON_DEBUG_LOG_ENABLED && (root == NULL), errorBuffer);
   
   return tree;
 }
@@ -63,7 +338,12 @@ void cx_json_tree_destroy (cx_json_tree tree)
   
   cx_json_tree_internal *t = (cx_json_tree_internal *) tree;
   
-  json_value_free (t->root);
+  if (!(t->flags & CX_JSON_TREE_FLAG_ARENA))
+  {
+    json_value_free_ex (&t->settings, t->root);
+  }
+  
+  cx_json_arena_free_all (t);
   
   cx_free (t);
 }
@@ -85,6 +365,20 @@ cx_json_node cx_json_tree_root_node (cx_json_tree tree)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void cx_json_tree_get_stats (cx_json_tree tree, cx_json_tree_stats *stats)
+{
+  CX_ASSERT (tree);
+  CX_ASSERT (stats);
+  
+  cx_json_tree_internal *t = (cx_json_tree_internal *) tree;
+  
+  *stats = t->stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 cx_json_type cx_json_node_type (cx_json_node node)
 {
   CX_ASSERT (node);
@@ -116,14 +410,37 @@ cx_json_node cx_json_object_child (cx_json_node node, const char * CX_RESTRICT k
   json_value *jnode = node;
   json_value *jchild = NULL;
   
-  for (cxu32 i = 0, c = jnode->u.object.length; i < c; ++i)
+  const cx_json_key_index *keyIndex = cx_json_node_get_ext (jnode)->keyIndex;
+  
+  if (keyIndex)
   {
-    const char *n = jnode->u.object.values [i].name;
+    cxu32 hash = cx_json_key_hash (key);
     
-    if (strcmp (key, n) == 0)
+    for (cxu32 s = hash & keyIndex->mask; keyIndex->slots [s].index; s = (s + 1) & keyIndex->mask)
     {
-      jchild = jnode->u.object.values [i].value;
-      break;
+      if (keyIndex->slots [s].hash == hash)
+      {
+        cxu32 i = keyIndex->slots [s].index - 1;
+        
+        if (strcmp (key, jnode->u.object.values [i].name) == 0)
+        {
+          jchild = jnode->u.object.values [i].value;
+          break;
+        }
+      }
+    }
+  }
+  else
+  {
+    for (cxu32 i = 0, c = jnode->u.object.length; i < c; ++i)
+    {
+      const char *n = jnode->u.object.values [i].name;
+      
+      if (strcmp (key, n) == 0)
+      {
+        jchild = jnode->u.object.values [i].value;
+        break;
+      }
     }
   }
   
@@ -236,6 +553,25 @@ const char *cx_json_value_string (cx_json_node node)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+const char *cx_json_value_string_view (cx_json_node node, cxu32 *length)
+{
+  CX_ASSERT (node);
+  CX_ASSERT (length);
+  CX_ASSERT (cx_json_node_type (node) == CX_JSON_TYPE_STRING);
+  
+  json_value *jnode = node;
+  
+  // borrowed: valid until the tree is destroyed
+  
+  *length = jnode->u.string.length;
+  
+  return jnode->u.string.ptr;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 cxi64 cx_json_value_int (cx_json_node node)
 {
   CX_ASSERT (node);
@@ -28,6 +28,20 @@ typedef enum
   CX_JSON_TYPE_ARRAY
 } cx_json_type;
 
+typedef enum cx_json_tree_flag
+{
+  CX_JSON_TREE_FLAG_NONE      = 0,
+  CX_JSON_TREE_FLAG_ARENA     = 0x1, // allocate all nodes and strings from one arena, freed in one go
+  CX_JSON_TREE_FLAG_KEY_INDEX = 0x2, // hash object keys for constant time cx_json_object_child lookups
+} cx_json_tree_flag;
+
+typedef struct cx_json_tree_stats
+{
+  cxu32 allocCount;
+  cxu32 allocBytes;
+  cxu32 keyIndexCount;
+} cx_json_tree_stats;
+
 typedef void * cx_json_tree;
 typedef void * cx_json_node;
 
@@ -36,8 +50,10 @@ typedef void * cx_json_node;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 cx_json_tree cx_json_tree_create (const char *data, cxu32 size);
+cx_json_tree cx_json_tree_create_ex (const char *data, cxu32 size, cxu32 flags);
 void         cx_json_tree_destroy (cx_json_tree tree);
 cx_json_node cx_json_tree_root_node (cx_json_tree tree);
+void         cx_json_tree_get_stats (cx_json_tree tree, cx_json_tree_stats *stats);
 
 cx_json_type cx_json_node_type (cx_json_node node);
 cx_json_node cx_json_object_child (cx_json_node node, const char * CX_RESTRICT key);
@@ -48,6 +64,7 @@ cx_json_node cx_json_array_member (cx_json_node node, cxu32 index);
 cxu32        cx_json_array_size (cx_json_node node);
 
 const char * cx_json_value_string (cx_json_node node);
+const char * cx_json_value_string_view (cx_json_node node, cxu32 *length);
 cxi64        cx_json_value_int (cx_json_node node);
 cxf32        cx_json_value_float (cx_json_node node);
 bool         cx_json_value_bool (cx_json_node node);
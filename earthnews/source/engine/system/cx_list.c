@@ -242,7 +242,15 @@ bool cx_list2_remove (cx_list2 *list, const void *data)
       cx_list2_node *next = list->head->next;
       cx_free (list->head);
       
-      next->prev = NULL;
+      if (next)
+      {
+        next->prev = NULL;
+      }
+      else
+      {
+        list->tail = NULL;
+      }
+      
       list->head = next;
       
       found = true;
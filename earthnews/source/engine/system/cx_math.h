@@ -21,13 +21,22 @@
 #define CX_SIMD_ENABLED   1
 
 #if CX_SIMD_ENABLED
-#ifdef __ARM_NEON__
+#if defined (__ARM_NEON__)
 #define CX_SIMD_NEON
+#elif defined (__SSE2__)
+#define CX_SIMD_SSE
+#if defined (__AVX__)
+#define CX_SIMD_AVX // batch kernels only
+#endif
 #endif
 #endif
 
-#ifdef CX_SIMD_NEON
+#if defined (CX_SIMD_NEON)
 #include <arm_neon.h>
+#elif defined (CX_SIMD_AVX)
+#include <immintrin.h>
+#elif defined (CX_SIMD_SSE)
+#include <emmintrin.h>
 #endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
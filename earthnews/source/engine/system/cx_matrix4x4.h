@@ -20,8 +20,10 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#ifdef CX_SIMD_NEON
+#if defined (CX_SIMD_NEON)
 #define CX_SIMD_MAT4_DECL   float32x4x4_t _q128x4;
+#elif defined (CX_SIMD_SSE)
+#define CX_SIMD_MAT4_DECL   __m128 _m128x4 [4];
 #else
 #define CX_SIMD_MAT4_DECL
 #endif
@@ -62,6 +64,8 @@ static CX_INLINE void cx_mat4x4_sub (cx_mat4x4 * CX_RESTRICT m_out, const cx_mat
 static CX_INLINE void cx_mat4x4_mul (cx_mat4x4 * CX_RESTRICT m_out, const cx_mat4x4 * CX_RESTRICT m0, const cx_mat4x4 * CX_RESTRICT m1);
 static CX_INLINE void cx_mat4x4_mul_scalar (cx_mat4x4 * CX_RESTRICT m_out, const cx_mat4x4 * CX_RESTRICT m, cxf32 scalar);
 static CX_INLINE void cx_mat4x4_mul_vec4 (cx_vec4 * CX_RESTRICT v_out, const cx_mat4x4 * CX_RESTRICT m, const cx_vec4 * CX_RESTRICT v);
+static CX_INLINE void cx_mat4x4_mul_vec4_array (cx_vec4 *v_out, const cx_mat4x4 * CX_RESTRICT m, const cx_vec4 *v, cxu32 count);
+static CX_INLINE void cx_mat4x4_mul_vec4_soa (const cx_vec4_soa *v_out, const cx_mat4x4 * CX_RESTRICT m, const cx_vec4_soa *v, cxu32 count);
 
 static CX_INLINE void cx_mat4x4_scale (cx_mat4x4 *m, cxf32 x, cxf32 y, cxf32 z);
 static CX_INLINE void cx_mat4x4_translation (cx_mat4x4 *m, cxf32 x, cxf32 y, cxf32 z);
@@ -121,6 +125,11 @@ static CX_INLINE void cx_mat4x4_zero (cx_mat4x4 *m)
   m->_q128x4.val [1] = vdupq_n_f32 (0.0f);
   m->_q128x4.val [2] = vdupq_n_f32 (0.0f);
   m->_q128x4.val [3] = vdupq_n_f32 (0.0f);
+#elif defined (CX_SIMD_SSE)
+  m->_m128x4 [0] = _mm_setzero_ps ();
+  m->_m128x4 [1] = _mm_setzero_ps ();
+  m->_m128x4 [2] = _mm_setzero_ps ();
+  m->_m128x4 [3] = _mm_setzero_ps ();
 #else
   m->f16 [0] = 0.0f;
   m->f16 [1] = 0.0f;
@@ -154,6 +163,11 @@ static CX_INLINE void cx_mat4x4_set (cx_mat4x4 *m, cxf32 f16 [16])
   m->_q128x4.val [1] = vld1q_f32 (f16 + 4);
   m->_q128x4.val [2] = vld1q_f32 (f16 + 8);
   m->_q128x4.val [3] = vld1q_f32 (f16 + 12);
+#elif defined (CX_SIMD_SSE)
+  m->_m128x4 [0] = _mm_loadu_ps (f16);
+  m->_m128x4 [1] = _mm_loadu_ps (f16 + 4);
+  m->_m128x4 [2] = _mm_loadu_ps (f16 + 8);
+  m->_m128x4 [3] = _mm_loadu_ps (f16 + 12);
 #else
   m->f16 [0] = f16 [0];
   m->f16 [1] = f16 [1];
@@ -185,6 +199,18 @@ static CX_INLINE void cx_mat4x4_transpose (cx_mat4x4 * CX_RESTRICT t, const cx_m
   
 #ifdef CX_SIMD_NEON
   t->_q128x4 = vld4q_f32 (m->f16);
+#elif defined (CX_SIMD_SSE)
+  __m128 c0 = m->_m128x4 [0];
+  __m128 c1 = m->_m128x4 [1];
+  __m128 c2 = m->_m128x4 [2];
+  __m128 c3 = m->_m128x4 [3];
+  
+  _MM_TRANSPOSE4_PS (c0, c1, c2, c3);
+  
+  t->_m128x4 [0] = c0;
+  t->_m128x4 [1] = c1;
+  t->_m128x4 [2] = c2;
+  t->_m128x4 [3] = c3;
 #else
   cxf32 m0  = m->f16 [0];
   cxf32 m1  = m->f16 [1];
@@ -274,6 +300,8 @@ static CX_INLINE void cx_mat4x4_set_column (cx_mat4x4 *m, cxi32 index, const cx_
   
 #ifdef CX_SIMD_NEON
   m->_q128x4.val [index] = col->_q128;
+#elif defined (CX_SIMD_SSE)
+  m->_m128x4 [index] = col->_m128;
 #else
   int i = index * 4;
   m->f16 [i + 0] = col->x;
@@ -295,6 +323,8 @@ static CX_INLINE void cx_mat4x4_get_column (const cx_mat4x4 *m, cxi32 index, cx_
   
 #ifdef CX_SIMD_NEON
   col->_q128 = m->_q128x4.val [index];
+#elif defined (CX_SIMD_SSE)
+  col->_m128 = m->_m128x4 [index];
 #else
   int i = index * 4;
   col->x = m->f16 [i + 0];
@@ -351,6 +381,11 @@ static CX_INLINE void cx_mat4x4_add (cx_mat4x4 * CX_RESTRICT m_out, const cx_mat
   m_out->_q128x4.val [1] = vaddq_f32 (m0->_q128x4.val [1], m1->_q128x4.val [1]);
   m_out->_q128x4.val [2] = vaddq_f32 (m0->_q128x4.val [2], m1->_q128x4.val [2]);
   m_out->_q128x4.val [3] = vaddq_f32 (m0->_q128x4.val [3], m1->_q128x4.val [3]);
+#elif defined (CX_SIMD_SSE)
+  m_out->_m128x4 [0] = _mm_add_ps (m0->_m128x4 [0], m1->_m128x4 [0]);
+  m_out->_m128x4 [1] = _mm_add_ps (m0->_m128x4 [1], m1->_m128x4 [1]);
+  m_out->_m128x4 [2] = _mm_add_ps (m0->_m128x4 [2], m1->_m128x4 [2]);
+  m_out->_m128x4 [3] = _mm_add_ps (m0->_m128x4 [3], m1->_m128x4 [3]);
 #else
   cxf32 m00 = m0->f16 [0];
   cxf32 m01 = m0->f16 [1];
@@ -420,6 +455,11 @@ static CX_INLINE void cx_mat4x4_sub (cx_mat4x4 * CX_RESTRICT m_out, const cx_mat
   m_out->_q128x4.val [1] = vsubq_f32 (m0->_q128x4.val [1], m1->_q128x4.val [1]);
   m_out->_q128x4.val [2] = vsubq_f32 (m0->_q128x4.val [2], m1->_q128x4.val [2]);
   m_out->_q128x4.val [3] = vsubq_f32 (m0->_q128x4.val [3], m1->_q128x4.val [3]);
+#elif defined (CX_SIMD_SSE)
+  m_out->_m128x4 [0] = _mm_sub_ps (m0->_m128x4 [0], m1->_m128x4 [0]);
+  m_out->_m128x4 [1] = _mm_sub_ps (m0->_m128x4 [1], m1->_m128x4 [1]);
+  m_out->_m128x4 [2] = _mm_sub_ps (m0->_m128x4 [2], m1->_m128x4 [2]);
+  m_out->_m128x4 [3] = _mm_sub_ps (m0->_m128x4 [3], m1->_m128x4 [3]);
 #else
   cxf32 m00 = m0->f16 [0];
   cxf32 m01 = m0->f16 [1];
@@ -557,6 +597,24 @@ static CX_INLINE void cx_mat4x4_mul (cx_mat4x4 * CX_RESTRICT m_out, const cx_mat
   m_out->_q128x4.val [3] = _q128x43;
 #endif
   
+#elif defined (CX_SIMD_SSE)
+  __m128 c0 = m0->_m128x4 [0];
+  __m128 c1 = m0->_m128x4 [1];
+  __m128 c2 = m0->_m128x4 [2];
+  __m128 c3 = m0->_m128x4 [3];
+  
+  for (int i = 0; i < 4; ++i)
+  {
+    const cxf32 *f = m1->f16 + (i * 4);
+    
+    __m128 r = _mm_mul_ps (c0, _mm_set1_ps (f [0]));
+    r = _mm_add_ps (r, _mm_mul_ps (c1, _mm_set1_ps (f [1])));
+    r = _mm_add_ps (r, _mm_mul_ps (c2, _mm_set1_ps (f [2])));
+    r = _mm_add_ps (r, _mm_mul_ps (c3, _mm_set1_ps (f [3])));
+    
+    m_out->_m128x4 [i] = r;
+  }
+  
 #else
   /* consume inputs - helps prevent against aliasing */
   
@@ -633,6 +691,12 @@ static CX_INLINE void cx_mat4x4_mul_scalar (cx_mat4x4 * CX_RESTRICT m_out, const
   m_out->_q128x4.val [1] = vmulq_n_f32 (m->_q128x4.val [1], scalar);
   m_out->_q128x4.val [2] = vmulq_n_f32 (m->_q128x4.val [2], scalar);
   m_out->_q128x4.val [3] = vmulq_n_f32 (m->_q128x4.val [3], scalar);
+#elif defined (CX_SIMD_SSE)
+  __m128 s = _mm_set1_ps (scalar);
+  m_out->_m128x4 [0] = _mm_mul_ps (m->_m128x4 [0], s);
+  m_out->_m128x4 [1] = _mm_mul_ps (m->_m128x4 [1], s);
+  m_out->_m128x4 [2] = _mm_mul_ps (m->_m128x4 [2], s);
+  m_out->_m128x4 [3] = _mm_mul_ps (m->_m128x4 [3], s);
 #else
   m_out->f16 [0]  = m->f16 [0] * scalar;
   m_out->f16 [1]  = m->f16 [1] * scalar;
@@ -677,6 +741,13 @@ static CX_INLINE void cx_mat4x4_mul_vec4 (cx_vec4 * CX_RESTRICT v_out, const cx_
   m4x43 = vmulq_n_f32 (m->_q128x4.val [3], vw);
 
   v_out->_q128 = vaddq_f32 (vaddq_f32 (m4x40, m4x41), vaddq_f32 (m4x42, m4x43));
+#elif defined (CX_SIMD_SSE)
+  __m128 r = _mm_mul_ps (m->_m128x4 [0], _mm_set1_ps (vx));
+  r = _mm_add_ps (r, _mm_mul_ps (m->_m128x4 [1], _mm_set1_ps (vy)));
+  r = _mm_add_ps (r, _mm_mul_ps (m->_m128x4 [2], _mm_set1_ps (vz)));
+  r = _mm_add_ps (r, _mm_mul_ps (m->_m128x4 [3], _mm_set1_ps (vw)));
+  
+  v_out->_m128 = r;
 #else
   cxf32 m00 = m->f16 [0];
   cxf32 m01 = m->f16 [1];
@@ -706,6 +777,160 @@ static CX_INLINE void cx_mat4x4_mul_vec4 (cx_vec4 * CX_RESTRICT v_out, const cx_
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+static CX_INLINE void cx_mat4x4_mul_vec4_array (cx_vec4 *v_out, const cx_mat4x4 * CX_RESTRICT m, const cx_vec4 *v, cxu32 count)
+{
+  CX_ASSERT (v_out);
+  CX_ASSERT (m);
+  CX_ASSERT (v);
+  
+  // v_out may be v (in-place transform)
+  
+  cxu32 i = 0;
+  
+#if defined (CX_SIMD_AVX)
+  __m256 c0 = _mm256_broadcast_ps (&m->_m128x4 [0]);
+  __m256 c1 = _mm256_broadcast_ps (&m->_m128x4 [1]);
+  __m256 c2 = _mm256_broadcast_ps (&m->_m128x4 [2]);
+  __m256 c3 = _mm256_broadcast_ps (&m->_m128x4 [3]);
+  
+  for (; (i + 2) <= count; i += 2)
+  {
+    __m256 p = _mm256_loadu_ps (v [i].f4);
+    
+    __m256 r = _mm256_mul_ps (c0, _mm256_permute_ps (p, _MM_SHUFFLE (0, 0, 0, 0)));
+    r = _mm256_add_ps (r, _mm256_mul_ps (c1, _mm256_permute_ps (p, _MM_SHUFFLE (1, 1, 1, 1))));
+    r = _mm256_add_ps (r, _mm256_mul_ps (c2, _mm256_permute_ps (p, _MM_SHUFFLE (2, 2, 2, 2))));
+    r = _mm256_add_ps (r, _mm256_mul_ps (c3, _mm256_permute_ps (p, _MM_SHUFFLE (3, 3, 3, 3))));
+    
+    _mm256_storeu_ps (v_out [i].f4, r);
+  }
+#endif
+  
+#if defined (CX_SIMD_SSE)
+  __m128 q0 = m->_m128x4 [0];
+  __m128 q1 = m->_m128x4 [1];
+  __m128 q2 = m->_m128x4 [2];
+  __m128 q3 = m->_m128x4 [3];
+  
+  for (; i < count; ++i)
+  {
+    __m128 p = v [i]._m128;
+    
+    __m128 r = _mm_mul_ps (q0, _mm_shuffle_ps (p, p, _MM_SHUFFLE (0, 0, 0, 0)));
+    r = _mm_add_ps (r, _mm_mul_ps (q1, _mm_shuffle_ps (p, p, _MM_SHUFFLE (1, 1, 1, 1))));
+    r = _mm_add_ps (r, _mm_mul_ps (q2, _mm_shuffle_ps (p, p, _MM_SHUFFLE (2, 2, 2, 2))));
+    r = _mm_add_ps (r, _mm_mul_ps (q3, _mm_shuffle_ps (p, p, _MM_SHUFFLE (3, 3, 3, 3))));
+    
+    v_out [i]._m128 = r;
+  }
+#else
+  for (; i < count; ++i)
+  {
+    cx_vec4 p = v [i];
+    
+    cx_mat4x4_mul_vec4 (&v_out [i], m, &p);
+  }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE void cx_mat4x4_mul_vec4_soa (const cx_vec4_soa *v_out, const cx_mat4x4 * CX_RESTRICT m, const cx_vec4_soa *v, cxu32 count)
+{
+  CX_ASSERT (v_out);
+  CX_ASSERT (m);
+  CX_ASSERT (v);
+  
+  // v_out streams may be the same as v streams (in-place transform)
+  
+  const cxf32 *f = m->f16;
+  
+  cxu32 i = 0;
+  
+#if defined (CX_SIMD_AVX)
+  for (; (i + 8) <= count; i += 8)
+  {
+    __m256 x = _mm256_loadu_ps (v->x + i);
+    __m256 y = _mm256_loadu_ps (v->y + i);
+    __m256 z = _mm256_loadu_ps (v->z + i);
+    __m256 w = _mm256_loadu_ps (v->w + i);
+    
+    for (int r = 0; r < 4; ++r)
+    {
+      __m256 o = _mm256_mul_ps (_mm256_set1_ps (f [r]), x);
+      o = _mm256_add_ps (o, _mm256_mul_ps (_mm256_set1_ps (f [r + 4]), y));
+      o = _mm256_add_ps (o, _mm256_mul_ps (_mm256_set1_ps (f [r + 8]), z));
+      o = _mm256_add_ps (o, _mm256_mul_ps (_mm256_set1_ps (f [r + 12]), w));
+      
+      cxf32 *dst = (r == 0) ? v_out->x : (r == 1) ? v_out->y : (r == 2) ? v_out->z : v_out->w;
+      
+      _mm256_storeu_ps (dst + i, o);
+    }
+  }
+#endif
+  
+#if defined (CX_SIMD_SSE)
+  for (; (i + 4) <= count; i += 4)
+  {
+    __m128 x = _mm_loadu_ps (v->x + i);
+    __m128 y = _mm_loadu_ps (v->y + i);
+    __m128 z = _mm_loadu_ps (v->z + i);
+    __m128 w = _mm_loadu_ps (v->w + i);
+    
+    for (int r = 0; r < 4; ++r)
+    {
+      __m128 o = _mm_mul_ps (_mm_set1_ps (f [r]), x);
+      o = _mm_add_ps (o, _mm_mul_ps (_mm_set1_ps (f [r + 4]), y));
+      o = _mm_add_ps (o, _mm_mul_ps (_mm_set1_ps (f [r + 8]), z));
+      o = _mm_add_ps (o, _mm_mul_ps (_mm_set1_ps (f [r + 12]), w));
+      
+      cxf32 *dst = (r == 0) ? v_out->x : (r == 1) ? v_out->y : (r == 2) ? v_out->z : v_out->w;
+      
+      _mm_storeu_ps (dst + i, o);
+    }
+  }
+#elif defined (CX_SIMD_NEON)
+  for (; (i + 4) <= count; i += 4)
+  {
+    float32x4_t x = vld1q_f32 (v->x + i);
+    float32x4_t y = vld1q_f32 (v->y + i);
+    float32x4_t z = vld1q_f32 (v->z + i);
+    float32x4_t w = vld1q_f32 (v->w + i);
+    
+    for (int r = 0; r < 4; ++r)
+    {
+      float32x4_t o = vmulq_n_f32 (x, f [r]);
+      o = vmlaq_n_f32 (o, y, f [r + 4]);
+      o = vmlaq_n_f32 (o, z, f [r + 8]);
+      o = vmlaq_n_f32 (o, w, f [r + 12]);
+      
+      cxf32 *dst = (r == 0) ? v_out->x : (r == 1) ? v_out->y : (r == 2) ? v_out->z : v_out->w;
+      
+      vst1q_f32 (dst + i, o);
+    }
+  }
+#endif
+  
+  for (; i < count; ++i)
+  {
+    cxf32 vx = v->x [i];
+    cxf32 vy = v->y [i];
+    cxf32 vz = v->z [i];
+    cxf32 vw = v->w [i];
+    
+    v_out->x [i] = (f [0] * vx) + (f [4] * vy) + (f [8] * vz) + (f [12] * vw);
+    v_out->y [i] = (f [1] * vx) + (f [5] * vy) + (f [9] * vz) + (f [13] * vw);
+    v_out->z [i] = (f [2] * vx) + (f [6] * vy) + (f [10] * vz) + (f [14] * vw);
+    v_out->w [i] = (f [3] * vx) + (f [7] * vy) + (f [11] * vz) + (f [15] * vw);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static CX_INLINE void cx_mat4x4_scale (cx_mat4x4 *m, cxf32 x, cxf32 y, cxf32 z)
 {
   CX_ASSERT (m);
@@ -0,0 +1,294 @@
+//
+//  cx_native_linux.c
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#include "cx_native_ios.h"
+#include "cx_native_linux.h"
+#include "cx_string.h"
+#include "../graphics/cx_opengl.h"
+#include <EGL/egl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct cx_native_offscreen
+{
+  EGLDisplay display;
+  EGLConfig config;
+  EGLSurface surface;
+  EGLContext context;
+} cx_native_offscreen;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_native_file_get_path (char *dstPath, cxu32 dstSize, const char *var, const char *fallback)
+{
+  CX_ASSERT (dstPath);
+  
+  const char *path = getenv (var);
+  
+  cx_strcpy (dstPath, dstSize, path ? path : fallback);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_file_get_resource_path (char *dstPath, cxu32 dstSize)
+{
+  CX_ASSERT (dstPath);
+  
+  if (getenv ("CX_RESOURCE_PATH") || !getcwd (dstPath, dstSize))
+  {
+    cx_native_file_get_path (dstPath, dstSize, "CX_RESOURCE_PATH", ".");
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_file_get_cache_path (char *dstPath, cxu32 dstSize)
+{
+  cx_native_file_get_path (dstPath, dstSize, "CX_CACHE_PATH", "/tmp");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_file_get_documents_path (char *dstPath, cxu32 dstSize)
+{
+  cx_native_file_get_path (dstPath, dstSize, "CX_DOCUMENTS_PATH", "/tmp");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// gl context
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_native_offscreen *g_offscreen = NULL;
+
+static __thread EGLContext g_threadContext = EGL_NO_CONTEXT;
+static __thread EGLSurface g_threadSurface = EGL_NO_SURFACE;
+
+// libGLESv2 only exports core entry points
+
+static PFNGLGENVERTEXARRAYSOESPROC g_glGenVertexArraysOES = NULL;
+static PFNGLBINDVERTEXARRAYOESPROC g_glBindVertexArrayOES = NULL;
+static PFNGLDELETEVERTEXARRAYSOESPROC g_glDeleteVertexArraysOES = NULL;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void *cx_native_offscreen_context_create (cxi32 width, cxi32 height)
+{
+  CX_ASSERT (width > 0);
+  CX_ASSERT (height > 0);
+  
+  EGLDisplay display = eglGetDisplay (EGL_DEFAULT_DISPLAY);
+  
+  if ((display == EGL_NO_DISPLAY) || !eglInitialize (display, NULL, NULL))
+  {
+    CX_LOG_CONSOLE (1, "cx_native_offscreen_context_create: no egl display (try EGL_PLATFORM=surfaceless)");
+    return NULL;
+  }
+  
+  eglBindAPI (EGL_OPENGL_ES_API);
+  
+  // matches the app's GLKView drawable (rgba8, 16 bit depth)
+  
+  const EGLint configAttribs [] =
+  {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 16,
+    EGL_NONE
+  };
+  
+  const EGLint surfaceAttribs [] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+  const EGLint contextAttribs [] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+  
+  EGLConfig config;
+  EGLint numConfigs = 0;
+  
+  if (!eglChooseConfig (display, configAttribs, &config, 1, &numConfigs) || (numConfigs < 1))
+  {
+    CX_LOG_CONSOLE (1, "cx_native_offscreen_context_create: no es2 pbuffer config");
+    eglTerminate (display);
+    return NULL;
+  }
+  
+  EGLSurface surface = eglCreatePbufferSurface (display, config, surfaceAttribs);
+  EGLContext context = eglCreateContext (display, config, EGL_NO_CONTEXT, contextAttribs);
+  
+  if ((surface == EGL_NO_SURFACE) || (context == EGL_NO_CONTEXT))
+  {
+    CX_LOG_CONSOLE (1, "cx_native_offscreen_context_create: egl error 0x%x", eglGetError ());
+    
+    if (surface != EGL_NO_SURFACE)
+    {
+      eglDestroySurface (display, surface);
+    }
+    
+    eglTerminate (display);
+    return NULL;
+  }
+  
+  cx_native_offscreen *offscreen = (cx_native_offscreen *) cx_malloc (sizeof (cx_native_offscreen));
+  
+  offscreen->display = display;
+  offscreen->config = config;
+  offscreen->surface = surface;
+  offscreen->context = context;
+  
+  // current from here on, as the app's context is before cx_engine_init compiles the built-in shaders
+  eglMakeCurrent (display, surface, surface, context);
+  
+  return offscreen;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_offscreen_context_destroy (void *context)
+{
+  CX_ASSERT (context);
+  CX_ASSERT (context != g_offscreen);
+  
+  cx_native_offscreen *offscreen = (cx_native_offscreen *) context;
+  
+  eglDestroyContext (offscreen->display, offscreen->context);
+  eglDestroySurface (offscreen->display, offscreen->surface);
+  eglTerminate (offscreen->display);
+  
+  cx_free (offscreen);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_eagl_context_init (void *eaglContext)
+{
+  CX_ASSERT (eaglContext);
+  CX_ASSERT (!g_offscreen);
+  
+  g_offscreen = (cx_native_offscreen *) eaglContext;
+  
+  EGLBoolean current = eglMakeCurrent (g_offscreen->display, g_offscreen->surface, g_offscreen->surface, g_offscreen->context);
+  CX_FATAL_ASSERT (current); CX_REF_UNUSED (current);
+  
+  g_glGenVertexArraysOES = (PFNGLGENVERTEXARRAYSOESPROC) eglGetProcAddress ("glGenVertexArraysOES");
+  g_glBindVertexArrayOES = (PFNGLBINDVERTEXARRAYOESPROC) eglGetProcAddress ("glBindVertexArrayOES");
+  g_glDeleteVertexArraysOES = (PFNGLDELETEVERTEXARRAYSOESPROC) eglGetProcAddress ("glDeleteVertexArraysOES");
+  
+  CX_FATAL_ASSERT (g_glGenVertexArraysOES && g_glBindVertexArrayOES && g_glDeleteVertexArraysOES);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_eagl_context_deinit (void)
+{
+  CX_ASSERT (g_offscreen);
+  
+  eglMakeCurrent (g_offscreen->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  
+  g_offscreen = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_eagl_context_add (void)
+{
+  CX_ASSERT (g_offscreen);
+  CX_ASSERT (g_threadContext == EGL_NO_CONTEXT);
+  
+  // shares objects with the offscreen context, the surface is only there to make it current
+  
+  const EGLint surfaceAttribs [] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+  const EGLint contextAttribs [] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+  
+  g_threadSurface = eglCreatePbufferSurface (g_offscreen->display, g_offscreen->config, surfaceAttribs);
+  g_threadContext = eglCreateContext (g_offscreen->display, g_offscreen->config, g_offscreen->context, contextAttribs);
+  
+  CX_ASSERT (g_threadSurface != EGL_NO_SURFACE);
+  CX_ASSERT (g_threadContext != EGL_NO_CONTEXT);
+  
+  eglMakeCurrent (g_offscreen->display, g_threadSurface, g_threadSurface, g_threadContext);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_native_eagl_context_remove (void)
+{
+  CX_ASSERT (g_offscreen);
+  
+  eglMakeCurrent (g_offscreen->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  
+  if (g_threadContext != EGL_NO_CONTEXT)
+  {
+    eglDestroyContext (g_offscreen->display, g_threadContext);
+    eglDestroySurface (g_offscreen->display, g_threadSurface);
+    
+    g_threadContext = EGL_NO_CONTEXT;
+    g_threadSurface = EGL_NO_SURFACE;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+// oes extensions
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GL_APICALL void GL_APIENTRY glGenVertexArraysOES (GLsizei n, GLuint *arrays)
+{
+  g_glGenVertexArraysOES (n, arrays);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GL_APICALL void GL_APIENTRY glBindVertexArrayOES (GLuint array)
+{
+  g_glBindVertexArrayOES (array);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+GL_APICALL void GL_APIENTRY glDeleteVertexArraysOES (GLsizei n, const GLuint *arrays)
+{
+  g_glDeleteVertexArraysOES (n, arrays);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
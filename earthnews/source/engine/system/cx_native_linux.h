@@ -0,0 +1,35 @@
+//
+//  cx_native_linux.h
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#ifndef CX_NATIVE_LINUX_H
+#define CX_NATIVE_LINUX_H
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "cx_system.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// headless linux backend for cx_native_ios.h. cx_native_linux.c implements the same file and
+// context functions, rendering goes to an egl pbuffer (mesa llvmpipe with EGL_PLATFORM=surfaceless).
+//
+// the offscreen context stands in for the app's EAGLContext: it is current once created, pass it as
+// the graphics context of cx_engine_init. resource paths are relative to CX_RESOURCE_PATH (or the
+// working directory), documents and cache go to CX_DOCUMENTS_PATH and CX_CACHE_PATH (or /tmp).
+
+void *cx_native_offscreen_context_create (cxi32 width, cxi32 height);
+
+void cx_native_offscreen_context_destroy (void *context);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
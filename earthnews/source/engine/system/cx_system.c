@@ -5,13 +5,87 @@
 //
 
 #include "cx_system.h"
+#include <pthread.h>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define CX_SYSTEM_MEMORY_SIZE_ALIGN (4)
-#define CX_MALLOC_STD_C 1
+#define CX_SYSTEM_MEMORY_SIZE_ALIGN         (16)
+#define CX_SYSTEM_MEMORY_CHUNK_SIZE         (64 * 1024)
+#define CX_SYSTEM_MEMORY_SIZE_CLASS_MAX     (2048)
+#define CX_SYSTEM_MEMORY_SIZE_CLASS_LARGE   (0xffff)
+#define CX_SYSTEM_MEMORY_BATCH_MIN          (4)
+#define CX_SYSTEM_MEMORY_BATCH_MAX          (64)
+
+#define CX_SYSTEM_MEMORY_MAGIC_ALLOC        (0xA110CA7Eu)
+#define CX_SYSTEM_MEMORY_MAGIC_FREE         (0xF4EEB10Cu)
+#define CX_SYSTEM_MEMORY_GUARD_WORD         (0xFDFDFDFDu)
+#define CX_SYSTEM_MEMORY_FILL_ALLOC         (0xDEADBEEFu)
+#define CX_SYSTEM_MEMORY_FILL_FREE          (0xFEEEFEEEu)
+
+#if CX_SYSTEM_MEMORY_DEBUG_GUARD
+#define CX_SYSTEM_MEMORY_GUARD_SIZE         (sizeof (cxu32))
+#else
+#define CX_SYSTEM_MEMORY_GUARD_SIZE         (0)
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+
+// every block (pooled or large) is preceded by a header. header is 16 bytes so that
+// returned memory keeps the 16 byte alignment that cx_vec4 and cx_mat4x4 rely on.
+
+typedef struct cx_mem_header
+{
+  cxu32 size;
+  cxu16 sizeClass;
+  cxu16 reserved;
+  cxu32 magic;
+  cxu32 pad;
+} cx_mem_header;
+
+typedef struct cx_mem_block
+{
+  struct cx_mem_block *next;
+} cx_mem_block;
+
+typedef struct cx_mem_chunk
+{
+  struct cx_mem_chunk *next;
+  cxu8 pad [CX_SYSTEM_MEMORY_SIZE_ALIGN - sizeof (struct cx_mem_chunk *)];
+} cx_mem_chunk;
+
+typedef struct cx_mem_size_class
+{
+  cxu32 blockSize;
+  cxu32 batchSize;
+  cxu32 blocksReserved;
+  cxu32 freeCount;
+  cx_mem_block *freeList;
+  cxu8 *chunkCursor;
+  cxu8 *chunkEnd;
+} cx_mem_size_class;
+
+typedef struct cx_mem_thread_bin
+{
+  cx_mem_block *freeList;
+  cxu32 freeCount;
+  cxu64 allocCount;
+  cxi64 blocksInUse;
+} cx_mem_thread_bin;
+
+typedef struct cx_mem_thread_cache
+{
+  cx_mem_thread_bin bins [CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES];
+  struct cx_mem_thread_cache *next;
+  struct cx_mem_thread_cache *prev;
+} cx_mem_thread_cache;
+
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -19,14 +93,91 @@
 
 static bool g_initialised = false;
 
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+
+static const cxu32 g_sizeClassSizes [CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES] =
+{
+  16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048
+};
+
+static cxu8 g_sizeClassLookup [(CX_SYSTEM_MEMORY_SIZE_CLASS_MAX / CX_SYSTEM_MEMORY_SIZE_ALIGN) + 1];
+
+static cx_mem_size_class g_sizeClasses [CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES];
+static cx_mem_chunk *g_chunks = NULL;
+static cx_mem_thread_cache *g_threadCaches = NULL;
+static cx_mem_thread_bin g_retiredBins [CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES]; // stats of exited threads
+static pthread_mutex_t g_memoryMutex;
+static pthread_key_t g_threadCacheKey;
+
+static volatile cxu64 g_bytesInUse = 0;
+static volatile cxu64 g_bytesPeak = 0;
+static volatile cxu64 g_bytesLarge = 0;
+static volatile cxu64 g_largeAllocCount = 0;
+
+static cxu64 g_statsPrevAllocCount [CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES];
+static cxf64 g_statsPrevTime = 0.0;
+
+#endif
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void cx_system_memory_init (void)    
-{ 
+#if CX_SYSTEM_MEMORY_DEBUG_FILL
+static void *cx_malloc_memset (void *data, cxu32 fill, cxu32 size);
+#endif
+
 #if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
-  CX_ERROR ("cx_system_memory_init: NOT YET IMPLEMENTED!");
+static void cx_system_memory_thread_cache_destroy (void *data);
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_init (void)
+{
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+  CX_ASSERT ((sizeof (cx_mem_header) % CX_SYSTEM_MEMORY_SIZE_ALIGN) == 0);
+  CX_ASSERT ((sizeof (cx_mem_chunk) % CX_SYSTEM_MEMORY_SIZE_ALIGN) == 0);
+  
+  memset (g_sizeClasses, 0, sizeof (g_sizeClasses));
+  memset (g_retiredBins, 0, sizeof (g_retiredBins));
+  memset (g_statsPrevAllocCount, 0, sizeof (g_statsPrevAllocCount));
+  
+  cxu32 lookup = 0;
+  
+  for (cxu32 i = 0; i < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES; ++i)
+  {
+    cx_mem_size_class *sc = &g_sizeClasses [i];
+    
+    cxu32 blockSize = g_sizeClassSizes [i];
+    cxu32 blocksPerChunk = (CX_SYSTEM_MEMORY_CHUNK_SIZE - sizeof (cx_mem_chunk)) / (blockSize + sizeof (cx_mem_header));
+    cxu32 batchSize = blocksPerChunk / 4;
+    
+    batchSize = (batchSize < CX_SYSTEM_MEMORY_BATCH_MIN) ? CX_SYSTEM_MEMORY_BATCH_MIN : batchSize;
+    batchSize = (batchSize > CX_SYSTEM_MEMORY_BATCH_MAX) ? CX_SYSTEM_MEMORY_BATCH_MAX : batchSize;
+    
+    sc->blockSize = blockSize;
+    sc->batchSize = batchSize;
+    
+    // size -> size class lookup in 16 byte steps
+    
+    while ((lookup * CX_SYSTEM_MEMORY_SIZE_ALIGN) <= blockSize)
+    {
+      g_sizeClassLookup [lookup++] = (cxu8) i;
+    }
+  }
+  
+  g_chunks = NULL;
+  g_threadCaches = NULL;
+  g_bytesInUse = 0;
+  g_bytesPeak = 0;
+  g_bytesLarge = 0;
+  g_largeAllocCount = 0;
+  
+  pthread_mutex_init (&g_memoryMutex, NULL);
+  pthread_key_create (&g_threadCacheKey, cx_system_memory_thread_cache_destroy);
 #endif
 }
 
@@ -34,10 +185,41 @@ static void cx_system_memory_init (void)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void cx_system_memory_deinit (void)  
-{ 
+static void cx_system_memory_deinit (void)
+{
 #if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
-  CX_ERROR ("cx_system_memory_deinit: NOT YET IMPLEMENTED!");
+  // thread cache destructors must not run after chunks are released
+  
+  pthread_key_delete (g_threadCacheKey);
+  
+  pthread_mutex_lock (&g_memoryMutex);
+  
+  cx_mem_thread_cache *cache = g_threadCaches;
+  
+  while (cache)
+  {
+    cx_mem_thread_cache *next = cache->next;
+    free (cache);
+    cache = next;
+  }
+  
+  cx_mem_chunk *chunk = g_chunks;
+  
+  while (chunk)
+  {
+    cx_mem_chunk *next = chunk->next;
+    free (chunk);
+    chunk = next;
+  }
+  
+  g_threadCaches = NULL;
+  g_chunks = NULL;
+  
+  memset (g_sizeClasses, 0, sizeof (g_sizeClasses));
+  
+  pthread_mutex_unlock (&g_memoryMutex);
+  
+  pthread_mutex_destroy (&g_memoryMutex);
 #endif
 }
 
@@ -45,7 +227,225 @@ static void cx_system_memory_deinit (void)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-static void *cx_malloc_memset (void *data, cxu32 fill, cxu32 size);
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+
+static cx_mem_thread_cache *cx_system_memory_thread_cache (void)
+{
+  cx_mem_thread_cache *cache = (cx_mem_thread_cache *) pthread_getspecific (g_threadCacheKey);
+  
+  if (!cache)
+  {
+    cache = (cx_mem_thread_cache *) calloc (1, sizeof (cx_mem_thread_cache));
+    CX_FATAL_ASSERT (cache);
+    
+    pthread_mutex_lock (&g_memoryMutex);
+    
+    cache->prev = NULL;
+    cache->next = g_threadCaches;
+    
+    if (g_threadCaches)
+    {
+      g_threadCaches->prev = cache;
+    }
+    
+    g_threadCaches = cache;
+    
+    pthread_mutex_unlock (&g_memoryMutex);
+    
+    pthread_setspecific (g_threadCacheKey, cache);
+  }
+  
+  return cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_thread_cache_destroy (void *data)
+{
+  // called on thread exit: hand cached blocks back to the global pool
+  
+  cx_mem_thread_cache *cache = (cx_mem_thread_cache *) data;
+  CX_ASSERT (cache);
+  
+  pthread_mutex_lock (&g_memoryMutex);
+  
+  for (cxu32 i = 0; i < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES; ++i)
+  {
+    cx_mem_thread_bin *bin = &cache->bins [i];
+    cx_mem_size_class *sc = &g_sizeClasses [i];
+    
+    while (bin->freeList)
+    {
+      cx_mem_block *block = bin->freeList;
+      bin->freeList = block->next;
+      
+      block->next = sc->freeList;
+      sc->freeList = block;
+      sc->freeCount++;
+    }
+    
+    g_retiredBins [i].allocCount += bin->allocCount;
+    g_retiredBins [i].blocksInUse += bin->blocksInUse;
+  }
+  
+  if (cache->prev)
+  {
+    cache->prev->next = cache->next;
+  }
+  else
+  {
+    g_threadCaches = cache->next;
+  }
+  
+  if (cache->next)
+  {
+    cache->next->prev = cache->prev;
+  }
+  
+  pthread_mutex_unlock (&g_memoryMutex);
+  
+  free (cache);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_refill (cx_mem_thread_bin *bin, cxu32 sizeClass)
+{
+  CX_ASSERT (bin);
+  CX_ASSERT (sizeClass < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES);
+  
+  cx_mem_size_class *sc = &g_sizeClasses [sizeClass];
+  
+  cxu32 stride = sc->blockSize + sizeof (cx_mem_header);
+  
+  pthread_mutex_lock (&g_memoryMutex);
+  
+  for (cxu32 i = 0; i < sc->batchSize; ++i)
+  {
+    cx_mem_block *block = sc->freeList;
+    
+    if (block)
+    {
+      sc->freeList = block->next;
+      sc->freeCount--;
+    }
+    else
+    {
+      if ((sc->chunkCursor + stride) > sc->chunkEnd)
+      {
+        cx_mem_chunk *chunk = (cx_mem_chunk *) malloc (CX_SYSTEM_MEMORY_CHUNK_SIZE);
+        CX_FATAL_ASSERT (chunk);
+        
+        chunk->next = g_chunks;
+        g_chunks = chunk;
+        
+        sc->chunkCursor = (cxu8 *) (chunk + 1);
+        sc->chunkEnd = ((cxu8 *) chunk) + CX_SYSTEM_MEMORY_CHUNK_SIZE;
+      }
+      
+      block = (cx_mem_block *) sc->chunkCursor;
+      sc->chunkCursor += stride;
+      sc->blocksReserved++;
+    }
+    
+    block->next = bin->freeList;
+    bin->freeList = block;
+    bin->freeCount++;
+  }
+  
+  pthread_mutex_unlock (&g_memoryMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_release (cx_mem_thread_bin *bin, cxu32 sizeClass)
+{
+  CX_ASSERT (bin);
+  CX_ASSERT (sizeClass < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES);
+  
+  cx_mem_size_class *sc = &g_sizeClasses [sizeClass];
+  
+  pthread_mutex_lock (&g_memoryMutex);
+  
+  for (cxu32 i = 0; (i < sc->batchSize) && bin->freeList; ++i)
+  {
+    cx_mem_block *block = bin->freeList;
+    bin->freeList = block->next;
+    bin->freeCount--;
+    
+    block->next = sc->freeList;
+    sc->freeList = block;
+    sc->freeCount++;
+  }
+  
+  pthread_mutex_unlock (&g_memoryMutex);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_set_guard (cx_mem_header *header)
+{
+#if CX_SYSTEM_MEMORY_DEBUG_GUARD
+  cxu32 guard = CX_SYSTEM_MEMORY_GUARD_WORD;
+  cxu8 *tail = ((cxu8 *) (header + 1)) + header->size;
+  memcpy (tail, &guard, sizeof (guard));
+#else
+  CX_REF_UNUSED (header);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_check_guard (const cx_mem_header *header)
+{
+  CX_ASSERT (header->magic != CX_SYSTEM_MEMORY_MAGIC_FREE); // double free
+  CX_ASSERT (header->magic == CX_SYSTEM_MEMORY_MAGIC_ALLOC); // underrun or foreign pointer
+  
+#if CX_SYSTEM_MEMORY_DEBUG_GUARD
+  cxu32 guard = 0;
+  const cxu8 *tail = ((const cxu8 *) (header + 1)) + header->size;
+  memcpy (&guard, tail, sizeof (guard));
+  CX_ASSERT (guard == CX_SYSTEM_MEMORY_GUARD_WORD); // overrun
+#else
+  CX_REF_UNUSED (header);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_system_memory_add_bytes (cxu64 size)
+{
+  // 64-bit loads aren't atomic on armv7, so peak is only read through the atomics
+  
+  cxu64 inUse = __sync_add_and_fetch (&g_bytesInUse, size);
+  cxu64 peak = __sync_fetch_and_add (&g_bytesPeak, 0);
+  
+  while (inUse > peak)
+  {
+    cxu64 prev = __sync_val_compare_and_swap (&g_bytesPeak, peak, inUse);
+    
+    if (prev == peak)
+    {
+      break;
+    }
+    
+    peak = prev;
+  }
+}
+
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -82,31 +482,129 @@ void *_cx_malloc (size_t size)
 {
   CX_ASSERT (g_initialised);
   
-#if 0
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
   
-  void *block = malloc (size);
+  CX_ASSERT (size < 0xffffffff);
   
-  memset (block, 0, size);
+  size_t blockSize = size + CX_SYSTEM_MEMORY_GUARD_SIZE;
   
-  CX_FATAL_ASSERT (block);
+  cx_mem_header *header = NULL;
+  
+  if (blockSize <= CX_SYSTEM_MEMORY_SIZE_CLASS_MAX)
+  {
+    cxu32 sizeClass = g_sizeClassLookup [(blockSize + CX_SYSTEM_MEMORY_SIZE_ALIGN - 1) / CX_SYSTEM_MEMORY_SIZE_ALIGN];
+    
+    cx_mem_thread_cache *cache = cx_system_memory_thread_cache ();
+    cx_mem_thread_bin *bin = &cache->bins [sizeClass];
+    
+    if (!bin->freeList)
+    {
+      cx_system_memory_refill (bin, sizeClass);
+    }
+    
+    cx_mem_block *block = bin->freeList;
+    CX_FATAL_ASSERT (block);
+    
+    bin->freeList = block->next;
+    bin->freeCount--;
+    bin->allocCount++;
+    bin->blocksInUse++;
+    
+    header = (cx_mem_header *) block;
+    header->sizeClass = (cxu16) sizeClass;
+  }
+  else
+  {
+    header = (cx_mem_header *) malloc (sizeof (cx_mem_header) + blockSize);
+    CX_FATAL_ASSERT (header);
+    
+    header->sizeClass = CX_SYSTEM_MEMORY_SIZE_CLASS_LARGE;
+    
+    __sync_add_and_fetch (&g_bytesLarge, (cxu64) blockSize);
+    __sync_add_and_fetch (&g_largeAllocCount, 1);
+  }
+  
+  header->size = (cxu32) size;
+  header->magic = CX_SYSTEM_MEMORY_MAGIC_ALLOC;
+  
+  void *block = header + 1;
+  
+#if CX_SYSTEM_MEMORY_DEBUG_FILL
+  cx_malloc_memset (block, CX_SYSTEM_MEMORY_FILL_ALLOC, (cxu32) size);
+#endif
+  
+  cx_system_memory_set_guard (header);
+  cx_system_memory_add_bytes ((cxu64) size);
   
   return block;
   
 #else
   
-  int pad = (CX_SYSTEM_MEMORY_SIZE_ALIGN - (size % CX_SYSTEM_MEMORY_SIZE_ALIGN));
+  void *block = malloc (size);
   
-  int allocsize = size + pad;
+  CX_FATAL_ASSERT (block);
   
-  void *block = malloc (allocsize);
+#if CX_SYSTEM_MEMORY_DEBUG_FILL
+  cx_malloc_memset (block, CX_SYSTEM_MEMORY_FILL_ALLOC, (cxu32) size);
+#endif
+  
+  return block;
   
-#if (CX_DEBUG || 1)
-  cx_malloc_memset (block, 0xDEADBEEF, allocsize);
 #endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void *_cx_realloc (void *data, size_t size)
+{
+  CX_ASSERT (g_initialised);
+  
+  if (!data)
+  {
+    return _cx_malloc (size);
+  }
+  
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+  
+  cx_mem_header *header = ((cx_mem_header *) data) - 1;
+  
+  cx_system_memory_check_guard (header);
+  
+  size_t blockSize = size + CX_SYSTEM_MEMORY_GUARD_SIZE;
+  
+  if ((header->sizeClass != CX_SYSTEM_MEMORY_SIZE_CLASS_LARGE) &&
+      (blockSize <= g_sizeClasses [header->sizeClass].blockSize))
+  {
+    // still fits in its size class
+    
+    __sync_sub_and_fetch (&g_bytesInUse, (cxu64) header->size);
+    
+    header->size = (cxu32) size;
+    
+    cx_system_memory_set_guard (header);
+    cx_system_memory_add_bytes ((cxu64) size);
+    
+    return data;
+  }
+  
+  void *block = _cx_malloc (size);
+  
+  memcpy (block, data, (header->size < size) ? header->size : size);
+  
+  _cx_free (data);
+  
+  return block;
+  
+#else
+  
+  void *block = realloc (data, size);
   
   CX_FATAL_ASSERT (block);
   
   return block;
+  
 #endif
 }
 
@@ -119,30 +617,146 @@ void _cx_free (void *data)
   CX_ASSERT (g_initialised);
   
   CX_ASSERT (data);
-  //CX_ASSERT (data != 0xDEADBEEF);
+  
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+  
+  cx_mem_header *header = ((cx_mem_header *) data) - 1;
+  
+  cx_system_memory_check_guard (header);
+  
+  __sync_sub_and_fetch (&g_bytesInUse, (cxu64) header->size);
+  
+#if CX_SYSTEM_MEMORY_DEBUG_FILL
+  cx_malloc_memset (data, CX_SYSTEM_MEMORY_FILL_FREE, header->size);
+#endif
+  
+  header->magic = CX_SYSTEM_MEMORY_MAGIC_FREE;
+  
+  cxu32 sizeClass = header->sizeClass;
+  
+  if (sizeClass == CX_SYSTEM_MEMORY_SIZE_CLASS_LARGE)
+  {
+    __sync_sub_and_fetch (&g_bytesLarge, (cxu64) (header->size + CX_SYSTEM_MEMORY_GUARD_SIZE));
+    
+    free (header);
+  }
+  else
+  {
+    CX_ASSERT (sizeClass < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES);
+    
+    cx_mem_thread_cache *cache = cx_system_memory_thread_cache ();
+    cx_mem_thread_bin *bin = &cache->bins [sizeClass];
+    
+    cx_mem_block *block = (cx_mem_block *) header;
+    
+    block->next = bin->freeList;
+    bin->freeList = block;
+    bin->freeCount++;
+    bin->blocksInUse--;
+    
+    if (bin->freeCount > (g_sizeClasses [sizeClass].batchSize * 2))
+    {
+      cx_system_memory_release (bin, sizeClass);
+    }
+  }
+  
+#else
   
   free (data);
+  
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+void cx_system_memory_get_stats (cx_system_memory_stats *stats)
+{
+  CX_ASSERT (g_initialised);
+  CX_ASSERT (stats);
+  
+  memset (stats, 0, sizeof (cx_system_memory_stats));
+  
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+  
+  // thread cache counters are read without their owners' cooperation, so figures are approximate
+  
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  
+  cxf64 currTime = (cxf64) tv.tv_sec + ((cxf64) tv.tv_usec / 1e6);
+  cxf64 elapsed = currTime - g_statsPrevTime;
+  
+  pthread_mutex_lock (&g_memoryMutex);
+  
+  for (cxu32 i = 0; i < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES; ++i)
+  {
+    cx_system_memory_size_class_stats *s = &stats->sizeClass [i];
+    
+    cxu64 allocCount = g_retiredBins [i].allocCount;
+    cxi64 blocksInUse = g_retiredBins [i].blocksInUse;
+    
+    const cx_mem_thread_cache *cache = g_threadCaches;
+    
+    while (cache)
+    {
+      allocCount += cache->bins [i].allocCount;
+      blocksInUse += cache->bins [i].blocksInUse;
+      cache = cache->next;
+    }
+    
+    s->blockSize = g_sizeClasses [i].blockSize;
+    s->blocksReserved = g_sizeClasses [i].blocksReserved;
+    s->blocksInUse = (blocksInUse > 0) ? (cxu32) blocksInUse : 0;
+    s->allocCount = allocCount;
+    s->allocsPerSec = (elapsed > 0.0) ? (cxf32) ((cxf64) (allocCount - g_statsPrevAllocCount [i]) / elapsed) : 0.0f;
+    
+    g_statsPrevAllocCount [i] = allocCount;
+    
+    stats->bytesReserved += (cxu64) s->blocksReserved * (s->blockSize + sizeof (cx_mem_header));
+  }
+  
+  g_statsPrevTime = currTime;
+  
+  pthread_mutex_unlock (&g_memoryMutex);
+  
+  stats->bytesInUse = __sync_fetch_and_add (&g_bytesInUse, 0);
+  stats->bytesPeak = __sync_fetch_and_add (&g_bytesPeak, 0);
+  stats->bytesReserved += g_bytesLarge;
+  stats->largeAllocCount = g_largeAllocCount;
+  
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if CX_SYSTEM_MEMORY_DEBUG_FILL
 static void *cx_malloc_memset (void *data, cxu32 fill, cxu32 size)
 {
   CX_ASSERT (g_initialised);
   
   cxu32 *d32 = data;
-  cxu32 cntr = size;
+  cxu32 cntr = size >> 2;
   
-  while (cntr)
+  while (cntr--)
   {
     *d32++ = fill;
-    cntr -= 4;
+  }
+  
+  cxu8 *d8 = (cxu8 *) d32;
+  cxu32 rem = size & 3;
+  
+  for (cxu32 i = 0; i < rem; ++i)
+  {
+    *d8++ = ((cxu8 *) &fill) [i];
   }
   
   return data;
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
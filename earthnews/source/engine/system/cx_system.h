@@ -18,10 +18,39 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#define CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED     0
+#ifndef CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+#define CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED     1 // pooled size classes, see tools/bench memory
+#endif
+
+#define CX_SYSTEM_MEMORY_DEBUG_FILL                   (CX_DEBUG)
+#define CX_SYSTEM_MEMORY_DEBUG_GUARD                  (CX_DEBUG)
+#define CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES             14
 
-#define cx_malloc(X)  _cx_malloc(X)
-#define cx_free(X)    _cx_free(X)
+#define cx_malloc(X)      _cx_malloc(X)
+#define cx_realloc(X,Y)   _cx_realloc(X,Y)
+#define cx_free(X)        _cx_free(X)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct cx_system_memory_size_class_stats
+{
+  cxu32 blockSize;
+  cxu32 blocksInUse;
+  cxu32 blocksReserved;
+  cxu64 allocCount;
+  cxf32 allocsPerSec;
+} cx_system_memory_size_class_stats;
+
+typedef struct cx_system_memory_stats
+{
+  cxu64 bytesInUse;
+  cxu64 bytesPeak;
+  cxu64 bytesReserved;
+  cxu64 largeAllocCount;
+  cx_system_memory_size_class_stats sizeClass [CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES];
+} cx_system_memory_stats;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -56,8 +85,11 @@ void cx_system_sleep (cxu32 msecs);
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 void *_cx_malloc (size_t size);
+void *_cx_realloc (void *data, size_t size);
 void _cx_free (void *data);
 
+void cx_system_memory_get_stats (cx_system_memory_stats *stats);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
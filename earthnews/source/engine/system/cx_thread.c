@@ -4,6 +4,10 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
+#if !defined (__APPLE__) && !defined (_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setname_np
+#endif
+
 #include "cx_thread.h"
 #include "cx_string.h"
 #include <unistd.h>
@@ -18,7 +22,13 @@ static void *cx_thread_pthread_func (void *data)
   
   cx_thread *thread = (cx_thread *) data;
   
+#if defined (__APPLE__)
   pthread_setname_np (thread->name);
+#else
+  char name [16]; // linux limit
+  cx_strcpy (name, sizeof (name), thread->name);
+  pthread_setname_np (pthread_self (), name);
+#endif
   
   cx_thread_monitor_wait (&thread->start);
   
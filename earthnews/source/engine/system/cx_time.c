@@ -9,11 +9,34 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "cx_time.h"
-#include "cx_thread.h"
 #include "cx_string.h"
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define CX_TIME_CYCLE_COUNTER_ENABLED   0
+
+#if defined (__APPLE__)
+#define CX_TIME_MACH
+#else
+#define CX_TIME_POSIX
+#if CX_TIME_CYCLE_COUNTER_ENABLED
+#if defined (__aarch64__)
+#define CX_TIME_CYCLE_COUNTER_ARM64
+#elif defined (__x86_64__) || defined (__i386__)
+#define CX_TIME_CYCLE_COUNTER_X86   // assumes an invariant tsc
+#endif
+#endif
+#endif
+
+#if defined (CX_TIME_MACH)
 #include <mach/mach.h>
 #include <mach/mach_time.h>
-#include <unistd.h>
+#elif defined (CX_TIME_CYCLE_COUNTER_X86)
+#include <x86intrin.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -21,7 +44,7 @@
 
 struct cx_sys_time
 {
-  uint64_t prevTime;
+  cxu64 prevTime;
   cxf64 deltaTime;
   cxf64 totalTime;
   bool update;
@@ -32,23 +55,98 @@ struct cx_sys_time
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 static struct cx_sys_time g_systemTime;
-static cx_thread_mutex g_criticalSection; // for thread-unsafe and non-reentrant crt time functions
-static mach_timebase_info_data_t g_timebase;
+static cxf64 g_ticksToNanosecs = 1.0;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_system_time_init (void)
+#if defined (CX_TIME_POSIX)
+static CX_INLINE cxu64 cx_time_get_monotonic_nanosecs (void)
 {
-  cx_thread_mutex_init (&g_criticalSection);
+  struct timespec ts;
   
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  
+  return ((cxu64) ts.tv_sec * 1000000000ull) + (cxu64) ts.tv_nsec;
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE cxu64 cx_time_get_ticks (void)
+{
+#if defined (CX_TIME_MACH)
+  return mach_absolute_time ();
+#elif defined (CX_TIME_CYCLE_COUNTER_ARM64)
+  cxu64 ticks;
+  __asm__ __volatile__ ("isb\n\tmrs %0, cntvct_el0" : "=r" (ticks) :: "memory");
+  return ticks;
+#elif defined (CX_TIME_CYCLE_COUNTER_X86)
+  return (cxu64) __rdtsc ();
+#else
+  return cx_time_get_monotonic_nanosecs ();
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_time_ticks_init (void)
+{
+#if defined (CX_TIME_MACH)
+  // Reference: http://developer.apple.com/library/mac/#qa/qa1398/_index.html
+  
+  mach_timebase_info_data_t timebase;
+  mach_timebase_info (&timebase);
+  
+  g_ticksToNanosecs = (cxf64) timebase.numer / (cxf64) timebase.denom;
+  
+#elif defined (CX_TIME_CYCLE_COUNTER_ARM64)
+  cxu64 freq;
+  __asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (freq));
+  CX_ASSERT (freq);
+  
+  g_ticksToNanosecs = 1e9 / (cxf64) freq;
+  
+#elif defined (CX_TIME_CYCLE_COUNTER_X86)
+  // calibrate tsc against the monotonic clock
+  
+  struct timespec delay = { 0, 10 * 1000000 };
+  
+  cxu64 ns0 = cx_time_get_monotonic_nanosecs ();
+  cxu64 tsc0 = (cxu64) __rdtsc ();
+  
+  nanosleep (&delay, NULL);
+  
+  cxu64 ns1 = cx_time_get_monotonic_nanosecs ();
+  cxu64 tsc1 = (cxu64) __rdtsc ();
+  
+  CX_ASSERT (tsc1 > tsc0);
+  
+  g_ticksToNanosecs = (cxf64) (ns1 - ns0) / (cxf64) (tsc1 - tsc0);
+  
+#else
+  g_ticksToNanosecs = 1.0;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_system_time_init (void)
+{
   //struct timeval t;
   //gettimeofday (&t, NULL);  
   //g_systemTime.prevTime = ((uint64_t) t.tv_sec * 1000000) + (uint64_t) t.tv_usec; // microseconds
   
-  mach_timebase_info (&g_timebase);
-  g_systemTime.prevTime = mach_absolute_time ();
+  cx_time_ticks_init ();
+  
+  g_systemTime.prevTime = cx_time_get_ticks ();
   g_systemTime.deltaTime = 0.0f;
   g_systemTime.totalTime = 0.0f;
   g_systemTime.update = true;
@@ -64,8 +162,8 @@ void cx_system_time_update (void)
   //gettimeofday (&t, NULL);  
   //u_int64_t currentTime = ((uint64_t) t.tv_sec * 1000000) + (uint64_t) t.tv_usec;
   
-  u_int64_t currentTime = mach_absolute_time ();
-  u_int64_t deltaTime = currentTime - g_systemTime.prevTime;
+  cxu64 currentTime = cx_time_get_ticks ();
+  cxu64 deltaTime = currentTime - g_systemTime.prevTime;
   g_systemTime.prevTime = currentTime;
   
   if (g_systemTime.update)
@@ -75,7 +173,7 @@ void cx_system_time_update (void)
     //g_systemTime.totalTime += g_systemTime.deltaTime;
   
     // nanoseconds to seconds 
-    g_systemTime.deltaTime = (cxf64) deltaTime * (cxf64) g_timebase.numer / (cxf64) g_timebase.denom / 1e9;
+    g_systemTime.deltaTime = (cxf64) deltaTime * g_ticksToNanosecs / 1e9;
     g_systemTime.totalTime += g_systemTime.deltaTime;
   }
 }
@@ -128,20 +226,12 @@ void cx_system_sleep (cxu32 msecs)
 
 cxi64 cx_time_get_utc_epoch (void)
 {
-  cxi64 timestamp = 0;
-  
-  cx_thread_mutex_lock (&g_criticalSection);
+  // time () is already seconds since the utc epoch, no calendar round trip required
   
   time_t rawTime = time (NULL);
   CX_ASSERT (rawTime != -1);
   
-  struct tm gmt = *gmtime (&rawTime);
-  time_t utcTime = timegm (&gmt);
-  CX_ASSERT (utcTime != -1);
-  
-  timestamp = (cxi64) utcTime;
-  
-  cx_thread_mutex_unlock (&g_criticalSection);
+  cxi64 timestamp = (cxi64) rawTime;
   
   return timestamp;
 }
@@ -152,17 +242,17 @@ cxi64 cx_time_get_utc_epoch (void)
 
 cxi32 cx_time_get_utc_offset (void)
 {
-  cx_thread_mutex_lock (&g_criticalSection);
-  
   time_t rawTime = time (NULL);
   CX_ASSERT (rawTime != -1);
 
-  struct tm locTm = *localtime (&rawTime);
+  struct tm locTm;
+  localtime_r (&rawTime, &locTm);
   
 #if 1
   cxi32 diffSecs = locTm.tm_gmtoff;
 #else
-  struct tm utcTm = *gmtime (&rawTime);
+  struct tm utcTm;
+  gmtime_r (&rawTime, &utcTm);
   time_t utcTime = timegm (&utcTm);
   time_t locTime = timegm (&locTm);
   cxi32 diffSecs = (cxi32) difftime (locTime, utcTime);
@@ -172,8 +262,6 @@ cxi32 cx_time_get_utc_offset (void)
   cxi32 offsetHr = (diffSecs / 3600) * 100;
   cxi32 offset = offsetHr + offsetMin;
   
-  cx_thread_mutex_unlock (&g_criticalSection);
-  
   return offset;
 }
 
@@ -309,15 +397,16 @@ void cx_time_set_date (cx_date *date, cx_time_zone zone)
   CX_ASSERT (date);
   CX_ASSERT ((zone > CX_TIME_ZONE_INVALID) && (zone < CX_NUM_TIME_ZONES));
   
-  cx_thread_mutex_lock (&g_criticalSection); // gmtime not reentrant
+  // reentrant crt variants, safe to call from any thread without locking.
+  // epoch time is taken straight from time (), mktime/timegm would just round trip it
   
   switch (zone) 
   {
     case CX_TIME_ZONE_LOCAL:
     {
       time_t rawTime = time (NULL);
-      date->calendar = *localtime (&rawTime);
-      date->epochTime = (cxi64) mktime (&date->calendar);
+      localtime_r (&rawTime, &date->calendar);
+      date->epochTime = (cxi64) rawTime;
       
       break;
     }
@@ -325,8 +414,8 @@ void cx_time_set_date (cx_date *date, cx_time_zone zone)
     case CX_TIME_ZONE_UTC:
     {
       time_t rawTime = time (NULL);
-      date->calendar = *gmtime (&rawTime);
-      date->epochTime = (cxi64) timegm (&date->calendar);
+      gmtime_r (&rawTime, &date->calendar);
+      date->epochTime = (cxi64) rawTime;
       
       break;
     }
@@ -338,8 +427,6 @@ void cx_time_set_date (cx_date *date, cx_time_zone zone)
       break;
     }
   }
-  
-  cx_thread_mutex_unlock (&g_criticalSection);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -352,7 +439,7 @@ void cx_time_start_timer (cx_timer *timer)
   
   timer->elapsedTime = 0.0f;
   timer->active = true;
-  timer->startTime = mach_absolute_time ();
+  timer->startTime = cx_time_get_ticks ();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -363,21 +450,15 @@ void cx_time_stop_timer (cx_timer *timer)
 {
   CX_ASSERT (timer);
   
-  // Reference: http://developer.apple.com/library/mac/#qa/qa1398/_index.html
-  
   if (timer->active)
   {
-    uint64_t endTime = mach_absolute_time ();
+    cxu64 endTime = cx_time_get_ticks ();
     
-    uint64_t elapsed = endTime - timer->startTime;
+    cxu64 elapsed = endTime - timer->startTime;
     
     // convert to milliseconds
     
-    mach_timebase_info_data_t timebase;
-    
-    mach_timebase_info (&timebase);
-    
-    timer->elapsedTime = ((cxf64) elapsed * (cxf64) timebase.numer / (cxf64) timebase.denom) / 1e6;
+    timer->elapsedTime = ((cxf64) elapsed * g_ticksToNanosecs) / 1e6;
     
     timer->active = false;
   }
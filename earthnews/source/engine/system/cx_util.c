@@ -4,6 +4,10 @@
 //  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
 //
 
+#if !defined (__APPLE__) && !defined (_GNU_SOURCE)
+#define _GNU_SOURCE // strcasestr
+#endif
+
 #include "cx_util.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -184,6 +188,289 @@ void cx_util_world_space_to_screen_space (cxf32 width, cxf32 height, const cx_ma
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#if defined (CX_SIMD_SSE)
+static CX_INLINE __m128 cx_util_sse_mul_row (const cxf32 *m, int row, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+  __m128 r = _mm_mul_ps (_mm_set1_ps (m [row]), x);
+  r = _mm_add_ps (r, _mm_mul_ps (_mm_set1_ps (m [row + 4]), y));
+  r = _mm_add_ps (r, _mm_mul_ps (_mm_set1_ps (m [row + 8]), z));
+  r = _mm_add_ps (r, _mm_mul_ps (_mm_set1_ps (m [row + 12]), w));
+  
+  return r;
+}
+
+static CX_INLINE __m128 cx_util_sse_smoothstep (__m128 edge0, __m128 edge1, __m128 x)
+{
+  __m128 t = _mm_div_ps (_mm_sub_ps (x, edge0), _mm_sub_ps (edge1, edge0));
+  t = _mm_min_ps (_mm_max_ps (t, _mm_setzero_ps ()), _mm_set1_ps (1.0f));
+  
+  return _mm_mul_ps (_mm_mul_ps (t, t), _mm_sub_ps (_mm_set1_ps (3.0f), _mm_mul_ps (_mm_set1_ps (2.0f), t)));
+}
+#elif defined (CX_SIMD_NEON)
+static CX_INLINE float32x4_t cx_util_neon_mul_row (const cxf32 *m, int row, float32x4_t x, float32x4_t y, float32x4_t z, float32x4_t w)
+{
+  float32x4_t r = vmulq_n_f32 (x, m [row]);
+  r = vaddq_f32 (r, vmulq_n_f32 (y, m [row + 4]));
+  r = vaddq_f32 (r, vmulq_n_f32 (z, m [row + 8]));
+  r = vaddq_f32 (r, vmulq_n_f32 (w, m [row + 12]));
+  
+  return r;
+}
+
+static CX_INLINE float32x4_t cx_util_neon_div (float32x4_t n, float32x4_t d)
+{
+  // reciprocal estimate + 2 newton-raphson steps (armv7 has no vector divide)
+  
+  float32x4_t r = vrecpeq_f32 (d);
+  r = vmulq_f32 (vrecpsq_f32 (d, r), r);
+  r = vmulq_f32 (vrecpsq_f32 (d, r), r);
+  
+  return vmulq_f32 (n, r);
+}
+
+static CX_INLINE float32x4_t cx_util_neon_smoothstep (float32x4_t edge0, float32x4_t edge1, float32x4_t x)
+{
+  float32x4_t t = cx_util_neon_div (vsubq_f32 (x, edge0), vsubq_f32 (edge1, edge0));
+  t = vminq_f32 (vmaxq_f32 (t, vdupq_n_f32 (0.0f)), vdupq_n_f32 (1.0f));
+  
+  return vmulq_f32 (vmulq_f32 (t, t), vsubq_f32 (vdupq_n_f32 (3.0f), vmulq_n_f32 (t, 2.0f)));
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_util_world_space_to_screen_space_batch (cxf32 width, cxf32 height, const cx_mat4x4 *proj, const cx_mat4x4 *view, 
+                                                const cx_vec4 *world, const cx_vec4 *normal, cxu32 count, 
+                                                const cx_vec4 *eyeDir, const cx_vec4 *fade, const cx_vec2 *margin, 
+                                                cx_vec4 *screen, cx_vec2 *opacity, cxu8 *visible)
+{
+  // same transform as cx_util_world_space_to_screen_space for 'count' points, 4 at a time.
+  // screen: x, y, depth (0, 1), z scale. opacity: smoothstep (fade.x, fade.y, facing) and 
+  // smoothstep (fade.z, fade.w, facing) where facing = max (0, normal . eyeDir).
+  // visible: 1 if in front of the eye, inside the viewport grown by margin (pixels each side, the 
+  // half-extent of whatever is drawn at the point, may be NULL) and either opacity is non-zero
+  
+  CX_ASSERT (proj);
+  CX_ASSERT (view);
+  CX_ASSERT (world);
+  CX_ASSERT (normal);
+  CX_ASSERT (eyeDir);
+  CX_ASSERT (fade);
+  CX_ASSERT (screen);
+  CX_ASSERT (opacity);
+  
+  const cxf32 *v = view->f16;
+  const cxf32 *p = proj->f16;
+  
+  // z scale: proj * { 0.5, 0.5, eye.z, eye.w }, constant part
+  
+  cxf32 zsx = (p [0] * 0.5f) + (p [4] * 0.5f);
+  cxf32 zsw = (p [3] * 0.5f) + (p [7] * 0.5f);
+  
+  // viewport edges in ndc
+  
+  cxf32 limx = margin ? (1.0f + ((2.0f * margin->x) / width)) : 1.0f;
+  cxf32 limy = margin ? (1.0f + ((2.0f * margin->y) / height)) : 1.0f;
+  
+  cxu32 i = 0;
+  
+#if defined (CX_SIMD_SSE)
+  __m128 one = _mm_set1_ps (1.0f);
+  __m128 half = _mm_set1_ps (0.5f);
+  __m128 fade0 = _mm_set1_ps (fade->x), fade1 = _mm_set1_ps (fade->y);
+  __m128 fade2 = _mm_set1_ps (fade->z), fade3 = _mm_set1_ps (fade->w);
+  
+  for (; (i + 4) <= count; i += 4)
+  {
+    __m128 x = world [i + 0]._m128;
+    __m128 y = world [i + 1]._m128;
+    __m128 z = world [i + 2]._m128;
+    __m128 w = world [i + 3]._m128;
+    
+    _MM_TRANSPOSE4_PS (x, y, z, w);
+    
+    // to eye space
+    
+    __m128 ex = cx_util_sse_mul_row (v, 0, x, y, z, w);
+    __m128 ey = cx_util_sse_mul_row (v, 1, x, y, z, w);
+    __m128 ez = cx_util_sse_mul_row (v, 2, x, y, z, w);
+    __m128 ew = cx_util_sse_mul_row (v, 3, x, y, z, w);
+    
+    // to clip space
+    
+    __m128 cx = cx_util_sse_mul_row (p, 0, ex, ey, ez, ew);
+    __m128 cy = cx_util_sse_mul_row (p, 1, ex, ey, ez, ew);
+    __m128 cz = cx_util_sse_mul_row (p, 2, ex, ey, ez, ew);
+    __m128 cw = cx_util_sse_mul_row (p, 3, ex, ey, ez, ew);
+    
+    __m128 rcw = _mm_div_ps (one, cw);
+    
+    __m128 nx = _mm_mul_ps (cx, rcw);
+    __m128 ny = _mm_mul_ps (cy, rcw);
+    __m128 nz = _mm_mul_ps (cz, rcw);
+    
+    // to screen
+    
+    __m128 sx = _mm_mul_ps (_mm_mul_ps (_mm_add_ps (nx, one), half), _mm_set1_ps (width));
+    __m128 sy = _mm_mul_ps (_mm_mul_ps (_mm_sub_ps (one, ny), half), _mm_set1_ps (height));
+    __m128 sz = _mm_mul_ps (_mm_add_ps (nz, one), half);
+    
+    __m128 zn = _mm_add_ps (_mm_set1_ps (zsx), _mm_mul_ps (_mm_set1_ps (p [8]), ez));
+    zn = _mm_add_ps (zn, _mm_mul_ps (_mm_set1_ps (p [12]), ew));
+    __m128 zd = _mm_add_ps (_mm_set1_ps (zsw), _mm_mul_ps (_mm_set1_ps (p [11]), ez));
+    zd = _mm_add_ps (zd, _mm_mul_ps (_mm_set1_ps (p [15]), ew));
+    __m128 sw = _mm_div_ps (zn, zd);
+    
+    _MM_TRANSPOSE4_PS (sx, sy, sz, sw);
+    
+    screen [i + 0]._m128 = sx;
+    screen [i + 1]._m128 = sy;
+    screen [i + 2]._m128 = sz;
+    screen [i + 3]._m128 = sw;
+    
+    // facing opacity
+    
+    __m128 n0 = normal [i + 0]._m128;
+    __m128 n1 = normal [i + 1]._m128;
+    __m128 n2 = normal [i + 2]._m128;
+    __m128 n3 = normal [i + 3]._m128;
+    
+    _MM_TRANSPOSE4_PS (n0, n1, n2, n3);
+    
+    __m128 d = _mm_mul_ps (n0, _mm_set1_ps (eyeDir->x));
+    d = _mm_add_ps (d, _mm_mul_ps (n1, _mm_set1_ps (eyeDir->y)));
+    d = _mm_add_ps (d, _mm_mul_ps (n2, _mm_set1_ps (eyeDir->z)));
+    d = _mm_add_ps (d, _mm_mul_ps (n3, _mm_set1_ps (eyeDir->w)));
+    d = _mm_max_ps (d, _mm_setzero_ps ());
+    
+    __m128 o0 = cx_util_sse_smoothstep (fade0, fade1, d);
+    __m128 o1 = cx_util_sse_smoothstep (fade2, fade3, d);
+    
+    _mm_storeu_ps (opacity [i + 0].f2, _mm_unpacklo_ps (o0, o1));
+    _mm_storeu_ps (opacity [i + 2].f2, _mm_unpackhi_ps (o0, o1));
+    
+    if (visible)
+    {
+      __m128 inside = _mm_and_ps (_mm_cmpgt_ps (cw, _mm_setzero_ps ()), _mm_cmple_ps (_mm_max_ps (nx, _mm_sub_ps (_mm_setzero_ps (), nx)), _mm_set1_ps (limx)));
+      inside = _mm_and_ps (inside, _mm_cmple_ps (_mm_max_ps (ny, _mm_sub_ps (_mm_setzero_ps (), ny)), _mm_set1_ps (limy)));
+      inside = _mm_and_ps (inside, _mm_cmpgt_ps (_mm_max_ps (o0, o1), _mm_setzero_ps ()));
+      
+      int mask = _mm_movemask_ps (inside);
+      
+      visible [i + 0] = (mask >> 0) & 1;
+      visible [i + 1] = (mask >> 1) & 1;
+      visible [i + 2] = (mask >> 2) & 1;
+      visible [i + 3] = (mask >> 3) & 1;
+    }
+  }
+#elif defined (CX_SIMD_NEON)
+  float32x4_t one = vdupq_n_f32 (1.0f);
+  float32x4_t fade0 = vdupq_n_f32 (fade->x), fade1 = vdupq_n_f32 (fade->y);
+  float32x4_t fade2 = vdupq_n_f32 (fade->z), fade3 = vdupq_n_f32 (fade->w);
+  
+  for (; (i + 4) <= count; i += 4)
+  {
+    float32x4x4_t pos = vld4q_f32 (world [i].f4);
+    
+    float32x4_t ex = cx_util_neon_mul_row (v, 0, pos.val [0], pos.val [1], pos.val [2], pos.val [3]);
+    float32x4_t ey = cx_util_neon_mul_row (v, 1, pos.val [0], pos.val [1], pos.val [2], pos.val [3]);
+    float32x4_t ez = cx_util_neon_mul_row (v, 2, pos.val [0], pos.val [1], pos.val [2], pos.val [3]);
+    float32x4_t ew = cx_util_neon_mul_row (v, 3, pos.val [0], pos.val [1], pos.val [2], pos.val [3]);
+    
+    float32x4_t cx = cx_util_neon_mul_row (p, 0, ex, ey, ez, ew);
+    float32x4_t cy = cx_util_neon_mul_row (p, 1, ex, ey, ez, ew);
+    float32x4_t cz = cx_util_neon_mul_row (p, 2, ex, ey, ez, ew);
+    float32x4_t cw = cx_util_neon_mul_row (p, 3, ex, ey, ez, ew);
+    
+    float32x4_t rcw = cx_util_neon_div (one, cw);
+    
+    float32x4_t nx = vmulq_f32 (cx, rcw);
+    float32x4_t ny = vmulq_f32 (cy, rcw);
+    float32x4_t nz = vmulq_f32 (cz, rcw);
+    
+    float32x4x4_t scr;
+    scr.val [0] = vmulq_n_f32 (vmulq_n_f32 (vaddq_f32 (nx, one), 0.5f), width);
+    scr.val [1] = vmulq_n_f32 (vmulq_n_f32 (vsubq_f32 (one, ny), 0.5f), height);
+    scr.val [2] = vmulq_n_f32 (vaddq_f32 (nz, one), 0.5f);
+    
+    float32x4_t zn = vaddq_f32 (vdupq_n_f32 (zsx), vmulq_n_f32 (ez, p [8]));
+    zn = vaddq_f32 (zn, vmulq_n_f32 (ew, p [12]));
+    float32x4_t zd = vaddq_f32 (vdupq_n_f32 (zsw), vmulq_n_f32 (ez, p [11]));
+    zd = vaddq_f32 (zd, vmulq_n_f32 (ew, p [15]));
+    scr.val [3] = cx_util_neon_div (zn, zd);
+    
+    vst4q_f32 (screen [i].f4, scr);
+    
+    float32x4x4_t nor = vld4q_f32 (normal [i].f4);
+    
+    float32x4_t d = vmulq_n_f32 (nor.val [0], eyeDir->x);
+    d = vaddq_f32 (d, vmulq_n_f32 (nor.val [1], eyeDir->y));
+    d = vaddq_f32 (d, vmulq_n_f32 (nor.val [2], eyeDir->z));
+    d = vaddq_f32 (d, vmulq_n_f32 (nor.val [3], eyeDir->w));
+    d = vmaxq_f32 (d, vdupq_n_f32 (0.0f));
+    
+    float32x4x2_t opa;
+    opa.val [0] = cx_util_neon_smoothstep (fade0, fade1, d);
+    opa.val [1] = cx_util_neon_smoothstep (fade2, fade3, d);
+    
+    vst2q_f32 (opacity [i].f2, opa);
+    
+    if (visible)
+    {
+      uint32x4_t inside = vandq_u32 (vcgtq_f32 (cw, vdupq_n_f32 (0.0f)), vcaleq_f32 (nx, vdupq_n_f32 (limx)));
+      inside = vandq_u32 (inside, vcaleq_f32 (ny, vdupq_n_f32 (limy)));
+      inside = vandq_u32 (inside, vcgtq_f32 (vmaxq_f32 (opa.val [0], opa.val [1]), vdupq_n_f32 (0.0f)));
+      
+      visible [i + 0] = (cxu8) (vgetq_lane_u32 (inside, 0) & 1);
+      visible [i + 1] = (cxu8) (vgetq_lane_u32 (inside, 1) & 1);
+      visible [i + 2] = (cxu8) (vgetq_lane_u32 (inside, 2) & 1);
+      visible [i + 3] = (cxu8) (vgetq_lane_u32 (inside, 3) & 1);
+    }
+  }
+#endif
+  
+  for (; i < count; ++i)
+  {
+    const cx_vec4 *pos = &world [i];
+    const cx_vec4 *nor = &normal [i];
+    
+    cx_vec4 eye, clip;
+    
+    cx_mat4x4_mul_vec4 (&eye, view, pos);
+    cx_mat4x4_mul_vec4 (&clip, proj, &eye);
+    
+    cxf32 rcw = 1.0f / clip.w;
+    
+    cxf32 nx = clip.x * rcw;
+    cxf32 ny = clip.y * rcw;
+    cxf32 nz = clip.z * rcw;
+    
+    screen [i].x = (nx + 1.0f) * 0.5f * width;
+    screen [i].y = (-ny + 1.0f) * 0.5f * height;
+    screen [i].z = (nz + 1.0f) * 0.5f;
+    screen [i].w = (zsx + (p [8] * eye.z) + (p [12] * eye.w)) / (zsw + (p [11] * eye.z) + (p [15] * eye.w));
+    
+    cxf32 d = (nor->x * eyeDir->x) + (nor->y * eyeDir->y) + (nor->z * eyeDir->z) + (nor->w * eyeDir->w);
+    d = cx_max (0.0f, d);
+    
+    opacity [i].x = cx_smoothstep (fade->x, fade->y, d);
+    opacity [i].y = cx_smoothstep (fade->z, fade->w, d);
+    
+    if (visible)
+    {
+      bool inside = (clip.w > 0.0f) && (fabsf (nx) <= limx) && (fabsf (ny) <= limy);
+      
+      visible [i] = (inside && ((opacity [i].x > 0.0f) || (opacity [i].y > 0.0f))) ? 1 : 0;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 void cx_util_screen_space_to_world_space (cxf32 width, cxf32 height, const cx_mat4x4 *proj, const cx_mat4x4 *view, 
                                            const cx_vec2 *screen, cx_vec4 *world, cxf32 depth, bool ray)
 {
@@ -329,7 +616,9 @@ void cx_util_word_filter (char *text, const char **words, cxu32 wordCount, char
       
       if (replace)
       {
-        while (wlen--)
+        cxu32 n = wlen;
+        
+        while (n--)
         {
           cxu8 fc = *found;
           
@@ -352,3 +641,441 @@ void cx_util_word_filter (char *text, const char **words, cxu32 wordCount, char
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define CX_UTIL_WORD_FILTER_ROOT      (0)
+#define CX_UTIL_WORD_FILTER_NONE      (-1)
+#define CX_UTIL_WORD_FILTER_ERASE     (0xff) // never valid in utf-8
+
+// aho-corasick automaton compiled to a dfa over the byte classes that occur in the
+// (case-folded) words. bytes not in any word share class 0, which always goes to root.
+
+struct cx_word_filter
+{
+  cxi32 *next;          // [stateCount * classCount]
+  cxi32 *match;         // first word ending at state
+  cxi32 *dict;          // nearest suffix state with a match
+  cxi32 *wordNext;      // next word ending at same state
+  cxu16 *wordLen;       // in bytes
+  bool *wordWhole;      // '@' prefixed
+  cxu32 stateCount;
+  cxu32 classCount;
+  cxu32 wordCount;
+  cxu8 classes [256];
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE cxu8 cx_util_fold_ascii (cxu8 c)
+{
+  return ((c >= 'A') && (c <= 'Z')) ? (cxu8) (c + 32) : c;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static CX_INLINE void cx_util_fold_utf8_2 (cxu8 *c0, cxu8 *c1)
+{
+  // lower case for 2-byte sequences (latin-1, latin extended-a, greek, cyrillic).
+  // every mapping stays within 2 bytes so folded text lines up with the original.
+  
+  cxu32 cp = ((*c0 & 0x1f) << 6) | (*c1 & 0x3f);
+  
+  if ((cp >= 0xc0) && (cp <= 0xde) && (cp != 0xd7))
+  {
+    cp += 0x20;
+  }
+  else if (((cp >= 0x100) && (cp <= 0x137)) || ((cp >= 0x14a) && (cp <= 0x177)))
+  {
+    cp |= 1;
+  }
+  else if ((cp >= 0x139) && (cp <= 0x148) && (cp & 1))
+  {
+    cp += 1;
+  }
+  else if ((cp >= 0x391) && (cp <= 0x3a9) && (cp != 0x3a2))
+  {
+    cp += 0x20;
+  }
+  else if ((cp >= 0x386) && (cp <= 0x38f))
+  {
+    // accented greek capitals
+    
+    static const cxu16 lower [10] = { 0x3ac, 0x387, 0x3ad, 0x3ae, 0x3af, 0x38b, 0x3cc, 0x38d, 0x3cd, 0x3ce };
+    
+    cp = lower [cp - 0x386];
+  }
+  else if ((cp >= 0x410) && (cp <= 0x42f))
+  {
+    cp += 0x20;
+  }
+  else if ((cp >= 0x400) && (cp <= 0x40f))
+  {
+    cp += 0x50;
+  }
+  
+  *c0 = (cxu8) (0xc0 | (cp >> 6));
+  *c1 = (cxu8) (0x80 | (cp & 0x3f));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_util_fold_utf8 (cxu8 *dst, const cxu8 *src)
+{
+  cxu32 len = 0;
+  
+  while (src [len])
+  {
+    cxu8 c0 = src [len];
+    cxu8 c1 = src [len + 1];
+    
+    if (((c0 & 0xe0) == 0xc0) && ((c1 & 0xc0) == 0x80))
+    {
+      cx_util_fold_utf8_2 (&c0, &c1);
+      
+      dst [len++] = c0;
+      dst [len++] = c1;
+    }
+    else
+    {
+      dst [len++] = cx_util_fold_ascii (c0);
+    }
+  }
+  
+  dst [len] = 0;
+  
+  return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+cx_word_filter *cx_util_word_filter_create (const char **words, cxu32 wordCount)
+{
+  CX_ASSERT (words || (wordCount == 0));
+  
+  cx_word_filter *filter = cx_malloc (sizeof (cx_word_filter));
+  
+  memset (filter, 0, sizeof (cx_word_filter));
+  
+  // fold words and assign byte classes
+  
+  cxu32 totalLen = 0;
+  cxu32 maxLen = 0;
+  
+  for (cxu32 i = 0; i < wordCount; ++i)
+  {
+    cxu32 len = strlen (words [i]);
+    
+    totalLen += len;
+    maxLen = cx_max (maxLen, len);
+  }
+  
+  cxu8 *folded = cx_malloc (maxLen + 1);
+  
+  filter->classCount = 1;
+  
+  for (cxu32 i = 0; i < wordCount; ++i)
+  {
+    const char *word = (words [i][0] == '@') ? (words [i] + 1) : words [i];
+    
+    cxu32 len = cx_util_fold_utf8 (folded, (const cxu8 *) word);
+    
+    for (cxu32 j = 0; j < len; ++j)
+    {
+      if (filter->classes [folded [j]] == 0)
+      {
+        CX_ASSERT (filter->classCount < 256);
+        
+        filter->classes [folded [j]] = (cxu8) filter->classCount++;
+      }
+    }
+  }
+  
+  // trie
+  
+  cxu32 maxStates = totalLen + 1;
+  cxu32 classCount = filter->classCount;
+  
+  filter->next = cx_malloc (sizeof (cxi32) * maxStates * classCount);
+  filter->match = cx_malloc (sizeof (cxi32) * maxStates);
+  filter->dict = cx_malloc (sizeof (cxi32) * maxStates);
+  filter->wordNext = cx_malloc (sizeof (cxi32) * cx_max (wordCount, 1));
+  filter->wordLen = cx_malloc (sizeof (cxu16) * cx_max (wordCount, 1));
+  filter->wordWhole = cx_malloc (sizeof (bool) * cx_max (wordCount, 1));
+  filter->stateCount = 1;
+  
+  for (cxu32 i = 0; i < (maxStates * classCount); ++i)
+  {
+    filter->next [i] = CX_UTIL_WORD_FILTER_NONE;
+  }
+  
+  for (cxu32 i = 0; i < maxStates; ++i)
+  {
+    filter->match [i] = CX_UTIL_WORD_FILTER_NONE;
+    filter->dict [i] = CX_UTIL_WORD_FILTER_NONE;
+  }
+  
+  for (cxu32 i = 0; i < wordCount; ++i)
+  {
+    bool whole = (words [i][0] == '@');
+    
+    const char *word = whole ? (words [i] + 1) : words [i];
+    
+    cxu32 len = cx_util_fold_utf8 (folded, (const cxu8 *) word);
+    
+    if ((len == 0) || (len > 0xffff))
+    {
+      continue;
+    }
+    
+    cxi32 state = CX_UTIL_WORD_FILTER_ROOT;
+    
+    for (cxu32 j = 0; j < len; ++j)
+    {
+      cxi32 *next = &filter->next [(state * classCount) + filter->classes [folded [j]]];
+      
+      if (*next == CX_UTIL_WORD_FILTER_NONE)
+      {
+        *next = (cxi32) filter->stateCount++;
+      }
+      
+      state = *next;
+    }
+    
+    cxi32 w = (cxi32) filter->wordCount++;
+    
+    filter->wordLen [w] = (cxu16) len;
+    filter->wordWhole [w] = whole;
+    filter->wordNext [w] = filter->match [state];
+    filter->match [state] = w;
+  }
+  
+  cx_free (folded);
+  
+  // failure links (breadth first), folded into the transition table as we go
+  
+  cxi32 *fail = cx_malloc (sizeof (cxi32) * filter->stateCount);
+  cxi32 *queue = cx_malloc (sizeof (cxi32) * filter->stateCount);
+  
+  cxu32 head = 0, tail = 0;
+  
+  fail [CX_UTIL_WORD_FILTER_ROOT] = CX_UTIL_WORD_FILTER_ROOT;
+  
+  for (cxu32 c = 0; c < classCount; ++c)
+  {
+    cxi32 *next = &filter->next [c];
+    
+    if (*next == CX_UTIL_WORD_FILTER_NONE)
+    {
+      *next = CX_UTIL_WORD_FILTER_ROOT;
+    }
+    else
+    {
+      fail [*next] = CX_UTIL_WORD_FILTER_ROOT;
+      queue [tail++] = *next;
+    }
+  }
+  
+  while (head < tail)
+  {
+    cxi32 state = queue [head++];
+    
+    cxi32 *next = &filter->next [state * classCount];
+    const cxi32 *failNext = &filter->next [fail [state] * classCount];
+    
+    for (cxu32 c = 0; c < classCount; ++c)
+    {
+      if (next [c] == CX_UTIL_WORD_FILTER_NONE)
+      {
+        next [c] = failNext [c];
+      }
+      else
+      {
+        cxi32 child = next [c];
+        cxi32 f = failNext [c];
+        
+        fail [child] = f;
+        filter->dict [child] = (filter->match [f] != CX_UTIL_WORD_FILTER_NONE) ? f : filter->dict [f];
+        
+        queue [tail++] = child;
+      }
+    }
+  }
+  
+  cx_free (fail);
+  cx_free (queue);
+  
+  // trim to size
+  
+  filter->next = cx_realloc (filter->next, sizeof (cxi32) * filter->stateCount * classCount);
+  filter->match = cx_realloc (filter->match, sizeof (cxi32) * filter->stateCount);
+  filter->dict = cx_realloc (filter->dict, sizeof (cxi32) * filter->stateCount);
+  
+  return filter;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_util_word_filter_destroy (cx_word_filter *filter)
+{
+  CX_ASSERT (filter);
+  
+  cx_free (filter->next);
+  cx_free (filter->match);
+  cx_free (filter->dict);
+  cx_free (filter->wordNext);
+  cx_free (filter->wordLen);
+  cx_free (filter->wordWhole);
+  cx_free (filter);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool cx_util_word_filter_emit (const cx_word_filter *filter, cxu8 *text, cxi32 state, cxu32 pos, char subchar)
+{
+  // replace every word ending at pos. returns true if a multi-byte character was replaced.
+  
+  bool erase = false;
+  
+  if (filter->match [state] == CX_UTIL_WORD_FILTER_NONE)
+  {
+    state = filter->dict [state];
+  }
+  
+  while (state != CX_UTIL_WORD_FILTER_NONE)
+  {
+    for (cxi32 w = filter->match [state]; w != CX_UTIL_WORD_FILTER_NONE; w = filter->wordNext [w])
+    {
+      cxu32 start = pos + 1 - filter->wordLen [w];
+      
+      if (filter->wordWhole [w]) // match word
+      {
+        cxu8 fca = (start == 0) ? 0 : text [start - 1];
+        cxu8 fcb = text [pos + 1];
+        
+        if ((fca > 32) || (fcb > 32))
+        {
+          continue;
+        }
+      }
+      
+      for (cxu32 i = start; i <= pos; ++i)
+      {
+        cxu8 fc = text [i];
+        
+        if ((fc <= 32) || (fc == CX_UTIL_WORD_FILTER_ERASE)) // ignore whitespace
+        {
+          continue;
+        }
+        
+        if ((fc & 0xc0) == 0x80) // continuation byte, removed after the scan
+        {
+          text [i] = CX_UTIL_WORD_FILTER_ERASE;
+          erase = true;
+        }
+        else
+        {
+          text [i] = (cxu8) subchar;
+        }
+      }
+    }
+    
+    state = filter->dict [state];
+  }
+  
+  return erase;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_util_word_filter_apply (const cx_word_filter *filter, char *text, char subchar)
+{
+  // single pass over text. matching is case-insensitive (see cx_util_fold_utf8_2) and a
+  // replaced multi-byte character becomes a single subchar.
+  
+  CX_ASSERT (filter);
+  CX_ASSERT (text);
+  
+  cxu8 *t = (cxu8 *) text;
+  
+  const cxi32 *next = filter->next;
+  const cxi32 *match = filter->match;
+  const cxi32 *dict = filter->dict;
+  const cxu8 *classes = filter->classes;
+  const cxu32 classCount = filter->classCount;
+  
+  bool erase = false;
+  cxi32 state = CX_UTIL_WORD_FILTER_ROOT;
+  cxu32 i = 0;
+  
+  while (t [i])
+  {
+    cxu8 c0 = t [i];
+    
+    if (c0 < 0x80)
+    {
+      state = next [(state * classCount) + classes [cx_util_fold_ascii (c0)]];
+      
+      if ((match [state] != CX_UTIL_WORD_FILTER_NONE) || (dict [state] != CX_UTIL_WORD_FILTER_NONE))
+      {
+        erase |= cx_util_word_filter_emit (filter, t, state, i, subchar);
+      }
+      
+      i++;
+    }
+    else
+    {
+      cxu8 c1 = t [i + 1];
+      cxu32 n = 1;
+      
+      if (((c0 & 0xe0) == 0xc0) && ((c1 & 0xc0) == 0x80))
+      {
+        cx_util_fold_utf8_2 (&c0, &c1);
+        n = 2;
+      }
+      
+      cxu8 fc [2] = { c0, c1 };
+      
+      for (cxu32 j = 0; j < n; ++j, ++i)
+      {
+        state = next [(state * classCount) + classes [fc [j]]];
+        
+        if ((match [state] != CX_UTIL_WORD_FILTER_NONE) || (dict [state] != CX_UTIL_WORD_FILTER_NONE))
+        {
+          erase |= cx_util_word_filter_emit (filter, t, state, i, subchar);
+        }
+      }
+    }
+  }
+  
+  if (erase)
+  {
+    cxu8 *dst = t;
+    
+    for (cxu8 *src = t; *src; ++src)
+    {
+      if (*src != CX_UTIL_WORD_FILTER_ERASE)
+      {
+        *dst++ = *src;
+      }
+    }
+    
+    *dst = 0;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -36,8 +36,14 @@ cxu32 cx_util_roundup_pow2 (cxu32 x);
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+typedef struct cx_word_filter cx_word_filter;
+
 void cx_util_word_filter (char *text, const char **words, cxu32 wordCount, char subchar);
 
+cx_word_filter *cx_util_word_filter_create (const char **words, cxu32 wordCount);
+void            cx_util_word_filter_destroy (cx_word_filter *filter);
+void            cx_util_word_filter_apply (const cx_word_filter *filter, char *text, char subchar);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -45,6 +51,11 @@ void cx_util_word_filter (char *text, const char **words, cxu32 wordCount, char
 void cx_util_world_space_to_screen_space (cxf32 width, cxf32 height, const cx_mat4x4 *proj, const cx_mat4x4 *view, 
                                           const cx_vec4 *world, cx_vec2 *screen, cxf32 *depth, cxf32 *zScale);
 
+void cx_util_world_space_to_screen_space_batch (cxf32 width, cxf32 height, const cx_mat4x4 *proj, const cx_mat4x4 *view, 
+                                                const cx_vec4 *world, const cx_vec4 *normal, cxu32 count, 
+                                                const cx_vec4 *eyeDir, const cx_vec4 *fade, const cx_vec2 *margin, 
+                                                cx_vec4 *screen, cx_vec2 *opacity, cxu8 *visible);
+
 void cx_util_screen_space_to_world_space (cxf32 width, cxf32 height, const cx_mat4x4 *proj, const cx_mat4x4 *view, 
                                           const cx_vec2 *screen, cx_vec4 *world, cxf32 depth, bool ray);
 
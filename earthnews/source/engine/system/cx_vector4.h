@@ -19,8 +19,10 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-#ifdef CX_SIMD_NEON
+#if defined (CX_SIMD_NEON)
 #define CX_SIMD_VEC4_DECL   float32x4_t _q128;
+#elif defined (CX_SIMD_SSE)
+#define CX_SIMD_VEC4_DECL   __m128 _m128;
 #else
 #define CX_SIMD_VEC4_DECL
 #endif
@@ -39,6 +41,14 @@ union cx_vec4
 
 typedef union cx_vec4 cx_vec4;
 
+typedef struct cx_vec4_soa
+{
+  cxf32 *x;
+  cxf32 *y;
+  cxf32 *z;
+  cxf32 *w;
+} cx_vec4_soa;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -62,12 +72,30 @@ static CX_INLINE void cx_vec4_string (const cx_vec4 *v, char *destBuffer, cxu32
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+#ifdef CX_SIMD_SSE
+static CX_INLINE __m128 cx_vec4_sse_dot (__m128 v0, __m128 v1)
+{
+  // sse2 has no horizontal add. result is broadcast to all lanes
+  
+  __m128 m = _mm_mul_ps (v0, v1);
+  __m128 s = _mm_add_ps (m, _mm_shuffle_ps (m, m, _MM_SHUFFLE (2, 3, 0, 1)));
+  
+  return _mm_add_ps (s, _mm_shuffle_ps (s, s, _MM_SHUFFLE (1, 0, 3, 2)));
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
 static CX_INLINE void cx_vec4_zero (cx_vec4 *v_out)
 {
   CX_ASSERT (cx_vec4_validate (v_out));
   
 #ifdef CX_SIMD_NEON
   v_out->_q128 = vdupq_n_f32 (0.0f);
+#elif defined (CX_SIMD_SSE)
+  v_out->_m128 = _mm_setzero_ps ();
 #else
   v_out->x = 0.0f;
   v_out->y = 0.0f;
@@ -86,6 +114,8 @@ static CX_INLINE void cx_vec4_negate (cx_vec4 *v_out)
   
 #ifdef CX_SIMD_NEON
   v_out->_q128 = vnegq_f32 (v_out->_q128);
+#elif defined (CX_SIMD_SSE)
+  v_out->_m128 = _mm_xor_ps (v_out->_m128, _mm_set1_ps (-0.0f));
 #else
   v_out->x = -v_out->x;
   v_out->y = -v_out->y;
@@ -108,6 +138,8 @@ static CX_INLINE void cx_vec4_set (cx_vec4 * CX_RESTRICT v_out, cxf32 x, cxf32 y
 #ifdef CX_SIMD_NEON
   cxf32 a[4] CX_ALIGN(16) = { x, y, z, w };
   v_out->_q128 = vld1q_f32 (a);
+#elif defined (CX_SIMD_SSE)
+  v_out->_m128 = _mm_setr_ps (x, y, z, w);
 #else
   v_out->x = x;
   v_out->y = y;
@@ -127,6 +159,8 @@ static CX_INLINE void cx_vec4_mul (cx_vec4 * CX_RESTRICT v_out, cxf32 s, const c
   
 #ifdef CX_SIMD_NEON
   v_out->_q128 = vmulq_n_f32 (v->_q128, s);
+#elif defined (CX_SIMD_SSE)
+  v_out->_m128 = _mm_mul_ps (v->_m128, _mm_set1_ps (s));
 #else
   v_out->x = v->x * s;
   v_out->y = v->y * s;
@@ -146,6 +180,8 @@ static CX_INLINE void cx_vec4_add (cx_vec4 * CX_RESTRICT v_out, const cx_vec4 *
   
 #ifdef CX_SIMD_NEON
   v_out->_q128 = vaddq_f32 (v0->_q128, v1->_q128);
+#elif defined (CX_SIMD_SSE)
+  v_out->_m128 = _mm_add_ps (v0->_m128, v1->_m128);
 #else
   v_out->x = v0->x + v1->x;
   v_out->y = v0->y + v1->y;
@@ -165,6 +201,8 @@ static CX_INLINE void cx_vec4_sub (cx_vec4 * CX_RESTRICT v_out, const cx_vec4 *
   
 #ifdef CX_SIMD_NEON
   v_out->_q128 = vsubq_f32 (v0->_q128, v1->_q128);
+#elif defined (CX_SIMD_SSE)
+  v_out->_m128 = _mm_sub_ps (v0->_m128, v1->_m128);
 #else
   v_out->x = v0->x - v1->x;
   v_out->y = v0->y - v1->y;
@@ -179,12 +217,23 @@ static CX_INLINE void cx_vec4_sub (cx_vec4 * CX_RESTRICT v_out, const cx_vec4 *
 
 static CX_INLINE void cx_vec4_normalize (cx_vec4 *v)
 {
+#ifdef CX_SIMD_SSE
+  CX_ASSERT (cx_vec4_validate (v));
+  
+  __m128 len = _mm_sqrt_ps (cx_vec4_sse_dot (v->_m128, v->_m128));
+  
+  CX_ASSERT (cx_validatef (_mm_cvtss_f32 (len)));
+  CX_ASSERT (_mm_cvtss_f32 (len) > CX_EPSILON);
+  
+  v->_m128 = _mm_mul_ps (v->_m128, _mm_div_ps (_mm_set1_ps (1.0f), len));
+#else
   cxf32 len = cx_vec4_length (v);
   
   CX_ASSERT (cx_validatef (len));
   CX_ASSERT (len > CX_EPSILON);
   
   cx_vec4_mul (v, (1.0f / len), v);
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -216,6 +265,8 @@ static CX_INLINE cxf32 cx_vec4_length_sq (const cx_vec4 *v)
   float32x2_t v64b = vget_high_f32 (v128);
   v64a = vadd_f32 (v64a, v64b);
   return vget_lane_f32 (v64a, 0) + vget_lane_f32 (v64a, 1);
+#elif defined (CX_SIMD_SSE)
+  return _mm_cvtss_f32 (cx_vec4_sse_dot (v->_m128, v->_m128));
 #else
   return (v->x * v->x) + (v->y * v->y) + (v->z * v->z) + (v->w * v->w);
 #endif
@@ -231,10 +282,22 @@ static CX_INLINE void cx_vec4_cross (cx_vec4 * CX_RESTRICT v_out, const cx_vec4
   CX_ASSERT (cx_vec4_validate (v0));
   CX_ASSERT (cx_vec4_validate (v1));
   
+#ifdef CX_SIMD_SSE
+  __m128 a = v0->_m128;
+  __m128 b = v1->_m128;
+  __m128 a_yzx = _mm_shuffle_ps (a, a, _MM_SHUFFLE (3, 0, 2, 1));
+  __m128 b_yzx = _mm_shuffle_ps (b, b, _MM_SHUFFLE (3, 0, 2, 1));
+  __m128 a_zxy = _mm_shuffle_ps (a, a, _MM_SHUFFLE (3, 1, 0, 2));
+  __m128 b_zxy = _mm_shuffle_ps (b, b, _MM_SHUFFLE (3, 1, 0, 2));
+  __m128 c = _mm_sub_ps (_mm_mul_ps (a_yzx, b_zxy), _mm_mul_ps (a_zxy, b_yzx));
+  
+  v_out->_m128 = _mm_and_ps (c, _mm_castsi128_ps (_mm_setr_epi32 (-1, -1, -1, 0)));
+#else
   v_out->x = (v0->y * v1->z) - (v0->z * v1->y);
   v_out->y = (v0->z * v1->x) - (v0->x * v1->z);
   v_out->z = (v0->x * v1->y) - (v0->y * v1->x);
   v_out->w = 0.0f;
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -253,6 +316,10 @@ static CX_INLINE cxf32 cx_vec4_dot (const cx_vec4 * CX_RESTRICT v0, const cx_vec
   v64a = vadd_f32 (v64a, v64b);
   return vget_lane_f32 (v64a, 0) + vget_lane_f32 (v64a, 1);
   
+#elif defined (CX_SIMD_SSE)
+  
+  return _mm_cvtss_f32 (cx_vec4_sse_dot (v0->_m128, v1->_m128));
+  
 #else
   
   return (v0->x * v1->x) + (v0->y * v1->y) + (v0->z * v1->z) + (v0->w * v1->w);
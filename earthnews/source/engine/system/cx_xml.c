@@ -8,6 +8,43 @@
 #include "cx_file.h"
 #include <libxml/parser.h>
 #include <libxml/tree.h>
+#include <libxml/SAX2.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct cx_xml_sax_context
+{
+  const cx_xml_sax_callbacks *callbacks;
+  void *userdata;
+  char *valueBuffer; // decoded attribute values, grow-only
+  cxu32 valueBufferSize;
+} cx_xml_sax_context;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static char *cx_xml_strdup (xmlChar *xmlstr)
+{
+  // callers release strings with cx_free, so move libxml owned memory into the engine allocator
+
+  if (!xmlstr)
+  {
+    return NULL;
+  }
+  
+  cxu32 len = strlen ((const char *) xmlstr);
+  
+  char *str = (char *) cx_malloc (len + 1);
+  
+  memcpy (str, xmlstr, len + 1);
+  
+  xmlFree (xmlstr);
+  
+  return str;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -169,9 +206,7 @@ char *cx_xml_node_content (cx_xml_node node)
   
   xmlNodePtr xmlnode = (xmlNodePtr) node;
   
-  char *content = (char *) xmlNodeGetContent (xmlnode);
-  
-  // free
+  char *content = cx_xml_strdup (xmlNodeGetContent (xmlnode));
   
   return content;
 }
@@ -189,9 +224,7 @@ char *cx_xml_node_attr (cx_xml_node node, const char *name)
   
   const xmlChar *xmlname = (const xmlChar *) name;
   
-  char *content = (char *) xmlGetProp (xmlnode, xmlname);
-  
-  // free
+  char *content = cx_xml_strdup (xmlGetProp (xmlnode, xmlname));
   
   return content;
 }
@@ -221,3 +254,236 @@ const char *cx_xml_attr_get_name (cx_xml_attr attr)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 cx_xml_sax_decode_value (char *dst, const char *src, cxu32 srcLength)
+{
+  // libxml2 leaves references in sax2 attribute values (&amp; arrives as &#38;) and its tree builder
+  // decodes them, do the same for character and predefined entity references. decoded length never
+  // exceeds the source length. unknown references are copied as they are
+  
+  static const struct { const char *name; cxu32 len; char c; } entities [5] =
+  {
+    { "amp;", 4, '&' }, { "lt;", 3, '<' }, { "gt;", 3, '>' }, { "quot;", 5, '"' }, { "apos;", 5, '\'' }
+  };
+  
+  cxu32 len = 0;
+  cxu32 i = 0;
+  
+  while (i < srcLength)
+  {
+    if (src [i] != '&')
+    {
+      dst [len++] = src [i++];
+      continue;
+    }
+    
+    const char *ref = src + i + 1;
+    cxu32 refLength = srcLength - i - 1;
+    cxu32 used = 0;
+    
+    if ((refLength > 1) && (ref [0] == '#'))
+    {
+      bool hex = (ref [1] == 'x');
+      cxu32 j = hex ? 2 : 1;
+      cxu32 code = 0;
+      
+      for (; (j < refLength) && (j < 10) && (ref [j] != ';'); ++j)
+      {
+        char c = ref [j];
+        cxu32 digit = ((c >= '0') && (c <= '9')) ? (cxu32) (c - '0') : 
+                      (hex && (c >= 'a') && (c <= 'f')) ? (cxu32) (c - 'a' + 10) : 
+                      (hex && (c >= 'A') && (c <= 'F')) ? (cxu32) (c - 'A' + 10) : 0xff;
+        
+        if (digit == 0xff)
+        {
+          break;
+        }
+        
+        code = (code * (hex ? 16 : 10)) + digit;
+      }
+      
+      if ((j < refLength) && (ref [j] == ';') && (j > (hex ? 2 : 1)) && (code > 0) && (code <= 0x10ffff))
+      {
+        // utf-8
+        
+        if (code < 0x80)
+        {
+          dst [len++] = (char) code;
+        }
+        else if (code < 0x800)
+        {
+          dst [len++] = (char) (0xc0 | (code >> 6));
+          dst [len++] = (char) (0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+          dst [len++] = (char) (0xe0 | (code >> 12));
+          dst [len++] = (char) (0x80 | ((code >> 6) & 0x3f));
+          dst [len++] = (char) (0x80 | (code & 0x3f));
+        }
+        else
+        {
+          dst [len++] = (char) (0xf0 | (code >> 18));
+          dst [len++] = (char) (0x80 | ((code >> 12) & 0x3f));
+          dst [len++] = (char) (0x80 | ((code >> 6) & 0x3f));
+          dst [len++] = (char) (0x80 | (code & 0x3f));
+        }
+        
+        used = j + 2;
+      }
+    }
+    else
+    {
+      for (cxu32 e = 0; e < 5; ++e)
+      {
+        if ((refLength >= entities [e].len) && (memcmp (ref, entities [e].name, entities [e].len) == 0))
+        {
+          dst [len++] = entities [e].c;
+          used = entities [e].len + 1;
+          break;
+        }
+      }
+    }
+    
+    if (used)
+    {
+      i += used;
+    }
+    else
+    {
+      dst [len++] = src [i++];
+    }
+  }
+  
+  return len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_xml_sax_element_begin (void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *uri, 
+                                      int namespaceCount, const xmlChar **namespaces, 
+                                      int attributeCount, int defaultedCount, const xmlChar **attributes)
+{
+  cx_xml_sax_context *context = (cx_xml_sax_context *) ctx;
+  
+  if (context->callbacks->element_begin)
+  {
+    // libxml2 passes attributes as (localname, prefix, uri, value, end) tuples
+    
+    cx_xml_sax_attr attrs [CX_XML_SAX_MAX_ATTRS];
+    
+    cxu32 attrCount = (attributeCount < CX_XML_SAX_MAX_ATTRS) ? (cxu32) attributeCount : CX_XML_SAX_MAX_ATTRS;
+    cxu32 decodeSize = 0;
+    
+    for (cxu32 i = 0; i < attrCount; ++i)
+    {
+      const xmlChar **a = &attributes [i * 5];
+      
+      attrs [i].name = (const char *) a [0];
+      attrs [i].nsprefix = (const char *) a [1];
+      attrs [i].value = (const char *) a [3];
+      attrs [i].valueLength = (cxu32) (a [4] - a [3]);
+      
+      decodeSize += memchr (attrs [i].value, '&', attrs [i].valueLength) ? attrs [i].valueLength : 0;
+    }
+    
+    if (decodeSize > 0)
+    {
+      // values with references are decoded into the context's buffer, the rest stay in place
+      
+      if (decodeSize > context->valueBufferSize)
+      {
+        context->valueBuffer = (char *) cx_realloc (context->valueBuffer, decodeSize);
+        context->valueBufferSize = decodeSize;
+      }
+      
+      char *dst = context->valueBuffer;
+      
+      for (cxu32 i = 0; i < attrCount; ++i)
+      {
+        if (memchr (attrs [i].value, '&', attrs [i].valueLength))
+        {
+          cxu32 len = cx_xml_sax_decode_value (dst, attrs [i].value, attrs [i].valueLength);
+          
+          attrs [i].value = dst;
+          
+          dst += attrs [i].valueLength;
+          
+          attrs [i].valueLength = len;
+        }
+      }
+    }
+    
+    context->callbacks->element_begin (context->userdata, (const char *) localname, (const char *) prefix, attrs, attrCount);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_xml_sax_element_end (void *ctx, const xmlChar *localname, const xmlChar *prefix, const xmlChar *uri)
+{
+  cx_xml_sax_context *context = (cx_xml_sax_context *) ctx;
+  
+  if (context->callbacks->element_end)
+  {
+    context->callbacks->element_end (context->userdata, (const char *) localname, (const char *) prefix);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void cx_xml_sax_characters (void *ctx, const xmlChar *ch, int len)
+{
+  cx_xml_sax_context *context = (cx_xml_sax_context *) ctx;
+  
+  if (context->callbacks->characters)
+  {
+    context->callbacks->characters (context->userdata, (const char *) ch, (cxu32) len);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool cx_xml_sax_parse (const char *data, cxu32 dataSize, const cx_xml_sax_callbacks *callbacks, void *userdata)
+{
+  CX_ASSERT (data);
+  CX_ASSERT (callbacks);
+  
+  // streams the document through callbacks, no tree is built
+  
+  xmlSAXHandler handler;
+  memset (&handler, 0, sizeof (handler));
+  
+  handler.initialized = XML_SAX2_MAGIC;
+  handler.startElementNs = cx_xml_sax_element_begin;
+  handler.endElementNs = cx_xml_sax_element_end;
+  handler.characters = cx_xml_sax_characters;
+  handler.cdataBlock = cx_xml_sax_characters;
+  
+  cx_xml_sax_context context;
+  context.callbacks = callbacks;
+  context.userdata = userdata;
+  context.valueBuffer = NULL;
+  context.valueBufferSize = 0;
+  
+  int rc = xmlSAXUserParseMemory (&handler, &context, data, (int) dataSize);
+  
+  if (context.valueBuffer)
+  {
+    cx_free (context.valueBuffer);
+  }
+  
+  return (rc == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
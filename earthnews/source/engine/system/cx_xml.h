@@ -21,6 +21,23 @@ typedef void * cx_xml_doc;
 typedef void * cx_xml_node;
 typedef void * cx_xml_attr;
 
+typedef struct cx_xml_sax_attr
+{
+  const char *name;
+  const char *nsprefix;
+  const char *value; // not null-terminated, character and predefined entity references decoded
+  cxu32 valueLength;
+} cx_xml_sax_attr;
+
+typedef struct cx_xml_sax_callbacks
+{
+  void (*element_begin) (void *userdata, const char *name, const char *nsprefix, const cx_xml_sax_attr *attrs, cxu32 attrCount);
+  void (*element_end) (void *userdata, const char *name, const char *nsprefix);
+  void (*characters) (void *userdata, const char *text, cxu32 textLength); // may be called several times per element
+} cx_xml_sax_callbacks;
+
+#define CX_XML_SAX_MAX_ATTRS (16)
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,6 +58,8 @@ char *       cx_xml_node_attr (cx_xml_node node, const char *name);
 cx_xml_attr  cx_xml_attr_get_next_sibling (cx_xml_attr attr);
 const char * cx_xml_attr_get_name (cx_xml_attr attr);
 
+bool         cx_xml_sax_parse (const char *data, cxu32 dataSize, const cx_xml_sax_callbacks *callbacks, void *userdata);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -31,9 +31,11 @@ typedef struct cx_varmod_var
   const char *name;
   void *val;
   cx_varmod_var_type type;
+  cxf32 min;
+  cxf32 max;
 } cx_varmod_var;
 
-void cx_varmod_register_var (cx_varmod_var_type type, void *val, const char *name);
+void cx_varmod_register_var (cx_varmod_var_type type, void *val, const char *name, cxf32 min, cxf32 max);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -41,7 +43,7 @@ void cx_varmod_register_var (cx_varmod_var_type type, void *val, const char *nam
 
 static bool g_initialised = false;
 static cx_varmod_settings g_settings;
-static cx_list2 *g_variables = NULL;
+static cx_list2 g_variables;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -49,8 +51,13 @@ static cx_list2 *g_variables = NULL;
 
 bool cx_varmod_init (cx_varmod_settings *settings)
 {
+  CX_ASSERT (!g_initialised);
+  CX_ASSERT (settings);
+  
   g_settings.renderFunc = settings->renderFunc;
   
+  cx_list2_init (&g_variables);
+  
   g_initialised = true;
   
   return g_initialised;
@@ -62,6 +69,15 @@ bool cx_varmod_init (cx_varmod_settings *settings)
 
 bool cx_varmod_deinit (void)
 {
+  CX_ASSERT (g_initialised);
+  
+  for (cx_list2_node *node = g_variables.head; node; node = node->next)
+  {
+    cx_free ((void *) node->data);
+  }
+  
+  cx_list2_deinit (&g_variables);
+  
   g_initialised = false;
   
   return !g_initialised;
@@ -73,7 +89,7 @@ bool cx_varmod_deinit (void)
 
 void cx_varmod_register_bool (bool *val, const char *name)
 {
-  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_BOOL, val, name);
+  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_BOOL, val, name, 0.0f, 1.0f);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -82,7 +98,7 @@ void cx_varmod_register_bool (bool *val, const char *name)
 
 void cx_varmod_register_float (cxf32 *val, const char *name, cxf32 min, cxf32 max)
 {
-  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_FLOAT, val, name);
+  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_FLOAT, val, name, min, max);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -91,7 +107,7 @@ void cx_varmod_register_float (cxf32 *val, const char *name, cxf32 min, cxf32 ma
 
 void cx_varmod_register_int (cxi32 *val, const char *name, cxi32 min, cxi32 max)
 {
-  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_INT, val, name);
+  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_INT, val, name, (cxf32) min, (cxf32) max);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -100,23 +116,55 @@ void cx_varmod_register_int (cxi32 *val, const char *name, cxi32 min, cxi32 max)
 
 void cx_varmod_register_vec4 (cx_vec4 *val, const char *name, cxf32 min, cxf32 max)
 {
-  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_VEC4, val, name);
+  cx_varmod_register_var (CX_VARMOD_VAR_TYPE_VEC4, val, name, min, max);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-void cx_varmod_register_var (cx_varmod_var_type type, void *val, const char *name)
+void cx_varmod_register_var (cx_varmod_var_type type, void *val, const char *name, cxf32 min, cxf32 max)
 {
+  CX_ASSERT (g_initialised);
+  CX_ASSERT (val);
+  CX_ASSERT (name);
+  CX_ASSERT (min <= max);
+  
   cx_varmod_var *var = (cx_varmod_var *) cx_malloc (sizeof (cx_varmod_var));
   
   var->type = type;
   var->val = val;
   var->name = name;
+  var->min = min;
+  var->max = max;
   
   // add to list
-  g_variables = NULL;
+  cx_list2_insert_back (&g_variables, var);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void cx_varmod_unregister (void *val)
+{
+  CX_ASSERT (g_initialised);
+  CX_ASSERT (val);
+  
+  for (cx_list2_node *node = g_variables.head; node; node = node->next)
+  {
+    cx_varmod_var *var = (cx_varmod_var *) node->data;
+    
+    if (var->val == val)
+    {
+      cx_list2_remove (&g_variables, var);
+      cx_free (var);
+      
+      return;
+    }
+  }
+  
+  CX_ASSERT (0 && "unregistered variable");
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -125,6 +173,49 @@ void cx_varmod_register_var (cx_varmod_var_type type, void *val, const char *nam
 
 void cx_varmod_render (void)
 {
+  CX_ASSERT (g_initialised);
+  
+  // values are held to the range they were registered with
+  
+  for (cx_list2_node *node = g_variables.head; node; node = node->next)
+  {
+    const cx_varmod_var *var = (const cx_varmod_var *) node->data;
+    
+    switch (var->type)
+    {
+      case CX_VARMOD_VAR_TYPE_BOOL:   { CX_LOG_CONSOLE (1, "%s: %d", var->name, *((bool *) var->val)); break; }
+      case CX_VARMOD_VAR_TYPE_INT:
+      {
+        cxi32 *i = (cxi32 *) var->val;
+        *i = cx_clamp (*i, (cxi32) var->min, (cxi32) var->max);
+        CX_LOG_CONSOLE (1, "%s: %d", var->name, *i);
+        break;
+      }
+      case CX_VARMOD_VAR_TYPE_FLOAT:
+      {
+        cxf32 *f = (cxf32 *) var->val;
+        *f = cx_clamp (*f, var->min, var->max);
+        CX_LOG_CONSOLE (1, "%s: %.3f", var->name, *f);
+        break;
+      }
+      case CX_VARMOD_VAR_TYPE_VEC4:
+      {
+        cx_vec4 *v = (cx_vec4 *) var->val;
+        v->x = cx_clamp (v->x, var->min, var->max);
+        v->y = cx_clamp (v->y, var->min, var->max);
+        v->z = cx_clamp (v->z, var->min, var->max);
+        v->w = cx_clamp (v->w, var->min, var->max);
+        CX_LOG_CONSOLE (1, "%s: %.3f %.3f %.3f %.3f", var->name, v->x, v->y, v->z, v->w);
+        break;
+      }
+      default:                        { break; }
+    }
+  }
+  
+  if (g_settings.renderFunc)
+  {
+    g_settings.renderFunc ();
+  }
 }
 
 
@@ -37,6 +37,7 @@ void cx_varmod_register_bool (bool *val, const char *name);
 void cx_varmod_register_float (cxf32 *val, const char *name, cxf32 min, cxf32 max);
 void cx_varmod_register_int (cxi32 *val, const char *name, cxi32 min, cxi32 max);
 void cx_varmod_register_vec4 (cx_vec4 *val, const char *name, cxf32 min, cxf32 max);
+void cx_varmod_unregister (void *val);
 
 void cx_varmod_render (void);
 void cx_varmod_input (cxf32 touchx, cxf32 touchy);
@@ -0,0 +1,2154 @@
+//
+//  bench.c
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+//  host micro benchmarks for engine and app modules, each comparing against the code path it
+//  replaced where that still exists. numbers are from the build machine, not a device: compare runs
+//  on the same host only.
+//
+//  build: make bench (see Makefile), make benchmark runs all of them
+//  usage: EGL_PLATFORM=surfaceless CX_RESOURCE_PATH=.. bench [name ...]
+//
+
+#include "harness.h"
+#include "../source/app/earth.h"
+#include "../source/app/camera.h"
+#include "../source/app/worker.h"
+#include "../source/engine/system/cx_thread.h"
+#include "../source/engine/system/cx_time.h"
+#include "../source/engine/system/cx_xml.h"
+#include "../source/engine/system/cx_json.h"
+#include "../source/engine/system/cx_file.h"
+#include "../source/engine/system/cx_string.h"
+#include "../source/engine/system/cx_util.h"
+#include "../source/engine/graphics/cx_font.h"
+#include "../source/engine/graphics/cx_globe.h"
+#include "../source/engine/graphics/cx_mesh.h"
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_WIDTH             1024
+#define BENCH_HEIGHT            768
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct bench_case
+{
+  const char *name;
+  void (*func) (void);
+} bench_case;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_MEMORY_SLOTS      (1024)
+#define BENCH_MEMORY_OPS        (1000000)
+
+typedef struct bench_memory_ops
+{
+  void *(*alloc) (size_t size);
+  void (*release) (void *data);
+} bench_memory_ops;
+
+static void *bench_memory_cx_alloc (size_t size) { return cx_malloc (size); }
+static void bench_memory_cx_release (void *data) { cx_free (data); }
+static void *bench_memory_sys_alloc (size_t size) { return malloc (size); }
+static void bench_memory_sys_release (void *data) { free (data); }
+
+static const bench_memory_ops g_benchMemoryOps [2] =
+{
+  { bench_memory_sys_alloc, bench_memory_sys_release },
+  { bench_memory_cx_alloc, bench_memory_cx_release },
+};
+
+static cx_thread_exit_status bench_memory_thread (void *userdata)
+{
+  // random free/alloc churn over a working set of small blocks (16 to 512 bytes), as json, xml and feeds do
+  
+  const bench_memory_ops *ops = (const bench_memory_ops *) userdata;
+  
+  void *slots [BENCH_MEMORY_SLOTS];
+  memset (slots, 0, sizeof (slots));
+  
+  cxu32 seed = 12345;
+  
+  for (int i = 0; i < BENCH_MEMORY_OPS; ++i)
+  {
+    seed = (seed * 1664525u) + 1013904223u;
+    
+    cxu32 slot = (seed >> 8) % BENCH_MEMORY_SLOTS;
+    size_t size = 16 + ((seed >> 20) % 497);
+    
+    if (slots [slot])
+    {
+      ops->release (slots [slot]);
+    }
+    
+    slots [slot] = ops->alloc (size);
+    *((cxu8 *) slots [slot]) = (cxu8) i;
+  }
+  
+  for (int i = 0; i < BENCH_MEMORY_SLOTS; ++i)
+  {
+    if (slots [i])
+    {
+      ops->release (slots [i]);
+    }
+  }
+  
+  return CX_THREAD_EXIT_STATUS_SUCCESS;
+}
+
+static void bench_memory_threads (int threadCount)
+{
+  const char *names [2] = { "malloc", "cx_malloc" };
+  
+  for (int a = 0; a < 2; ++a)
+  {
+    cx_thread *threads [threadCount];
+    
+    cx_timer timer;
+    cx_time_start_timer (&timer);
+    
+    for (int i = 0; i < threadCount; ++i)
+    {
+      threads [i] = cx_thread_create ("bench_memory", CX_THREAD_TYPE_JOINABLE, bench_memory_thread, (void *) &g_benchMemoryOps [a]);
+      cx_thread_start (threads [i]);
+    }
+    
+    for (int i = 0; i < threadCount; ++i)
+    {
+      cx_thread_join (threads [i], NULL);
+      cx_thread_destroy (threads [i]);
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    cxf64 ns = (timer.elapsedTime * 1e6) / ((cxf64) BENCH_MEMORY_OPS * threadCount);
+    
+    printf ("bench: memory %-9s x %d threads %8.3f ms (%.1f ns per free+alloc)\n", names [a], threadCount, timer.elapsedTime, ns);
+  }
+}
+
+static void bench_memory (void)
+{
+  // pooled allocator vs system malloc. debug builds add the fill and guard words to cx_malloc
+  
+  bench_memory_threads (1);
+  bench_memory_threads (4);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_TIMER_COUNT       (1000000)
+
+static void bench_timer (void)
+{
+  // cx_time_start_timer/cx_time_stop_timer pair overhead
+  
+  cx_timer timer, inner;
+  cx_time_start_timer (&timer);
+  
+  for (int i = 0; i < BENCH_TIMER_COUNT; ++i)
+  {
+    cx_time_start_timer (&inner);
+    cx_time_stop_timer (&inner);
+  }
+  
+  cx_time_stop_timer (&timer);
+  
+  printf ("bench: timer start/stop %.1f ns\n", (timer.elapsedTime * 1e6) / (cxf64) BENCH_TIMER_COUNT);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_DATE_THREADS      (4)
+#define BENCH_DATE_COUNT        (100000)
+
+static cx_thread_exit_status bench_date_thread (void *userdata)
+{
+  cx_date date;
+  
+  for (int i = 0; i < BENCH_DATE_COUNT; ++i)
+  {
+    cx_time_set_date (&date, (i & 1) ? CX_TIME_ZONE_UTC : CX_TIME_ZONE_LOCAL);
+    cx_time_get_utc_offset ();
+  }
+  
+  return CX_THREAD_EXIT_STATUS_SUCCESS;
+}
+
+static void bench_date (void)
+{
+  // date conversion contention
+  
+  cx_thread *threads [BENCH_DATE_THREADS];
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  for (int i = 0; i < BENCH_DATE_THREADS; ++i)
+  {
+    threads [i] = cx_thread_create ("bench_date", CX_THREAD_TYPE_JOINABLE, bench_date_thread, NULL);
+    cx_thread_start (threads [i]);
+  }
+  
+  for (int i = 0; i < BENCH_DATE_THREADS; ++i)
+  {
+    cx_thread_join (threads [i], NULL);
+    cx_thread_destroy (threads [i]);
+  }
+  
+  cx_time_stop_timer (&timer);
+  
+  printf ("bench: date conversion x %d threads %.3f ms\n", BENCH_DATE_THREADS, timer.elapsedTime);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_WORKER_TASKS      (100000)
+
+static volatile int g_benchTaskCount = 0;
+
+static void bench_worker_task (void *userdata)
+{
+  __sync_add_and_fetch (&g_benchTaskCount, 1);
+}
+
+static void bench_worker (void)
+{
+  // empty task throughput through worker_add_task
+  
+  worker_init ();
+  
+  g_benchTaskCount = 0;
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  for (int i = 0; i < BENCH_WORKER_TASKS; ++i)
+  {
+    // retry when full so the same loop also runs against the old 16 slot worker
+    while (worker_add_task (bench_worker_task, NULL, NULL) == TASK_ID_INVALID)
+    {
+      worker_update ();
+      cx_thread_sleep (0);
+    }
+  }
+  
+  while (g_benchTaskCount < BENCH_WORKER_TASKS)
+  {
+    worker_update ();
+    cx_thread_sleep (1);
+  }
+  
+  cx_time_stop_timer (&timer);
+  
+  worker_stats stats;
+  worker_get_stats (&stats);
+  
+  printf ("bench: worker %d tasks %.3f ms (workers %d, steals %u, depth max %d, latency p50 %.3f p90 %.3f p99 %.3f ms)\n", 
+          BENCH_WORKER_TASKS, timer.elapsedTime, stats.workerCount, stats.steals, stats.queueDepthMax, 
+          stats.latencyP50, stats.latencyP90, stats.latencyP99);
+  
+  worker_deinit ();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_PRIORITY_BACKLOG  (500)
+
+static void bench_priority_task_background (void *userdata)
+{
+  cx_thread_sleep (1);
+}
+
+static void bench_priority (void)
+{
+  // time to first visible result under a saturated queue. a backlog at the focused task's own
+  // priority is the previous fifo behaviour
+  
+  const task_priority backlog [2] = { TASK_PRIORITY_NORMAL, TASK_PRIORITY_LOW };
+  const task_priority focus [2] = { TASK_PRIORITY_NORMAL, TASK_PRIORITY_HIGH };
+  
+  worker_init ();
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    for (int i = 0; i < BENCH_PRIORITY_BACKLOG; ++i)
+    {
+      worker_task_release (worker_task_submit (bench_priority_task_background, NULL, backlog [p]));
+    }
+    
+    cx_timer timer;
+    cx_time_start_timer (&timer);
+    
+    task_handle focused = worker_task_submit (bench_worker_task, NULL, focus [p]);
+    worker_task_wait (focused);
+    worker_task_release (focused);
+    
+    cx_time_stop_timer (&timer);
+    
+    printf ("bench: focused task priority %d, backlog %d x 1 ms at priority %d, first result %.3f ms\n", 
+            focus [p], BENCH_PRIORITY_BACKLOG, backlog [p], timer.elapsedTime);
+    
+    worker_stats stats;
+    
+    do 
+    {
+      cx_thread_sleep (10);
+      worker_get_stats (&stats);
+    } while (stats.queueDepth > 0);
+  }
+  
+  worker_deinit ();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static long bench_peak_rss_kb (void)
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  
+  return usage.ru_maxrss;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_XML_ITEMS         (60)
+#define BENCH_XML_LARGE_ITEMS   (10000)
+#define BENCH_XML_PARSES        (200)
+#define BENCH_XML_TEXT_MAX_LEN  (512)
+
+typedef struct bench_xml_feed
+{
+  char title [BENCH_XML_TEXT_MAX_LEN];
+  char link [BENCH_XML_TEXT_MAX_LEN];
+  char pubDate [64];
+  char text [BENCH_XML_TEXT_MAX_LEN];
+  cxu32 textLen;
+  char *field;
+  int fieldSize;
+  int depth;
+  int itemCount;
+} bench_xml_feed;
+
+static char *bench_xml_create_feed (int itemCount, cxu32 *size)
+{
+  // google news shaped rss: escaped html descriptions, query strings in links
+  
+  const char *desc = "&lt;table border=&quot;0&quot; cellpadding=&quot;2&quot; cellspacing=&quot;7&quot;&gt;&lt;tr&gt;"
+                     "&lt;td width=&quot;80&quot; align=&quot;center&quot; valign=&quot;top&quot;&gt;&lt;font style=&quot;font-size:85%%&quot;&gt;"
+                     "&lt;img src=&quot;http://nt0.ggpht.com/news/tbn/%d&quot; border=&quot;1&quot; width=&quot;80&quot; height=&quot;80&quot; /&gt;"
+                     "&lt;/font&gt;&lt;/td&gt;&lt;td valign=&quot;top&quot;&gt;&lt;font size=&quot;-1&quot;&gt;Lorem ipsum dolor sit amet, "
+                     "consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore et dolore magna aliqua.&lt;/font&gt;&lt;/td&gt;&lt;/tr&gt;&lt;/table&gt;";
+  
+  cxu32 capacity = 2048 * (itemCount + 1);
+  char *data = cx_malloc (capacity);
+  cxu32 len = 0;
+  
+  len += snprintf (data + len, capacity - len, "<?xml version=\"1.0\" encoding=\"UTF-8\"?><rss version=\"2.0\"><channel>"
+                   "<title>Top Stories</title><link>http://news.google.com/news?pz=1&amp;ned=us&amp;hl=en</link>"
+                   "<language>en</language><ttl>15</ttl>\n");
+  
+  for (int i = 0; i < itemCount; ++i)
+  {
+    len += snprintf (data + len, capacity - len, "<item><title>Headline number %d &amp; its &quot;subtitle&quot; - The Source</title>"
+                     "<link>http://news.google.com/news/url?sa=t&amp;fd=R&amp;usg=AFQjCN%d&amp;url=http://www.example.com/story/%d</link>"
+                     "<guid isPermaLink=\"false\">tag:news.google.com,2005:cluster=%d</guid><category>Top Stories</category>"
+                     "<pubDate>Fri, 21 Jun 2013 %02d:%02d:00 GMT</pubDate><description>", i, i, i, i, i % 24, i % 60);
+    len += snprintf (data + len, capacity - len, desc, i);
+    len += snprintf (data + len, capacity - len, "</description></item>\n");
+  }
+  
+  len += snprintf (data + len, capacity - len, "</channel></rss>\n");
+  
+  CX_ASSERT (len < capacity);
+  
+  *size = len;
+  
+  return data;
+}
+
+static void bench_xml_sax_begin (void *userdata, const char *name, const char *nsprefix, const cx_xml_sax_attr *attrs, cxu32 attrCount)
+{
+  bench_xml_feed *feed = (bench_xml_feed *) userdata;
+  
+  int depth = feed->depth++; // rss = 0, channel = 1, item = 2
+  
+  feed->field = NULL;
+  
+  if (depth == 3)
+  {
+    if (strcmp (name, "title") == 0)
+    {
+      feed->field = feed->title;
+      feed->fieldSize = sizeof (feed->title);
+    }
+    else if (strcmp (name, "link") == 0)
+    {
+      feed->field = feed->link;
+      feed->fieldSize = sizeof (feed->link);
+    }
+    else if (strcmp (name, "pubDate") == 0)
+    {
+      feed->field = feed->pubDate;
+      feed->fieldSize = sizeof (feed->pubDate);
+    }
+    
+    feed->textLen = 0;
+  }
+}
+
+static void bench_xml_sax_end (void *userdata, const char *name, const char *nsprefix)
+{
+  bench_xml_feed *feed = (bench_xml_feed *) userdata;
+  
+  int depth = --feed->depth;
+  
+  if (feed->field && (depth == 3))
+  {
+    feed->text [feed->textLen] = 0;
+    cx_strcpy (feed->field, feed->fieldSize, feed->text);
+    feed->field = NULL;
+  }
+  else if (depth == 2)
+  {
+    feed->itemCount++;
+  }
+}
+
+static void bench_xml_sax_characters (void *userdata, const char *text, cxu32 textLength)
+{
+  bench_xml_feed *feed = (bench_xml_feed *) userdata;
+  
+  if (feed->field)
+  {
+    cxu32 avail = (BENCH_XML_TEXT_MAX_LEN - 1) - feed->textLen;
+    cxu32 len = (textLength < avail) ? textLength : avail;
+    
+    memcpy (feed->text + feed->textLen, text, len);
+    feed->textLen += len;
+  }
+}
+
+static int bench_xml_parse_sax (const char *data, cxu32 size)
+{
+  bench_xml_feed feed;
+  memset (&feed, 0, sizeof (feed));
+  
+  cx_xml_sax_callbacks callbacks;
+  callbacks.element_begin = bench_xml_sax_begin;
+  callbacks.element_end = bench_xml_sax_end;
+  callbacks.characters = bench_xml_sax_characters;
+  
+  cx_xml_sax_parse (data, size, &callbacks, &feed);
+  
+  return feed.itemCount;
+}
+
+static int bench_xml_parse_dom (const char *data, cxu32 size)
+{
+  // the dom walk feeds.m did before the sax parser
+  
+  int itemCount = 0;
+  
+  cx_xml_doc doc = cx_xml_doc_create (data, size);
+  
+  if (doc)
+  {
+    cx_xml_node channelNode = cx_xml_node_child (cx_xml_doc_root_node (doc), "channel", NULL);
+    cx_xml_node child = cx_xml_node_first_child (channelNode);
+    
+    while (child)
+    {
+      if (strcmp (cx_xml_node_name (child), "item") == 0)
+      {
+        char *title = cx_xml_node_content (cx_xml_node_child (child, "title", NULL));
+        char *link = cx_xml_node_content (cx_xml_node_child (child, "link", NULL));
+        char *pubDate = cx_xml_node_content (cx_xml_node_child (child, "pubDate", NULL));
+        
+        itemCount += (title && link && pubDate) ? 1 : 0;
+        
+        cx_free (title);
+        cx_free (link);
+        cx_free (pubDate);
+      }
+      
+      child = cx_xml_node_next_sibling (child);
+    }
+    
+    cx_xml_doc_destroy (doc);
+  }
+  
+  return itemCount;
+}
+
+static void bench_xml (void)
+{
+  // news feed parse through the sax callbacks vs building and walking a dom
+  
+  const char *names [2] = { "dom", "sax" };
+  int (*parse [2]) (const char *data, cxu32 size) = { bench_xml_parse_dom, bench_xml_parse_sax };
+  
+  cxu32 size = 0;
+  char *data = bench_xml_create_feed (BENCH_XML_ITEMS, &size);
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    int items = 0;
+    
+    cx_timer timer;
+    cx_time_start_timer (&timer);
+    
+    for (int i = 0; i < BENCH_XML_PARSES; ++i)
+    {
+      items += parse [p] (data, size);
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    CX_ASSERT (items == (BENCH_XML_ITEMS * BENCH_XML_PARSES));
+    
+    cxf64 mbs = ((cxf64) size * BENCH_XML_PARSES) / (timer.elapsedTime * 1e-3) / (1024.0 * 1024.0);
+    
+    printf ("bench: xml %s %d items (%u KB) %.3f ms per parse, %.1f MB/s\n", names [p], BENCH_XML_ITEMS, size / 1024, 
+            timer.elapsedTime / BENCH_XML_PARSES, mbs);
+  }
+  
+  cx_free (data);
+  
+  // peak rss of one parse of a large feed, each path in its own process so neither sees the other's peak
+  
+  data = bench_xml_create_feed (BENCH_XML_LARGE_ITEMS, &size);
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    fflush (stdout);
+    
+    pid_t pid = fork ();
+    
+    if (pid == 0)
+    {
+      long rss = bench_peak_rss_kb ();
+      
+      parse [p] (data, size);
+      
+      printf ("bench: xml %s %d items (%u KB) peak rss +%ld KB\n", names [p], BENCH_XML_LARGE_ITEMS, size / 1024, bench_peak_rss_kb () - rss);
+      fflush (stdout);
+      
+      _exit (0);
+    }
+    
+    waitpid (pid, NULL, 0);
+  }
+  
+  cx_free (data);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int bench_json_lookups (cx_json_node node)
+{
+  int count = 0;
+  
+  if (cx_json_node_type (node) == CX_JSON_TYPE_OBJECT)
+  {
+    for (cxu32 i = 0, c = cx_json_object_length (node); i < c; ++i)
+    {
+      cx_json_node child = cx_json_object_child (node, cx_json_object_child_key (node, i));
+      
+      count += bench_json_lookups (child) + 1;
+    }
+  }
+  else if (cx_json_node_type (node) == CX_JSON_TYPE_ARRAY)
+  {
+    for (cxu32 i = 0, c = cx_json_array_size (node); i < c; ++i)
+    {
+      count += bench_json_lookups (cx_json_array_member (node, i));
+    }
+  }
+  
+  return count;
+}
+
+static void bench_json_tree (const char *name, const char *data, cxu32 dataSize)
+{
+  const cxu32 flags [3] = { CX_JSON_TREE_FLAG_NONE, CX_JSON_TREE_FLAG_ARENA, CX_JSON_TREE_FLAG_ARENA | CX_JSON_TREE_FLAG_KEY_INDEX };
+  const int parseCount = 100;
+  
+  cx_timer timer;
+  
+  for (int f = 0; f < 3; ++f)
+  {
+    cx_time_start_timer (&timer);
+    
+    for (int i = 0; i < parseCount; ++i)
+    {
+      cx_json_tree_destroy (cx_json_tree_create_ex (data, dataSize, flags [f]));
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    cxf64 parseTime = timer.elapsedTime / (cxf64) parseCount;
+    
+    cx_json_tree jsonTree = cx_json_tree_create_ex (data, dataSize, flags [f]);
+    
+    cx_json_tree_stats stats;
+    cx_json_tree_get_stats (jsonTree, &stats);
+    
+    int lookupCount = 0;
+    
+    cx_time_start_timer (&timer);
+    
+    for (int i = 0; i < parseCount; ++i)
+    {
+      lookupCount += bench_json_lookups (cx_json_tree_root_node (jsonTree));
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_json_tree_destroy (jsonTree);
+    
+    printf ("bench: json %s (%u KB) flags %u parse %.3f ms, %.2f M lookups/s, allocs %u (%u KB), key indices %u\n", 
+            name, dataSize / 1024, flags [f], parseTime, (lookupCount / timer.elapsedTime) * 1e-3, 
+            stats.allocCount, stats.allocBytes / 1024, stats.keyIndexCount);
+  }
+}
+
+static char *bench_json_create_timeline (int statusCount, cxu32 *size)
+{
+  // search api v1.1 shaped timeline: 25 key statuses with a 40 key user object each
+  
+  cxu32 capacity = 2560 * (statusCount + 1);
+  char *data = cx_malloc (capacity);
+  cxu32 len = 0;
+  
+  len += snprintf (data + len, capacity - len, "{\"statuses\":[");
+  
+  for (int i = 0; i < statusCount; ++i)
+  {
+    len += snprintf (data + len, capacity - len, "%s{\"metadata\":{\"result_type\":\"recent\",\"iso_language_code\":\"en\"},"
+                     "\"created_at\":\"Fri Jun 21 12:%02d:%02d +0000 2013\",\"id\":3479%08d,\"id_str\":\"3479%08d\","
+                     "\"text\":\"Status number %d from the city, with a link http:\\/\\/t.co\\/abc%d #news \\u00e9\","
+                     "\"source\":\"<a href=\\\"http:\\/\\/twitter.com\\/download\\/iphone\\\" rel=\\\"nofollow\\\">Twitter for iPhone<\\/a>\","
+                     "\"truncated\":false,\"in_reply_to_status_id\":null,\"in_reply_to_status_id_str\":null,"
+                     "\"in_reply_to_user_id\":null,\"in_reply_to_user_id_str\":null,\"in_reply_to_screen_name\":null,",
+                     (i > 0) ? "," : "", i % 60, (i * 7) % 60, i, i, i, i);
+    
+    len += snprintf (data + len, capacity - len, "\"user\":{\"id\":%d,\"id_str\":\"%d\",\"name\":\"User %d\",\"screen_name\":\"user%d\","
+                     "\"location\":\"London\",\"description\":\"Reading the news, all of it, every day of the week.\",\"url\":null,"
+                     "\"entities\":{\"description\":{\"urls\":[]}},\"protected\":false,\"followers_count\":%d,\"friends_count\":%d,"
+                     "\"listed_count\":3,\"created_at\":\"Mon Mar 05 10:11:12 +0000 2012\",\"favourites_count\":12,\"utc_offset\":3600,"
+                     "\"time_zone\":\"London\",\"geo_enabled\":true,\"verified\":false,\"statuses_count\":%d,\"lang\":\"en\","
+                     "\"contributors_enabled\":false,\"is_translator\":false,\"profile_background_color\":\"C0DEED\","
+                     "\"profile_background_image_url\":\"http:\\/\\/a0.twimg.com\\/images\\/themes\\/theme1\\/bg.png\","
+                     "\"profile_background_image_url_https\":\"https:\\/\\/si0.twimg.com\\/images\\/themes\\/theme1\\/bg.png\","
+                     "\"profile_background_tile\":false,\"profile_image_url\":\"http:\\/\\/a0.twimg.com\\/profile_images\\/%d\\/a_normal.jpeg\","
+                     "\"profile_image_url_https\":\"https:\\/\\/si0.twimg.com\\/profile_images\\/%d\\/a_normal.jpeg\","
+                     "\"profile_link_color\":\"0084B4\",\"profile_sidebar_border_color\":\"C0DEED\",\"profile_sidebar_fill_color\":\"DDEEF6\","
+                     "\"profile_text_color\":\"333333\",\"profile_use_background_image\":true,\"default_profile\":true,"
+                     "\"default_profile_image\":false,\"following\":null,\"follow_request_sent\":null,\"notifications\":null},",
+                     i, i, i, i, i * 3, i * 2, i * 11, i, i);
+    
+    len += snprintf (data + len, capacity - len, "\"geo\":null,\"coordinates\":null,\"place\":null,\"contributors\":null,"
+                     "\"retweet_count\":%d,\"favorite_count\":%d,\"entities\":{\"hashtags\":[{\"text\":\"news\",\"indices\":[60,65]}],"
+                     "\"symbols\":[],\"urls\":[{\"url\":\"http:\\/\\/t.co\\/abc%d\",\"expanded_url\":\"http:\\/\\/www.example.com\\/%d\","
+                     "\"display_url\":\"example.com\\/%d\",\"indices\":[40,59]}],\"user_mentions\":[]},"
+                     "\"favorited\":false,\"retweeted\":false,\"possibly_sensitive\":false,\"lang\":\"en\"}",
+                     i % 5, i % 3, i, i, i);
+  }
+  
+  len += snprintf (data + len, capacity - len, "],\"search_metadata\":{\"completed_in\":0.031,\"max_id\":347900000400,"
+                   "\"max_id_str\":\"347900000400\",\"next_results\":\"?max_id=3479&q=london\",\"query\":\"london\","
+                   "\"refresh_url\":\"?since_id=3479&q=london\",\"count\":%d,\"since_id\":0,\"since_id_str\":\"0\"}}", statusCount);
+  
+  CX_ASSERT (len < capacity);
+  
+  *size = len;
+  
+  return data;
+}
+
+static void bench_json (void)
+{
+  // parse and lookups per tree mode. twitter.json is a captured search timeline, copy one to
+  // CX_DOCUMENTS_PATH to include it
+  
+  const char *files [2] = { "data/earth.json", "twitter.json" };
+  const cx_file_storage_base bases [2] = { CX_FILE_STORAGE_BASE_RESOURCE, CX_FILE_STORAGE_BASE_DOCUMENTS };
+  
+  for (int f = 0; f < 2; ++f)
+  {
+    cxu8 *filedata = NULL;
+    cxu32 filedataSize = 0;
+    
+    if (cx_file_storage_load_contents (&filedata, &filedataSize, files [f], bases [f]))
+    {
+      bench_json_tree (files [f], (const char *) filedata, filedataSize);
+      
+      cx_free (filedata);
+    }
+  }
+  
+  cxu32 size = 0;
+  char *data = bench_json_create_timeline (400, &size);
+  
+  bench_json_tree ("synthetic timeline", data, size);
+  
+  cx_free (data);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_SIMD_COUNT        (4096)
+
+static cx_vec4 g_benchSimdIn0 [BENCH_SIMD_COUNT];
+static cx_vec4 g_benchSimdIn1 [BENCH_SIMD_COUNT];
+static cx_mat4x4 g_benchSimdMat [BENCH_SIMD_COUNT / 4];
+static cxf32 g_benchSimdSoa [4][BENCH_SIMD_COUNT];
+static cxf32 g_benchSimdOut [2][BENCH_SIMD_COUNT * 4] CX_ALIGN(32);
+
+typedef void (*bench_simd_func) (cxf32 *out);
+
+static void bench_simd_dot (cxf32 *out)
+{
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    out [i] = cx_vec4_dot (&g_benchSimdIn0 [i], &g_benchSimdIn1 [i]);
+  }
+}
+
+static void bench_simd_dot_ref (cxf32 *out)
+{
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    const cx_vec4 *v0 = &g_benchSimdIn0 [i];
+    const cx_vec4 *v1 = &g_benchSimdIn1 [i];
+    out [i] = (v0->x * v1->x) + (v0->y * v1->y) + (v0->z * v1->z) + (v0->w * v1->w);
+  }
+}
+
+static void bench_simd_normalize (cxf32 *out)
+{
+  cx_vec4 *v = (cx_vec4 *) out;
+  
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    v [i] = g_benchSimdIn0 [i];
+    cx_vec4_normalize (&v [i]);
+  }
+}
+
+static void bench_simd_normalize_ref (cxf32 *out)
+{
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    const cx_vec4 *v = &g_benchSimdIn0 [i];
+    cxf32 s = 1.0f / sqrtf ((v->x * v->x) + (v->y * v->y) + (v->z * v->z) + (v->w * v->w));
+    out [(i * 4) + 0] = v->x * s;
+    out [(i * 4) + 1] = v->y * s;
+    out [(i * 4) + 2] = v->z * s;
+    out [(i * 4) + 3] = v->w * s;
+  }
+}
+
+static void bench_simd_cross (cxf32 *out)
+{
+  cx_vec4 *v = (cx_vec4 *) out;
+  
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    cx_vec4_cross (&v [i], &g_benchSimdIn0 [i], &g_benchSimdIn1 [i]);
+  }
+}
+
+static void bench_simd_cross_ref (cxf32 *out)
+{
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    const cx_vec4 *v0 = &g_benchSimdIn0 [i];
+    const cx_vec4 *v1 = &g_benchSimdIn1 [i];
+    out [(i * 4) + 0] = (v0->y * v1->z) - (v0->z * v1->y);
+    out [(i * 4) + 1] = (v0->z * v1->x) - (v0->x * v1->z);
+    out [(i * 4) + 2] = (v0->x * v1->y) - (v0->y * v1->x);
+    out [(i * 4) + 3] = 0.0f;
+  }
+}
+
+static void bench_simd_mat_mul (cxf32 *out)
+{
+  cx_mat4x4 *m = (cx_mat4x4 *) out;
+  
+  for (int i = 0; i < (BENCH_SIMD_COUNT / 4); ++i)
+  {
+    cx_mat4x4_mul (&m [i], &g_benchSimdMat [i], &g_benchSimdMat [(i + 1) % (BENCH_SIMD_COUNT / 4)]);
+  }
+}
+
+static void bench_simd_mat_mul_ref (cxf32 *out)
+{
+  for (int i = 0; i < (BENCH_SIMD_COUNT / 4); ++i)
+  {
+    const cxf32 *a = g_benchSimdMat [i].f16;
+    const cxf32 *b = g_benchSimdMat [(i + 1) % (BENCH_SIMD_COUNT / 4)].f16;
+    
+    for (int c = 0; c < 4; ++c)
+    {
+      for (int r = 0; r < 4; ++r)
+      {
+        out [(i * 16) + (c * 4) + r] = (a [r] * b [c * 4]) + (a [r + 4] * b [(c * 4) + 1]) + (a [r + 8] * b [(c * 4) + 2]) + (a [r + 12] * b [(c * 4) + 3]);
+      }
+    }
+  }
+}
+
+static void bench_simd_transpose (cxf32 *out)
+{
+  cx_mat4x4 *m = (cx_mat4x4 *) out;
+  
+  for (int i = 0; i < (BENCH_SIMD_COUNT / 4); ++i)
+  {
+    cx_mat4x4_transpose (&m [i], &g_benchSimdMat [i]);
+  }
+}
+
+static void bench_simd_transpose_ref (cxf32 *out)
+{
+  for (int i = 0; i < (BENCH_SIMD_COUNT / 4); ++i)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      for (int r = 0; r < 4; ++r)
+      {
+        out [(i * 16) + (c * 4) + r] = g_benchSimdMat [i].f16 [(r * 4) + c];
+      }
+    }
+  }
+}
+
+static void bench_simd_mul_vec4_ref (cxf32 *out)
+{
+  const cxf32 *m = g_benchSimdMat [0].f16;
+  
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    const cx_vec4 *v = &g_benchSimdIn0 [i];
+    out [(i * 4) + 0] = (m [0] * v->x) + (m [4] * v->y) + (m [8] * v->z) + (m [12] * v->w);
+    out [(i * 4) + 1] = (m [1] * v->x) + (m [5] * v->y) + (m [9] * v->z) + (m [13] * v->w);
+    out [(i * 4) + 2] = (m [2] * v->x) + (m [6] * v->y) + (m [10] * v->z) + (m [14] * v->w);
+    out [(i * 4) + 3] = (m [3] * v->x) + (m [7] * v->y) + (m [11] * v->z) + (m [15] * v->w);
+  }
+}
+
+static void bench_simd_mul_vec4 (cxf32 *out)
+{
+  cx_vec4 *v = (cx_vec4 *) out;
+  
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    cx_mat4x4_mul_vec4 (&v [i], &g_benchSimdMat [0], &g_benchSimdIn0 [i]);
+  }
+}
+
+static void bench_simd_mul_vec4_array (cxf32 *out)
+{
+  cx_mat4x4_mul_vec4_array ((cx_vec4 *) out, &g_benchSimdMat [0], g_benchSimdIn0, BENCH_SIMD_COUNT);
+}
+
+static void bench_simd_mul_vec4_soa (cxf32 *out)
+{
+  cx_vec4_soa src = { g_benchSimdSoa [0], g_benchSimdSoa [1], g_benchSimdSoa [2], g_benchSimdSoa [3] };
+  cx_vec4_soa dst = { out, out + BENCH_SIMD_COUNT, out + (BENCH_SIMD_COUNT * 2), out + (BENCH_SIMD_COUNT * 3) };
+  
+  cx_mat4x4_mul_vec4_soa (&dst, &g_benchSimdMat [0], &src, BENCH_SIMD_COUNT);
+}
+
+static void bench_simd_mul_vec4_soa_ref (cxf32 *out)
+{
+  const cxf32 *m = g_benchSimdMat [0].f16;
+  
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    cxf32 x = g_benchSimdSoa [0][i], y = g_benchSimdSoa [1][i], z = g_benchSimdSoa [2][i], w = g_benchSimdSoa [3][i];
+    
+    for (int r = 0; r < 4; ++r)
+    {
+      out [(r * BENCH_SIMD_COUNT) + i] = (m [r] * x) + (m [r + 4] * y) + (m [r + 8] * z) + (m [r + 12] * w);
+    }
+  }
+}
+
+static cxi64 bench_simd_ulp (cxf32 a, cxf32 b)
+{
+  cxi32 ia, ib;
+  memcpy (&ia, &a, sizeof (ia));
+  memcpy (&ib, &b, sizeof (ib));
+  
+  cxi64 la = (ia < 0) ? ((cxi64) INT32_MIN - ia) : ia;
+  cxi64 lb = (ib < 0) ? ((cxi64) INT32_MIN - ib) : ib;
+  
+  return (la > lb) ? (la - lb) : (lb - la);
+}
+
+static void bench_simd (void)
+{
+  // scalar reference vs simd path, throughput and accuracy (ulp, or absolute error when the
+  // result is near zero after cancellation)
+  
+  const struct { const char *name; bench_simd_func simd, ref; int outCount; cxi64 maxUlp; } kernels [] =
+  {
+    { "vec4_dot",            bench_simd_dot,            bench_simd_dot_ref,          BENCH_SIMD_COUNT,     4 },
+    { "vec4_normalize",      bench_simd_normalize,      bench_simd_normalize_ref,    BENCH_SIMD_COUNT * 4, 4 },
+    { "vec4_cross",          bench_simd_cross,          bench_simd_cross_ref,        BENCH_SIMD_COUNT * 4, 0 },
+    { "mat4x4_mul",          bench_simd_mat_mul,        bench_simd_mat_mul_ref,      BENCH_SIMD_COUNT * 4, 0 },
+    { "mat4x4_transpose",    bench_simd_transpose,      bench_simd_transpose_ref,    BENCH_SIMD_COUNT * 4, 0 },
+    { "mat4x4_mul_vec4",     bench_simd_mul_vec4,       bench_simd_mul_vec4_ref,     BENCH_SIMD_COUNT * 4, 0 },
+    { "mat4x4_mul_vec4_aos", bench_simd_mul_vec4_array, bench_simd_mul_vec4_ref,     BENCH_SIMD_COUNT * 4, 0 },
+    { "mat4x4_mul_vec4_soa", bench_simd_mul_vec4_soa,   bench_simd_mul_vec4_soa_ref, BENCH_SIMD_COUNT * 4, 0 },
+  };
+  
+  const int repeatCount = 1000;
+  const cxf32 maxAbsErr = 1.0e-6f;
+  
+  for (int i = 0; i < BENCH_SIMD_COUNT; ++i)
+  {
+    cxf32 r [8];
+    
+    for (int j = 0; j < 8; ++j)
+    {
+      r [j] = ((rand () / (cxf32) RAND_MAX) * 2.0f) - 1.0f;
+    }
+    
+    cx_vec4_set (&g_benchSimdIn0 [i], r [0], r [1], r [2], r [3] + 2.0f);
+    cx_vec4_set (&g_benchSimdIn1 [i], r [4], r [5], r [6], r [7]);
+    
+    g_benchSimdSoa [0][i] = r [0];
+    g_benchSimdSoa [1][i] = r [1];
+    g_benchSimdSoa [2][i] = r [2];
+    g_benchSimdSoa [3][i] = r [3] + 2.0f;
+    
+    g_benchSimdMat [i / 4].f16 [((i % 4) * 4) + 0] = r [4] * 4.0f;
+    g_benchSimdMat [i / 4].f16 [((i % 4) * 4) + 1] = r [5] * 4.0f;
+    g_benchSimdMat [i / 4].f16 [((i % 4) * 4) + 2] = r [6] * 4.0f;
+    g_benchSimdMat [i / 4].f16 [((i % 4) * 4) + 3] = r [7] * 4.0f;
+  }
+  
+  for (unsigned int k = 0; k < sizeof (kernels) / sizeof (kernels [0]); ++k)
+  {
+    cx_timer timer;
+    cxf64 elapsed [2];
+    
+    for (int p = 0; p < 2; ++p)
+    {
+      bench_simd_func func = (p == 0) ? kernels [k].ref : kernels [k].simd;
+      
+      cx_time_start_timer (&timer);
+      
+      for (int r = 0; r < repeatCount; ++r)
+      {
+        func (g_benchSimdOut [p]);
+      }
+      
+      cx_time_stop_timer (&timer);
+      
+      elapsed [p] = timer.elapsedTime;
+    }
+    
+    cxi64 ulp = 0;
+    cxf32 err = 0.0f;
+    bool pass = true;
+    
+    for (int i = 0; i < kernels [k].outCount; ++i)
+    {
+      cxi64 u = bench_simd_ulp (g_benchSimdOut [0][i], g_benchSimdOut [1][i]);
+      cxf32 e = fabsf (g_benchSimdOut [0][i] - g_benchSimdOut [1][i]);
+      
+      ulp = cx_max (ulp, u);
+      err = cx_max (err, e);
+      pass &= (u <= kernels [k].maxUlp) || (e <= maxAbsErr);
+    }
+    
+    printf ("bench: simd %-20s scalar %7.3f ms simd %7.3f ms (x%.2f) max ulp %lld max err %g %s\n", 
+            kernels [k].name, elapsed [0], elapsed [1], elapsed [0] / elapsed [1], (long long) ulp, err, pass ? "ok" : "FAILED");
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_projection_run (int count)
+{
+  // old per-city projection loop vs batch. the mask is also taken without and with a sprite sized 
+  // margin to show how many points near the edges it keeps
+  
+  cx_vec4 *pos = cx_malloc (sizeof (cx_vec4) * count);
+  cx_vec4 *nor = cx_malloc (sizeof (cx_vec4) * count);
+  cx_vec4 *screen [2] = { cx_malloc (sizeof (cx_vec4) * count), cx_malloc (sizeof (cx_vec4) * count) };
+  cx_vec2 *opacity [2] = { cx_malloc (sizeof (cx_vec2) * count), cx_malloc (sizeof (cx_vec2) * count) };
+  cxu8 *visible [2] = { cx_malloc (sizeof (cxu8) * count), cx_malloc (sizeof (cxu8) * count) };
+  
+  for (int i = 0; i < count; ++i)
+  {
+    float lat = cx_rad (((rand () / (float) RAND_MAX) * 180.0f) - 90.0f);
+    float lon = cx_rad (((rand () / (float) RAND_MAX) * 360.0f) - 180.0f);
+    
+    cx_vec4_set (&nor [i], cx_cos (lat) * cx_sin (lon), cx_sin (lat), cx_cos (lat) * cx_cos (lon), 0.0f);
+    cx_vec4_set (&pos [i], nor [i].x * 1.025f, nor [i].y * 1.025f, nor [i].z * 1.025f, 1.0f);
+  }
+  
+  const float width = BENCH_HEIGHT;
+  const float height = BENCH_WIDTH;
+  
+  cx_mat4x4 proj, view;
+  cx_vec4 eye = {{ 0.0f, 0.0f, 1.8f, 1.0f }};
+  cx_vec4 target = {{ 0.0f, 0.0f, 0.0f, 1.0f }};
+  cx_vec4 up = {{ 0.0f, 1.0f, 0.0f, 0.0f }};
+  
+  cx_mat4x4_perspective (&proj, cx_rad (65.0f), width / height, 0.1f, 100.0f);
+  cx_util_look_at (&view, &eye, &target, &up);
+  
+  cx_vec4 look;
+  cx_vec4_sub (&look, &eye, &target);
+  cx_vec4_normalize (&look);
+  
+  const cx_vec4 fade = {{ 0.95f, 1.0f, 0.80f, 1.0f }};
+  const cx_vec2 margin = {{ 8.0f, 8.0f }};
+  const int repeatCount = cx_max (1, 2000000 / count);
+  
+  cx_timer timer;
+  cxf64 elapsed [2];
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    cx_time_start_timer (&timer);
+    
+    for (int r = 0; r < repeatCount; ++r)
+    {
+      if (p == 0)
+      {
+        for (int i = 0; i < count; ++i)
+        {
+          cx_vec2 s;
+          
+          cx_util_world_space_to_screen_space (width, height, &proj, &view, &pos [i], &s, &screen [0][i].z, &screen [0][i].w);
+          
+          screen [0][i].x = s.x;
+          screen [0][i].y = s.y;
+          
+          float dotp = cx_max (0.0f, cx_vec4_dot (&nor [i], &look));
+          
+          opacity [0][i].x = cx_smoothstep (fade.x, fade.y, dotp);
+          opacity [0][i].y = cx_smoothstep (fade.z, fade.w, dotp);
+        }
+      }
+      else
+      {
+        cx_util_world_space_to_screen_space_batch (width, height, &proj, &view, pos, nor, count, &look, &fade, &margin, 
+                                                   screen [1], opacity [1], visible [1]);
+      }
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    elapsed [p] = timer.elapsedTime;
+  }
+  
+  cx_util_world_space_to_screen_space_batch (width, height, &proj, &view, pos, nor, count, &look, &fade, NULL, 
+                                             screen [1], opacity [1], visible [0]);
+  
+  float err = 0.0f;
+  int visibleCount [2] = { 0, 0 };
+  bool pass = true;
+  
+  for (int i = 0; i < count; ++i)
+  {
+    for (int j = 0; j < 4; ++j)
+    {
+      err = cx_max (err, fabsf (screen [0][i].f4 [j] - screen [1][i].f4 [j]) / cx_max (1.0f, fabsf (screen [0][i].f4 [j])));
+    }
+    
+    err = cx_max (err, fabsf (opacity [0][i].x - opacity [1][i].x));
+    err = cx_max (err, fabsf (opacity [0][i].y - opacity [1][i].y));
+    
+    // the margin mask is a superset, and only adds points within the margin of an edge
+    
+    const cx_vec4 *s = &screen [1][i];
+    
+    bool edge = (s->x >= -margin.x) && (s->x <= (width + margin.x)) && (s->y >= -margin.y) && (s->y <= (height + margin.y));
+    
+    pass &= !visible [0][i] || visible [1][i];
+    pass &= (visible [0][i] == visible [1][i]) || edge;
+    
+    visibleCount [0] += visible [0][i];
+    visibleCount [1] += visible [1][i];
+  }
+  
+  pass &= (err < 1.0e-5f);
+  
+  cxf64 perCity = 1.0e6 / ((cxf64) count * repeatCount);
+  
+  printf ("bench: projection %6d cities, per city %.2f ns -> batch %.2f ns, visible %d (%d with margin), max rel err %g %s\n", 
+          count, elapsed [0] * perCity, elapsed [1] * perCity, visibleCount [0], visibleCount [1], err, pass ? "ok" : "FAILED");
+  
+  cx_free (pos);
+  cx_free (nor);
+  cx_free (screen [0]);
+  cx_free (screen [1]);
+  cx_free (opacity [0]);
+  cx_free (opacity [1]);
+  cx_free (visible [0]);
+  cx_free (visible [1]);
+}
+
+static void bench_projection (void)
+{
+  bench_projection_run (200);
+  bench_projection_run (10000);
+  bench_projection_run (100000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_word_filter_run (const char **words, int wordCount, const char *name)
+{
+  // brute-force strcasestr filter vs automaton over a synthetic tweet corpus
+  
+  static const char *corpusWords [] = 
+  {
+    "the", "news", "today", "breaking", "rain", "in", "london", "is", "classic", "assassin", "Passage", "SHIT", 
+    "weather", "@user", "#tag", "http://t.co/x1", "bass", "Scunthorpe", "Zürich", "café", "Москва", "ΑΘΗΝΑ", 
+    "東京", "Bitch", "tits", "title", "cocktail", "dickens", "grass", "lol", "rt", "so", "good", "night"
+  };
+  
+  const int corpusWordCount = sizeof (corpusWords) / sizeof (corpusWords [0]);
+  const int tweetCount = 2000;
+  const int tweetSize = 160;
+  
+  char *tweets = cx_malloc (tweetCount * tweetSize);
+  char *out [2] = { cx_malloc (tweetCount * tweetSize), cx_malloc (tweetCount * tweetSize) };
+  
+  cxu32 corpusSize = 0;
+  
+  for (int t = 0; t < tweetCount; ++t)
+  {
+    char *tweet = &tweets [t * tweetSize];
+    int len = 0;
+    
+    tweet [0] = 0;
+    
+    for (;;)
+    {
+      const char *w = ((rand () % 8) == 0) ? words [rand () % wordCount] : corpusWords [rand () % corpusWordCount];
+      
+      w += (w [0] == '@') ? 1 : 0;
+      
+      int wlen = (int) strlen (w);
+      
+      if ((len + wlen + 2) >= tweetSize)
+      {
+        break;
+      }
+      
+      memcpy (&tweet [len], w, wlen);
+      len += wlen;
+      tweet [len++] = ((rand () % 6) == 0) ? '.' : ' ';
+      tweet [len] = 0;
+    }
+    
+    corpusSize += len;
+  }
+  
+  cx_timer timer;
+  cxf64 elapsed [2];
+  int filterCount [2];
+  
+  cx_time_start_timer (&timer);
+  
+  cx_word_filter *filter = cx_util_word_filter_create (words, wordCount);
+  
+  cx_time_stop_timer (&timer);
+  
+  cxf64 buildTime = timer.elapsedTime;
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    // brute force is O(text * words), so only time a slice of the corpus for long lists
+    
+    filterCount [p] = (p == 0) ? cx_min (tweetCount, cx_max (10, 2000000 / wordCount)) : tweetCount;
+    
+    cx_time_start_timer (&timer);
+    
+    for (int t = 0; t < filterCount [p]; ++t)
+    {
+      char *tweet = &out [p][t * tweetSize];
+      
+      memcpy (tweet, &tweets [t * tweetSize], tweetSize);
+      
+      if (p == 0)
+      {
+        cx_util_word_filter (tweet, words, wordCount, '*');
+      }
+      else
+      {
+        cx_util_word_filter_apply (filter, tweet, '*');
+      }
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    elapsed [p] = timer.elapsedTime;
+  }
+  
+  // results only differ where matches overlap (brute force masks words one after another so
+  // a later word can miss text already masked) or where non-ascii case folding applies
+  
+  int diffCount = 0;
+  
+  for (int t = 0; t < filterCount [0]; ++t)
+  {
+    diffCount += (strcmp (&out [0][t * tweetSize], &out [1][t * tweetSize]) != 0);
+  }
+  
+  cxf64 bytes [2] = { (cxf64) corpusSize * filterCount [0] / tweetCount, (cxf64) corpusSize };
+  
+  printf ("bench: word filter %-8s %5d words, build %.2f ms, brute %.2f MB/s, automaton %.2f MB/s (x%.1f), differ %d/%d\n", 
+          name, wordCount, buildTime, bytes [0] / (elapsed [0] * 1000.0), bytes [1] / (elapsed [1] * 1000.0), 
+          (elapsed [0] / bytes [0]) / (elapsed [1] / bytes [1]), diffCount, filterCount [0]);
+  
+  cx_util_word_filter_destroy (filter);
+  
+  cx_free (tweets);
+  cx_free (out [0]);
+  cx_free (out [1]);
+}
+
+static void bench_word_filter (void)
+{
+  // shipped list and a synthetic 10k word list (1 in 10 whole word)
+  
+  cxu8 *filedata = NULL;
+  cxu32 filedataSize = 0;
+  
+  if (cx_file_storage_load_contents (&filedata, &filedataSize, "data/profanity.list", CX_FILE_STORAGE_BASE_RESOURCE))
+  {
+    char *words [128];
+    
+    cxu32 wordCount = cx_str_explode (words, 128, (const char *) filedata, ',');
+    
+    bench_word_filter_run ((const char **) words, wordCount, "list");
+    
+    for (cxu32 i = 0; i < wordCount; ++i)
+    {
+      cx_free (words [i]);
+    }
+    
+    cx_free (filedata);
+  }
+  
+  const int wordCount = 10000;
+  
+  char **words = cx_malloc (sizeof (char *) * wordCount);
+  
+  for (int i = 0; i < wordCount; ++i)
+  {
+    int len = 4 + (rand () % 5);
+    int k = 0;
+    
+    words [i] = cx_malloc (len + 2);
+    
+    if ((i % 10) == 0)
+    {
+      words [i][k++] = '@';
+    }
+    
+    while (len--)
+    {
+      words [i][k++] = 'a' + (rand () % 26);
+    }
+    
+    words [i][k] = 0;
+  }
+  
+  bench_word_filter_run ((const char **) words, wordCount, "10k");
+  
+  for (int i = 0; i < wordCount; ++i)
+  {
+    cx_free (words [i]);
+  }
+  
+  cx_free (words);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_font_labels (void)
+{
+  // city label set (name + time) per frame: run cache off, on, and on with batching. times cpu side 
+  // submission. then a word wrapped news headline, which always lays out into the run scratch buffer
+  
+  cx_str_unicode_block blocks [] = { CX_STR_UNICODE_BLOCK_LATIN_BASIC };
+  
+  cx_font *lfont = cx_font_create ("data/fonts/mplus-1c-bold.ttf", 15.0f, blocks, 1, NULL, 0);
+  cx_font *sfont = cx_font_create ("data/fonts/mplus-1c-bold.ttf", 14.0f, blocks, 1, NULL, 0);
+  
+  cx_date date;
+  memset (&date, 0, sizeof (date));
+  
+  if (!lfont || !sfont || !earth_init ("data/earth.json", &date))
+  {
+    printf ("bench: font labels, failed to load fonts or earth data\n");
+    
+    return;
+  }
+  
+  const int cityCount = earth_data_get_count ();
+  const int frameCount = 100;
+  const cxu32 capacity [3] = { 0, 512, 512 };
+  const char *names [3] = { "uncached", "cached  ", "batched " };
+  
+  cx_colour colour;
+  cx_colour_set (&colour, 0.9f, 0.9f, 0.9f, 0.95f);
+  
+  cx_timer timer;
+  
+  for (int p = 0; p < 3; ++p)
+  {
+    cx_font_set_run_cache_capacity (capacity [p]);
+    cx_font_reset_run_cache_stats ();
+    cx_font_reset_batch_stats ();
+    
+    cx_time_start_timer (&timer);
+    
+    for (int f = 0; f < frameCount; ++f)
+    {
+      if (p == 2)
+      {
+        cx_font_batch_begin ();
+      }
+      
+      for (int i = 0; i < cityCount; ++i)
+      {
+        char timeStr [16];
+        cx_sprintf (timeStr, 16, "%02d:%02d", (i + 9) % 24, (i * 7) % 60);
+        
+        cxf32 x = 12.0f + ((i * 37) % 900);
+        cxf32 y = 14.0f + ((i * 53) % 700);
+        
+        cx_font_render (lfont, earth_data_get_city (i), x, y, 0.0f, 0, &colour);
+        cx_font_render (sfont, timeStr, x, y + 12.0f, 0.0f, 0, &colour);
+      }
+      
+      if (p == 2)
+      {
+        cx_font_batch_end ();
+      }
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_font_run_cache_stats stats;
+    cx_font_get_run_cache_stats (&stats);
+    
+    cx_font_batch_stats batchStats;
+    cx_font_get_batch_stats (&batchStats);
+    
+    printf ("bench: font labels %s, %d labels %.0f labels/s, %.2f ms/frame, %u draws/frame, hits %u misses %u evictions %u, %u runs (%u KB)\n", 
+            names [p], cityCount * 2, (cityCount * 2 * frameCount) / (timer.elapsedTime * 0.001), timer.elapsedTime / frameCount, 
+            batchStats.drawCalls / frameCount, stats.hits, stats.misses, stats.evictions, stats.count, stats.bytes / 1024);
+  }
+  
+  const char *headline = "Leaders meet in Geneva for a second day of talks on the climate accord, with delegates "
+                         "from more than forty nations expected to sign a draft text before the weekend";
+  const int wrapCount = 10000;
+  
+  int lines = 0;
+  
+  cx_time_start_timer (&timer);
+  
+  cx_font_batch_begin ();
+  
+  for (int i = 0; i < wrapCount; ++i)
+  {
+    lines += cx_font_render_word_wrap (lfont, headline, 20.0f, 20.0f, 320.0f, 200.0f, 0.0f, 0, &colour) + 1;
+  }
+  
+  cx_font_batch_end ();
+  
+  cx_time_stop_timer (&timer);
+  
+  printf ("bench: font word wrap, %d chars %d lines, %.2f us/headline\n", 
+          (int) strlen (headline), lines / wrapCount, (timer.elapsedTime * 1000.0) / wrapCount);
+  
+  cx_font_set_run_cache_capacity (capacity [1]);
+  
+  earth_deinit ();
+  
+  cx_font_destroy (lfont);
+  cx_font_destroy (sfont);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_draw_quads (void)
+{
+  // quads/sec through cx_draw_quad with shader state tracking. z shared, then z per quad.
+  
+  cx_texture *texture = cx_texture_create_from_file ("data/images/earth/glowcircle.gb25-16.png", CX_FILE_STORAGE_BASE_RESOURCE, false);
+  
+  if (!texture)
+  {
+    printf ("bench: draw quads, failed to load texture\n");
+    
+    return;
+  }
+  
+  const int quadCount = 2000;
+  const int frameCount = 50;
+  
+  cx_colour colour;
+  cx_colour_set (&colour, 1.0f, 1.0f, 1.0f, 0.5f);
+  
+  cx_timer timer;
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    cx_shader_reset_stats ();
+    
+    cx_time_start_timer (&timer);
+    
+    for (int f = 0; f < frameCount; ++f)
+    {
+      for (int i = 0; i < quadCount; ++i)
+      {
+        cxf32 x = (cxf32) ((i * 37) % 1000);
+        cxf32 y = (cxf32) ((i * 53) % 740);
+        cxf32 z = (p == 0) ? 0.0f : ((i % 16) / 16.0f);
+        
+        cx_draw_quad (x, y, x + 24.0f, y + 24.0f, z, 0.0f, &colour, texture);
+      }
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_shader_stats stats;
+    cx_shader_get_stats (&stats);
+    
+    printf ("bench: draw quads %s, %.0f quads/s, binds %u (skipped %u), uniforms %u (skipped %u), "
+            "texture units skipped %u, location lookups skipped %u\n", 
+            (p == 0) ? "shared z" : "z/quad  ", (quadCount * frameCount) / (timer.elapsedTime * 0.001), 
+            stats.programBinds, stats.programBindsSkipped, stats.uniformUploads, stats.uniformUploadsSkipped, 
+            stats.textureUnitsSkipped, stats.locationLookupsSkipped);
+  }
+  
+  cx_texture_destroy (texture);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_draw_batch (void)
+{
+  // 10k quad stress: one texture, then a ui-like mix of solid and textured quads. immediate and
+  // batched. times cpu side submission.
+  
+  cx_texture *texture = cx_texture_create_from_file ("data/images/earth/glowcircle.gb25-16.png", CX_FILE_STORAGE_BASE_RESOURCE, false);
+  
+  if (!texture)
+  {
+    printf ("bench: draw batch, failed to load texture\n");
+    
+    return;
+  }
+  
+  const int quadCount = 10000;
+  const int frameCount = 30;
+  
+  cx_colour colour;
+  cx_colour_set (&colour, 1.0f, 0.8f, 0.6f, 0.6f);
+  
+  cx_timer timer;
+  
+  for (int p = 0; p < 4; ++p)
+  {
+    bool mixed = (p >= 2);
+    bool batched = (p & 1);
+    
+    cx_draw_reset_batch_stats ();
+    
+    cx_time_start_timer (&timer);
+    
+    for (int f = 0; f < frameCount; ++f)
+    {
+      if (batched)
+      {
+        cx_draw_batch_begin ();
+      }
+      
+      for (int i = 0; i < quadCount; ++i)
+      {
+        cxf32 x = (cxf32) ((i * 37) % 1000);
+        cxf32 y = (cxf32) ((i * 53) % 740);
+        
+        const cx_texture *t = (mixed && ((i % 4) == 0)) ? NULL : texture;
+        
+        cx_draw_quad (x, y, x + 24.0f, y + 24.0f, 0.0f, 0.0f, &colour, t);
+      }
+      
+      if (batched)
+      {
+        cx_draw_batch_end ();
+      }
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_draw_batch_stats stats;
+    cx_draw_get_batch_stats (&stats);
+    
+    printf ("bench: draw batch %s %s, %d quads %.2f ms/frame, %u draws/frame, %u KB/frame\n", 
+            mixed ? "mixed " : "single", batched ? "batched  " : "immediate", quadCount, timer.elapsedTime / frameCount, 
+            stats.drawCalls / frameCount, stats.bytes / (frameCount * 1024));
+  }
+  
+  cx_texture_destroy (texture);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_font_atlas (void)
+{
+  // startup cost and atlas memory with glyphs rasterised on first use. creates a font with the
+  // full cjk block, draws a city label set then lines of distinct cjk glyphs. an up-front bake of
+  // the same font needs a 2048 x 2048 atlas (5.3 MB with mips) and every glyph rasterised at create.
+  
+  cx_str_unicode_block blocks [] =
+  {
+    CX_STR_UNICODE_BLOCK_CJK_FULL,
+    CX_STR_UNICODE_BLOCK_LATIN_BASIC,
+    CX_STR_UNICODE_BLOCK_LATIN_1_SUPPLEMENT,
+    CX_STR_UNICODE_BLOCK_KATAKANA,
+    CX_STR_UNICODE_BLOCK_HIRAGANA,
+  };
+  
+  cxu32 blocksCount = sizeof (blocks) / sizeof (cx_str_unicode_block);
+  
+  cx_colour colour;
+  cx_colour_set (&colour, 0.9f, 0.9f, 0.9f, 0.95f);
+  
+  cx_font_reset_atlas_stats ();
+  
+  cx_font_atlas_stats before;
+  cx_font_get_atlas_stats (&before);
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  cx_font *font = cx_font_create ("data/fonts/mplus-1c-medium.ttf", 18.0f, blocks, blocksCount, NULL, 0);
+  
+  cx_time_stop_timer (&timer);
+  
+  float createTime = timer.elapsedTime;
+  
+  cx_date date;
+  memset (&date, 0, sizeof (date));
+  
+  if (!font || !earth_init ("data/earth.json", &date))
+  {
+    printf ("bench: font atlas, failed to load font or earth data\n");
+    
+    return;
+  }
+  
+  const int cityCount = earth_data_get_count ();
+  const int lineCount = 40;
+  const int lineLength = 50;
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    cx_time_start_timer (&timer);
+    
+    cx_font_batch_begin ();
+    
+    for (int i = 0; i < cityCount; ++i)
+    {
+      cx_font_render (font, earth_data_get_city (i), 12.0f + ((i * 37) % 900), 14.0f + ((i * 53) % 700), 0.0f, 0, &colour);
+    }
+    
+    if (p == 1)
+    {
+      for (int l = 0; l < lineCount; ++l)
+      {
+        char line [(lineLength * 3) + 1];
+        char *c = line;
+        
+        for (int k = 0; k < lineLength; ++k)
+        {
+          // 3 byte utf-8
+          cxu32 cp = 19968 + ((((l * lineLength) + k) * 7) % 20000);
+          
+          *c++ = (char) (0xe0 | (cp >> 12));
+          *c++ = (char) (0x80 | ((cp >> 6) & 0x3f));
+          *c++ = (char) (0x80 | (cp & 0x3f));
+        }
+        
+        *c = 0;
+        
+        cx_font_render (font, line, 0.0f, l * 19.0f, 0.0f, 0, &colour);
+      }
+    }
+    
+    cx_font_batch_end ();
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_font_atlas_stats stats;
+    cx_font_get_atlas_stats (&stats);
+    
+    printf ("bench: font atlas %s, create %.2f ms, first draw %.2f ms, %u glyphs baked in %.2f ms, %u grows, %u uploads (%u KB), atlas %u KB\n", 
+            (p == 0) ? "labels      " : "labels + cjk", createTime, timer.elapsedTime, stats.glyphs, stats.bakeTime, stats.grows, 
+            stats.uploads, stats.uploadBytes / 1024, (stats.bytes - before.bytes) / 1024);
+  }
+  
+  earth_deinit ();
+  
+  cx_font_destroy (font);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_TEXTURE_STREAM_BYTES_PER_FRAME    (1024 * 1024)
+
+static void bench_earth_textures_run (bool streamed)
+{
+  // decodes the shipped 2048 earth maps the way earth_visual_create does. current path: decode, upload
+  // and glGenerateMipmap one after the other. streamed: parallel decode and cpu mips on the workers, the
+  // load stage only waits for previews and the finer levels go up at the app's per frame budget.
+  
+  const char *paths [] =
+  {
+    "data/images/earth/maps/diff-06-2048.jpg",
+    "data/images/earth/maps/spec1-2048.png",
+    "data/images/earth/maps/clouds-2048.png",
+    "data/images/earth/maps/night1-2048.jpg",
+    "data/images/earth/maps/norm-sobel3x3-2048.png",
+  };
+  
+  const int count = sizeof (paths) / sizeof (paths [0]);
+  
+  cx_texture *textures [count];
+  
+  long rss = bench_peak_rss_kb ();
+  
+  int frames = 0;
+  bool success = true;
+  
+  float loadTime = 0.0f;
+  
+  cx_timer timer;
+  cx_time_start_timer (&timer);
+  
+  if (streamed)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      textures [i] = cx_texture_create_from_file_streamed (paths [i], CX_FILE_STORAGE_BASE_RESOURCE);
+    }
+    
+    success = cx_texture_stream_wait ();
+    
+    cx_time_stop_timer (&timer);
+    
+    loadTime = timer.elapsedTime;
+    
+    while (cx_texture_stream_update (BENCH_TEXTURE_STREAM_BYTES_PER_FRAME))
+    {
+      frames++;
+    }
+  }
+  else
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      textures [i] = cx_texture_create_from_file (paths [i], CX_FILE_STORAGE_BASE_RESOURCE, true);
+      
+      success &= (textures [i] != NULL);
+    }
+    
+    cx_time_stop_timer (&timer);
+    
+    loadTime = timer.elapsedTime;
+  }
+  
+  glFinish ();
+  
+  cx_time_stop_timer (&timer);
+  
+  printf ("bench: earth textures %s, load stage %.1f ms, full res %.1f ms (%d frames), peak rss +%ld KB %s\n", 
+          streamed ? "streamed" : "current ", loadTime, timer.elapsedTime, streamed ? (frames + 1) : 0, bench_peak_rss_kb () - rss, 
+          success ? "ok" : "FAILED");
+  
+  for (int i = 0; i < count; ++i)
+  {
+    if (textures [i])
+    {
+      cx_texture_destroy (textures [i]);
+    }
+  }
+}
+
+static void bench_earth_textures (void)
+{
+  // peak rss is per process, so each path runs in its own
+  
+  for (int p = 0; p < 2; ++p)
+  {
+    fflush (stdout);
+    
+    pid_t pid = fork ();
+    
+    if (pid == 0)
+    {
+      bench_earth_textures_run (p == 1);
+      
+      fflush (stdout);
+      
+      _exit (0);
+    }
+    
+    waitpid (pid, NULL, 0);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_globe (void)
+{
+  // earth surface over the camera zoom range (app.c CAMERA_MAX_FOV to CAMERA_MIN_FOV): the 128 slice
+  // uv sphere it replaces against the patched globe at the default error threshold. cpu side update
+  // and submission only, gpu time needs a finish.
+  
+  const int frameCount = 30;
+  const float fovs [] = { 75.0f, 60.0f, 50.0f, 40.0f };
+  
+  camera_t *camera = camera_create ((float) BENCH_WIDTH / (float) BENCH_HEIGHT, fovs [0]);
+  camera_orbit (camera, 0.0f, 0.0f);
+  
+  cx_shader *shader = cx_shader_create ("topo-hi", "data/shaders");
+  
+  cx_vertex_data *sphere = cx_vertex_data_create_sphere (1.0f, 128, CX_VERTEX_FORMAT_PTNTB);
+  cx_vertex_data_optimise (sphere);
+  
+  cx_mesh *mesh = cx_mesh_create (sphere, shader, NULL);
+  cx_globe *globe = cx_globe_create (1.0f, CX_VERTEX_FORMAT_PTNTB, shader, NULL);
+  
+  int sphereTriangles = sphere->numTriangles;
+  
+  cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_CULL | CX_GDI_RENDER_STATE_DEPTH_TEST);
+  
+  cx_timer timer;
+  
+  for (int i = 0; i < (int) (sizeof (fovs) / sizeof (fovs [0])); ++i)
+  {
+    camera->fov = fovs [i];
+    
+    cx_mat4x4 projmatrix, viewmatrix, mvpMatrix;
+    camera_get_projection_matrix (camera, &projmatrix);
+    camera_get_view_matrix (camera, &viewmatrix);
+    cx_mat4x4_mul (&mvpMatrix, &projmatrix, &viewmatrix);
+    
+    cx_gdi_set_transform (CX_GDI_TRANSFORM_P, &projmatrix);
+    cx_gdi_set_transform (CX_GDI_TRANSFORM_MV, &viewmatrix);
+    cx_gdi_set_transform (CX_GDI_TRANSFORM_MVP, &mvpMatrix);
+    
+    float elapsed [2];
+    
+    for (int p = 0; p < 2; ++p)
+    {
+      cx_time_start_timer (&timer);
+      
+      for (int f = 0; f < frameCount; ++f)
+      {
+        cx_shader_begin (shader);
+        cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
+        
+        if (p == 0)
+        {
+          cx_mesh_render (mesh);
+        }
+        else
+        {
+          cx_globe_update (globe, &camera->position, &mvpMatrix);
+          cx_globe_render (globe);
+        }
+        
+        cx_shader_end (shader);
+      }
+      
+      cx_time_stop_timer (&timer);
+      
+      elapsed [p] = timer.elapsedTime / frameCount;
+    }
+    
+    cx_globe_stats stats;
+    cx_globe_get_stats (globe, &stats);
+    
+    printf ("bench: globe fov %.0f, uv sphere %d tris %.3f ms, globe %u tris %.3f ms, levels %u/%u/%u/%u\n", 
+            fovs [i], sphereTriangles, elapsed [0], stats.triangles, elapsed [1], 
+            stats.levels [0], stats.levels [1], stats.levels [2], stats.levels [3]);
+  }
+  
+  glFinish ();
+  
+  cx_globe_destroy (globe);
+  cx_mesh_destroy (mesh);
+  cx_shader_destroy (shader);
+  
+  camera_destroy (camera);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_vertex_formats (void)
+{
+  // packed vs float vertex buffers for the earth, cloud and atmosphere meshes (ipad3 settings).
+  // upload is the first render, which packs and creates the buffers.
+  
+  const char *names [] = { "earth", "clouds", "atmos" };
+  const char *shaders [] = { "topo-hi", "clouds-anim", "atmos" };
+  const float radii [] = { 1.0f, 1.008f, 1.010f };
+  const int slices [] = { 128, 48, 128 };
+  const cx_vertex_format formats [] = { CX_VERTEX_FORMAT_PTNTB, CX_VERTEX_FORMAT_PTN, CX_VERTEX_FORMAT_PN };
+  
+  bool halfFloat = cx_gdi_get_extension_supported (CX_GDI_EXTENSION_VERTEX_HALF_FLOAT);
+  
+  cx_timer timer;
+  
+  for (int i = 0; i < 3; ++i)
+  {
+    cx_shader *shader = cx_shader_create (shaders [i], "data/shaders");
+    cx_vertex_data *sphere = cx_vertex_data_create_sphere (radii [i], slices [i], formats [i]);
+    
+    int numVertices = sphere->numVertices;
+    
+    cx_vertex_layout layout;
+    
+    cx_time_start_timer (&timer);
+    
+    cxu8 *packed = cx_vertex_data_pack (sphere, halfFloat, &layout);
+    
+    cx_time_stop_timer (&timer);
+    
+    float packTime = timer.elapsedTime;
+    
+    cx_free (packed);
+    
+    cx_mesh *mesh = cx_mesh_create (sphere, shader, NULL);
+    
+    cx_shader_begin (shader);
+    
+    cx_time_start_timer (&timer);
+    
+    cx_mesh_render (mesh);
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_shader_end (shader);
+    
+    printf ("bench: %s %d vertices, %u bytes (float %u), stride %u, pack %.3f ms, upload %.3f ms\n", 
+            names [i], numVertices, numVertices * layout.stride, numVertices * (cxu32) sizeof (cx_vertex), 
+            layout.stride, packTime, timer.elapsedTime);
+    
+    cx_mesh_destroy (mesh);
+    cx_shader_destroy (shader);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_vertex_cache (void)
+{
+  // offline post-transform cache report for uv spheres, fifo of CX_VERTEX_CACHE_SIZE entries.
+  // acmr is misses per triangle, atvr misses per vertex.
+  
+  const int slices [] = { 48, 128, 256, 512 };
+  
+  cx_timer timer;
+  
+  for (int i = 0; i < (int) (sizeof (slices) / sizeof (slices [0])); ++i)
+  {
+    cx_vertex_data *sphere = cx_vertex_data_create_sphere (1.0f, slices [i], CX_VERTEX_FORMAT_PTNTB);
+    
+    float acmr [2], atvr [2];
+    
+    cx_vertex_data_get_cache_stats (sphere->indices, sphere->numIndices, sphere->numVertices, CX_VERTEX_CACHE_SIZE, &acmr [0], &atvr [0]);
+    
+    cx_time_start_timer (&timer);
+    
+    cx_vertex_data_optimise (sphere);
+    
+    cx_time_stop_timer (&timer);
+    
+    cx_vertex_data_get_cache_stats (sphere->indices, sphere->numIndices, sphere->numVertices, CX_VERTEX_CACHE_SIZE, &acmr [1], &atvr [1]);
+    
+    printf ("bench: vertex cache %d slices, %d vertices, acmr %.3f -> %.3f, atvr %.3f -> %.3f, optimise %.3f ms%s\n", 
+            slices [i], sphere->numVertices, acmr [0], acmr [1], atvr [0], atvr [1], timer.elapsedTime, 
+            (sphere->numVertices > 0x10000) ? " (32 bit indices)" : "");
+    
+    cx_vertex_data_destroy (sphere);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void bench_globe_culling (void)
+{
+  // camera swept once around the earth (tilted orbit) for each zoom (app.c CAMERA_MAX_FOV,
+  // CAMERA_START_FOV and CAMERA_MIN_FOV), surface, clouds and atmosphere with horizon and frustum
+  // culling off then on. averages per frame, cpu side update and submission.
+  
+  const int stepCount = 36;
+  const float fovs [] = { 75.0f, 50.0f, 40.0f };
+  
+  const char *names [] = { "earth", "clouds", "atmos" };
+  const char *shaders [] = { "topo-hi", "clouds-anim", "atmos" };
+  const float radii [] = { 1.0f, 1.008f, 1.010f };
+  const cx_vertex_format formats [] = { CX_VERTEX_FORMAT_PTNTB, CX_VERTEX_FORMAT_PTN, CX_VERTEX_FORMAT_PN };
+  
+  camera_t *camera = camera_create ((float) BENCH_WIDTH / (float) BENCH_HEIGHT, fovs [0]);
+  camera_orbit (camera, 0.0f, 0.0f);
+  
+  const camera_t start = *camera;
+  
+  cx_vec4 origin, up, axis;
+  cx_vec4_set (&origin, 0.0f, 0.0f, 0.0f, 1.0f);
+  cx_vec4_set (&up, 0.0f, 1.0f, 0.0f, 0.0f);
+  
+  cx_mat4x4 tilt;
+  cx_mat4x4_rotation (&tilt, cx_rad (30.0f), 1.0f, 0.0f, 0.0f);
+  cx_mat4x4_mul_vec4 (&axis, &tilt, &up);
+  
+  cx_gdi_set_renderstate (CX_GDI_RENDER_STATE_CULL | CX_GDI_RENDER_STATE_DEPTH_TEST);
+  
+  cx_timer timer;
+  
+  for (int i = 0; i < 3; ++i)
+  {
+    cx_shader *shader = cx_shader_create (shaders [i], "data/shaders");
+    cx_globe *globe = cx_globe_create (radii [i], formats [i], shader, NULL);
+    
+    for (int j = 0; j < (int) (sizeof (fovs) / sizeof (fovs [0])); ++j)
+    {
+      float elapsed [2];
+      float submitted [2];
+      float triangles [2];
+      float horizonCulled = 0.0f;
+      float frustumCulled = 0.0f;
+      
+      for (int p = 0; p < 2; ++p)
+      {
+        *camera = start;
+        camera->fov = fovs [j];
+        
+        cx_globe_set_culling (globe, (p == 1));
+        
+        submitted [p] = 0.0f;
+        triangles [p] = 0.0f;
+        
+        // drain the previous pass so its gpu work is not billed to this one
+        glFinish ();
+        
+        cx_time_start_timer (&timer);
+        
+        for (int k = 0; k < stepCount; ++k)
+        {
+          camera_rotate_around_point (camera, &origin, (2.0f * CX_PI) / (float) stepCount, &axis);
+          
+          cx_mat4x4 projmatrix, viewmatrix, mvpMatrix;
+          camera_get_projection_matrix (camera, &projmatrix);
+          camera_get_view_matrix (camera, &viewmatrix);
+          cx_mat4x4_mul (&mvpMatrix, &projmatrix, &viewmatrix);
+          
+          cx_gdi_set_transform (CX_GDI_TRANSFORM_P, &projmatrix);
+          
+          cx_shader_begin (shader);
+          cx_shader_set_uniform (shader, CX_SHADER_UNIFORM_TRANSFORM_MVP, &mvpMatrix);
+          
+          cx_globe_update (globe, &camera->position, &mvpMatrix);
+          cx_globe_render (globe);
+          
+          cx_shader_end (shader);
+          
+          cx_globe_stats stats;
+          cx_globe_get_stats (globe, &stats);
+          
+          submitted [p] += (float) stats.submitted;
+          triangles [p] += (float) stats.triangles;
+          
+          if (p == 1)
+          {
+            horizonCulled += (float) stats.horizonCulled;
+            frustumCulled += (float) stats.frustumCulled;
+          }
+        }
+        
+        cx_time_stop_timer (&timer);
+        
+        elapsed [p] = timer.elapsedTime / stepCount;
+        submitted [p] /= stepCount;
+        triangles [p] /= stepCount;
+      }
+      
+      printf ("bench: globe culling %s fov %.0f, off %.1f patches %.0f tris %.3f ms, on %.1f patches %.0f tris %.3f ms (horizon %.1f, frustum %.1f)\n", 
+              names [i], fovs [j], submitted [0], triangles [0], elapsed [0], submitted [1], triangles [1], elapsed [1], 
+              horizonCulled / stepCount, frustumCulled / stepCount);
+    }
+    
+    cx_globe_destroy (globe);
+    cx_shader_destroy (shader);
+  }
+  
+  glFinish ();
+  
+  camera_destroy (camera);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const bench_case g_benches [] =
+{
+  { "memory", bench_memory },
+  { "timer", bench_timer },
+  { "date", bench_date },
+  { "worker", bench_worker },
+  { "priority", bench_priority },
+  { "xml", bench_xml },
+  { "json", bench_json },
+  { "simd", bench_simd },
+  { "projection", bench_projection },
+  { "word_filter", bench_word_filter },
+  { "font_labels", bench_font_labels },
+  { "draw_quads", bench_draw_quads },
+  { "draw_batch", bench_draw_batch },
+  { "font_atlas", bench_font_atlas },
+  { "earth_textures", bench_earth_textures },
+  { "globe", bench_globe },
+  { "vertex_formats", bench_vertex_formats },
+  { "vertex_cache", bench_vertex_cache },
+  { "globe_culling", bench_globe_culling },
+};
+
+static const int g_benchCount = sizeof (g_benches) / sizeof (bench_case);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool bench_selected (const bench_case *bench, int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    return true;
+  }
+  
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp (argv [i], bench->name) == 0)
+    {
+      return true;
+    }
+  }
+  
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+  if (!harness_init (BENCH_WIDTH, BENCH_HEIGHT))
+  {
+    return 1;
+  }
+  
+  int runCount = 0;
+  
+  for (int i = 0; i < g_benchCount; ++i)
+  {
+    if (bench_selected (&g_benches [i], argc, argv))
+    {
+      g_benches [i].func ();
+      
+      runCount++;
+    }
+  }
+  
+  harness_deinit ();
+  
+  if (runCount == 0)
+  {
+    fprintf (stderr, "usage: bench [name ...], names:");
+    
+    for (int i = 0; i < g_benchCount; ++i)
+    {
+      fprintf (stderr, " %s", g_benches [i].name);
+    }
+    
+    fprintf (stderr, "\n");
+    
+    return 1;
+  }
+  
+  return 0;
+}
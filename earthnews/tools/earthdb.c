@@ -0,0 +1,404 @@
+//
+//  earthdb.c
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+//  offline compiler for the precompiled city database loaded by earth_data_create.
+//
+//  build: make earthdb (see Makefile), make db regenerates ../data/earth.db
+//  usage: earthdb ../data/earth.json ../data/earth.db
+//         earthdb -synthetic 50000 earth-50k.db
+//
+//  the json size and hash are stored in the header, earth_data_create rejects the database once the
+//  json next to it changes. synthetic databases are only loaded when there is no json beside them.
+//
+
+#include "../source/app/earth_db.h"
+#include "../source/engine/3rdparty/json-parser/json.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define EARTHDB_RADIUS 1.0f // must match earth_create
+#define EARTHDB_SLICES 128  // location is independent of (even) slice count
+#define EARTHDB_PI     (3.14159265358979f)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct earthdb_city
+{
+  const char *name;
+  const char *news;
+  const char *tzname;
+  const char *weather;
+  int utcOffset;
+  float latitude;
+  float longitude;
+} earthdb_city;
+
+typedef struct earthdb_strings
+{
+  char *data;
+  cxu32 size;
+  cxu32 capacity;
+} earthdb_strings;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void earthdb_convert_dd_to_world (float *world, float *n, float latitude, float longitude, float radius, int slices)
+{
+  // mirrors earth_convert_dd_to_world (app/earth.c)
+  
+  float tx = (longitude + 180.0f) / 360.0f;
+  float ty = 1.0f - ((latitude + 90.0f) / 180.0f);
+  
+  float i = ty * (float) (slices >> 1);
+  float j = tx * (float) slices;
+  
+  float angleStep = (2.0f * EARTHDB_PI) / (float) slices;
+  
+  float a0 = sinf (angleStep * i) * sinf (angleStep * j);
+  float a1 = cosf (angleStep * i);
+  float a2 = sinf (angleStep * i) * cosf (angleStep * j);
+  
+  world [0] = radius * a0;
+  world [1] = radius * a1;
+  world [2] = radius * a2;
+  world [3] = 1.0f;
+  
+  float len = sqrtf ((a0 * a0) + (a1 * a1) + (a2 * a2));
+  
+  n [0] = a0 * (1.0f / len);
+  n [1] = a1 * (1.0f / len);
+  n [2] = a2 * (1.0f / len);
+  n [3] = 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cxu32 earthdb_strings_add (earthdb_strings *strings, const char *str)
+{
+  cxu32 len = (cxu32) strlen (str) + 1;
+  
+  if ((strings->size + len) > strings->capacity)
+  {
+    strings->capacity = (strings->capacity + len) * 2;
+    strings->data = realloc (strings->data, strings->capacity);
+  }
+  
+  cxu32 offset = strings->size;
+  
+  memcpy (strings->data + offset, str, len);
+  
+  strings->size += len;
+  
+  return offset;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const char *earthdb_json_string (const json_value *object, const char *key)
+{
+  for (unsigned int i = 0; i < object->u.object.length; ++i)
+  {
+    const json_value *v = object->u.object.values [i].value;
+    
+    if ((strcmp (object->u.object.values [i].name, key) == 0) && (v->type == json_string))
+    {
+      return v->u.string.ptr;
+    }
+  }
+  
+  return "";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const json_value *earthdb_json_child (const json_value *object, const char *key)
+{
+  for (unsigned int i = 0; i < object->u.object.length; ++i)
+  {
+    if (strcmp (object->u.object.values [i].name, key) == 0)
+    {
+      return object->u.object.values [i].value;
+    }
+  }
+  
+  return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static float earthdb_json_number (const json_value *value)
+{
+  if (value && (value->type == json_double))
+  {
+    return (float) value->u.dbl;
+  }
+  
+  if (value && (value->type == json_integer))
+  {
+    return (float) value->u.integer;
+  }
+  
+  return 0.0f;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static earthdb_city *earthdb_cities_from_json (const char *filename, cxu32 *count, json_value **root, earth_db_header *header)
+{
+  FILE *file = fopen (filename, "rb");
+  
+  if (!file)
+  {
+    fprintf (stderr, "earthdb: failed to open %s\n", filename);
+    return NULL;
+  }
+  
+  fseek (file, 0, SEEK_END);
+  long size = ftell (file);
+  fseek (file, 0, SEEK_SET);
+  
+  char *data = malloc (size + 1);
+  size_t read = fread (data, 1, size, file);
+  data [read] = 0;
+  
+  fclose (file);
+  
+  header->sourceSize = (cxu32) read;
+  header->sourceHash = earth_db_source_hash ((const cxu8 *) data, (cxu32) read);
+  
+  char error [512];
+  json_settings settings;
+  memset (&settings, 0, sizeof (settings));
+  
+  *root = json_parse_ex (&settings, data, (unsigned int) read, error, sizeof (error));
+  
+  free (data);
+  
+  if (!*root || ((*root)->type != json_array))
+  {
+    fprintf (stderr, "earthdb: %s: %s\n", filename, *root ? "expected array" : error);
+    return NULL;
+  }
+  
+  *count = (*root)->u.array.length;
+  
+  earthdb_city *cities = calloc (*count, sizeof (earthdb_city));
+  
+  for (cxu32 i = 0; i < *count; ++i)
+  {
+    const json_value *object = (*root)->u.array.values [i];
+    const json_value *timezone = earthdb_json_child (object, "timezone");
+    const json_value *location = earthdb_json_child (object, "location");
+    
+    cities [i].name = earthdb_json_string (object, "name");
+    cities [i].news = earthdb_json_string (object, "news");
+    cities [i].weather = earthdb_json_string (object, "weather");
+    cities [i].tzname = timezone ? earthdb_json_string (timezone, "name") : "";
+    cities [i].utcOffset = timezone ? (int) earthdb_json_number (earthdb_json_child (timezone, "utcoffset")) : 0;
+    cities [i].latitude = location ? earthdb_json_number (earthdb_json_child (location, "latitude")) : 0.0f;
+    cities [i].longitude = location ? earthdb_json_number (earthdb_json_child (location, "longitude")) : 0.0f;
+  }
+  
+  return cities;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static earthdb_city *earthdb_cities_synthetic (cxu32 count)
+{
+  static const char *tznames [] = { "Europe/London", "America/New_York", "Asia/Tokyo", "Australia/Sydney", "Africa/Lagos" };
+  static const int utcOffsets [] = { 0, -18000, 32400, 36000, 3600 };
+  
+  earthdb_city *cities = calloc (count, sizeof (earthdb_city));
+  
+  srand (360);
+  
+  for (cxu32 i = 0; i < count; ++i)
+  {
+    char buffer [64];
+    int tz = rand () % 5;
+    
+    snprintf (buffer, sizeof (buffer), "City %u", i);
+    cities [i].name = strdup (buffer);
+    
+    snprintf (buffer, sizeof (buffer), "City %u, Country %u", i, i % 200);
+    cities [i].news = strdup (buffer);
+    
+    snprintf (buffer, sizeof (buffer), "%u", 1000000 + i);
+    cities [i].weather = strdup (buffer);
+    
+    cities [i].tzname = tznames [tz];
+    cities [i].utcOffset = utcOffsets [tz];
+    cities [i].latitude = ((float) rand () / (float) RAND_MAX) * 180.0f - 90.0f;
+    cities [i].longitude = ((float) rand () / (float) RAND_MAX) * 360.0f - 180.0f;
+  }
+  
+  return cities;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool earthdb_write (const char *filename, const earthdb_city *cities, cxu32 count, const earth_db_header *source)
+{
+  const cxu32 elemSize [EARTH_DB_NUM_SECTIONS] =
+  {
+    sizeof (float) * 4, sizeof (float) * 4, sizeof (float), sizeof (float), sizeof (int),
+    EARTH_DB_WEATHER_ID_LEN, sizeof (cxu32), sizeof (cxu32), sizeof (cxu32), 0
+  };
+  
+  earthdb_strings strings = { NULL, 0, 0 };
+  
+  cxu8 *sections [EARTH_DB_NUM_SECTIONS];
+  
+  earth_db_header header;
+  memset (&header, 0, sizeof (header));
+  
+  header.sourceSize = source->sourceSize;
+  header.sourceHash = source->sourceHash;
+  
+  for (int s = 0; s < EARTH_DB_SECTION_STRINGS; ++s)
+  {
+    header.sectionSize [s] = elemSize [s] * count;
+    sections [s] = calloc (1, header.sectionSize [s] + EARTH_DB_ALIGNMENT);
+  }
+  
+  for (cxu32 i = 0; i < count; ++i)
+  {
+    const earthdb_city *city = &cities [i];
+    
+    float *location = (float *) sections [EARTH_DB_SECTION_LOCATION] + (i * 4);
+    float *normal = (float *) sections [EARTH_DB_SECTION_NORMAL] + (i * 4);
+    
+    earthdb_convert_dd_to_world (location, normal, city->latitude, city->longitude,
+                                 EARTHDB_RADIUS * EARTH_DB_RADIUS_SCALE, EARTHDB_SLICES);
+    
+    ((float *) sections [EARTH_DB_SECTION_LATITUDE]) [i] = city->latitude;
+    ((float *) sections [EARTH_DB_SECTION_LONGITUDE]) [i] = city->longitude;
+    ((int *) sections [EARTH_DB_SECTION_UTC_OFFSET]) [i] = city->utcOffset;
+    
+    char *weather = (char *) sections [EARTH_DB_SECTION_WEATHER_ID] + (i * EARTH_DB_WEATHER_ID_LEN);
+    strncpy (weather, city->weather, EARTH_DB_WEATHER_ID_LEN - 1);
+    
+    ((cxu32 *) sections [EARTH_DB_SECTION_NAME]) [i] = earthdb_strings_add (&strings, city->name);
+    ((cxu32 *) sections [EARTH_DB_SECTION_NEWS]) [i] = earthdb_strings_add (&strings, city->news);
+    ((cxu32 *) sections [EARTH_DB_SECTION_TZ_NAME]) [i] = earthdb_strings_add (&strings, city->tzname);
+  }
+  
+  header.sectionSize [EARTH_DB_SECTION_STRINGS] = strings.size;
+  sections [EARTH_DB_SECTION_STRINGS] = calloc (1, strings.size + EARTH_DB_ALIGNMENT);
+  memcpy (sections [EARTH_DB_SECTION_STRINGS], strings.data, strings.size);
+  
+  // lay out sections
+  
+  cxu32 offset = sizeof (earth_db_header);
+  
+  for (int s = 0; s < EARTH_DB_NUM_SECTIONS; ++s)
+  {
+    header.sectionOffset [s] = offset;
+    offset += (header.sectionSize [s] + (EARTH_DB_ALIGNMENT - 1)) & ~(EARTH_DB_ALIGNMENT - 1);
+  }
+  
+  cxu8 *file = calloc (1, offset);
+  
+  for (int s = 0; s < EARTH_DB_NUM_SECTIONS; ++s)
+  {
+    memcpy (file + header.sectionOffset [s], sections [s], header.sectionSize [s]);
+    free (sections [s]);
+  }
+  
+  header.magic = EARTH_DB_MAGIC;
+  header.version = EARTH_DB_VERSION;
+  header.size = offset;
+  header.count = count;
+  header.radius = EARTHDB_RADIUS;
+  header.checksum = earth_db_checksum (file + sizeof (earth_db_header), offset - sizeof (earth_db_header));
+  
+  memcpy (file, &header, sizeof (header));
+  
+  bool written = false;
+  
+  FILE *out = fopen (filename, "wb");
+  
+  if (out)
+  {
+    written = fwrite (file, 1, offset, out) == offset;
+    fclose (out);
+  }
+  
+  if (written)
+  {
+    printf ("earthdb: %s: %u cities, %u bytes\n", filename, count, offset);
+  }
+  else
+  {
+    fprintf (stderr, "earthdb: failed to write %s\n", filename);
+  }
+  
+  free (file);
+  free (strings.data);
+  
+  return written;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+  earthdb_city *cities = NULL;
+  json_value *root = NULL;
+  cxu32 count = 0;
+  
+  earth_db_header source;
+  memset (&source, 0, sizeof (source));
+  
+  if ((argc == 4) && (strcmp (argv [1], "-synthetic") == 0))
+  {
+    count = (cxu32) strtoul (argv [2], NULL, 10);
+    cities = earthdb_cities_synthetic (count);
+  }
+  else if (argc == 3)
+  {
+    cities = earthdb_cities_from_json (argv [1], &count, &root, &source);
+  }
+  else
+  {
+    fprintf (stderr, "usage: earthdb <earth.json> <earth.db>\n"
+                     "       earthdb -synthetic <count> <earth.db>\n");
+    return 1;
+  }
+  
+  bool success = cities && earthdb_write (argv [argc - 1], cities, count, &source);
+  
+  json_value_free (root);
+  
+  return success ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
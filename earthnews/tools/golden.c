@@ -0,0 +1,486 @@
+//
+//  golden.c
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+//  headless golden image test for the 3d earth scene (earth_render_scene). renders a fixed set of
+//  camera views into an offscreen egl pbuffer (see cx_native_linux.h), compares every frame against
+//  a stored golden image and records per-frame render time.
+//
+//  build: make golden (see Makefile), make check runs it against goldens/
+//  usage: EGL_PLATFORM=surfaceless CX_RESOURCE_PATH=.. golden goldens
+//         EGL_PLATFORM=surfaceless CX_RESOURCE_PATH=.. golden -update goldens
+//         EGL_PLATFORM=surfaceless CX_RESOURCE_PATH=.. golden -frames 100 -timings frames.csv goldens
+//
+
+#include "harness.h"
+#include "../source/app/earth.h"
+#include "../source/app/camera.h"
+#include <time.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define GOLDEN_WIDTH            256
+#define GOLDEN_HEIGHT           192
+#define GOLDEN_FRAMES           30
+#define GOLDEN_TOLERANCE        8       // max per-channel difference of a matching pixel
+#define GOLDEN_MAX_BAD_PIXELS   0.001f  // max fraction of pixels outside tolerance
+#define GOLDEN_POINT_SCALE      2.0f
+#define GOLDEN_PATH_MAX         512
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct golden_view
+{
+  const char *name;
+  float rotx;
+  float roty;
+  float fov;
+} golden_view;
+
+typedef struct golden_options
+{
+  const char *dir;
+  const char *timings;
+  int frames;
+  int tolerance;
+  float maxBadPixels;
+  bool update;
+} golden_options;
+
+typedef struct golden_image
+{
+  int width;
+  int height;
+  unsigned char *rgb;
+} golden_image;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// camera rotation (degrees) and field of view as set by app_update_camera
+
+static const golden_view g_views [] =
+{
+  { "start",        0.0f,   0.0f, 50.0f },
+  { "europe",     -20.0f,  45.0f, 40.0f },
+  { "asia",       -90.0f,  30.0f, 75.0f },
+  { "arctic",      80.0f,  80.0f, 50.0f },
+  { "terminator", 100.0f,  20.0f, 40.0f },
+};
+
+static const int g_viewCount = sizeof (g_views) / sizeof (golden_view);
+
+static cx_texture *g_glowTex = NULL;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int golden_compare_ms (const void *a, const void *b)
+{
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  
+  return (x > y) - (x < y);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool golden_image_read (golden_image *image, const char *path)
+{
+  FILE *fp = fopen (path, "rb");
+  
+  if (!fp)
+  {
+    return false;
+  }
+  
+  int width = 0, height = 0, maxval = 0;
+  bool success = (fscanf (fp, "P6 %d %d %d", &width, &height, &maxval) == 3) && (maxval == 255) && (fgetc (fp) != EOF);
+  
+  if (success)
+  {
+    size_t size = (size_t) width * height * 3;
+    
+    image->width = width;
+    image->height = height;
+    image->rgb = cx_malloc (size);
+    
+    success = fread (image->rgb, 1, size, fp) == size;
+    
+    if (!success)
+    {
+      cx_free (image->rgb);
+      image->rgb = NULL;
+    }
+  }
+  
+  fclose (fp);
+  
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool golden_image_write (const golden_image *image, const char *path)
+{
+  FILE *fp = fopen (path, "wb");
+  
+  if (!fp)
+  {
+    fprintf (stderr, "golden: failed to write %s\n", path);
+    return false;
+  }
+  
+  size_t size = (size_t) image->width * image->height * 3;
+  
+  fprintf (fp, "P6\n%d %d\n255\n", image->width, image->height);
+  
+  bool success = fwrite (image->rgb, 1, size, fp) == size;
+  
+  fclose (fp);
+  
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void golden_image_read_framebuffer (golden_image *image, int width, int height)
+{
+  unsigned char *rgba = cx_malloc ((size_t) width * height * 4);
+  
+  glPixelStorei (GL_PACK_ALIGNMENT, 1);
+  glReadPixels (0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+  
+  image->width = width;
+  image->height = height;
+  image->rgb = cx_malloc ((size_t) width * height * 3);
+  
+  // gl rows are bottom-up
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char *src = rgba + ((size_t) (height - 1 - y) * width * 4);
+    unsigned char *dst = image->rgb + ((size_t) y * width * 3);
+    
+    for (int x = 0; x < width; ++x)
+    {
+      dst [x * 3 + 0] = src [x * 4 + 0];
+      dst [x * 3 + 1] = src [x * 4 + 1];
+      dst [x * 3 + 2] = src [x * 4 + 2];
+    }
+  }
+  
+  cx_free (rgba);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int golden_image_diff (golden_image *diff, const golden_image *a, const golden_image *b, int tolerance, int *maxError)
+{
+  CX_ASSERT ((a->width == b->width) && (a->height == b->height));
+  
+  int count = a->width * a->height;
+  int bad = 0;
+  
+  diff->width = a->width;
+  diff->height = a->height;
+  diff->rgb = cx_malloc ((size_t) count * 3);
+  
+  *maxError = 0;
+  
+  for (int i = 0; i < count; ++i)
+  {
+    int error = 0;
+    
+    for (int c = 0; c < 3; ++c)
+    {
+      int d = abs ((int) a->rgb [i * 3 + c] - (int) b->rgb [i * 3 + c]);
+      error = cx_max (error, d);
+    }
+    
+    // mismatches in red, scaled differences in grey
+    bool mismatch = error > tolerance;
+    unsigned char grey = (unsigned char) cx_min (error * 8, 255);
+    
+    diff->rgb [i * 3 + 0] = mismatch ? 255 : grey;
+    diff->rgb [i * 3 + 1] = mismatch ? 0 : grey;
+    diff->rgb [i * 3 + 2] = mismatch ? 0 : grey;
+    
+    bad += mismatch ? 1 : 0;
+    *maxError = cx_max (*maxError, error);
+  }
+  
+  return bad;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void golden_render (camera_t *camera, const golden_view *view, const cx_date *date)
+{
+  // app_update_camera and app_render_3d_earth, with every city displayed
+  
+  camera->fov = view->fov;
+  
+  camera_orbit (camera, view->rotx, view->roty);
+  
+  cx_gdi_clear (cx_colour_black ());
+  
+  int cityCount = earth_data_get_count ();
+  
+  cx_colour col [cityCount];
+  
+  for (int i = 0; i < cityCount; ++i)
+  {
+    col [i] = *cx_colour_white ();
+  }
+  
+  earth_render_scene (&camera->position, date, cityCount, earth_data_get_position (0), col, g_glowTex, GOLDEN_POINT_SCALE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool golden_run_view (const golden_options *options, camera_t *camera, const golden_view *view,
+                             const cx_date *date, FILE *timings)
+{
+  int width = (int) cx_gdi_get_screen_width ();
+  int height = (int) cx_gdi_get_screen_height ();
+  
+  // warm up (shader and texture first use), then time each frame to completion
+  
+  golden_render (camera, view, date);
+  glFinish ();
+  
+  double ms [options->frames];
+  double total = 0.0;
+  
+  for (int i = 0; i < options->frames; ++i)
+  {
+    double start = harness_time_ms ();
+    
+    golden_render (camera, view, date);
+    glFinish ();
+    
+    ms [i] = harness_time_ms () - start;
+    total += ms [i];
+    
+    if (timings)
+    {
+      fprintf (timings, "%s,%d,%.3f\n", view->name, i, ms [i]);
+    }
+  }
+  
+  qsort (ms, options->frames, sizeof (double), golden_compare_ms);
+  
+  printf ("%-12s min %7.3f ms  median %7.3f ms  mean %7.3f ms  max %7.3f ms  ", view->name,
+          ms [0], ms [options->frames / 2], total / options->frames, ms [options->frames - 1]);
+  
+  // compare
+  
+  golden_image actual;
+  golden_image_read_framebuffer (&actual, width, height);
+  
+  char path [GOLDEN_PATH_MAX];
+  snprintf (path, sizeof (path), "%s/%s.ppm", options->dir, view->name);
+  
+  bool success = true;
+  
+  if (options->update)
+  {
+    success = golden_image_write (&actual, path);
+    
+    printf ("%s\n", success ? "updated" : "FAILED (write)");
+  }
+  else
+  {
+    golden_image expected;
+    
+    if (!golden_image_read (&expected, path))
+    {
+      success = false;
+      printf ("FAILED (no golden image %s)\n", path);
+    }
+    else if ((expected.width != width) || (expected.height != height))
+    {
+      success = false;
+      printf ("FAILED (golden image is %dx%d)\n", expected.width, expected.height);
+      
+      cx_free (expected.rgb);
+    }
+    else
+    {
+      golden_image diff;
+      int maxError = 0;
+      int bad = golden_image_diff (&diff, &actual, &expected, options->tolerance, &maxError);
+      float badFraction = (float) bad / (float) (width * height);
+      
+      success = badFraction <= options->maxBadPixels;
+      
+      printf ("%s (%d pixels outside tolerance, max error %d)\n", success ? "ok" : "FAILED", bad, maxError);
+      
+      if (!success)
+      {
+        snprintf (path, sizeof (path), "%s/%s-actual.ppm", options->dir, view->name);
+        golden_image_write (&actual, path);
+        
+        snprintf (path, sizeof (path), "%s/%s-diff.ppm", options->dir, view->name);
+        golden_image_write (&diff, path);
+      }
+      
+      cx_free (diff.rgb);
+      cx_free (expected.rgb);
+    }
+  }
+  
+  cx_free (actual.rgb);
+  
+  return success;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void golden_usage (void)
+{
+  fprintf (stderr, "usage: golden [-update] [-frames n] [-tolerance t] [-max-bad-pixels f] [-timings file.csv] dir\n");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+  golden_options options;
+  
+  memset (&options, 0, sizeof (options));
+  options.frames = GOLDEN_FRAMES;
+  options.tolerance = GOLDEN_TOLERANCE;
+  options.maxBadPixels = GOLDEN_MAX_BAD_PIXELS;
+  
+  for (int i = 1; i < argc; ++i)
+  {
+    bool hasValue = (i + 1) < argc;
+    
+    if (strcmp (argv [i], "-update") == 0)
+    {
+      options.update = true;
+    }
+    else if ((strcmp (argv [i], "-frames") == 0) && hasValue)
+    {
+      int frames = atoi (argv [++i]);
+      options.frames = cx_max (frames, 1);
+    }
+    else if ((strcmp (argv [i], "-tolerance") == 0) && hasValue)
+    {
+      options.tolerance = atoi (argv [++i]);
+    }
+    else if ((strcmp (argv [i], "-max-bad-pixels") == 0) && hasValue)
+    {
+      options.maxBadPixels = (float) atof (argv [++i]);
+    }
+    else if ((strcmp (argv [i], "-timings") == 0) && hasValue)
+    {
+      options.timings = argv [++i];
+    }
+    else if ((argv [i][0] != '-') && !options.dir)
+    {
+      options.dir = argv [i];
+    }
+    else
+    {
+      golden_usage ();
+      return 1;
+    }
+  }
+  
+  if (!options.dir)
+  {
+    golden_usage ();
+    return 1;
+  }
+  
+  if (!harness_init (GOLDEN_WIDTH, GOLDEN_HEIGHT))
+  {
+    return 1;
+  }
+  
+  // fixed date (june solstice, noon utc). system time is never updated, so animated clouds stay put
+  
+  cx_date date;
+  memset (&date, 0, sizeof (date));
+  
+  date.calendar.tm_year = 2013 - 1900;
+  date.calendar.tm_mon = 5;
+  date.calendar.tm_mday = 21;
+  date.calendar.tm_hour = 12;
+  date.epochTime = (cxi64) timegm (&date.calendar);
+  
+  bool success = earth_init ("data/earth.json", &date);
+  
+  if (success)
+  {
+    // finish streaming the full resolution mip levels so every run samples the same textures
+    while (cx_texture_stream_update (0xffffffff))
+    {
+    }
+    
+    g_glowTex = cx_texture_create_from_file ("data/images/earth/glowcircle.gb25-16.png", CX_FILE_STORAGE_BASE_RESOURCE, false);
+    
+    camera_t *camera = camera_create ((float) GOLDEN_WIDTH / (float) GOLDEN_HEIGHT, g_views [0].fov);
+    
+    FILE *timings = options.timings ? fopen (options.timings, "w") : NULL;
+    
+    if (timings)
+    {
+      fprintf (timings, "view,frame,ms\n");
+    }
+    
+    int failures = 0;
+    
+    for (int i = 0; i < g_viewCount; ++i)
+    {
+      failures += golden_run_view (&options, camera, &g_views [i], &date, timings) ? 0 : 1;
+    }
+    
+    if (timings)
+    {
+      fclose (timings);
+    }
+    
+    camera_destroy (camera);
+    cx_texture_destroy (g_glowTex);
+    earth_deinit ();
+    
+    success = (failures == 0);
+    
+    printf ("%d/%d views %s\n", g_viewCount - failures, g_viewCount, options.update ? "updated" : "passed");
+  }
+  else
+  {
+    fprintf (stderr, "golden: failed to load data/earth.json\n");
+  }
+  
+  harness_deinit ();
+  
+  return success ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+//
+//  harness.c
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+
+#include "harness.h"
+#include "../source/app/util.h"
+#include <time.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void *g_context = NULL;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// util.m stand-ins. ipad1 selects the 2048 maps shipped in data/images/earth/maps, and static clouds
+
+device_type_t util_get_device_type (void)
+{
+  return DEVICE_TYPE_IPAD1;
+}
+
+int util_get_dst_offset_secs (const char *tzname)
+{
+  CX_REF_UNUSED (tzname);
+  
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+bool harness_init (int width, int height)
+{
+  CX_ASSERT (!g_context);
+  
+  _cx_system_init ();
+  
+  g_context = cx_native_offscreen_context_create (width, height);
+  
+  if (!g_context)
+  {
+    fprintf (stderr, "harness: failed to create offscreen context\n");
+    
+    _cx_system_deinit ();
+    
+    return false;
+  }
+  
+  _cx_shader_init ();
+  _cx_gdi_init (g_context, width, height);
+  _cx_draw_init ();
+  _cx_texture_init ();
+  
+  cx_varmod_settings varmodSettings;
+  varmodSettings.renderFunc = NULL;
+  
+  cx_varmod_init (&varmodSettings);
+  
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void harness_deinit (void)
+{
+  CX_ASSERT (g_context);
+  
+  cx_varmod_deinit ();
+  
+  // cx_engine_deinit without the network module
+  _cx_texture_deinit ();
+  _cx_draw_deinit ();
+  _cx_shader_deinit ();
+  _cx_gdi_deinit ();
+  
+  cx_native_offscreen_context_destroy (g_context);
+  g_context = NULL;
+  
+  _cx_system_deinit ();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+double harness_time_ms (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  
+  return (ts.tv_sec * 1e3) + (ts.tv_nsec / 1e6);
+}
@@ -0,0 +1,43 @@
+//
+//  harness.h
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+//  shared setup for the host tools (golden, tests, bench): engine and offscreen gl context without
+//  the network module, and the util.m functions the app sources call.
+//
+
+#ifndef HARNESS_H
+#define HARNESS_H
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "../source/engine/system/cx_system.h"
+#include "../source/engine/system/cx_native_linux.h"
+#include "../source/engine/graphics/cx_gdi.h"
+#include "../source/engine/graphics/cx_draw.h"
+#include "../source/engine/graphics/cx_shader.h"
+#include "../source/engine/graphics/cx_texture.h"
+#include "../source/engine/graphics/cx_opengl.h"
+#include "../source/engine/utility/cx_varmod.h"
+#include <stdio.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// cx_engine_init (CX_ENGINE_INIT_GRAPHICS) into a width x height offscreen context
+
+bool harness_init (int width, int height);
+void harness_deinit (void);
+
+double harness_time_ms (void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,649 @@
+//
+//  tests.c
+//  now360
+//
+//  Copyright (c) 2012 Ubaka Onyechi. All rights reserved.
+//
+//  host unit tests for engine and app modules that have no visual output. every test runs against
+//  the same engine setup as golden (harness.c), a failed check is reported and the run carries on.
+//
+//  build: make tests (see Makefile), make check runs every test then golden
+//  usage: CX_RESOURCE_PATH=.. tests [name ...]
+//
+
+#include "harness.h"
+#include "../source/app/earth.h"
+#include "../source/app/earth_index.h"
+#include "../source/engine/system/cx_thread.h"
+#include "../source/engine/system/cx_xml.h"
+#include "../source/engine/system/cx_string.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define TESTS_WIDTH             64
+#define TESTS_HEIGHT            64
+
+#define TEST_CHECK(X)           do { if (!(X)) { tests_fail (__FILE__, __LINE__, #X); } } while (0)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct test_case
+{
+  const char *name;
+  void (*func) (void);
+} test_case;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int g_checkFailures = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void tests_fail (const char *file, int line, const char *expr)
+{
+  printf ("\n  %s:%d: check failed: %s", file, line, expr);
+  
+  g_checkFailures++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define TEST_MEMORY_THREADS     4
+#define TEST_MEMORY_BLOCKS      256
+
+static void test_memory_totals (const cx_system_memory_stats *stats, cxi64 *blocksInUse, cxu64 *allocCount)
+{
+  *blocksInUse = 0;
+  *allocCount = 0;
+  
+  for (cxu32 i = 0; i < CX_SYSTEM_MEMORY_NUM_SIZE_CLASSES; ++i)
+  {
+    *blocksInUse += stats->sizeClass [i].blocksInUse;
+    *allocCount += stats->sizeClass [i].allocCount;
+  }
+}
+
+static cx_thread_exit_status test_memory_thread (void *userdata)
+{
+  // blocks outlive the thread, so its cache is retired while they are still in use
+  
+  void **blocks = (void **) userdata;
+  
+  for (int i = 0; i < TEST_MEMORY_BLOCKS; ++i)
+  {
+    blocks [i] = cx_malloc (16 + (i % 8) * 60);
+  }
+  
+  return CX_THREAD_EXIT_STATUS_SUCCESS;
+}
+
+static void test_memory (void)
+{
+#if CX_SYSTEM_CUSTOM_MEMORY_ALLOCATOR_ENABLED
+  cx_system_memory_stats stats;
+  cxi64 blocksInUse0, blocksInUse1;
+  cxu64 allocCount0, allocCount1;
+  
+  cx_system_memory_get_stats (&stats);
+  test_memory_totals (&stats, &blocksInUse0, &allocCount0);
+  
+  cxu64 bytesInUse0 = stats.bytesInUse;
+  cxu64 largeAllocCount0 = stats.largeAllocCount;
+  
+  // pooled blocks: 16 byte aligned, filled in debug builds, counted per size class
+  
+  void *blocks [TEST_MEMORY_BLOCKS];
+  
+  for (int i = 0; i < TEST_MEMORY_BLOCKS; ++i)
+  {
+    blocks [i] = cx_malloc (100);
+    
+    TEST_CHECK (((uintptr_t) blocks [i] & 15) == 0);
+#if CX_SYSTEM_MEMORY_DEBUG_FILL
+    TEST_CHECK (*((cxu32 *) blocks [i]) == 0xDEADBEEFu);
+#endif
+  }
+  
+  cx_system_memory_get_stats (&stats);
+  test_memory_totals (&stats, &blocksInUse1, &allocCount1);
+  
+  TEST_CHECK ((blocksInUse1 - blocksInUse0) == TEST_MEMORY_BLOCKS);
+  TEST_CHECK ((allocCount1 - allocCount0) == TEST_MEMORY_BLOCKS);
+  TEST_CHECK ((stats.bytesInUse - bytesInUse0) == (TEST_MEMORY_BLOCKS * 100));
+  TEST_CHECK (stats.bytesPeak >= stats.bytesInUse);
+  
+  // realloc within the size class stays put, past it the contents move
+  
+  memset (blocks [0], 0x5a, 100);
+  
+  void *grown = cx_realloc (blocks [0], 110);
+  TEST_CHECK (grown == blocks [0]);
+  
+  blocks [0] = cx_realloc (grown, 1000);
+  TEST_CHECK ((((cxu8 *) blocks [0]) [0] == 0x5a) && (((cxu8 *) blocks [0]) [99] == 0x5a));
+  
+  for (int i = 0; i < TEST_MEMORY_BLOCKS; ++i)
+  {
+    cx_free (blocks [i]);
+  }
+  
+  // large blocks bypass the pools
+  
+  void *large = cx_malloc (64 * 1024);
+  TEST_CHECK (((uintptr_t) large & 15) == 0);
+  
+  cx_system_memory_get_stats (&stats);
+  TEST_CHECK ((stats.largeAllocCount - largeAllocCount0) == 1);
+  
+  cx_free (large);
+  
+  cx_system_memory_get_stats (&stats);
+  test_memory_totals (&stats, &blocksInUse1, &allocCount1);
+  
+  TEST_CHECK (blocksInUse1 == blocksInUse0);
+  TEST_CHECK (stats.bytesInUse == bytesInUse0);
+  
+  // thread caches: counters of exited threads are kept, blocks can be freed on another thread
+  
+  void *threadBlocks [TEST_MEMORY_THREADS][TEST_MEMORY_BLOCKS];
+  cx_thread *threads [TEST_MEMORY_THREADS];
+  
+  for (int i = 0; i < TEST_MEMORY_THREADS; ++i)
+  {
+    threads [i] = cx_thread_create ("test_memory", CX_THREAD_TYPE_JOINABLE, test_memory_thread, threadBlocks [i]);
+    cx_thread_start (threads [i]);
+  }
+  
+  for (int i = 0; i < TEST_MEMORY_THREADS; ++i)
+  {
+    cx_thread_join (threads [i], NULL);
+    cx_thread_destroy (threads [i]);
+  }
+  
+  cx_system_memory_get_stats (&stats);
+  test_memory_totals (&stats, &blocksInUse0, &allocCount0);
+  
+  TEST_CHECK ((blocksInUse0 - blocksInUse1) == (TEST_MEMORY_THREADS * TEST_MEMORY_BLOCKS));
+  TEST_CHECK ((allocCount0 - allocCount1) >= (TEST_MEMORY_THREADS * TEST_MEMORY_BLOCKS)); // and cx_thread_create
+  
+  for (int i = 0; i < TEST_MEMORY_THREADS; ++i)
+  {
+    for (int j = 0; j < TEST_MEMORY_BLOCKS; ++j)
+    {
+      cx_free (threadBlocks [i][j]);
+    }
+  }
+  
+  cx_system_memory_get_stats (&stats);
+  test_memory_totals (&stats, &blocksInUse0, &allocCount0);
+  
+  TEST_CHECK (blocksInUse0 == blocksInUse1);
+  TEST_CHECK (stats.bytesInUse == bytesInUse0);
+#else
+  printf ("(allocator disabled) ");
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define TEST_XML_ATTRS          4
+#define TEST_XML_VALUE_MAX_LEN  64
+
+typedef struct test_xml_sax_item
+{
+  char names [TEST_XML_ATTRS][TEST_XML_VALUE_MAX_LEN];
+  char values [TEST_XML_ATTRS][TEST_XML_VALUE_MAX_LEN];
+  cxu32 count;
+} test_xml_sax_item;
+
+static void test_xml_sax_begin (void *userdata, const char *name, const char *nsprefix, const cx_xml_sax_attr *attrs, cxu32 attrCount)
+{
+  test_xml_sax_item *item = (test_xml_sax_item *) userdata;
+  
+  if (strcmp (name, "item") == 0)
+  {
+    item->count = cx_min (attrCount, TEST_XML_ATTRS);
+    
+    for (cxu32 i = 0; i < item->count; ++i)
+    {
+      cxu32 len = cx_min (attrs [i].valueLength, TEST_XML_VALUE_MAX_LEN - 1);
+      
+      cx_strcpy (item->names [i], TEST_XML_VALUE_MAX_LEN, attrs [i].name);
+      memcpy (item->values [i], attrs [i].value, len);
+      item->values [i][len] = 0;
+    }
+  }
+}
+
+static void test_xml (void)
+{
+  // sax attribute values match what the dom path returns
+  
+  const char *doc = "<rss><item link=\"http://a.b/?q=1&amp;r=2&#38;s\" title=\"&lt;b&gt; &quot;x&quot; &apos;y&apos;\" "
+                    "utf8=\"&#233;&#x263A;&#x1F600;\" plain=\"no references\"/></rss>";
+  
+  test_xml_sax_item item;
+  memset (&item, 0, sizeof (item));
+  
+  cx_xml_sax_callbacks callbacks;
+  memset (&callbacks, 0, sizeof (callbacks));
+  callbacks.element_begin = test_xml_sax_begin;
+  
+  TEST_CHECK (cx_xml_sax_parse (doc, (cxu32) strlen (doc), &callbacks, &item));
+  TEST_CHECK (item.count == TEST_XML_ATTRS);
+  
+  cx_xml_doc xmlDoc = cx_xml_doc_create (doc, (cxu32) strlen (doc));
+  cx_xml_node xmlItem = cx_xml_node_child (cx_xml_doc_root_node (xmlDoc), "item", NULL);
+  
+  TEST_CHECK (xmlItem);
+  
+  for (cxu32 i = 0; xmlItem && (i < item.count); ++i)
+  {
+    char *value = cx_xml_node_attr (xmlItem, item.names [i]);
+    
+    TEST_CHECK (value && (strcmp (value, item.values [i]) == 0));
+    
+    cx_free (value);
+  }
+  
+  TEST_CHECK (strcmp (item.values [0], "http://a.b/?q=1&r=2&s") == 0);
+  
+  cx_xml_doc_destroy (xmlDoc);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool test_earth_db_mapped (void)
+{
+  FILE *fp = fopen ("/proc/self/maps", "r");
+  
+  bool mapped = false;
+  
+  if (fp)
+  {
+    char line [1024];
+    
+    while (!mapped && fgets (line, sizeof (line), fp))
+    {
+      mapped = strstr (line, "earth.db") != NULL;
+    }
+    
+    fclose (fp);
+  }
+  
+  return mapped;
+}
+
+static void test_earth (void)
+{
+  // earth_deinit releases the mapped city database
+  
+  cx_date date;
+  memset (&date, 0, sizeof (date));
+  
+  for (int i = 0; i < 2; ++i)
+  {
+    TEST_CHECK (earth_init ("data/earth.json", &date));
+    TEST_CHECK (earth_data_get_count () > 0);
+    TEST_CHECK (test_earth_db_mapped ());
+    
+    while (cx_texture_stream_update (0xffffffff))
+    {
+    }
+    
+    earth_deinit ();
+    
+    TEST_CHECK (!test_earth_db_mapped ());
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define TEST_PICK_QUERIES       500
+#define TEST_PICK_MAX_RESULTS   4096
+
+static bool test_pick_filter (int index, void *userdata)
+{
+  CX_REF_UNUSED (userdata);
+  
+  return (index % 3) != 0;
+}
+
+static int test_pick_compare (const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+static void test_pick_random_point (cx_vec4 *point)
+{
+  float lat = cx_rad (((rand () / (float) RAND_MAX) * 180.0f) - 90.0f);
+  float lon = cx_rad (((rand () / (float) RAND_MAX) * 360.0f) - 180.0f);
+  
+  cx_vec4_set (point, cx_cos (lat) * cx_sin (lon) * 1.025f, cx_sin (lat) * 1.025f, cx_cos (lat) * cx_cos (lon) * 1.025f, 1.0f);
+}
+
+static void test_pick_count (int count)
+{
+  cx_vec4 *pos = cx_malloc (sizeof (cx_vec4) * count);
+  int *results [2] = { cx_malloc (sizeof (int) * TEST_PICK_MAX_RESULTS), cx_malloc (sizeof (int) * TEST_PICK_MAX_RESULTS) };
+  
+  for (int i = 0; i < count; ++i)
+  {
+    test_pick_random_point (&pos [i]);
+  }
+  
+  earth_index_t *index = earth_index_create (pos, count);
+  
+  TEST_CHECK (index);
+  TEST_CHECK (earth_index_get_count (index) == count);
+  TEST_CHECK (fabsf (earth_index_get_radius (index) - 1.025f) < 1.0e-3f);
+  
+  const float touchRadius = 0.025f;
+  const float areaRadius = 0.05f;
+  
+  int nearestErrors = 0;
+  int withinErrors = 0;
+  int hits = 0;
+  
+  for (int q = 0; q < TEST_PICK_QUERIES; ++q)
+  {
+    // half the queries right on a city that passes the filter so there is always something to find
+    
+    cx_vec4 query;
+    
+    if (q & 1)
+    {
+      int i = rand () % count;
+      
+      query = pos [((i % 3) || ((i + 1) >= count)) ? i : (i + 1)];
+    }
+    else
+    {
+      test_pick_random_point (&query);
+    }
+    
+    // nearest within touch radius (ties go to the first index)
+    
+    int best = EARTH_INDEX_INVALID;
+    float bestDistSq = touchRadius * touchRadius;
+    int n1 = 0;
+    
+    for (int i = 0; i < count; ++i)
+    {
+      float dx = pos [i].x - query.x;
+      float dy = pos [i].y - query.y;
+      float dz = pos [i].z - query.z;
+      float distSq = (dx * dx) + (dy * dy) + (dz * dz);
+      
+      if (!test_pick_filter (i, NULL))
+      {
+        continue;
+      }
+      
+      if ((distSq < bestDistSq) || ((distSq == bestDistSq) && (best == EARTH_INDEX_INVALID)))
+      {
+        best = i;
+        bestDistSq = distSq;
+      }
+      
+      if ((distSq <= (areaRadius * areaRadius)) && (n1 < TEST_PICK_MAX_RESULTS))
+      {
+        results [1][n1++] = i;
+      }
+    }
+    
+    int nearest = earth_index_find_nearest (index, &query, touchRadius, test_pick_filter, NULL);
+    
+    nearestErrors += (nearest != best);
+    hits += (nearest != EARTH_INDEX_INVALID);
+    
+    // all within a larger radius, compared as sorted sets
+    
+    int n0 = earth_index_find_within (index, &query, areaRadius, results [0], TEST_PICK_MAX_RESULTS, test_pick_filter, NULL);
+    
+    if (n0 != n1)
+    {
+      withinErrors++;
+    }
+    else
+    {
+      qsort (results [0], n0, sizeof (int), test_pick_compare);
+      qsort (results [1], n1, sizeof (int), test_pick_compare);
+      
+      withinErrors += (memcmp (results [0], results [1], sizeof (int) * n0) != 0);
+    }
+  }
+  
+  TEST_CHECK (nearestErrors == 0);
+  TEST_CHECK (withinErrors == 0);
+  TEST_CHECK (hits >= ((count > 1) ? (TEST_PICK_QUERIES / 2) : 0));
+  
+  earth_index_destroy (index);
+  
+  cx_free (pos);
+  cx_free (results [0]);
+  cx_free (results [1]);
+}
+
+static void test_pick (void)
+{
+  // city index matches a brute force search (nearest within touch radius and all within a larger radius)
+  
+  test_pick_count (1);
+  test_pick_count (1000);
+  test_pick_count (100000);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static cx_texture *test_texture_cache_load (int icon)
+{
+  char filename [64];
+  cx_sprintf (filename, 64, "data/images/weather/a%d.png", icon);
+  
+  return cx_texture_create_from_file (filename, CX_FILE_STORAGE_BASE_RESOURCE, false);
+}
+
+static void test_texture_cache (void)
+{
+  // shared loads are reference counted and decoded once, released textures stay resident until the
+  // cache goes over budget and then go least recently released first
+  
+  cx_texture_cache_stats stats, base;
+  
+  cx_texture_cache_purge ();
+  cx_texture_cache_reset_stats ();
+  cx_texture_cache_get_stats (&base);
+  
+  // refcount and single decode
+  
+  cx_texture *a = test_texture_cache_load (0);
+  cx_texture *b = test_texture_cache_load (0);
+  
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK (a && (a == b));
+  TEST_CHECK (a && a->cached);
+  TEST_CHECK ((stats.misses == 1) && (stats.hits == 1));
+  TEST_CHECK (stats.count == (base.count + 1));
+  
+  cx_texture_destroy (b);
+  cx_texture_cache_purge ();
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK (stats.count == (base.count + 1));
+  TEST_CHECK (stats.unreferenced == base.unreferenced);
+  
+  cx_texture_destroy (a);
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK (stats.count == (base.count + 1));
+  TEST_CHECK (stats.unreferenced == (base.unreferenced + 1));
+  
+  a = test_texture_cache_load (0);
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK ((stats.misses == 1) && (stats.hits == 2));
+  TEST_CHECK (stats.unreferenced == base.unreferenced);
+  
+  cx_texture_destroy (a);
+  
+  // lru eviction: release 0, 1, 2 in order then drop the budget just below what's resident
+  
+  cx_texture *icons [3];
+  
+  for (int i = 0; i < 3; ++i)
+  {
+    icons [i] = test_texture_cache_load (i);
+    
+    TEST_CHECK (icons [i]);
+  }
+  
+  for (int i = 0; i < 3; ++i)
+  {
+    if (icons [i])
+    {
+      cx_texture_destroy (icons [i]);
+    }
+  }
+  
+  cx_texture_cache_reset_stats ();
+  cx_texture_cache_get_stats (&stats);
+  
+  cxu32 budget = stats.budget;
+  
+  cx_texture_cache_set_budget (stats.bytes - 1);
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK (stats.evictions == 1);
+  
+  cx_texture_cache_set_budget (budget);
+  
+  for (int i = 1; i < 3; ++i)
+  {
+    icons [i] = test_texture_cache_load (i);
+    
+    TEST_CHECK (icons [i]);
+  }
+  
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK ((stats.hits == 2) && (stats.misses == 0));
+  
+  icons [0] = test_texture_cache_load (0);
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK (icons [0]);
+  TEST_CHECK ((stats.hits == 2) && (stats.misses == 1));
+  
+  for (int i = 0; i < 3; ++i)
+  {
+    if (icons [i])
+    {
+      cx_texture_destroy (icons [i]);
+    }
+  }
+  
+  cx_texture_cache_purge ();
+  cx_texture_cache_get_stats (&stats);
+  
+  TEST_CHECK (stats.count == base.count);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const test_case g_tests [] =
+{
+  { "memory", test_memory },
+  { "xml", test_xml },
+  { "earth", test_earth },
+  { "pick", test_pick },
+  { "texture_cache", test_texture_cache },
+};
+
+static const int g_testCount = sizeof (g_tests) / sizeof (test_case);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool tests_selected (const test_case *test, int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    return true;
+  }
+  
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp (argv [i], test->name) == 0)
+    {
+      return true;
+    }
+  }
+  
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int main (int argc, char **argv)
+{
+  if (!harness_init (TESTS_WIDTH, TESTS_HEIGHT))
+  {
+    return 1;
+  }
+  
+  int runCount = 0;
+  int failCount = 0;
+  
+  for (int i = 0; i < g_testCount; ++i)
+  {
+    const test_case *test = &g_tests [i];
+    
+    if (tests_selected (test, argc, argv))
+    {
+      int checkFailures = g_checkFailures;
+      
+      printf ("%-16s ", test->name);
+      fflush (stdout);
+      
+      test->func ();
+      
+      bool success = (g_checkFailures == checkFailures);
+      
+      printf ("%s\n", success ? "ok" : "\nFAILED");
+      
+      runCount++;
+      failCount += success ? 0 : 1;
+    }
+  }
+  
+  harness_deinit ();
+  
+  printf ("%d/%d tests passed\n", runCount - failCount, runCount);
+  
+  return ((runCount > 0) && (failCount == 0)) ? 0 : 1;
+}